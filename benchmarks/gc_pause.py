@@ -0,0 +1,73 @@
+"""Measure full GC collection pauses with many live multidicts.
+
+A server keeps lots of small header dicts alive, every gen-2 collection
+has to traverse the tracked ones.  The script builds such dicts and
+reports the duration of gc.collect().
+"""
+
+import argparse
+import gc
+import importlib
+import time
+
+IMPLEMENTATIONS = {
+    "multidict_c": ("multidict._multidict", "MultiDict"),
+    "cimultidict_c": ("multidict._multidict", "CIMultiDict"),
+    "multidict_py": ("multidict._multidict_py", "MultiDict"),
+    "cimultidict_py": ("multidict._multidict_py", "CIMultiDict"),
+}
+
+HEADERS = [
+    ("Host", "example.com"),
+    ("User-Agent", "python-requests/2.31.0"),
+    ("Accept", "*/*"),
+    ("Accept-Encoding", "gzip, deflate"),
+    ("Connection", "keep-alive"),
+    ("Content-Type", "application/json"),
+    ("Content-Length", "42"),
+    ("Cookie", "session=abc"),
+]
+
+
+def measure(cls, count, repeat):
+    dicts = [cls(HEADERS) for _ in range(count)]
+    gc.collect()
+    timings = []
+    for _ in range(repeat):
+        t0 = time.perf_counter()
+        gc.collect()
+        timings.append(time.perf_counter() - t0)
+    tracked = sum(gc.is_tracked(md) for md in dicts)
+    return min(timings), tracked
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Allows to measure GC pauses with many live multidicts"
+    )
+    parser.add_argument(
+        "--impl",
+        choices=sorted(IMPLEMENTATIONS),
+        help="specific implementation to measure",
+    )
+    parser.add_argument(
+        "--count",
+        type=int,
+        default=300_000,
+        help="number of live multidicts",
+    )
+    parser.add_argument(
+        "--repeat",
+        type=int,
+        default=5,
+        help="number of measured collections, the best one is reported",
+    )
+
+    options = parser.parse_args()
+    implementations = (options.impl,) if options.impl else IMPLEMENTATIONS
+
+    for impl in implementations:
+        module, name = IMPLEMENTATIONS[impl]
+        cls = getattr(importlib.import_module(module), name)
+        pause, tracked = measure(cls, options.count, options.repeat)
+        print(f"{impl:15} gc.collect(): {pause * 1000:8.2f} ms  tracked: {tracked}")
@@ -16,6 +16,26 @@ INIT = """\
 val = istr('VaLuE')
 """
 
+NAMES = {
+    "short lower": "'host'",
+    "short mixed": "'Host'",
+    "long lower": "'access-control-allow-credentials'",
+    "long mixed": "'Access-Control-Allow-Credentials'",
+}
+
+STR_TO_ISTR = """\
+istr(name)
+istr(name)
+istr(name)
+istr(name)
+istr(name)
+istr(name)
+istr(name)
+istr(name)
+istr(name)
+istr(name)
+"""
+
 
 ISTR_TO_ISTR = """\
 istr(val)
@@ -64,3 +84,10 @@ if __name__ == "__main__":
         )
 
         runner.timeit(name("istr->istr"), ISTR_TO_ISTR, imports + INIT, inner_loops=10)
+        for case, value in NAMES.items():
+            runner.timeit(
+                name(f"str->istr ({case})"),
+                STR_TO_ISTR,
+                imports + f"name = {value}\n",
+                inner_loops=10,
+            )
@@ -0,0 +1,85 @@
+"""Measure the latency distribution of single add() calls.
+
+benchmark.py reports mean timings which hide the occasional slow call
+that has to resize the table, this script times every add() while a large
+multidict is built and reports percentiles.  Page faults and other
+processes add random spikes, the medians of several runs are reported.
+"""
+
+import argparse
+import gc
+import importlib
+import statistics
+import time
+
+IMPLEMENTATIONS = {
+    "multidict_c": ("multidict._multidict", "MultiDict"),
+    "cimultidict_c": ("multidict._multidict", "CIMultiDict"),
+    "multidict_py": ("multidict._multidict_py", "MultiDict"),
+    "cimultidict_py": ("multidict._multidict_py", "CIMultiDict"),
+}
+
+PERCENTILES = (50, 99, 99.9, 99.99)
+
+
+def measure(cls, keys):
+    timer = time.perf_counter_ns
+    timings = []
+    append = timings.append
+    md = cls()
+    add = md.add
+    gc.disable()
+    try:
+        for key in keys:
+            t0 = timer()
+            add(key, None)
+            append(timer() - t0)
+    finally:
+        gc.enable()
+    timings.sort()
+    return timings
+
+
+def percentiles(timings):
+    last = len(timings) - 1
+    return [timings[int(last * p / 100)] for p in PERCENTILES] + [timings[-1]]
+
+
+def report(impl, runs):
+    values = [int(statistics.median(column)) for column in zip(*runs)]
+    cols = [f"p{p}: {value:8} ns" for p, value in zip(PERCENTILES, values)]
+    cols.append(f"max: {values[-1]:10} ns")
+    print(f"{impl:15} " + "  ".join(cols))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Allows to measure add() latency of MultiDict implementations"
+    )
+    parser.add_argument(
+        "--impl",
+        choices=sorted(IMPLEMENTATIONS),
+        help="specific implementation to measure",
+    )
+    parser.add_argument(
+        "--size",
+        type=int,
+        default=1_000_000,
+        help="number of items added to the multidict",
+    )
+    parser.add_argument(
+        "--repeat",
+        type=int,
+        default=3,
+        help="number of runs to take the medians from",
+    )
+
+    options = parser.parse_args()
+    implementations = (options.impl,) if options.impl else IMPLEMENTATIONS
+    keys = [f"key{i}" for i in range(options.size)]
+
+    for impl in implementations:
+        module, name = IMPLEMENTATIONS[impl]
+        cls = getattr(importlib.import_module(module), name)
+        runs = [percentiles(measure(cls, keys)) for _ in range(options.repeat)]
+        report(impl, runs)
@@ -0,0 +1,88 @@
+"""Measure memory retained by multidicts.
+
+Unlike benchmark.py it reports sizes, not timings: sys.getsizeof() of the
+multidict left after each scenario, keys and values are not counted.
+"""
+
+import argparse
+import importlib
+import sys
+
+IMPLEMENTATIONS = {
+    "multidict_c": ("multidict._multidict", "MultiDict"),
+    "cimultidict_c": ("multidict._multidict", "CIMultiDict"),
+    "multidict_py": ("multidict._multidict_py", "MultiDict"),
+    "cimultidict_py": ("multidict._multidict_py", "CIMultiDict"),
+}
+
+KEYS = [f"key{i}" for i in range(5000)]
+
+
+def small(cls):
+    return cls((key, "v") for key in KEYS[:8])
+
+
+def after_peak_delitem(cls):
+    # a connection state dict that briefly reached thousands of items
+    md = cls((key, "v") for key in KEYS)
+    for key in KEYS[8:]:
+        del md[key]
+    return md
+
+
+def after_peak_popone(cls):
+    md = cls((key, "v") for key in KEYS)
+    for key in KEYS[8:]:
+        md.popone(key)
+    return md
+
+
+def after_peak_popall(cls):
+    md = cls((key, "v") for key in KEYS)
+    for key in KEYS[8:]:
+        md.add(key, "w")
+    for key in KEYS[8:]:
+        md.popall(key)
+    return md
+
+
+def after_peak_popitem(cls):
+    md = cls((key, "v") for key in KEYS)
+    for _ in KEYS[8:]:
+        md.popitem()
+    return md
+
+
+SCENARIOS = {
+    "small": small,
+    "after peak, __delitem__": after_peak_delitem,
+    "after peak, popone": after_peak_popone,
+    "after peak, popall": after_peak_popall,
+    "after peak, popitem": after_peak_popitem,
+}
+
+
+def measure(cls, scenario):
+    md = scenario(cls)
+    assert len(md) == 8
+    return sys.getsizeof(md)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Allows to measure memory usage of MultiDict implementations"
+    )
+    parser.add_argument(
+        "--impl",
+        choices=sorted(IMPLEMENTATIONS),
+        help="specific implementation to measure",
+    )
+
+    options = parser.parse_args()
+    implementations = (options.impl,) if options.impl else IMPLEMENTATIONS
+
+    for impl in implementations:
+        module, name = IMPLEMENTATIONS[impl]
+        cls = getattr(importlib.import_module(module), name)
+        for case, scenario in SCENARIOS.items():
+            print(f"{impl:15} {case:25} {measure(cls, scenario):10} bytes")
@@ -14,10 +14,14 @@ from ._compat import USE_EXTENSIONS
 __all__ = (
     "CIMultiDict",
     "CIMultiDictProxy",
+    "FrozenCIMultiDict",
+    "FrozenMultiDict",
     "MultiDict",
     "MultiDictProxy",
     "MultiMapping",
     "MutableMultiMapping",
+    "PersistentCIMultiDict",
+    "PersistentMultiDict",
     "getversion",
     "istr",
     "upstr",
@@ -30,8 +34,12 @@ if TYPE_CHECKING or not USE_EXTENSIONS:
     from ._multidict_py import (
         CIMultiDict,
         CIMultiDictProxy,
+        FrozenCIMultiDict,
+        FrozenMultiDict,
         MultiDict,
         MultiDictProxy,
+        PersistentCIMultiDict,
+        PersistentMultiDict,
         getversion,
         istr,
     )
@@ -41,8 +49,12 @@ else:
     from ._multidict import (
         CIMultiDict,
         CIMultiDictProxy,
+        FrozenCIMultiDict,
+        FrozenMultiDict,
         MultiDict,
         MultiDictProxy,
+        PersistentCIMultiDict,
+        PersistentMultiDict,
         _ItemsView,
         _KeysView,
         _ValuesView,
@@ -51,6 +63,8 @@ else:
     )
 
     MultiMapping.register(MultiDictProxy)
+    MultiMapping.register(FrozenMultiDict)
+    MultiMapping.register(PersistentMultiDict)
     MutableMultiMapping.register(MultiDict)
     KeysView.register(_KeysView)
     ItemsView.register(_ItemsView)
@@ -3,12 +3,16 @@
 
 #include "_multilib/dict.h"
 #include "_multilib/hashtable.h"
+#include "_multilib/headerblock.h"
+#include "_multilib/intern.h"
 #include "_multilib/istr.h"
 #include "_multilib/iter.h"
 #include "_multilib/parser.h"
+#include "_multilib/persistent.h"
 #include "_multilib/pythoncapi_compat.h"
 #include "_multilib/state.h"
 #include "_multilib/views.h"
+#include "multidict_api.h"
 
 #define MultiDict_CheckExact(state, obj) Py_IS_TYPE(obj, state->MultiDictType)
 #define MultiDict_Check(state, obj)      \
@@ -37,9 +41,77 @@
     (MultiDictProxy_CheckExact(state, obj) ||   \
      CIMultiDictProxy_CheckExact(state, obj) || \
      PyObject_TypeCheck(obj, state->MultiDictProxyType))
+#define FrozenMultiDict_CheckExact(state, obj) \
+    Py_IS_TYPE(obj, state->FrozenMultiDictType)
+#define FrozenCIMultiDict_CheckExact(state, obj) \
+    Py_IS_TYPE(obj, state->FrozenCIMultiDictType)
+#define AnyFrozenMultiDict_Check(state, obj)     \
+    (FrozenMultiDict_CheckExact(state, obj) ||   \
+     FrozenCIMultiDict_CheckExact(state, obj) || \
+     PyObject_TypeCheck(obj, state->FrozenMultiDictType))
+#define PersistentMultiDict_CheckExact(state, obj) \
+    Py_IS_TYPE(obj, state->PersistentMultiDictType)
+#define PersistentCIMultiDict_CheckExact(state, obj) \
+    Py_IS_TYPE(obj, state->PersistentCIMultiDictType)
+#define AnyPersistentMultiDict_Check(state, obj)     \
+    (PersistentMultiDict_CheckExact(state, obj) ||   \
+     PersistentCIMultiDict_CheckExact(state, obj) || \
+     PyObject_TypeCheck(obj, state->PersistentMultiDictType))
 
 /******************** Internal Methods ********************/
 
+/* Allocate a multidict of the type, the callers knowing the module state
+   skip the lookup of multidict_tp_alloc() */
+static inline PyObject *
+_multidict_alloc(mod_state *state, PyTypeObject *type, Py_ssize_t nitems)
+{
+    if (type == state->MultiDictType || type == state->CIMultiDictType) {
+        PyObject *op = freelist_pop(&state->multidict_freelist, type);
+        if (op != NULL) {
+            return op;
+        }
+    } else if (type != state->FrozenMultiDictType &&
+               type != state->FrozenCIMultiDictType) {
+        return PyType_GenericAlloc(type, nitems);
+    }
+    // untracked until an item that may be tracked is stored,
+    // see _md_maintain_tracking()
+    PyObject *op = PyType_GenericAlloc(type, nitems);
+    if (op != NULL) {
+        PyObject_GC_UnTrack(op);
+    }
+    return op;
+}
+
+/* The items of a persistent multidict as (CI)FrozenMultiDict for
+   iteration, views and comparison.  It is built on the first use and
+   cached, returns a borrowed reference. */
+static inline MultiDictObject *
+_persistent_multidict_frozen(PersistentMultiDictObject *self)
+{
+    MultiDictObject *ret;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    ret = self->frozen;
+    if (ret == NULL) {
+        mod_state *state = self->state;
+        PyTypeObject *type = self->is_ci ? state->FrozenCIMultiDictType
+                                         : state->FrozenMultiDictType;
+        FrozenMultiDictObject *fmd =
+            (FrozenMultiDictObject *)_multidict_alloc(state, type, 0);
+        if (fmd != NULL) {
+            fmd->hash = -1;
+            if (md_init(&fmd->md, state, self->is_ci, self->used) < 0 ||
+                pmd_to_md(self, &fmd->md) < 0 || md_freeze(&fmd->md) < 0) {
+                Py_CLEAR(fmd);
+            }
+        }
+        ret = (MultiDictObject *)fmd;
+        self->frozen = ret;
+    }
+    Py_END_CRITICAL_SECTION();
+    return ret;
+}
+
 static inline PyObject *
 _multidict_getone(MultiDictObject *self, PyObject *key, PyObject *_default)
 {
@@ -70,6 +142,15 @@ _multidict_extend(MultiDictObject *self, PyObject *arg, PyObject *kwds,
 {
     mod_state *state = self->state;
     PyObject *seq = NULL;
+    md_dirty_t dirty;
+    bool in_update = self->in_update;  // could be nested by a callback
+
+    if (op != Extend) {  // Update or Merge
+        // soft deletions are not mirrored to the next table
+        md_finish_resize(self);
+        self->in_update = true;
+    }
+    md_dirty_init(&dirty, self);
 
     if (kwds && !PyArg_ValidateKeywordArguments(kwds)) {
         goto fail;
@@ -78,24 +159,38 @@ _multidict_extend(MultiDictObject *self, PyObject *arg, PyObject *kwds,
     if (arg != NULL) {
         if (AnyMultiDict_Check(state, arg)) {
             MultiDictObject *other = (MultiDictObject *)arg;
-            if (md_update_from_ht(self, other, op) < 0) {
+            if (md_update_from_ht(self, other, op, &dirty) < 0) {
                 goto fail;
             }
         } else if (AnyMultiDictProxy_Check(state, arg)) {
             MultiDictObject *other = ((MultiDictProxyObject *)arg)->md;
-            if (md_update_from_ht(self, other, op) < 0) {
+            if (md_update_from_ht(self, other, op, &dirty) < 0) {
+                goto fail;
+            }
+        } else if (AnyFrozenMultiDict_Check(state, arg)) {
+            MultiDictObject *other = (MultiDictObject *)arg;
+            if (md_update_from_ht(self, other, op, &dirty) < 0) {
+                goto fail;
+            }
+        } else if (AnyPersistentMultiDict_Check(state, arg)) {
+            MultiDictObject *other =
+                _persistent_multidict_frozen((PersistentMultiDictObject *)arg);
+            if (other == NULL) {
+                goto fail;
+            }
+            if (md_update_from_ht(self, other, op, &dirty) < 0) {
                 goto fail;
             }
         } else if (PyDict_CheckExact(arg)) {
-            if (md_update_from_dict(self, arg, op) < 0) {
+            if (md_update_from_dict(self, arg, op, &dirty) < 0) {
                 goto fail;
             }
         } else if (PyList_CheckExact(arg)) {
-            if (md_update_from_seq(self, arg, op) < 0) {
+            if (md_update_from_seq(self, arg, op, &dirty) < 0) {
                 goto fail;
             }
         } else if (PyTuple_CheckExact(arg)) {
-            if (md_update_from_seq(self, arg, op) < 0) {
+            if (md_update_from_seq(self, arg, op, &dirty) < 0) {
                 goto fail;
             }
         } else {
@@ -105,20 +200,21 @@ _multidict_extend(MultiDictObject *self, PyObject *arg, PyObject *kwds,
                 seq = Py_NewRef(arg);
             }
 
-            if (md_update_from_seq(self, seq, op) < 0) {
+            if (md_update_from_seq(self, seq, op, &dirty) < 0) {
                 goto fail;
             }
         }
     }
 
     if (kwds != NULL) {
-        if (md_update_from_dict(self, kwds, op) < 0) {
+        if (md_update_from_dict(self, kwds, op, &dirty) < 0) {
             goto fail;
         }
     }
 
     if (op != Extend) {  // Update or Merge
-        md_post_update(self);
+        md_post_update(self, &dirty);
+        self->in_update = in_update;
     }
 
     ASSERT_CONSISTENT(self, false);
@@ -127,7 +223,8 @@ _multidict_extend(MultiDictObject *self, PyObject *arg, PyObject *kwds,
 fail:
     if (op != Extend) {  // Update or Merge
         // Cleanup soft-deleted items
-        md_post_update(self);
+        md_post_update(self, &dirty);
+        self->in_update = in_update;
     }
     ASSERT_CONSISTENT(self, false);
     Py_CLEAR(seq);
@@ -170,6 +267,13 @@ _multidict_extend_parse_args(mod_state *state, PyObject *args, PyObject *kwds,
                    CIMultiDictProxy_CheckExact(state, *parg)) {
             MultiDictObject *md = ((MultiDictProxyObject *)*parg)->md;
             size += md_len(md);
+        } else if (FrozenMultiDict_CheckExact(state, *parg) ||
+                   FrozenCIMultiDict_CheckExact(state, *parg)) {
+            MultiDictObject *md = (MultiDictObject *)*parg;
+            size += md_len(md);
+        } else if (PersistentMultiDict_CheckExact(state, *parg) ||
+                   PersistentCIMultiDict_CheckExact(state, *parg)) {
+            size += ((PersistentMultiDictObject *)*parg)->used;
         } else {
             s = PyObject_LengthHint(*parg, 0);
             if (s < 0) {
@@ -206,6 +310,15 @@ _multidict_clone_fast(mod_state *state, MultiDictObject *self, bool is_ci,
             other = (MultiDictObject *)arg;
         } else if (AnyMultiDictProxy_Check(state, arg)) {
             other = ((MultiDictProxyObject *)arg)->md;
+        } else if (AnyFrozenMultiDict_Check(state, arg)) {
+            other = (MultiDictObject *)arg;
+        } else if (AnyPersistentMultiDict_Check(state, arg)) {
+            other =
+                _persistent_multidict_frozen((PersistentMultiDictObject *)arg);
+            if (other == NULL) {
+                ret = -1;
+                goto done;
+            }
         }
         if (other != NULL && other->is_ci == is_ci) {
             if (md_clone_from_ht(self, other) < 0) {
@@ -221,9 +334,9 @@ done:
 }
 
 static inline PyObject *
-multidict_copy(MultiDictObject *self)
+_multidict_copy_as(MultiDictObject *self, PyTypeObject *type)
 {
-    PyObject *ret = PyType_GenericNew(Py_TYPE(self), NULL, NULL);
+    PyObject *ret = _multidict_alloc(self->state, type, 0);
     if (ret == NULL) {
         goto fail;
     }
@@ -239,6 +352,12 @@ fail:
     return NULL;
 }
 
+static inline PyObject *
+multidict_copy(MultiDictObject *self)
+{
+    return _multidict_copy_as(self, Py_TYPE(self));
+}
+
 static inline PyObject *
 _multidict_proxy_copy(MultiDictProxyObject *self, PyTypeObject *type)
 {
@@ -303,6 +422,16 @@ multidict_getone(MultiDictObject *self, PyObject *const *args,
     return _multidict_getone(self, key, _default);
 }
 
+static inline PyObject *
+multidict_count(MultiDictObject *self, PyObject *key)
+{
+    Py_ssize_t count = md_count(self, key);
+    if (count < 0) {
+        return NULL;
+    }
+    return PyLong_FromSsize_t(count);
+}
+
 static inline PyObject *
 multidict_get(MultiDictObject *self, PyObject *const *args, Py_ssize_t nargs,
               PyObject *kwnames)
@@ -355,8 +484,8 @@ multidict_values(MultiDictObject *self)
     return multidict_valuesview_new(self);
 }
 
-static PyObject *
-multidict_reduce(MultiDictObject *self)
+static inline PyObject *
+_multidict_reduce_as(MultiDictObject *self, PyTypeObject *type)
 {
     PyObject *items = NULL, *items_list = NULL, *args = NULL, *result = NULL;
 
@@ -375,7 +504,7 @@ multidict_reduce(MultiDictObject *self)
         goto ret;
     }
 
-    result = PyTuple_Pack(2, Py_TYPE(self), args);
+    result = PyTuple_Pack(2, type, args);
 ret:
     Py_XDECREF(args);
     Py_XDECREF(items_list);
@@ -384,6 +513,12 @@ ret:
     return result;
 }
 
+static PyObject *
+multidict_reduce(MultiDictObject *self)
+{
+    return _multidict_reduce_as(self, Py_TYPE(self));
+}
+
 static PyObject *
 multidict_repr(MultiDictObject *self)
 {
@@ -462,6 +597,15 @@ multidict_tp_richcompare(MultiDictObject *self, PyObject *other, int op)
         cmp = md_eq(self, (MultiDictObject *)other);
     } else if (AnyMultiDictProxy_Check(state, other)) {
         cmp = md_eq(self, ((MultiDictProxyObject *)other)->md);
+    } else if (AnyFrozenMultiDict_Check(state, other)) {
+        cmp = md_eq(self, (MultiDictObject *)other);
+    } else if (AnyPersistentMultiDict_Check(state, other)) {
+        MultiDictObject *md =
+            _persistent_multidict_frozen((PersistentMultiDictObject *)other);
+        if (md == NULL) {
+            return NULL;
+        }
+        cmp = md_eq(self, md);
     } else {
         bool fits = false;
         fits = PyDict_Check(other);
@@ -490,14 +634,31 @@ multidict_tp_richcompare(MultiDictObject *self, PyObject *other, int op)
     return PyBool_FromLong(cmp);
 }
 
+static PyObject *
+multidict_tp_alloc(PyTypeObject *type, Py_ssize_t nitems)
+{
+    PyObject *mod = PyType_GetModuleByDef(type, &multidict_module);
+    if (mod == NULL) {
+        return NULL;
+    }
+    return _multidict_alloc(get_mod_state(mod), type, nitems);
+}
+
 static void
 multidict_tp_dealloc(MultiDictObject *self)
 {
+    PyTypeObject *tp = Py_TYPE(self);
+    mod_state *state = self->state;
     PyObject_GC_UnTrack(self);
     Py_TRASHCAN_BEGIN(self, multidict_tp_dealloc)
         PyObject_ClearWeakRefs((PyObject *)self);
     md_clear(self);
-    Py_TYPE(self)->tp_free((PyObject *)self);
+    if (state == NULL ||
+        (tp != state->MultiDictType && tp != state->CIMultiDictType) ||
+        !freelist_push(&state->multidict_freelist, (PyObject *)self)) {
+        tp->tp_free((PyObject *)self);
+    }
+    Py_DECREF(tp);
     Py_TRASHCAN_END  // there should be no code after this
 }
 
@@ -519,6 +680,9 @@ PyDoc_STRVAR(multidict_getall_doc,
 
 PyDoc_STRVAR(multidict_getone_doc, "Get first value matching the key.");
 
+PyDoc_STRVAR(multidict_count_doc,
+             "Return the number of values matching the key.");
+
 PyDoc_STRVAR(
     multidict_get_doc,
     "Get first value matching the key.\n\nThe method is alias for .getone().");
@@ -551,12 +715,22 @@ multidict_tp_init(MultiDictObject *self, PyObject *args, PyObject *kwds)
     } else if (tmp == 1) {
         goto done;
     }
+    Py_ssize_t slot = -1;
+    if (kwds == NULL) {
+        tmp = md_init_split(self, state, false, arg, &slot);
+        if (tmp < 0) {
+            goto fail;
+        } else if (tmp == 1) {
+            goto done;
+        }
+    }
     if (md_init(self, state, false, size) < 0) {
         goto fail;
     }
     if (_multidict_extend(self, arg, kwds, "MultiDict", Extend) < 0) {
         goto fail;
     }
+    md_publish_layout(self, slot);
 done:
     Py_CLEAR(arg);
     ASSERT_CONSISTENT(self, false);
@@ -607,12 +781,76 @@ fail:
 }
 
 static PyObject *
-multidict_clear(MultiDictObject *self)
+multidict_clear(MultiDictObject *self, PyObject *const *args, Py_ssize_t nargs,
+                PyObject *kwnames)
+{
+    int keep_capacity = 0;
+
+    if (nargs != 0) {
+        PyErr_Format(PyExc_TypeError,
+                     "clear() takes no positional arguments but %zd were given",
+                     nargs);
+        return NULL;
+    }
+    if (kwnames != NULL) {
+        Py_ssize_t kwsize = PyTuple_Size(kwnames);
+        if (kwsize < 0) {
+            return NULL;
+        }
+        for (Py_ssize_t i = 0; i < kwsize; i++) {
+            PyObject *argname = PyTuple_GetItem(kwnames, i);
+            if (argname == NULL) {
+                return NULL;
+            }
+            if (argname != self->state->str_keep_capacity &&
+                PyUnicode_Compare(argname, self->state->str_keep_capacity) !=
+                    0) {
+                raise_unexpected_kwarg("clear", argname);
+                return NULL;
+            }
+            keep_capacity = PyObject_IsTrue(args[i]);
+            if (keep_capacity < 0) {
+                return NULL;
+            }
+        }
+    }
+
+    if (keep_capacity) {
+        if (md_clear_keep_capacity(self) < 0) {
+            return NULL;
+        }
+    } else if (md_clear(self) < 0) {
+        return NULL;
+    }
+
+    ASSERT_CONSISTENT(self, false);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+multidict_reserve(MultiDictObject *self, PyObject *arg)
 {
-    if (md_clear(self) < 0) {
+    Py_ssize_t size = PyNumber_AsSsize_t(arg, PyExc_OverflowError);
+    if (size == -1 && PyErr_Occurred()) {
+        return NULL;
+    }
+    if (size < 0) {
+        PyErr_SetString(PyExc_ValueError, "size should be non-negative");
+        return NULL;
+    }
+    if (md_reserve_capacity(self, size) < 0) {
         return NULL;
     }
+    ASSERT_CONSISTENT(self, false);
+    Py_RETURN_NONE;
+}
 
+static PyObject *
+multidict_shrink_to_fit(MultiDictObject *self)
+{
+    if (md_shrink_to_fit(self) < 0) {
+        return NULL;
+    }
     ASSERT_CONSISTENT(self, false);
     Py_RETURN_NONE;
 }
@@ -820,7 +1058,15 @@ PyDoc_STRVAR(multdicit_method_extend_doc,
              "Extend current MultiDict with more values.\n\
 This method must be used instead of update.");
 
-PyDoc_STRVAR(multidict_clear_doc, "Remove all items from MultiDict");
+PyDoc_STRVAR(multidict_clear_doc,
+             "Remove all items from MultiDict.\n\n\
+If keep_capacity is true, the allocated storage is kept for reusing.");
+
+PyDoc_STRVAR(multidict_reserve_doc,
+             "Make room for at least size more items without resizing.");
+
+PyDoc_STRVAR(multidict_shrink_to_fit_doc,
+             "Release the storage not needed by the current items.");
 
 PyDoc_STRVAR(
     multidict_setdefault_doc,
@@ -855,12 +1101,26 @@ PyDoc_STRVAR(multidict_merge_doc,
 
 PyDoc_STRVAR(sizeof__doc__, "D.__sizeof__() -> size of D in memory, in bytes");
 
+static inline PyObject *
+_multidict_sizeof(MultiDictObject *self, Py_ssize_t size)
+{
+    // a shared table is not counted, like shared keys of dicts
+    if (self->keys != &empty_htkeys && self->keys->refcnt == 1) {
+        size += htkeys_sizeof(self->keys);
+        if (self->keys->next != NULL) {
+            size += htkeys_sizeof(self->keys->next);
+        }
+    }
+    if (self->values != NULL) {
+        size += self->used * (Py_ssize_t)sizeof(PyObject *);
+    }
+    return PyLong_FromSsize_t(size);
+}
+
 static PyObject *
 multidict_sizeof(MultiDictObject *self)
 {
-    Py_ssize_t size = sizeof(MultiDictObject);
-    if (self->keys != &empty_htkeys) size += htkeys_sizeof(self->keys);
-    return PyLong_FromSsize_t(size);
+    return _multidict_sizeof(self, sizeof(MultiDictObject));
 }
 
 static PyMethodDef multidict_methods[] = {
@@ -872,6 +1132,7 @@ static PyMethodDef multidict_methods[] = {
      (PyCFunction)multidict_getone,
      METH_FASTCALL | METH_KEYWORDS,
      multidict_getone_doc},
+    {"count", (PyCFunction)multidict_count, METH_O, multidict_count_doc},
     {"get",
      (PyCFunction)multidict_get,
      METH_FASTCALL | METH_KEYWORDS,
@@ -891,7 +1152,18 @@ static PyMethodDef multidict_methods[] = {
      (PyCFunction)multidict_extend,
      METH_VARARGS | METH_KEYWORDS,
      multdicit_method_extend_doc},
-    {"clear", (PyCFunction)multidict_clear, METH_NOARGS, multidict_clear_doc},
+    {"clear",
+     (PyCFunction)multidict_clear,
+     METH_FASTCALL | METH_KEYWORDS,
+     multidict_clear_doc},
+    {"reserve",
+     (PyCFunction)multidict_reserve,
+     METH_O,
+     multidict_reserve_doc},
+    {"shrink_to_fit",
+     (PyCFunction)multidict_shrink_to_fit,
+     METH_NOARGS,
+     multidict_shrink_to_fit_doc},
     {"setdefault",
      (PyCFunction)multidict_setdefault,
      METH_FASTCALL | METH_KEYWORDS,
@@ -967,7 +1239,7 @@ static PyType_Slot multidict_slots[] = {
     {Py_tp_iter, multidict_tp_iter},
     {Py_tp_methods, multidict_methods},
     {Py_tp_init, multidict_tp_init},
-    {Py_tp_alloc, PyType_GenericAlloc},
+    {Py_tp_alloc, multidict_tp_alloc},
     {Py_tp_new, PyType_GenericNew},
     {Py_tp_free, PyObject_GC_Del},
 
@@ -1009,12 +1281,22 @@ cimultidict_tp_init(MultiDictObject *self, PyObject *args, PyObject *kwds)
     } else if (tmp == 1) {
         goto done;
     }
+    Py_ssize_t slot = -1;
+    if (kwds == NULL) {
+        tmp = md_init_split(self, state, true, arg, &slot);
+        if (tmp < 0) {
+            goto fail;
+        } else if (tmp == 1) {
+            goto done;
+        }
+    }
     if (md_init(self, state, true, size) < 0) {
         goto fail;
     }
     if (_multidict_extend(self, arg, kwds, "CIMultiDict", Extend) < 0) {
         goto fail;
     }
+    md_publish_layout(self, slot);
 done:
     Py_CLEAR(arg);
     ASSERT_CONSISTENT(self, false);
@@ -1024,6 +1306,106 @@ fail:
     return -1;
 }
 
+static PyObject *
+cimultidict_from_http_header_block(PyTypeObject *type, PyObject *const *args,
+                                   Py_ssize_t nargs, PyObject *kwnames)
+{
+    PyObject *mod = PyType_GetModuleByDef(type, &multidict_module);
+    if (mod == NULL) {
+        return NULL;
+    }
+    mod_state *state = get_mod_state(mod);
+    PyObject *block = NULL, *encoding = NULL;
+    bool latin1 = false;
+
+    if (parse2("from_http_header_block",
+               args,
+               nargs,
+               kwnames,
+               1,
+               "block",
+               &block,
+               "encoding",
+               &encoding) < 0) {
+        return NULL;
+    }
+    if (encoding != NULL) {
+        if (!PyUnicode_Check(encoding)) {
+            PyErr_Format(PyExc_TypeError,
+                         "encoding should be a str, got %s",
+                         Py_TYPE(encoding)->tp_name);
+            return NULL;
+        }
+        if (PyUnicode_CompareWithASCIIString(encoding, "latin-1") == 0 ||
+            PyUnicode_CompareWithASCIIString(encoding, "latin1") == 0 ||
+            PyUnicode_CompareWithASCIIString(encoding, "iso-8859-1") == 0) {
+            latin1 = true;
+        } else if (PyUnicode_CompareWithASCIIString(encoding, "utf-8") != 0 &&
+                   PyUnicode_CompareWithASCIIString(encoding, "utf8") != 0) {
+            PyErr_Format(PyExc_ValueError,
+                         "encoding should be 'utf-8' or 'latin-1', got %R",
+                         encoding);
+            return NULL;
+        }
+    }
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(block, &view, PyBUF_SIMPLE) < 0) {
+        return NULL;
+    }
+    const uint8_t *data = (const uint8_t *)view.buf;
+    Py_ssize_t count;
+    Py_ssize_t len = hb_measure(data, view.len, &count);
+
+    MultiDictObject *md = NULL;
+    if (type == state->CIMultiDictType) {
+        md = (MultiDictObject *)_multidict_alloc(state, type, 0);
+        if (md == NULL) {
+            goto fail;
+        }
+        if (md_init(md, state, true, count) < 0) {
+            goto fail;
+        }
+    } else {
+        md = (MultiDictObject *)PyObject_CallNoArgs((PyObject *)type);
+        if (md == NULL) {
+            goto fail;
+        }
+        if (!CIMultiDict_Check(state, md)) {
+            PyErr_Format(PyExc_TypeError,
+                         "%s() should return a CIMultiDict, got %s",
+                         type->tp_name,
+                         Py_TYPE(md)->tp_name);
+            goto fail;
+        }
+        if (md_reserve(md, count) < 0) {
+            goto fail;
+        }
+    }
+    if (md_extend_from_header_block(md, data, len, latin1) < 0) {
+        goto fail;
+    }
+    PyBuffer_Release(&view);
+    return (PyObject *)md;
+fail:
+    PyBuffer_Release(&view);
+    Py_XDECREF(md);
+    return NULL;
+}
+
+PyDoc_STRVAR(cimultidict_from_http_header_block_doc,
+             "Create a CIMultiDict from a raw HTTP/1.x header block.\n\n\
+Lines are separated by CRLF or LF, parsing stops at the first empty line. \
+Values are decoded by encoding, 'utf-8' or 'latin-1'.");
+
+static PyMethodDef cimultidict_methods[] = {
+    {"from_http_header_block",
+     (PyCFunction)cimultidict_from_http_header_block,
+     METH_FASTCALL | METH_KEYWORDS | METH_CLASS,
+     cimultidict_from_http_header_block_doc},
+    {NULL, NULL} /* sentinel */
+};
+
 PyDoc_STRVAR(
     CIMultDict_doc,
     "Dictionary with the support for duplicate case-insensitive keys.");
@@ -1031,6 +1413,7 @@ PyDoc_STRVAR(
 static PyType_Slot cimultidict_slots[] = {
     {Py_tp_doc, (void *)CIMultDict_doc},
     {Py_tp_init, cimultidict_tp_init},
+    {Py_tp_methods, cimultidict_methods},
     {0, NULL},
 };
 
@@ -1104,6 +1487,12 @@ multidict_proxy_getone(MultiDictProxyObject *self, PyObject *const *args,
     return multidict_getone(self->md, args, nargs, kwnames);
 }
 
+static PyObject *
+multidict_proxy_count(MultiDictProxyObject *self, PyObject *key)
+{
+    return multidict_count(self->md, key);
+}
+
 static PyObject *
 multidict_proxy_get(MultiDictProxyObject *self, PyObject *const *args,
                     Py_ssize_t nargs, PyObject *kwnames)
@@ -1175,13 +1564,40 @@ multidict_proxy_tp_richcompare(MultiDictProxyObject *self, PyObject *other,
     return multidict_tp_richcompare(self->md, other, op);
 }
 
+static PyObject *
+multidict_proxy_tp_alloc(PyTypeObject *type, Py_ssize_t nitems)
+{
+    PyObject *mod = PyType_GetModuleByDef(type, &multidict_module);
+    if (mod == NULL) {
+        return NULL;
+    }
+    mod_state *state = get_mod_state(mod);
+    if (type == state->MultiDictProxyType ||
+        type == state->CIMultiDictProxyType) {
+        PyObject *op = freelist_pop(&state->proxy_freelist, type);
+        if (op != NULL) {
+            PyObject_GC_Track(op);
+            return op;
+        }
+    }
+    return PyType_GenericAlloc(type, nitems);
+}
+
 static void
 multidict_proxy_tp_dealloc(MultiDictProxyObject *self)
 {
+    PyTypeObject *tp = Py_TYPE(self);
+    mod_state *state = self->md != NULL ? self->md->state : NULL;
     PyObject_GC_UnTrack(self);
     PyObject_ClearWeakRefs((PyObject *)self);
     Py_XDECREF(self->md);
-    Py_TYPE(self)->tp_free((PyObject *)self);
+    if (state == NULL ||
+        (tp != state->MultiDictProxyType &&
+         tp != state->CIMultiDictProxyType) ||
+        !freelist_push(&state->proxy_freelist, (PyObject *)self)) {
+        tp->tp_free((PyObject *)self);
+    }
+    Py_DECREF(tp);
 }
 
 static int
@@ -1220,6 +1636,10 @@ static PyMethodDef multidict_proxy_methods[] = {
      (PyCFunction)multidict_proxy_getone,
      METH_FASTCALL | METH_KEYWORDS,
      multidict_getone_doc},
+    {"count",
+     (PyCFunction)multidict_proxy_count,
+     METH_O,
+     multidict_count_doc},
     {"get",
      (PyCFunction)multidict_proxy_get,
      METH_FASTCALL | METH_KEYWORDS,
@@ -1275,7 +1695,7 @@ static PyType_Slot multidict_proxy_slots[] = {
     {Py_tp_iter, multidict_proxy_tp_iter},
     {Py_tp_methods, multidict_proxy_methods},
     {Py_tp_init, multidict_proxy_tp_init},
-    {Py_tp_alloc, PyType_GenericAlloc},
+    {Py_tp_alloc, multidict_proxy_tp_alloc},
     {Py_tp_new, PyType_GenericNew},
     {Py_tp_free, PyObject_GC_Del},
 
@@ -1380,67 +1800,1247 @@ static PyType_Spec cimultidict_proxy_spec = {
     .slots = cimultidict_proxy_slots,
 };
 
-/******************** Other functions ********************/
+/******************** FrozenMultiDict ********************/
 
-static PyObject *
-getversion(PyObject *self, PyObject *arg)
+/* The object is built by __new__() and is never modified after that:
+   FrozenMultiDict has no __init__() that could fill it again. */
+static inline PyObject *
+_frozen_multidict_new(PyTypeObject *type, PyObject *args, PyObject *kwds,
+                      bool is_ci, const char *name)
 {
-    mod_state *state = get_mod_state(self);
-    MultiDictObject *md;
-    if (AnyMultiDict_Check(state, arg)) {
-        md = (MultiDictObject *)arg;
-    } else if (AnyMultiDictProxy_Check(state, arg)) {
-        md = ((MultiDictProxyObject *)arg)->md;
-    } else {
-        PyErr_Format(PyExc_TypeError, "unexpected type");
+    PyObject *mod = PyType_GetModuleByDef(type, &multidict_module);
+    if (mod == NULL) {
         return NULL;
     }
-    return PyLong_FromUnsignedLong(md_version(md));
+    mod_state *state = get_mod_state(mod);
+    FrozenMultiDictObject *self = NULL;
+    PyObject *arg = NULL;
+    Py_ssize_t size =
+        _multidict_extend_parse_args(state, args, kwds, name, &arg);
+    if (size < 0) {
+        goto fail;
+    }
+    if (arg != NULL && kwds == NULL && Py_IS_TYPE(arg, type) &&
+        (type == state->FrozenMultiDictType ||
+         type == state->FrozenCIMultiDictType)) {
+        // like frozenset(frozenset())
+        return arg;
+    }
+    self = (FrozenMultiDictObject *)_multidict_alloc(state, type, 0);
+    if (self == NULL) {
+        goto fail;
+    }
+    self->hash = -1;
+    Py_ssize_t slot = -1;
+    if (kwds == NULL) {
+        int tmp = md_init_split(&self->md, state, is_ci, arg, &slot);
+        if (tmp < 0) {
+            goto fail;
+        } else if (tmp == 1) {
+            Py_CLEAR(arg);
+            return (PyObject *)self;
+        }
+    }
+    if (md_init(&self->md, state, is_ci, size) < 0) {
+        goto fail;
+    }
+    if (_multidict_extend(&self->md, arg, kwds, name, Extend) < 0) {
+        goto fail;
+    }
+    if (md_freeze(&self->md) < 0) {
+        goto fail;
+    }
+    md_publish_layout(&self->md, slot);
+    Py_CLEAR(arg);
+    return (PyObject *)self;
+fail:
+    Py_CLEAR(arg);
+    Py_XDECREF(self);
+    return NULL;
 }
 
-/******************** Module ********************/
-
-static int
-module_traverse(PyObject *mod, visitproc visit, void *arg)
+static PyObject *
+frozen_multidict_tp_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
-    mod_state *state = get_mod_state(mod);
-
-    Py_VISIT(state->IStrType);
-
-    Py_VISIT(state->MultiDictType);
-    Py_VISIT(state->CIMultiDictType);
-    Py_VISIT(state->MultiDictProxyType);
-    Py_VISIT(state->CIMultiDictProxyType);
-
-    Py_VISIT(state->KeysViewType);
-    Py_VISIT(state->ItemsViewType);
-    Py_VISIT(state->ValuesViewType);
-
-    Py_VISIT(state->KeysIterType);
-    Py_VISIT(state->ItemsIterType);
-    Py_VISIT(state->ValuesIterType);
-
-    Py_VISIT(state->str_canonical);
-    Py_VISIT(state->str_lower);
-    Py_VISIT(state->str_name);
+    return _frozen_multidict_new(type, args, kwds, false, "FrozenMultiDict");
+}
 
-    return 0;
+static Py_hash_t
+frozen_multidict_tp_hash(FrozenMultiDictObject *self)
+{
+    // a racing thread stores the same value, no locking is needed
+    Py_hash_t hash = self->hash;
+    if (hash == -1) {
+        hash = md_hash(&self->md);
+        self->hash = hash;
+    }
+    return hash;
 }
 
-static int
-module_clear(PyObject *mod)
+static PyObject *
+frozen_multidict_copy(FrozenMultiDictObject *self)
 {
-    mod_state *state = get_mod_state(mod);
+    mod_state *state = self->md.state;
+    return _multidict_copy_as(
+        &self->md,
+        self->md.is_ci ? state->CIMultiDictType : state->MultiDictType);
+}
 
-    Py_CLEAR(state->IStrType);
+static PyObject *
+frozen_multidict_sizeof(FrozenMultiDictObject *self)
+{
+    return _multidict_sizeof(&self->md, sizeof(FrozenMultiDictObject));
+}
 
-    Py_CLEAR(state->MultiDictType);
-    Py_CLEAR(state->CIMultiDictType);
-    Py_CLEAR(state->MultiDictProxyType);
-    Py_CLEAR(state->CIMultiDictProxyType);
+PyDoc_STRVAR(frozen_multidict_copy_doc,
+             "Return a mutable copy of the dictionary.");
 
-    Py_CLEAR(state->KeysViewType);
-    Py_CLEAR(state->ItemsViewType);
+static PyMethodDef frozen_multidict_methods[] = {
+    {"getall",
+     (PyCFunction)multidict_getall,
+     METH_FASTCALL | METH_KEYWORDS,
+     multidict_getall_doc},
+    {"getone",
+     (PyCFunction)multidict_getone,
+     METH_FASTCALL | METH_KEYWORDS,
+     multidict_getone_doc},
+    {"count", (PyCFunction)multidict_count, METH_O, multidict_count_doc},
+    {"get",
+     (PyCFunction)multidict_get,
+     METH_FASTCALL | METH_KEYWORDS,
+     multidict_get_doc},
+    {"keys", (PyCFunction)multidict_keys, METH_NOARGS, multidict_keys_doc},
+    {"items", (PyCFunction)multidict_items, METH_NOARGS, multidict_items_doc},
+    {"values",
+     (PyCFunction)multidict_values,
+     METH_NOARGS,
+     multidict_values_doc},
+    {"copy",
+     (PyCFunction)frozen_multidict_copy,
+     METH_NOARGS,
+     frozen_multidict_copy_doc},
+    {
+        "__reduce__",
+        (PyCFunction)multidict_reduce,
+        METH_NOARGS,
+        NULL,
+    },
+    {"__class_getitem__",
+     (PyCFunction)Py_GenericAlias,
+     METH_O | METH_CLASS,
+     NULL},
+    {
+        "__sizeof__",
+        (PyCFunction)frozen_multidict_sizeof,
+        METH_NOARGS,
+        sizeof__doc__,
+    },
+    {NULL, NULL} /* sentinel */
+};
+
+PyDoc_STRVAR(FrozenMultiDict_doc,
+             "Immutable hashable dictionary with the support for duplicate "
+             "keys.");
+
+#ifndef MANAGED_WEAKREFS
+static PyMemberDef frozen_multidict_members[] = {
+    {"__weaklistoffset__",
+     Py_T_PYSSIZET,
+     offsetof(FrozenMultiDictObject, md.weaklist),
+     Py_READONLY},
+    {NULL} /* Sentinel */
+};
+#endif
+
+static PyType_Slot frozen_multidict_slots[] = {
+    {Py_tp_dealloc, multidict_tp_dealloc},
+    {Py_tp_repr, multidict_repr},
+    {Py_tp_doc, (void *)FrozenMultiDict_doc},
+    {Py_tp_hash, frozen_multidict_tp_hash},
+
+    {Py_sq_contains, multidict_sq_contains},
+    {Py_mp_length, multidict_mp_len},
+    {Py_mp_subscript, multidict_mp_subscript},
+
+    {Py_tp_traverse, multidict_tp_traverse},
+    {Py_tp_clear, multidict_tp_clear},
+    {Py_tp_richcompare, multidict_tp_richcompare},
+    {Py_tp_iter, multidict_tp_iter},
+    {Py_tp_methods, frozen_multidict_methods},
+    {Py_tp_alloc, multidict_tp_alloc},
+    {Py_tp_new, frozen_multidict_tp_new},
+    {Py_tp_free, PyObject_GC_Del},
+
+#ifndef MANAGED_WEAKREFS
+    {Py_tp_members, frozen_multidict_members},
+#endif
+    {0, NULL},
+};
+
+static PyType_Spec frozen_multidict_spec = {
+    .name = "multidict._multidict.FrozenMultiDict",
+    .basicsize = sizeof(FrozenMultiDictObject),
+    .flags = (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE
+#if PY_VERSION_HEX >= 0x030a00f0
+              | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+#ifdef MANAGED_WEAKREFS
+              | Py_TPFLAGS_MANAGED_WEAKREF
+#endif
+              | Py_TPFLAGS_HAVE_GC),
+    .slots = frozen_multidict_slots,
+};
+
+/******************** FrozenCIMultiDict ********************/
+
+static PyObject *
+frozen_cimultidict_tp_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    return _frozen_multidict_new(type, args, kwds, true, "FrozenCIMultiDict");
+}
+
+PyDoc_STRVAR(FrozenCIMultiDict_doc,
+             "Immutable hashable dictionary with the support for duplicate "
+             "case-insensitive keys.");
+
+static PyType_Slot frozen_cimultidict_slots[] = {
+    {Py_tp_doc, (void *)FrozenCIMultiDict_doc},
+    {Py_tp_new, frozen_cimultidict_tp_new},
+    {0, NULL},
+};
+
+static PyType_Spec frozen_cimultidict_spec = {
+    .name = "multidict._multidict.FrozenCIMultiDict",
+    .basicsize = sizeof(FrozenMultiDictObject),
+    .flags = (Py_TPFLAGS_DEFAULT
+#if PY_VERSION_HEX >= 0x030a00f0
+              | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+              | Py_TPFLAGS_BASETYPE),
+    .slots = frozen_cimultidict_slots,
+};
+
+/******************** PersistentMultiDict ********************/
+
+/* A new version of the same type sharing the tries with self */
+static inline PersistentMultiDictObject *
+_persistent_multidict_derive(PersistentMultiDictObject *self)
+{
+    PyTypeObject *type = Py_TYPE(self);
+    PersistentMultiDictObject *ret =
+        (PersistentMultiDictObject *)type->tp_alloc(type, 0);
+    if (ret == NULL) {
+        return NULL;
+    }
+    pmd_init_from(ret, self);
+    return ret;
+}
+
+/* The object is built by __new__() and is never modified after that,
+   updates return new versions. */
+static inline PyObject *
+_persistent_multidict_new(PyTypeObject *type, PyObject *args, PyObject *kwds,
+                          bool is_ci, const char *name)
+{
+    PyObject *mod = PyType_GetModuleByDef(type, &multidict_module);
+    if (mod == NULL) {
+        return NULL;
+    }
+    mod_state *state = get_mod_state(mod);
+    PersistentMultiDictObject *self = NULL;
+    MultiDictObject *md = NULL;
+    PyObject *arg = NULL;
+    Py_ssize_t size =
+        _multidict_extend_parse_args(state, args, kwds, name, &arg);
+    if (size < 0) {
+        goto fail;
+    }
+    if (arg != NULL && kwds == NULL && Py_IS_TYPE(arg, type) &&
+        (type == state->PersistentMultiDictType ||
+         type == state->PersistentCIMultiDictType)) {
+        return arg;
+    }
+    self = (PersistentMultiDictObject *)type->tp_alloc(type, 0);
+    if (self == NULL) {
+        goto fail;
+    }
+    self->state = state;
+    self->is_ci = is_ci;
+    if (arg != NULL && kwds == NULL &&
+        AnyPersistentMultiDict_Check(state, arg) &&
+        ((PersistentMultiDictObject *)arg)->is_ci == is_ci) {
+        pmd_init_from(self, (PersistentMultiDictObject *)arg);
+        Py_CLEAR(arg);
+        return (PyObject *)self;
+    }
+    // let the multidict parse and convert the arguments
+    md = (MultiDictObject *)_multidict_alloc(
+        state, is_ci ? state->CIMultiDictType : state->MultiDictType, 0);
+    if (md == NULL) {
+        goto fail;
+    }
+    if (md_init(md, state, is_ci, size) < 0) {
+        goto fail;
+    }
+    if (_multidict_extend(md, arg, kwds, name, Extend) < 0) {
+        goto fail;
+    }
+    if (pmd_extend_from_md(self, md) < 0) {
+        goto fail;
+    }
+    Py_CLEAR(md);
+    Py_CLEAR(arg);
+    return (PyObject *)self;
+fail:
+    Py_XDECREF(md);
+    Py_CLEAR(arg);
+    Py_XDECREF(self);
+    return NULL;
+}
+
+static PyObject *
+persistent_multidict_tp_new(PyTypeObject *type, PyObject *args,
+                            PyObject *kwds)
+{
+    return _persistent_multidict_new(
+        type, args, kwds, false, "PersistentMultiDict");
+}
+
+static inline PyObject *
+_persistent_multidict_getone(PersistentMultiDictObject *self, PyObject *key,
+                             PyObject *_default)
+{
+    PyObject *items;
+    int found = pmd_find(self, key, &items);
+    if (found < 0) {
+        return NULL;
+    }
+    if (found) {
+        PyObject *item = pmd_items_first(items);
+        return Py_NewRef(PyTuple_GET_ITEM(item, PMD_ITEM_VALUE));
+    }
+    if (_default != NULL) {
+        return Py_NewRef(_default);
+    }
+    PyErr_SetObject(PyExc_KeyError, key);
+    return NULL;
+}
+
+static PyObject *
+persistent_multidict_getall(PersistentMultiDictObject *self,
+                            PyObject *const *args, Py_ssize_t nargs,
+                            PyObject *kwnames)
+{
+    PyObject *key = NULL, *_default = NULL, *items;
+
+    if (parse2("getall",
+               args,
+               nargs,
+               kwnames,
+               1,
+               "key",
+               &key,
+               "default",
+               &_default) < 0) {
+        return NULL;
+    }
+    int found = pmd_find(self, key, &items);
+    if (found < 0) {
+        return NULL;
+    }
+    if (!found) {
+        if (_default != NULL) {
+            return Py_NewRef(_default);
+        }
+        PyErr_SetObject(PyExc_KeyError, key);
+        return NULL;
+    }
+    return pmd_items_values(items);
+}
+
+static PyObject *
+persistent_multidict_getone(PersistentMultiDictObject *self,
+                            PyObject *const *args, Py_ssize_t nargs,
+                            PyObject *kwnames)
+{
+    PyObject *key = NULL, *_default = NULL;
+
+    if (parse2("getone",
+               args,
+               nargs,
+               kwnames,
+               1,
+               "key",
+               &key,
+               "default",
+               &_default) < 0) {
+        return NULL;
+    }
+    return _persistent_multidict_getone(self, key, _default);
+}
+
+static PyObject *
+persistent_multidict_get(PersistentMultiDictObject *self,
+                         PyObject *const *args, Py_ssize_t nargs,
+                         PyObject *kwnames)
+{
+    PyObject *key = NULL;
+    PyObject *_default = NULL;
+    bool decref_default = false;
+
+    if (parse2("get",
+               args,
+               nargs,
+               kwnames,
+               1,
+               "key",
+               &key,
+               "default",
+               &_default) < 0) {
+        return NULL;
+    }
+    if (_default == NULL) {
+        _default = Py_GetConstant(Py_CONSTANT_NONE);
+        if (_default == NULL) {
+            return NULL;
+        }
+        decref_default = true;
+    }
+    PyObject *ret = _persistent_multidict_getone(self, key, _default);
+    if (decref_default) {
+        Py_CLEAR(_default);
+    }
+    return ret;
+}
+
+static PyObject *
+persistent_multidict_count(PersistentMultiDictObject *self, PyObject *key)
+{
+    PyObject *items;
+    int found = pmd_find(self, key, &items);
+    if (found < 0) {
+        return NULL;
+    }
+    return PyLong_FromSsize_t(found ? pmd_items_count(items) : 0);
+}
+
+static PyObject *
+persistent_multidict_keys(PersistentMultiDictObject *self)
+{
+    MultiDictObject *md = _persistent_multidict_frozen(self);
+    if (md == NULL) {
+        return NULL;
+    }
+    return multidict_keysview_new(md);
+}
+
+static PyObject *
+persistent_multidict_items(PersistentMultiDictObject *self)
+{
+    MultiDictObject *md = _persistent_multidict_frozen(self);
+    if (md == NULL) {
+        return NULL;
+    }
+    return multidict_itemsview_new(md);
+}
+
+static PyObject *
+persistent_multidict_values(PersistentMultiDictObject *self)
+{
+    MultiDictObject *md = _persistent_multidict_frozen(self);
+    if (md == NULL) {
+        return NULL;
+    }
+    return multidict_valuesview_new(md);
+}
+
+static PyObject *
+persistent_multidict_copy(PersistentMultiDictObject *self)
+{
+    MultiDictObject *md = _persistent_multidict_frozen(self);
+    if (md == NULL) {
+        return NULL;
+    }
+    mod_state *state = self->state;
+    return _multidict_copy_as(
+        md, self->is_ci ? state->CIMultiDictType : state->MultiDictType);
+}
+
+static PyObject *
+persistent_multidict_reduce(PersistentMultiDictObject *self)
+{
+    MultiDictObject *md = _persistent_multidict_frozen(self);
+    if (md == NULL) {
+        return NULL;
+    }
+    return _multidict_reduce_as(md, Py_TYPE(self));
+}
+
+static PyObject *
+persistent_multidict_with_added(PersistentMultiDictObject *self,
+                                PyObject *const *args, Py_ssize_t nargs,
+                                PyObject *kwnames)
+{
+    PyObject *key = NULL, *value = NULL;
+
+    if (parse2("with_added",
+               args,
+               nargs,
+               kwnames,
+               2,
+               "key",
+               &key,
+               "value",
+               &value) < 0) {
+        return NULL;
+    }
+    PersistentMultiDictObject *ret = _persistent_multidict_derive(self);
+    if (ret == NULL) {
+        return NULL;
+    }
+    if (pmd_add(ret, key, value) < 0) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    return (PyObject *)ret;
+}
+
+static PyObject *
+persistent_multidict_with_replaced(PersistentMultiDictObject *self,
+                                   PyObject *const *args, Py_ssize_t nargs,
+                                   PyObject *kwnames)
+{
+    PyObject *key = NULL, *value = NULL;
+
+    if (parse2("with_replaced",
+               args,
+               nargs,
+               kwnames,
+               2,
+               "key",
+               &key,
+               "value",
+               &value) < 0) {
+        return NULL;
+    }
+    PersistentMultiDictObject *ret = _persistent_multidict_derive(self);
+    if (ret == NULL) {
+        return NULL;
+    }
+    if (pmd_replace(ret, key, value) < 0) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    return (PyObject *)ret;
+}
+
+static PyObject *
+persistent_multidict_without(PersistentMultiDictObject *self, PyObject *key)
+{
+    PersistentMultiDictObject *ret = _persistent_multidict_derive(self);
+    if (ret == NULL) {
+        return NULL;
+    }
+    if (pmd_del(ret, key) < 0) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    return (PyObject *)ret;
+}
+
+static PyObject *
+persistent_multidict_repr(PersistentMultiDictObject *self)
+{
+    int tmp = Py_ReprEnter((PyObject *)self);
+    if (tmp < 0) {
+        return NULL;
+    }
+    if (tmp > 0) {
+        return PyUnicode_FromString("...");
+    }
+    PyObject *ret = NULL;
+    PyObject *name = NULL;
+    MultiDictObject *md = _persistent_multidict_frozen(self);
+    if (md == NULL) {
+        goto done;
+    }
+    name = PyObject_GetAttr((PyObject *)Py_TYPE(self), self->state->str_name);
+    if (name == NULL) {
+        goto done;
+    }
+    ret = md_repr(md, name, true, true);
+done:
+    Py_ReprLeave((PyObject *)self);
+    Py_XDECREF(name);
+    return ret;
+}
+
+static Py_hash_t
+persistent_multidict_tp_hash(PersistentMultiDictObject *self)
+{
+    MultiDictObject *md = _persistent_multidict_frozen(self);
+    if (md == NULL) {
+        return -1;
+    }
+    return frozen_multidict_tp_hash((FrozenMultiDictObject *)md);
+}
+
+static Py_ssize_t
+persistent_multidict_mp_len(PersistentMultiDictObject *self)
+{
+    return self->used;
+}
+
+static PyObject *
+persistent_multidict_mp_subscript(PersistentMultiDictObject *self,
+                                  PyObject *key)
+{
+    return _persistent_multidict_getone(self, key, NULL);
+}
+
+static int
+persistent_multidict_sq_contains(PersistentMultiDictObject *self,
+                                 PyObject *key)
+{
+    if (!PyUnicode_Check(key)) {
+        return 0;
+    }
+    PyObject *items;
+    return pmd_find(self, key, &items);
+}
+
+static PyObject *
+persistent_multidict_tp_iter(PersistentMultiDictObject *self)
+{
+    MultiDictObject *md = _persistent_multidict_frozen(self);
+    if (md == NULL) {
+        return NULL;
+    }
+    return multidict_keys_iter_new(md);
+}
+
+static PyObject *
+persistent_multidict_tp_richcompare(PersistentMultiDictObject *self,
+                                    PyObject *other, int op)
+{
+    if (op != Py_EQ && op != Py_NE) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+    MultiDictObject *md = _persistent_multidict_frozen(self);
+    if (md == NULL) {
+        return NULL;
+    }
+    return multidict_tp_richcompare(md, other, op);
+}
+
+static void
+persistent_multidict_tp_dealloc(PersistentMultiDictObject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+    PyObject_GC_UnTrack(self);
+    Py_TRASHCAN_BEGIN(self, persistent_multidict_tp_dealloc)
+        PyObject_ClearWeakRefs((PyObject *)self);
+    pmd_clear(self);
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
+    Py_TRASHCAN_END  // there should be no code after this
+}
+
+static int
+persistent_multidict_tp_traverse(PersistentMultiDictObject *self,
+                                 visitproc visit, void *arg)
+{
+    Py_VISIT(Py_TYPE(self));
+    return pmd_traverse(self, visit, arg);
+}
+
+static int
+persistent_multidict_tp_clear(PersistentMultiDictObject *self)
+{
+    return pmd_clear(self);
+}
+
+PyDoc_STRVAR(persistent_multidict_with_added_doc,
+             "Return a new dictionary with the item appended.");
+
+PyDoc_STRVAR(persistent_multidict_with_replaced_doc,
+             "Return a new dictionary with the first value matching the key "
+             "replaced.\n\nOther values of the key are removed, the item is "
+             "appended if the key is not found.");
+
+PyDoc_STRVAR(persistent_multidict_without_doc,
+             "Return a new dictionary without all values matching the key.");
+
+static PyMethodDef persistent_multidict_methods[] = {
+    {"getall",
+     (PyCFunction)persistent_multidict_getall,
+     METH_FASTCALL | METH_KEYWORDS,
+     multidict_getall_doc},
+    {"getone",
+     (PyCFunction)persistent_multidict_getone,
+     METH_FASTCALL | METH_KEYWORDS,
+     multidict_getone_doc},
+    {"count",
+     (PyCFunction)persistent_multidict_count,
+     METH_O,
+     multidict_count_doc},
+    {"get",
+     (PyCFunction)persistent_multidict_get,
+     METH_FASTCALL | METH_KEYWORDS,
+     multidict_get_doc},
+    {"keys",
+     (PyCFunction)persistent_multidict_keys,
+     METH_NOARGS,
+     multidict_keys_doc},
+    {"items",
+     (PyCFunction)persistent_multidict_items,
+     METH_NOARGS,
+     multidict_items_doc},
+    {"values",
+     (PyCFunction)persistent_multidict_values,
+     METH_NOARGS,
+     multidict_values_doc},
+    {"copy",
+     (PyCFunction)persistent_multidict_copy,
+     METH_NOARGS,
+     frozen_multidict_copy_doc},
+    {"with_added",
+     (PyCFunction)persistent_multidict_with_added,
+     METH_FASTCALL | METH_KEYWORDS,
+     persistent_multidict_with_added_doc},
+    {"with_replaced",
+     (PyCFunction)persistent_multidict_with_replaced,
+     METH_FASTCALL | METH_KEYWORDS,
+     persistent_multidict_with_replaced_doc},
+    {"without",
+     (PyCFunction)persistent_multidict_without,
+     METH_O,
+     persistent_multidict_without_doc},
+    {
+        "__reduce__",
+        (PyCFunction)persistent_multidict_reduce,
+        METH_NOARGS,
+        NULL,
+    },
+    {"__class_getitem__",
+     (PyCFunction)Py_GenericAlias,
+     METH_O | METH_CLASS,
+     NULL},
+    {NULL, NULL} /* sentinel */
+};
+
+PyDoc_STRVAR(PersistentMultiDict_doc,
+             "Immutable dictionary with the support for duplicate keys, "
+             "updates return new versions sharing the data.");
+
+#ifndef MANAGED_WEAKREFS
+static PyMemberDef persistent_multidict_members[] = {
+    {"__weaklistoffset__",
+     Py_T_PYSSIZET,
+     offsetof(PersistentMultiDictObject, weaklist),
+     Py_READONLY},
+    {NULL} /* Sentinel */
+};
+#endif
+
+static PyType_Slot persistent_multidict_slots[] = {
+    {Py_tp_dealloc, persistent_multidict_tp_dealloc},
+    {Py_tp_repr, persistent_multidict_repr},
+    {Py_tp_doc, (void *)PersistentMultiDict_doc},
+    {Py_tp_hash, persistent_multidict_tp_hash},
+
+    {Py_sq_contains, persistent_multidict_sq_contains},
+    {Py_mp_length, persistent_multidict_mp_len},
+    {Py_mp_subscript, persistent_multidict_mp_subscript},
+
+    {Py_tp_traverse, persistent_multidict_tp_traverse},
+    {Py_tp_clear, persistent_multidict_tp_clear},
+    {Py_tp_richcompare, persistent_multidict_tp_richcompare},
+    {Py_tp_iter, persistent_multidict_tp_iter},
+    {Py_tp_methods, persistent_multidict_methods},
+    {Py_tp_new, persistent_multidict_tp_new},
+    {Py_tp_free, PyObject_GC_Del},
+
+#ifndef MANAGED_WEAKREFS
+    {Py_tp_members, persistent_multidict_members},
+#endif
+    {0, NULL},
+};
+
+static PyType_Spec persistent_multidict_spec = {
+    .name = "multidict._multidict.PersistentMultiDict",
+    .basicsize = sizeof(PersistentMultiDictObject),
+    .flags = (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE
+#if PY_VERSION_HEX >= 0x030a00f0
+              | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+#ifdef MANAGED_WEAKREFS
+              | Py_TPFLAGS_MANAGED_WEAKREF
+#endif
+              | Py_TPFLAGS_HAVE_GC),
+    .slots = persistent_multidict_slots,
+};
+
+/******************** PersistentCIMultiDict ********************/
+
+static PyObject *
+persistent_cimultidict_tp_new(PyTypeObject *type, PyObject *args,
+                              PyObject *kwds)
+{
+    return _persistent_multidict_new(
+        type, args, kwds, true, "PersistentCIMultiDict");
+}
+
+PyDoc_STRVAR(PersistentCIMultiDict_doc,
+             "Immutable dictionary with the support for duplicate "
+             "case-insensitive keys, updates return new versions sharing "
+             "the data.");
+
+static PyType_Slot persistent_cimultidict_slots[] = {
+    {Py_tp_doc, (void *)PersistentCIMultiDict_doc},
+    {Py_tp_new, persistent_cimultidict_tp_new},
+    {0, NULL},
+};
+
+static PyType_Spec persistent_cimultidict_spec = {
+    .name = "multidict._multidict.PersistentCIMultiDict",
+    .basicsize = sizeof(PersistentMultiDictObject),
+    .flags = (Py_TPFLAGS_DEFAULT
+#if PY_VERSION_HEX >= 0x030a00f0
+              | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+              | Py_TPFLAGS_BASETYPE),
+    .slots = persistent_cimultidict_slots,
+};
+
+/******************** C API ********************/
+
+/* Implementation of the function table exported as the
+   MULTIDICT_CAPI_NAME capsule, see multidict_api.h.  The table lives in
+   the module state, the capsule points to it. */
+
+static MultiDictObject *
+capi_readable(mod_state *state, PyObject *obj)
+{
+    if (AnyMultiDict_Check(state, obj)) {
+        return (MultiDictObject *)obj;
+    } else if (AnyMultiDictProxy_Check(state, obj)) {
+        return ((MultiDictProxyObject *)obj)->md;
+    } else if (AnyFrozenMultiDict_Check(state, obj)) {
+        return (MultiDictObject *)obj;
+    } else if (AnyPersistentMultiDict_Check(state, obj)) {
+        return _persistent_multidict_frozen((PersistentMultiDictObject *)obj);
+    }
+    PyErr_Format(PyExc_TypeError, "multidict is expected, got %s",
+                 Py_TYPE(obj)->tp_name);
+    return NULL;
+}
+
+static MultiDictObject *
+capi_writable(mod_state *state, PyObject *obj)
+{
+    if (AnyMultiDict_Check(state, obj)) {
+        return (MultiDictObject *)obj;
+    }
+    PyErr_Format(PyExc_TypeError,
+                 "MultiDict or CIMultiDict is expected, got %s",
+                 Py_TYPE(obj)->tp_name);
+    return NULL;
+}
+
+static PyObject *
+capi_md_new(void *st, int is_ci, Py_ssize_t size_hint)
+{
+    mod_state *state = (mod_state *)st;
+    PyTypeObject *type = is_ci ? state->CIMultiDictType
+                               : state->MultiDictType;
+    if (size_hint < 0) {
+        PyErr_SetString(PyExc_ValueError, "size_hint should be >= 0");
+        return NULL;
+    }
+    MultiDictObject *md = (MultiDictObject *)_multidict_alloc(state, type, 0);
+    if (md == NULL) {
+        return NULL;
+    }
+    if (md_init(md, state, is_ci != 0, size_hint) < 0) {
+        Py_DECREF(md);
+        return NULL;
+    }
+    return (PyObject *)md;
+}
+
+static int
+capi_md_add(void *st, PyObject *obj, PyObject *key, PyObject *value)
+{
+    MultiDictObject *md = capi_writable((mod_state *)st, obj);
+    if (md == NULL) {
+        return -1;
+    }
+    int ret = md_add(md, key, value);
+    ASSERT_CONSISTENT(md, false);
+    return ret;
+}
+
+static PyObject *
+capi_md_identity(void *st, int is_ci, PyObject *key)
+{
+    return _md_calc_identity((mod_state *)st, key, is_ci != 0);
+}
+
+static int
+capi_md_add_with_identity(void *st, PyObject *obj, PyObject *identity,
+                          PyObject *key, PyObject *value)
+{
+    MultiDictObject *md = capi_writable((mod_state *)st, obj);
+    if (md == NULL) {
+        return -1;
+    }
+    if (!PyUnicode_CheckExact(identity) || !PyUnicode_Check(key)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "identity should be an exact str and key a str");
+        return -1;
+    }
+    Py_hash_t hash = _unicode_hash(identity);
+    if (hash == -1) {
+        return -1;
+    }
+    int ret = _md_add_with_hash(md, hash, identity, key, value);
+    ASSERT_CONSISTENT(md, false);
+    return ret;
+}
+
+static int
+capi_md_get_one(void *st, PyObject *obj, PyObject *key, PyObject **result)
+{
+    MultiDictObject *md = capi_readable((mod_state *)st, obj);
+    if (md == NULL) {
+        *result = NULL;
+        return -1;
+    }
+    return md_get_one(md, key, result);
+}
+
+static int
+capi_md_get_all(void *st, PyObject *obj, PyObject *key, PyObject **result)
+{
+    MultiDictObject *md = capi_readable((mod_state *)st, obj);
+    if (md == NULL) {
+        *result = NULL;
+        return -1;
+    }
+    return md_get_all(md, key, result);
+}
+
+static int
+capi_md_contains(void *st, PyObject *obj, PyObject *key)
+{
+    MultiDictObject *md = capi_readable((mod_state *)st, obj);
+    if (md == NULL) {
+        return -1;
+    }
+    return md_contains(md, key, NULL);
+}
+
+static Py_ssize_t
+capi_md_len(void *st, PyObject *obj)
+{
+    MultiDictObject *md = capi_readable((mod_state *)st, obj);
+    if (md == NULL) {
+        return -1;
+    }
+    return md_len(md);
+}
+
+static int
+capi_md_next(void *st, PyObject *obj, Py_ssize_t *ppos, PyObject **pkey,
+             PyObject **pvalue)
+{
+    MultiDictObject *md = capi_readable((mod_state *)st, obj);
+    if (md == NULL) {
+        return -1;
+    }
+    if (*ppos < 0) {
+        PyErr_SetString(PyExc_ValueError, "position must be non-negative");
+        return -1;
+    }
+    return md_next_at(md, ppos, NULL, pkey, pvalue);
+}
+
+static uint64_t
+capi_md_version(void *st, PyObject *obj)
+{
+    MultiDictObject *md = capi_readable((mod_state *)st, obj);
+    if (md == NULL) {
+        return (uint64_t)-1;
+    }
+    return md_version(md);
+}
+
+static PyObject *
+capi_new_capsule(mod_state *state)
+{
+    MultiDict_CAPI *api = &state->capi;
+    api->version = MULTIDICT_CAPI_VERSION;
+    api->state = state;
+    api->MultiDictType = state->MultiDictType;
+    api->CIMultiDictType = state->CIMultiDictType;
+    api->md_new = capi_md_new;
+    api->md_add = capi_md_add;
+    api->md_identity = capi_md_identity;
+    api->md_add_with_identity = capi_md_add_with_identity;
+    api->md_get_one = capi_md_get_one;
+    api->md_get_all = capi_md_get_all;
+    api->md_contains = capi_md_contains;
+    api->md_len = capi_md_len;
+    api->md_next = capi_md_next;
+    api->md_version = capi_md_version;
+    return PyCapsule_New(api, MULTIDICT_CAPI_NAME, NULL);
+}
+
+/******************** Other functions ********************/
+
+static PyObject *
+getversion(PyObject *self, PyObject *arg)
+{
+    mod_state *state = get_mod_state(self);
+    MultiDictObject *md;
+    if (AnyMultiDict_Check(state, arg)) {
+        md = (MultiDictObject *)arg;
+    } else if (AnyMultiDictProxy_Check(state, arg)) {
+        md = ((MultiDictProxyObject *)arg)->md;
+    } else if (AnyFrozenMultiDict_Check(state, arg)) {
+        md = (MultiDictObject *)arg;
+    } else {
+        PyErr_Format(PyExc_TypeError, "unexpected type");
+        return NULL;
+    }
+    return PyLong_FromUnsignedLong(md_version(md));
+}
+
+static PyObject *
+htkeys_pool_stats(PyObject *self, PyObject *Py_UNUSED(unused))
+{
+    mod_state *state = get_mod_state(self);
+    htkeys_pool_t *pool = &state->htkeys_pool;
+
+    htkeys_pool_lock(pool);
+    unsigned long long hits = pool->hits;
+    unsigned long long misses = pool->misses;
+    Py_ssize_t maxsize = pool->maxsize;
+    Py_ssize_t cached = 0;
+    for (size_t cls = 0; cls < HTKEYS_POOL_NCLASSES; cls++) {
+        cached += pool->sizes[cls];
+    }
+    htkeys_pool_unlock(pool);
+
+    return Py_BuildValue("{sKsKsnsn}",
+                         "hits",
+                         hits,
+                         "misses",
+                         misses,
+                         "cached",
+                         cached,
+                         "maxsize",
+                         maxsize);
+}
+
+static PyObject *
+set_htkeys_pool_maxsize(PyObject *self, PyObject *arg)
+{
+    mod_state *state = get_mod_state(self);
+    Py_ssize_t maxsize = PyLong_AsSsize_t(arg);
+    if (maxsize == -1 && PyErr_Occurred()) {
+        return NULL;
+    }
+    if (maxsize < 0) {
+        PyErr_SetString(PyExc_ValueError, "maxsize should be non-negative");
+        return NULL;
+    }
+    htkeys_pool_set_maxsize(state, maxsize);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(htkeys_pool_stats_doc,
+             "Return hits, misses, and the amount of cached tables "
+             "of the internal hashtable pool.");
+
+PyDoc_STRVAR(set_htkeys_pool_maxsize_doc,
+             "Set the maximum amount of cached tables per size class "
+             "of the internal hashtable pool.");
+
+static PyObject *
+identity_intern_stats(PyObject *self, PyObject *Py_UNUSED(unused))
+{
+    mod_state *state = get_mod_state(self);
+    intern_table_t *table = &state->intern_table;
+
+    Py_ssize_t used = intern_used(state);
+    intern_lock(table);
+    unsigned long long hits = table->hits;
+    unsigned long long misses = table->misses;
+    Py_ssize_t size = table->size;
+    intern_unlock(table);
+
+    return Py_BuildValue("{sKsKsnsn}",
+                         "hits",
+                         hits,
+                         "misses",
+                         misses,
+                         "used",
+                         used,
+                         "size",
+                         size);
+}
+
+static PyObject *
+set_identity_intern_size(PyObject *self, PyObject *arg)
+{
+    mod_state *state = get_mod_state(self);
+    Py_ssize_t size = PyLong_AsSsize_t(arg);
+    if (size == -1 && PyErr_Occurred()) {
+        return NULL;
+    }
+    if (size < 0 || (size & (size - 1)) != 0) {
+        PyErr_SetString(PyExc_ValueError,
+                        "size should be zero or a power of two");
+        return NULL;
+    }
+    intern_set_size(state, size);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+header_id(PyObject *Py_UNUSED(self), PyObject *arg)
+{
+    if (!PyUnicode_Check(arg)) {
+        PyErr_SetString(PyExc_TypeError, "header name should be str");
+        return NULL;
+    }
+    if (!PyUnicode_IS_ASCII(arg)) {
+        Py_RETURN_NONE;
+    }
+    int id =
+        headers_find(PyUnicode_1BYTE_DATA(arg), PyUnicode_GET_LENGTH(arg));
+    if (id < 0) {
+        Py_RETURN_NONE;
+    }
+    return PyLong_FromLong(id);
+}
+
+PyDoc_STRVAR(header_id_doc,
+             "Return the ID of the well-known HTTP header name "
+             "or None for other names.");
+
+PyDoc_STRVAR(identity_intern_stats_doc,
+             "Return hits, misses, the amount of used slots, and the size "
+             "of the internal table of case-insensitive identities.");
+
+PyDoc_STRVAR(set_identity_intern_size_doc,
+             "Resize the internal table of case-insensitive identities, "
+             "zero disables interning.");
+
+static PyObject *
+split_layouts_stats(PyObject *self, PyObject *Py_UNUSED(unused))
+{
+    mod_state *state = get_mod_state(self);
+    layout_cache_t *cache = &state->layout_cache;
+    return Py_BuildValue("{sKsKsnsn}",
+                         "hits",
+                         (unsigned long long)cache->hits,
+                         "misses",
+                         (unsigned long long)cache->misses,
+                         "used",
+                         layout_cache_used(state),
+                         "size",
+                         cache->size);
+}
+
+static PyObject *
+set_split_layouts_size(PyObject *self, PyObject *arg)
+{
+    mod_state *state = get_mod_state(self);
+    Py_ssize_t size = PyLong_AsSsize_t(arg);
+    if (size == -1 && PyErr_Occurred()) {
+        return NULL;
+    }
+    if (size < 0 || size > LAYOUT_CACHE_SIZE || (size & (size - 1)) != 0) {
+        PyErr_Format(PyExc_ValueError,
+                     "size should be zero or a power of two up to %d",
+                     LAYOUT_CACHE_SIZE);
+        return NULL;
+    }
+    layout_cache_set_size(state, size);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(split_layouts_stats_doc,
+             "Return hits, misses, the amount of used slots, and the size "
+             "of the internal cache of split table layouts.");
+
+PyDoc_STRVAR(set_split_layouts_size_doc,
+             "Resize the internal cache of split table layouts, "
+             "zero disables split tables.");
+
+/******************** Module ********************/
+
+static int
+module_traverse(PyObject *mod, visitproc visit, void *arg)
+{
+    mod_state *state = get_mod_state(mod);
+
+    Py_VISIT(state->IStrType);
+
+    Py_VISIT(state->MultiDictType);
+    Py_VISIT(state->CIMultiDictType);
+    Py_VISIT(state->MultiDictProxyType);
+    Py_VISIT(state->CIMultiDictProxyType);
+    Py_VISIT(state->FrozenMultiDictType);
+    Py_VISIT(state->FrozenCIMultiDictType);
+    Py_VISIT(state->PersistentMultiDictType);
+    Py_VISIT(state->PersistentCIMultiDictType);
+    Py_VISIT(state->PMDNodeType);
+
+    Py_VISIT(state->KeysViewType);
+    Py_VISIT(state->ItemsViewType);
+    Py_VISIT(state->ValuesViewType);
+
+    Py_VISIT(state->KeysIterType);
+    Py_VISIT(state->ItemsIterType);
+    Py_VISIT(state->ValuesIterType);
+
+    Py_VISIT(state->str_canonical);
+    Py_VISIT(state->str_lower);
+    Py_VISIT(state->str_name);
+    Py_VISIT(state->str_keep_capacity);
+
+    return 0;
+}
+
+static int
+module_clear(PyObject *mod)
+{
+    mod_state *state = get_mod_state(mod);
+
+    // Stored objects are freed by their types, clear them first
+    freelist_clear(&state->multidict_freelist);
+    freelist_clear(&state->proxy_freelist);
+    freelist_clear(&state->view_freelist);
+    freelist_clear(&state->iter_freelist);
+
+    Py_CLEAR(state->IStrType);
+
+    Py_CLEAR(state->MultiDictType);
+    Py_CLEAR(state->CIMultiDictType);
+    Py_CLEAR(state->MultiDictProxyType);
+    Py_CLEAR(state->CIMultiDictProxyType);
+    Py_CLEAR(state->FrozenMultiDictType);
+    Py_CLEAR(state->FrozenCIMultiDictType);
+    Py_CLEAR(state->PersistentMultiDictType);
+    Py_CLEAR(state->PersistentCIMultiDictType);
+    Py_CLEAR(state->PMDNodeType);
+
+    Py_CLEAR(state->KeysViewType);
+    Py_CLEAR(state->ItemsViewType);
     Py_CLEAR(state->ValuesViewType);
 
     Py_CLEAR(state->KeysIterType);
@@ -1450,6 +3050,13 @@ module_clear(PyObject *mod)
     Py_CLEAR(state->str_canonical);
     Py_CLEAR(state->str_lower);
     Py_CLEAR(state->str_name);
+    Py_CLEAR(state->str_keep_capacity);
+
+    // layouts are released to the pool
+    layout_cache_clear(state);
+    htkeys_pool_clear(state);
+    intern_clear(state);
+    headers_clear(state);
 
     return 0;
 }
@@ -1462,6 +3069,31 @@ module_free(void *mod)
 
 static PyMethodDef module_methods[] = {
     {"getversion", (PyCFunction)getversion, METH_O},
+    {"_htkeys_pool_stats",
+     (PyCFunction)htkeys_pool_stats,
+     METH_NOARGS,
+     htkeys_pool_stats_doc},
+    {"_set_htkeys_pool_maxsize",
+     (PyCFunction)set_htkeys_pool_maxsize,
+     METH_O,
+     set_htkeys_pool_maxsize_doc},
+    {"_identity_intern_stats",
+     (PyCFunction)identity_intern_stats,
+     METH_NOARGS,
+     identity_intern_stats_doc},
+    {"_set_identity_intern_size",
+     (PyCFunction)set_identity_intern_size,
+     METH_O,
+     set_identity_intern_size_doc},
+    {"_split_layouts_stats",
+     (PyCFunction)split_layouts_stats,
+     METH_NOARGS,
+     split_layouts_stats_doc},
+    {"_set_split_layouts_size",
+     (PyCFunction)set_split_layouts_size,
+     METH_O,
+     set_split_layouts_size_doc},
+    {"_header_id", (PyCFunction)header_id, METH_O, header_id_doc},
     {NULL, NULL} /* sentinel */
 };
 
@@ -1472,6 +3104,14 @@ module_exec(PyObject *mod)
     PyObject *tmp;
     PyObject *tpl = NULL;
 
+    htkeys_pool_init(state);
+    intern_init(state);
+    layout_cache_init(state);
+    freelist_init(&state->multidict_freelist);
+    freelist_init(&state->proxy_freelist);
+    freelist_init(&state->view_freelist);
+    freelist_init(&state->iter_freelist);
+
     state->str_lower = PyUnicode_InternFromString("lower");
     if (state->str_lower == NULL) {
         goto fail;
@@ -1484,6 +3124,13 @@ module_exec(PyObject *mod)
     if (state->str_name == NULL) {
         goto fail;
     }
+    state->str_keep_capacity = PyUnicode_InternFromString("keep_capacity");
+    if (state->str_keep_capacity == NULL) {
+        goto fail;
+    }
+    if (headers_init(state) < 0) {
+        goto fail;
+    }
 
     if (multidict_views_init(mod, state) < 0) {
         goto fail;
@@ -1497,6 +3144,10 @@ module_exec(PyObject *mod)
         goto fail;
     }
 
+    if (pmd_node_init(mod, state) < 0) {
+        goto fail;
+    }
+
     tmp = PyType_FromModuleAndSpec(mod, &multidict_spec, NULL);
     if (tmp == NULL) {
         goto fail;
@@ -1531,6 +3182,40 @@ module_exec(PyObject *mod)
     state->CIMultiDictProxyType = (PyTypeObject *)tmp;
     Py_CLEAR(tpl);
 
+    tmp = PyType_FromModuleAndSpec(mod, &frozen_multidict_spec, NULL);
+    if (tmp == NULL) {
+        goto fail;
+    }
+    state->FrozenMultiDictType = (PyTypeObject *)tmp;
+
+    tpl = PyTuple_Pack(1, (PyObject *)state->FrozenMultiDictType);
+    if (tpl == NULL) {
+        goto fail;
+    }
+    tmp = PyType_FromModuleAndSpec(mod, &frozen_cimultidict_spec, tpl);
+    if (tmp == NULL) {
+        goto fail;
+    }
+    state->FrozenCIMultiDictType = (PyTypeObject *)tmp;
+    Py_CLEAR(tpl);
+
+    tmp = PyType_FromModuleAndSpec(mod, &persistent_multidict_spec, NULL);
+    if (tmp == NULL) {
+        goto fail;
+    }
+    state->PersistentMultiDictType = (PyTypeObject *)tmp;
+
+    tpl = PyTuple_Pack(1, (PyObject *)state->PersistentMultiDictType);
+    if (tpl == NULL) {
+        goto fail;
+    }
+    tmp = PyType_FromModuleAndSpec(mod, &persistent_cimultidict_spec, tpl);
+    if (tmp == NULL) {
+        goto fail;
+    }
+    state->PersistentCIMultiDictType = (PyTypeObject *)tmp;
+    Py_CLEAR(tpl);
+
     if (PyModule_AddType(mod, state->IStrType) < 0) {
         goto fail;
     }
@@ -1546,6 +3231,18 @@ module_exec(PyObject *mod)
     if (PyModule_AddType(mod, state->CIMultiDictProxyType) < 0) {
         goto fail;
     }
+    if (PyModule_AddType(mod, state->FrozenMultiDictType) < 0) {
+        goto fail;
+    }
+    if (PyModule_AddType(mod, state->FrozenCIMultiDictType) < 0) {
+        goto fail;
+    }
+    if (PyModule_AddType(mod, state->PersistentMultiDictType) < 0) {
+        goto fail;
+    }
+    if (PyModule_AddType(mod, state->PersistentCIMultiDictType) < 0) {
+        goto fail;
+    }
     if (PyModule_AddType(mod, state->ItemsViewType) < 0) {
         goto fail;
     }
@@ -1556,6 +3253,14 @@ module_exec(PyObject *mod)
         goto fail;
     }
 
+    tmp = capi_new_capsule(state);
+    if (tmp == NULL) {
+        goto fail;
+    }
+    if (PyModule_Add(mod, "CAPI", tmp) < 0) {
+        goto fail;
+    }
+
     return 0;
 fail:
     Py_CLEAR(tpl);
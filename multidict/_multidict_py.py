@@ -1,5 +1,7 @@
 import enum
 import functools
+import itertools
+import operator
 import reprlib
 import sys
 from array import array
@@ -140,10 +142,8 @@ class _ItemsView(_ViewBase[_V], ItemsView[str, _V]):
                 continue
             hash_, identity, key, value = item
             for slot, idx, e in self._md._keys.iter_hash(hash_):
-                e.hash = -1
                 if e.identity == identity and e.value == value:
                     ret.add((e.key, e.value))
-            self._md._keys.restore_hash(hash_)
         return ret
 
     def __rand__(self, other: Iterable[_T]) -> set[_T]:
@@ -567,11 +567,24 @@ class _HtKeys(Generic[_V]):  # type: ignore[misc]
         i = hash_ & mask
         perturb = hash_ & sys.maxsize
         ix = indices[i]
+        # the probe sequence could visit the same slot twice; single-value
+        # lookups stop at the first match, the set is created for the second
+        first = -1
+        seen: set[int] | None = None
         while ix != -1:
             if ix != -2:
                 e = entries[ix]
                 if e.hash == hash_:
-                    yield i, ix, e
+                    if first == -1:
+                        first = ix
+                        yield i, ix, e
+                    elif ix != first:
+                        if seen is None:
+                            seen = {ix}
+                            yield i, ix, e
+                        elif ix not in seen:
+                            seen.add(ix)
+                            yield i, ix, e
             perturb >>= 5
             i = (i * 5 + perturb + 1) & mask
             ix = indices[i]
@@ -611,16 +624,18 @@ class _HtKeys(Generic[_V]):  # type: ignore[misc]
 class MultiDict(_CSMixin, MutableMultiMapping[_V]):
     """Dictionary with the support for duplicate keys."""
 
-    __slots__ = ("_keys", "_used", "_version")
+    __slots__ = ("_keys", "_used", "_version", "_log2_min_size")
 
     def __init__(self, arg: MDArg[_V] = None, /, **kwargs: _V):
         self._used = 0
+        # deletions don't downsize the table below it, see reserve()
+        self._log2_min_size = 0
         v = _version
         v[0] += 1
         self._version = v[0]
         if not kwargs:
             md = None
-            if isinstance(arg, MultiDictProxy):
+            if isinstance(arg, (MultiDictProxy, FrozenMultiDict, PersistentMultiDict)):
                 md = arg._md
             elif isinstance(arg, MultiDict):
                 md = arg
@@ -650,23 +665,25 @@ class MultiDict(_CSMixin, MutableMultiMapping[_V]):
         """Return a list of all values matching the key."""
         identity = self._identity(key)
         hash_ = hash(identity)
-        res = []
-        restore = []
-        for slot, idx, e in self._keys.iter_hash(hash_):
-            if e.identity == identity:  # pragma: no branch
-                res.append(e.value)
-                e.hash = -1
-                restore.append(idx)
-
+        res = [
+            e.value
+            for slot, idx, e in self._keys.iter_hash(hash_)
+            if e.identity == identity
+        ]
         if res:
-            entries = self._keys.entries
-            for idx in restore:
-                entries[idx].hash = hash_  # type: ignore[union-attr]
             return res
         if not res and default is not sentinel:
             return default
         raise KeyError(f"Key not found: {key!r}")
 
+    def count(self, key: str) -> int:
+        """Return the number of values matching the key."""
+        identity = self._identity(key)
+        hash_ = hash(identity)
+        return sum(
+            1 for slot, idx, e in self._keys.iter_hash(hash_) if e.identity == identity
+        )
+
     @overload
     def getone(self, key: str) -> _V: ...
     @overload
@@ -722,7 +739,7 @@ class MultiDict(_CSMixin, MutableMultiMapping[_V]):
     def __eq__(self, other: object) -> bool:
         if not isinstance(other, Mapping):
             return NotImplemented
-        if isinstance(other, MultiDictProxy):
+        if isinstance(other, (MultiDictProxy, FrozenMultiDict, PersistentMultiDict)):
             return self == other._md
         if isinstance(other, MultiDict):
             lft = self._keys
@@ -794,7 +811,7 @@ class MultiDict(_CSMixin, MutableMultiMapping[_V]):
     ) -> Iterator[int | _Entry[_V]]:
         identity_func = self._identity
         if arg:
-            if isinstance(arg, MultiDictProxy):
+            if isinstance(arg, (MultiDictProxy, FrozenMultiDict, PersistentMultiDict)):
                 arg = arg._md
             if isinstance(arg, MultiDict):
                 yield len(arg) + len(kwargs)
@@ -853,12 +870,41 @@ class MultiDict(_CSMixin, MutableMultiMapping[_V]):
             self._add_with_hash(e)
         self._incr_version()
 
-    def clear(self) -> None:
-        """Remove all items from MultiDict."""
+    def clear(self, *, keep_capacity: bool = False) -> None:
+        """Remove all items from MultiDict.
+
+        If keep_capacity is true, the allocated storage is kept for reusing.
+        """
         self._used = 0
-        self._keys = _HtKeys.new(_HtKeys.LOG_MINSIZE, [])
+        if keep_capacity:
+            self._log2_min_size = self._keys.log2_size
+        else:
+            self._log2_min_size = 0
+        self._keys = _HtKeys.new(max(self._log2_min_size, _HtKeys.LOG_MINSIZE), [])
         self._incr_version()
 
+    def reserve(self, size: int, /) -> None:
+        """Make room for at least size more items without resizing."""
+        size = operator.index(size)
+        if size < 0:
+            raise ValueError("size should be non-negative")
+        if size > (sys.maxsize - self._used) // 96:
+            # the same limit as the C implementation has
+            raise MemoryError
+        log2_size = estimate_log2_keysize(self._used + size)
+        self._log2_min_size = max(self._log2_min_size, log2_size)
+        if log2_size > self._keys.log2_size:
+            self._resize(log2_size, False)
+            self._incr_version()
+
+    def shrink_to_fit(self) -> None:
+        """Release the storage not needed by the current items."""
+        self._log2_min_size = 0
+        log2_size = estimate_log2_keysize(self._used)
+        if log2_size < self._keys.log2_size or self._used < len(self._keys.entries):
+            self._resize(log2_size, False)
+            self._incr_version()
+
     # Mapping interface #
 
     def __setitem__(self, key: str, value: _V) -> None:
@@ -894,6 +940,7 @@ class MultiDict(_CSMixin, MutableMultiMapping[_V]):
             raise KeyError(key)
         else:
             self._incr_version()
+            self._shrink_if_sparse()
 
     @overload
     def setdefault(
@@ -929,6 +976,7 @@ class MultiDict(_CSMixin, MutableMultiMapping[_V]):
                 value = e.value
                 self._del_at(slot, idx)
                 self._incr_version()
+                self._shrink_if_sparse()
                 return value
         if default is sentinel:
             raise KeyError(key)
@@ -968,6 +1016,7 @@ class MultiDict(_CSMixin, MutableMultiMapping[_V]):
             else:
                 return default
         else:
+            self._shrink_if_sparse()
             return ret
 
     def popitem(self) -> tuple[str, _V]:
@@ -986,6 +1035,7 @@ class MultiDict(_CSMixin, MutableMultiMapping[_V]):
         self._keys.del_idx(entry.hash, pos)
         self._used -= 1
         self._incr_version()
+        self._shrink_if_sparse()
         return ret
 
     def update(self, arg: MDArg[_V] = None, /, **kwargs: _V) -> None:
@@ -1111,14 +1161,103 @@ class MultiDict(_CSMixin, MutableMultiMapping[_V]):
         self._keys.indices[slot] = -2
         self._used -= 1
 
+    def _shrink_if_sparse(self) -> None:
+        # Downsize the table once most of the items are deleted,
+        # see _md_shrink_if_sparse() in the C implementation.
+        keys = self._keys
+        if keys.log2_size <= _HtKeys.LOG_MINSIZE:
+            return
+        if self._used >= ((keys.nslots << 1) // 3) // 8:
+            return
+        log2_size = (self._used * 3 | _HtKeys.MINSIZE - 1).bit_length()
+        log2_size = max(log2_size, self._log2_min_size)
+        if log2_size < keys.log2_size:
+            self._resize(log2_size, False)
+
     def _del_at_for_upd(self, entry: _Entry[_V]) -> None:
         entry.key = None  # type: ignore[assignment]
         entry.value = None  # type: ignore[assignment]
 
 
+_TCHARS = frozenset(
+    b"!#$%&'*+-.^_`|~0123456789"
+    b"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+)
+_HEADER_ENCODINGS = {
+    "utf-8": ("utf-8", "surrogateescape"),
+    "utf8": ("utf-8", "surrogateescape"),
+    "latin-1": ("latin-1", "strict"),
+    "latin1": ("latin-1", "strict"),
+    "iso-8859-1": ("latin-1", "strict"),
+}
+
+
+def _parse_header_block(data: bytes) -> list[tuple[str, list[bytes]]]:
+    # the twin of md_extend_from_header_block() in _multilib/headerblock.h
+    headers: list[tuple[str, list[bytes]]] = []
+    pos = 0
+    for line in data.split(b"\n"):
+        start = pos
+        pos += len(line) + 1
+        if line.endswith(b"\r"):
+            line = line[:-1]
+        if not line:
+            break
+        if line[0] in b" \t":
+            if not headers:
+                raise ValueError(f"Unexpected line folding at offset {start}")
+            content = line
+            offset = start
+        else:
+            name, sep, content = line.partition(b":")
+            if not sep:
+                raise ValueError(f"Missing colon in header line at offset {start}")
+            if not name or not _TCHARS.issuperset(name):
+                raise ValueError(f"Invalid header name at offset {start}")
+            offset = start + len(name) + 1
+            headers.append((name.decode("ascii"), []))
+        bad = [i for i in (content.find(b"\0"), content.find(b"\r")) if i >= 0]
+        if bad:
+            i = min(bad)
+            what = "NUL" if content[i] == 0 else "CR"
+            msg = f"Invalid {what} in header value at offset {offset + i}"
+            raise ValueError(msg)
+        headers[-1][1].append(content.strip(b" \t"))
+    return headers
+
+
 class CIMultiDict(_CIMixin, MultiDict[_V]):
     """Dictionary with the support for duplicate case-insensitive keys."""
 
+    @classmethod
+    def from_http_header_block(
+        cls, block: "bytes | bytearray | memoryview", encoding: str = "utf-8"
+    ) -> Self:
+        """Create a CIMultiDict from a raw HTTP/1.x header block.
+
+        Lines are separated by CRLF or LF, parsing stops at the first empty line.
+        Values are decoded by encoding, 'utf-8' or 'latin-1'.
+        """
+        if not isinstance(encoding, str):
+            raise TypeError(
+                f"encoding should be a str, got {type(encoding).__name__}"
+            )
+        try:
+            codec, errors = _HEADER_ENCODINGS[encoding]
+        except KeyError:
+            raise ValueError(
+                f"encoding should be 'utf-8' or 'latin-1', got {encoding!r}"
+            ) from None
+        headers = _parse_header_block(memoryview(block).tobytes())
+        md = cls()
+        md.extend(
+            [
+                (name, b" ".join(p for p in pieces if p).decode(codec, errors))
+                for name, pieces in headers
+            ]
+        )
+        return md
+
 
 class MultiDictProxy(_CSMixin, MultiMapping[_V]):
     """Read-only proxy for MultiDict instance."""
@@ -1151,6 +1290,10 @@ class MultiDictProxy(_CSMixin, MultiMapping[_V]):
         else:
             return self._md.getall(key)
 
+    def count(self, key: str) -> int:
+        """Return the number of values matching the key."""
+        return self._md.count(key)
+
     @overload
     def getone(self, key: str) -> _V: ...
     @overload
@@ -1232,8 +1375,578 @@ class CIMultiDictProxy(_CIMixin, MultiDictProxy[_V]):
         return CIMultiDict(self._md)
 
 
-def getversion(md: MultiDict[object] | MultiDictProxy[object]) -> int:
-    if isinstance(md, MultiDictProxy):
+class FrozenMultiDict(_CSMixin, MultiMapping[_V]):
+    """Immutable hashable dictionary with the support for duplicate keys."""
+
+    __slots__ = ("_md", "_hash")
+
+    _md: MultiDict[_V]
+    _hash: int | None
+
+    def __new__(cls, arg: MDArg[_V] = None, /, **kwargs: _V) -> Self:
+        if (
+            not kwargs
+            and type(arg) is cls
+            and cls in (FrozenMultiDict, FrozenCIMultiDict)
+        ):
+            return cast(Self, arg)
+        self = super().__new__(cls)
+        md: MultiDict[_V]
+        if cls._ci:
+            md = CIMultiDict(arg, **kwargs)
+        else:
+            md = MultiDict(arg, **kwargs)
+        md.shrink_to_fit()
+        self._md = md
+        self._hash = None
+        return self
+
+    def __hash__(self) -> int:
+        if self._hash is None:
+            # the same as the C implementation
+            self._hash = hash(
+                tuple(
+                    itertools.chain.from_iterable(
+                        (e.identity, e.value) for e in self._md._keys.iter_entries()
+                    )
+                )
+            )
+        return self._hash
+
+    def __reduce__(self) -> tuple[type[Self], tuple[list[tuple[str, _V]]]]:
+        return (self.__class__, (list(self.items()),))
+
+    @overload
+    def getall(self, key: str) -> list[_V]: ...
+    @overload
+    def getall(self, key: str, default: _T) -> list[_V] | _T: ...
+    def getall(self, key: str, default: _T | _SENTINEL = sentinel) -> list[_V] | _T:
+        """Return a list of all values matching the key."""
+        if default is not sentinel:
+            return self._md.getall(key, default)
+        else:
+            return self._md.getall(key)
+
+    def count(self, key: str) -> int:
+        """Return the number of values matching the key."""
+        return self._md.count(key)
+
+    @overload
+    def getone(self, key: str) -> _V: ...
+    @overload
+    def getone(self, key: str, default: _T) -> _V | _T: ...
+    def getone(self, key: str, default: _T | _SENTINEL = sentinel) -> _V | _T:
+        """Get first value matching the key.
+
+        Raises KeyError if the key is not found and no default is provided.
+        """
+        if default is not sentinel:
+            return self._md.getone(key, default)
+        else:
+            return self._md.getone(key)
+
+    # Mapping interface #
+
+    def __getitem__(self, key: str) -> _V:
+        return self.getone(key)
+
+    @overload
+    def get(self, key: str, /) -> _V | None: ...
+    @overload
+    def get(self, key: str, /, default: _T) -> _V | _T: ...
+    def get(self, key: str, default: _T | None = None) -> _V | _T | None:
+        """Get first value matching the key.
+
+        If the key is not found, returns the default (or None if no default is provided)
+        """
+        return self._md.getone(key, default)
+
+    def __iter__(self) -> Iterator[str]:
+        return iter(self._md.keys())
+
+    def __len__(self) -> int:
+        return len(self._md)
+
+    def keys(self) -> KeysView[str]:
+        """Return a new view of the dictionary's keys."""
+        return self._md.keys()
+
+    def items(self) -> ItemsView[str, _V]:
+        """Return a new view of the dictionary's items as ``(key, value)`` pairs."""
+        return self._md.items()
+
+    def values(self) -> _ValuesView[_V]:
+        """Return a new view of the dictionary's values."""
+        return self._md.values()
+
+    def __eq__(self, other: object) -> bool:
+        return self._md == other
+
+    def __contains__(self, key: object) -> bool:
+        return key in self._md
+
+    @reprlib.recursive_repr()
+    def __repr__(self) -> str:
+        body = ", ".join(f"'{k}': {v!r}" for k, v in self.items())
+        return f"<{self.__class__.__name__}({body})>"
+
+    def copy(self) -> MultiDict[_V]:
+        """Return a mutable copy of the dictionary."""
+        return MultiDict(self._md)
+
+
+class FrozenCIMultiDict(_CIMixin, FrozenMultiDict[_V]):
+    """Immutable hashable dictionary with the support for duplicate
+    case-insensitive keys."""
+
+    def copy(self) -> CIMultiDict[_V]:
+        """Return a mutable copy of the dictionary."""
+        return CIMultiDict(self._md)
+
+
+# Persistent multidict, see _multilib/persistent.h for the layout.
+#
+# Items are tuples (identity, key, value, pos).  The order trie is a tuple of
+# up to _PMD_WIDTH children per node with the items (None for removed ones)
+# as leaves.  The index is a hash array mapped trie from the identity to the
+# vector of its items: a node is (bitmap, key0, value0, ...), a pair with None
+# key holds a subnode, keys with equal folded hashes live in a collision node
+# (None, key0, value0, ...) below the last level.  The vector is a tuple of up
+# to _PMD_WIDTH items or (None, count, root) for more, root is an order trie
+# node without holes.
+
+_PMD_BITS = 5
+_PMD_WIDTH = 1 << _PMD_BITS
+_PMD_MASK = _PMD_WIDTH - 1
+_PMD_MAX_SHIFT = 30
+_PMD_REBUILD_MIN = _PMD_WIDTH
+
+_PMDItem = tuple[str, str, _V, int]
+
+
+def _pmd_hash32(hash_: int) -> int:
+    hash_ &= 0xFFFFFFFFFFFFFFFF
+    return (hash_ & 0xFFFFFFFF) ^ (hash_ >> 32)
+
+
+def _pmd_order_set(
+    node: tuple[Any, ...] | None, shift: int, pos: int, item: Any
+) -> tuple[Any, ...]:
+    if node is None:
+        node = ()
+    i = (pos >> shift) & _PMD_MASK
+    if shift:
+        item = _pmd_order_set(
+            node[i] if i < len(node) else None, shift - _PMD_BITS, pos, item
+        )
+    return node[:i] + (item,) + node[i + 1 :]
+
+
+def _pmd_order_iter(node: tuple[Any, ...], shift: int) -> Iterator[Any]:
+    if shift:
+        for child in node:
+            yield from _pmd_order_iter(child, shift - _PMD_BITS)
+    else:
+        for item in node:
+            if item is not None:
+                yield item
+
+
+def _pmd_vec_shift(count: int) -> int:
+    shift = 0
+    while (count - 1) >> (shift + _PMD_BITS):
+        shift += _PMD_BITS
+    return shift
+
+
+def _pmd_items_count(items: tuple[Any, ...]) -> int:
+    return len(items) if items[0] is not None else cast(int, items[1])
+
+
+def _pmd_items_first(items: tuple[Any, ...]) -> _PMDItem[Any]:
+    if items[0] is None:
+        node = items[2]
+        for _ in range(_pmd_vec_shift(items[1]) // _PMD_BITS):
+            node = node[0]
+        return cast(_PMDItem[Any], node[0])
+    return cast(_PMDItem[Any], items[0])
+
+
+def _pmd_items_iter(items: tuple[Any, ...]) -> Iterator[_PMDItem[Any]]:
+    if items[0] is None:
+        return _pmd_order_iter(items[2], _pmd_vec_shift(items[1]))
+    return iter(items)
+
+
+def _pmd_items_append(items: tuple[Any, ...] | None, item: Any) -> tuple[Any, ...]:
+    if items is None:
+        return (item,)
+    count = _pmd_items_count(items)
+    if count < _PMD_WIDTH:
+        return items + (item,)
+    root = items if items[0] is not None else items[2]
+    shift = _pmd_vec_shift(count + 1)
+    if shift > _pmd_vec_shift(count):
+        # the root is full
+        root = (root,)
+    return (None, count + 1, _pmd_order_set(root, shift, count, item))
+
+
+def _pmd_index_find(
+    node: tuple[Any, ...] | None, hash_: int, identity: str
+) -> tuple[Any, ...] | None:
+    h = _pmd_hash32(hash_)
+    shift = 0
+    while node is not None:
+        if node[0] is None:
+            for i in range(1, len(node), 2):
+                if node[i] == identity:
+                    return cast(tuple[Any, ...], node[i + 1])
+            return None
+        bitmap = node[0]
+        bit = 1 << ((h >> shift) & _PMD_MASK)
+        if not bitmap & bit:
+            return None
+        i = 1 + 2 * (bitmap & (bit - 1)).bit_count()
+        key = node[i]
+        if key is not None:
+            return cast(tuple[Any, ...], node[i + 1]) if key == identity else None
+        node = node[i + 1]
+        shift += _PMD_BITS
+    return None
+
+
+def _pmd_index_pair(
+    shift: int, key1: str, value1: Any, h1: int, key2: str, value2: Any, h2: int
+) -> tuple[Any, ...]:
+    if shift > _PMD_MAX_SHIFT:
+        return (None, key1, value1, key2, value2)
+    i1 = (h1 >> shift) & _PMD_MASK
+    i2 = (h2 >> shift) & _PMD_MASK
+    if i1 == i2:
+        sub = _pmd_index_pair(shift + _PMD_BITS, key1, value1, h1, key2, value2, h2)
+        return (1 << i1, None, sub)
+    bitmap = (1 << i1) | (1 << i2)
+    if i1 < i2:
+        return (bitmap, key1, value1, key2, value2)
+    else:
+        return (bitmap, key2, value2, key1, value1)
+
+
+def _pmd_index_assoc(
+    node: tuple[Any, ...] | None, shift: int, hash_: int, identity: str, value: Any
+) -> tuple[Any, ...]:
+    h = _pmd_hash32(hash_)
+    if node is None:
+        return (1 << ((h >> shift) & _PMD_MASK), identity, value)
+    if node[0] is None:
+        for i in range(1, len(node), 2):
+            if node[i] == identity:
+                return node[: i + 1] + (value,) + node[i + 2 :]
+        return node + (identity, value)
+    bitmap = node[0]
+    bit = 1 << ((h >> shift) & _PMD_MASK)
+    i = 1 + 2 * (bitmap & (bit - 1)).bit_count()
+    if not bitmap & bit:
+        return (bitmap | bit,) + node[1:i] + (identity, value) + node[i:]
+    key = node[i]
+    old = node[i + 1]
+    if key is None:
+        child = _pmd_index_assoc(old, shift + _PMD_BITS, hash_, identity, value)
+        return node[: i + 1] + (child,) + node[i + 2 :]
+    if key == identity:
+        return node[: i + 1] + (value,) + node[i + 2 :]
+    child = _pmd_index_pair(
+        shift + _PMD_BITS, key, old, _pmd_hash32(hash(key)), identity, value, h
+    )
+    return node[:i] + (None, child) + node[i + 2 :]
+
+
+def _pmd_index_without(
+    node: tuple[Any, ...], shift: int, hash_: int, identity: str
+) -> tuple[Any, ...] | None:
+    if node[0] is None:
+        for i in range(1, len(node), 2):  # pragma: no branch
+            if node[i] == identity:
+                break
+        if len(node) == 3:
+            return None
+        return node[:i] + node[i + 2 :]
+    bitmap = node[0]
+    bit = 1 << ((_pmd_hash32(hash_) >> shift) & _PMD_MASK)
+    i = 1 + 2 * (bitmap & (bit - 1)).bit_count()
+    if node[i] is None:
+        child = _pmd_index_without(node[i + 1], shift + _PMD_BITS, hash_, identity)
+        if child is not None:
+            if len(child) == 3 and child[1] is not None:
+                # a single key left in the subnode, pull it up
+                return node[:i] + child[1:] + node[i + 2 :]
+            return node[: i + 1] + (child,) + node[i + 2 :]
+    if bitmap == bit:
+        return None
+    return (bitmap & ~bit,) + node[1:i] + node[i + 2 :]
+
+
+class PersistentMultiDict(_CSMixin, MultiMapping[_V]):
+    """Immutable dictionary with the support for duplicate keys and cheap
+    updated copies."""
+
+    __slots__ = ("_used", "_nentries", "_shift", "_order", "_index", "_frozen")
+
+    _used: int
+    _nentries: int
+    _shift: int
+    _order: tuple[Any, ...] | None
+    _index: tuple[Any, ...] | None
+    _frozen: FrozenMultiDict[_V] | None
+
+    def __new__(cls, arg: MDArg[_V] = None, /, **kwargs: _V) -> Self:
+        if (
+            not kwargs
+            and type(arg) is cls
+            and cls in (PersistentMultiDict, PersistentCIMultiDict)
+        ):
+            return cast(Self, arg)
+        if not kwargs and isinstance(arg, PersistentMultiDict) and arg._ci is cls._ci:
+            return arg._derive(cls)
+        self = super().__new__(cls)
+        self._used = 0
+        self._nentries = 0
+        self._shift = 0
+        self._order = None
+        self._index = None
+        self._frozen = None
+        md: MultiDict[_V]
+        if cls._ci:
+            md = CIMultiDict(arg, **kwargs)
+        else:
+            md = MultiDict(arg, **kwargs)
+        for e in md._keys.iter_entries():
+            self._add_with_hash(e.hash, e.identity, e.key, e.value)
+        return self
+
+    def _derive(self, cls: type[Self] | None = None) -> Self:
+        # a new version sharing the tries
+        ret = object.__new__(cls or self.__class__)
+        ret._used = self._used
+        ret._nentries = self._nentries
+        ret._shift = self._shift
+        ret._order = self._order
+        ret._index = self._index
+        ret._frozen = None
+        return ret
+
+    @property
+    def _md(self) -> MultiDict[_V]:
+        return self._get_frozen()._md
+
+    def _get_frozen(self) -> FrozenMultiDict[_V]:
+        if self._frozen is None:
+            md: MultiDict[_V] = CIMultiDict() if self._ci else MultiDict()
+            md.reserve(self._used)
+            if self._order is not None:
+                for identity, key, value, pos in _pmd_order_iter(
+                    self._order, self._shift
+                ):
+                    md._add_with_hash(_Entry(hash(identity), identity, key, value))
+            frozen_cls = FrozenCIMultiDict if self._ci else FrozenMultiDict
+            self._frozen = frozen_cls(md)
+        return self._frozen
+
+    def _set_at(self, pos: int, item: Any) -> None:
+        if self._order is not None and pos == 1 << (self._shift + _PMD_BITS):
+            # the root is full
+            self._order = (self._order,)
+            self._shift += _PMD_BITS
+        self._order = _pmd_order_set(self._order, self._shift, pos, item)
+
+    def _add_with_hash(self, hash_: int, identity: str, key: str, value: _V) -> None:
+        item = (identity, key, value, self._nentries)
+        self._set_at(self._nentries, item)
+        self._nentries += 1
+        old = _pmd_index_find(self._index, hash_, identity)
+        items = _pmd_items_append(old, item)
+        self._index = _pmd_index_assoc(self._index, 0, hash_, identity, items)
+        self._used += 1
+
+    def _rebuild_if_sparse(self) -> None:
+        if (
+            self._nentries < _PMD_REBUILD_MIN
+            or self._nentries - self._used <= self._used
+        ):
+            return
+        order = self._order
+        shift = self._shift
+        self._order = None
+        self._index = None
+        self._shift = 0
+        self._nentries = 0
+        self._used = 0
+        if order is not None:  # pragma: no branch
+            for identity, key, value, pos in _pmd_order_iter(order, shift):
+                self._add_with_hash(hash(identity), identity, key, value)
+
+    def _find(self, key: str) -> tuple[Any, ...] | None:
+        identity = self._identity(key)
+        return _pmd_index_find(self._index, hash(identity), identity)
+
+    def with_added(self, key: str, value: _V) -> Self:
+        """Return a new dictionary with the item appended."""
+        identity = self._identity(key)
+        ret = self._derive()
+        ret._add_with_hash(hash(identity), identity, key, value)
+        return ret
+
+    def with_replaced(self, key: str, value: _V) -> Self:
+        """Return a new dictionary with the first value matching the key replaced.
+
+        Other values of the key are removed, the item is appended if the key is
+        not found.
+        """
+        identity = self._identity(key)
+        hash_ = hash(identity)
+        ret = self._derive()
+        items = _pmd_index_find(self._index, hash_, identity)
+        if items is None:
+            ret._add_with_hash(hash_, identity, key, value)
+            return ret
+        first = _pmd_items_first(items)
+        item = (first[0], key, value, first[3])
+        for other in _pmd_items_iter(items):
+            ret._set_at(other[3], None)
+        ret._set_at(first[3], item)
+        ret._index = _pmd_index_assoc(ret._index, 0, hash_, identity, (item,))
+        ret._used -= _pmd_items_count(items) - 1
+        ret._rebuild_if_sparse()
+        return ret
+
+    def without(self, key: str) -> Self:
+        """Return a new dictionary without all values matching the key."""
+        identity = self._identity(key)
+        hash_ = hash(identity)
+        items = _pmd_index_find(self._index, hash_, identity)
+        if items is None:
+            raise KeyError(key)
+        ret = self._derive()
+        for item in _pmd_items_iter(items):
+            ret._set_at(item[3], None)
+        ret._index = _pmd_index_without(
+            cast(tuple[Any, ...], ret._index), 0, hash_, identity
+        )
+        ret._used -= _pmd_items_count(items)
+        if not ret._used:
+            # start from scratch
+            ret._order = None
+            ret._shift = 0
+            ret._nentries = 0
+        ret._rebuild_if_sparse()
+        return ret
+
+    def __hash__(self) -> int:
+        return hash(self._get_frozen())
+
+    def __reduce__(self) -> tuple[type[Self], tuple[list[tuple[str, _V]]]]:
+        return (self.__class__, (list(self.items()),))
+
+    @overload
+    def getall(self, key: str) -> list[_V]: ...
+    @overload
+    def getall(self, key: str, default: _T) -> list[_V] | _T: ...
+    def getall(self, key: str, default: _T | _SENTINEL = sentinel) -> list[_V] | _T:
+        """Return a list of all values matching the key."""
+        items = self._find(key)
+        if items is not None:
+            return [item[2] for item in _pmd_items_iter(items)]
+        if default is not sentinel:
+            return default
+        raise KeyError(f"Key not found: {key!r}")
+
+    def count(self, key: str) -> int:
+        """Return the number of values matching the key."""
+        items = self._find(key)
+        return 0 if items is None else _pmd_items_count(items)
+
+    @overload
+    def getone(self, key: str) -> _V: ...
+    @overload
+    def getone(self, key: str, default: _T) -> _V | _T: ...
+    def getone(self, key: str, default: _T | _SENTINEL = sentinel) -> _V | _T:
+        """Get first value matching the key.
+
+        Raises KeyError if the key is not found and no default is provided.
+        """
+        items = self._find(key)
+        if items is not None:
+            return cast(_V, _pmd_items_first(items)[2])
+        if default is not sentinel:
+            return default
+        raise KeyError(f"Key not found: {key!r}")
+
+    # Mapping interface #
+
+    def __getitem__(self, key: str) -> _V:
+        return self.getone(key)
+
+    @overload
+    def get(self, key: str, /) -> _V | None: ...
+    @overload
+    def get(self, key: str, /, default: _T) -> _V | _T: ...
+    def get(self, key: str, default: _T | None = None) -> _V | _T | None:
+        """Get first value matching the key.
+
+        If the key is not found, returns the default (or None if no default is provided)
+        """
+        return self.getone(key, default)
+
+    def __iter__(self) -> Iterator[str]:
+        return iter(self._md.keys())
+
+    def __len__(self) -> int:
+        return self._used
+
+    def keys(self) -> KeysView[str]:
+        """Return a new view of the dictionary's keys."""
+        return self._md.keys()
+
+    def items(self) -> ItemsView[str, _V]:
+        """Return a new view of the dictionary's items as ``(key, value)`` pairs."""
+        return self._md.items()
+
+    def values(self) -> _ValuesView[_V]:
+        """Return a new view of the dictionary's values."""
+        return self._md.values()
+
+    def __eq__(self, other: object) -> bool:
+        return self._md == other
+
+    def __contains__(self, key: object) -> bool:
+        if not isinstance(key, str):
+            return False
+        return self._find(key) is not None
+
+    @reprlib.recursive_repr()
+    def __repr__(self) -> str:
+        body = ", ".join(f"'{k}': {v!r}" for k, v in self.items())
+        return f"<{self.__class__.__name__}({body})>"
+
+    def copy(self) -> MultiDict[_V]:
+        """Return a mutable copy of the dictionary."""
+        return MultiDict(self._md)
+
+
+class PersistentCIMultiDict(_CIMixin, PersistentMultiDict[_V]):
+    """Immutable dictionary with the support for duplicate case-insensitive
+    keys and cheap updated copies."""
+
+    def copy(self) -> CIMultiDict[_V]:
+        """Return a mutable copy of the dictionary."""
+        return CIMultiDict(self._md)
+
+
+def getversion(
+    md: MultiDict[object] | MultiDictProxy[object] | FrozenMultiDict[object],
+) -> int:
+    if isinstance(md, (MultiDictProxy, FrozenMultiDict)):
         md = md._md
     elif not isinstance(md, MultiDict):
         raise TypeError("Parameter should be multidict or proxy")
@@ -23,10 +23,23 @@ typedef struct {
 
     uint64_t version;
     bool is_ci;
+    // the table is not downsized below it by deletions, see md_reserve_capacity()
+    uint8_t log2_min_size;
+    // update() or merge() is running, the table may contain soft-deleted
+    // entries and is never shared, see md_clone_from_ht()
+    bool in_update;
 
     htkeys_t *keys;
+    // values of a split table, NULL for a combined one, see md_init_split()
+    PyObject **values;
 } MultiDictObject;
 
+typedef struct {
+    MultiDictObject md;
+    // -1 until computed by __hash__(), the table is never modified
+    Py_hash_t hash;
+} FrozenMultiDictObject;
+
 typedef struct {
     PyObject_HEAD
 #ifndef MANAGED_WEAKREFS
@@ -35,6 +48,25 @@ typedef struct {
     MultiDictObject *md;
 } MultiDictProxyObject;
 
+typedef struct {
+    PyObject_HEAD
+#ifndef MANAGED_WEAKREFS
+    PyObject *weaklist;
+#endif
+    mod_state *state;
+    Py_ssize_t used;
+    // positions taken in the order trie, including removed items
+    Py_ssize_t nentries;
+    bool is_ci;
+    // the level of the order trie root, see persistent.h
+    uint8_t shift;
+
+    PyObject *order;  // items in the insertion order, NULL if empty
+    PyObject *index;  // identity -> vector of items, NULL if empty
+    // (CI)FrozenMultiDict built on demand for iteration and comparison
+    MultiDictObject *frozen;
+} PersistentMultiDictObject;
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,117 @@
+#ifndef _MULTIDICT_FREELIST_H
+#define _MULTIDICT_FREELIST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+/* Bounded freelist of deallocated GC objects sharing the same memory layout.
+
+   Similar to CPython's tuple and dict freelists but lives in the module
+   state, thus it is per-interpreter.  Free-threaded build guards it by a
+   mutex.
+
+   Only instances of the exact types defined by the module are kept; the
+   memory of user-defined subclasses could be larger and is freed as usual.
+
+   The object is stored untracked by GC and without a reference to its type;
+   freelist_pop() re-initializes the object by PyObject_Init(), it doesn't
+   track the object and doesn't initialize the object fields except
+   zeroing them.
+*/
+
+#define FREELIST_MAXSIZE 80
+
+typedef struct {
+    PyObject *items[FREELIST_MAXSIZE];
+    Py_ssize_t size;
+    Py_ssize_t maxsize;
+#ifdef Py_GIL_DISABLED
+    PyMutex mutex;
+#endif
+} freelist_t;
+
+static inline void
+freelist_init(freelist_t *fl)
+{
+    fl->size = 0;
+    fl->maxsize = FREELIST_MAXSIZE;
+}
+
+static inline PyObject *
+freelist_pop(freelist_t *fl, PyTypeObject *tp)
+{
+    PyObject *op = NULL;
+#ifdef Py_GIL_DISABLED
+    PyMutex_Lock(&fl->mutex);
+#endif
+    if (fl->size > 0) {
+        fl->size -= 1;
+        op = fl->items[fl->size];
+    }
+#ifdef Py_GIL_DISABLED
+    PyMutex_Unlock(&fl->mutex);
+#endif
+    if (op == NULL) {
+        return NULL;
+    }
+    assert(tp->tp_basicsize >= (Py_ssize_t)sizeof(PyObject));
+    memset((char *)op + sizeof(PyObject),
+           0,
+           (size_t)tp->tp_basicsize - sizeof(PyObject));
+    return PyObject_Init(op, tp);
+}
+
+/* Store deallocated object, return true on success.
+
+   The object should be untracked by GC already, the caller is responsible
+   for the type decref regardless of the result.
+*/
+static inline bool
+freelist_push(freelist_t *fl, PyObject *op)
+{
+    bool ret = false;
+    assert(!PyObject_GC_IsTracked(op));
+#ifdef Py_GIL_DISABLED
+    PyMutex_Lock(&fl->mutex);
+#endif
+    if (fl->size < fl->maxsize) {
+        fl->items[fl->size] = op;
+        fl->size += 1;
+        ret = true;
+    }
+#ifdef Py_GIL_DISABLED
+    PyMutex_Unlock(&fl->mutex);
+#endif
+    return ret;
+}
+
+/* Free all stored objects and disable the freelist.
+
+   Should be called before clearing the module types,
+   PyObject_GC_Del() uses the type of the stored object.
+*/
+static inline void
+freelist_clear(freelist_t *fl)
+{
+#ifdef Py_GIL_DISABLED
+    PyMutex_Lock(&fl->mutex);
+#endif
+    Py_ssize_t size = fl->size;
+    fl->size = 0;
+    fl->maxsize = 0;
+#ifdef Py_GIL_DISABLED
+    PyMutex_Unlock(&fl->mutex);
+#endif
+    for (Py_ssize_t i = 0; i < size; i++) {
+        PyObject_GC_Del(fl->items[i]);
+        fl->items[i] = NULL;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
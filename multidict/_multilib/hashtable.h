@@ -14,7 +14,9 @@ extern "C" {
 
 #include "dict.h"
 #include "htkeys.h"
+#include "intern.h"
 #include "istr.h"
+#include "lower.h"
 #include "state.h"
 
 typedef struct _md_pos {
@@ -22,12 +24,19 @@ typedef struct _md_pos {
     uint64_t version;
 } md_pos_t;
 
+/* The key of a lookup that doesn't store the key (see md_init_lookup()) */
+typedef struct _md_lookup {
+    PyObject *identity;  // strong ref or NULL if ci_key is used
+    PyObject *ci_key;    // borrowed ref to ASCII str, compared case-insensitively
+    Py_hash_t hash;
+} md_lookup_t;
+
 typedef struct _md_finder {
     MultiDictObject *md;
     htkeysiter_t iter;
     uint64_t version;
-    Py_hash_t hash;
-    PyObject *identity;  // borrowed ref
+    md_lookup_t lookup;  // borrowed refs
+    bool found;          // iter points to the last found entry
 } md_finder_t;
 
 typedef enum _UpdateOp {
@@ -40,9 +49,11 @@ typedef enum _UpdateOp {
 The multidict's implementation is close to Python's dict except for multiple
 keys.
 
-It starts from the empty hashtable, which grows by a power of 2 starting from
-8: 8, 16, 32, 64, 128, ...  The amount of items is 2/3 of the hashtable size
-(1/3 of the table is never allocated).
+It starts from the empty hashtable, the first allocated table is small: up to
+8 entries without the index, lookups scan entries linearly (see htkeys.h).
+Larger tables grow by a power of 2 starting from 16: 16, 32, 64, 128, ...  The
+amount of items is 2/3 of the hashtable size (1/3 of the table is never
+allocated).
 
 The table is resized if needed, and bulk updates (extend(), update(), and
 constructor calls) pre-allocate many items at once, reducing the amount of
@@ -55,19 +66,29 @@ multiple equal keys. The index table rebuild happens on the keys table size
 changeing and if the number of DKIX_DUMMY slots grows to 1/4 of the total
 amount.
 
-The iteration for operations like getall() is a little tricky. The next index
-calculation could return the already visited index before reaching the end. To
-eliminate duplicates, the code marks already visited entries by entry->hash =
--1. -1 hash is an invalid hash value that could be used as a marker. After the
-iteration finishes, all marked entries are restored.  Double iteration over the
-indices still has O(1) amortized time, it is ok.
+Deletions never grow the table, but once most of the items are gone the table
+is downsized (see _md_shrink_if_sparse()), thus a dict that had a short peak
+does not keep its peak-sized table forever.
+
+Lookups scan control bytes of slot groups (see htkeys.h) and read an entry
+only if the 7-bit hash tag of its slot matches; most misses never touch
+entries at all.
+
+Lookups never modify the table: the probe sequence visits every slot at most
+once and equal keys are chained after the single indexed entry (see htkeys.h),
+thus operations like getall() need no bookkeeping of already visited entries.
+
+Bulk updates record the positions of entries processed by the current call
+in md_dirty_t, md_post_update() visits the recorded entries only.
 
 `.add()`, `val = md[key]`, `md[key] = val`, `md.setdefault()` all have O(1).
 `.getall()` / `.popall()` have O(N) where N is the amount of returned items.
-`.update()` / `extend()` have O(N+M) where N and M are amount of items
+`.extend()` has O(M), `.update()` / `.merge()` have O(M) unless the table
+is resized, and O(N+M) otherwise, where N and M are amount of items
 in the left and right arguments.
 
-`.copy()` and constuction from multidict is super fast.
+`.copy()` and constuction from multidict is super fast, O(1) if the table
+can be shared (see md_clone_from_ht()).
 */
 
 /* GROWTH_RATE. Growth rate upon hitting maximum load.
@@ -97,21 +118,93 @@ _md_dump(MultiDictObject *md);
 #define ASSERT_CONSISTENT(md, update) assert(1)
 #endif
 
-static inline int
-_str_cmp(PyObject *s1, PyObject *s2)
+/* GC tracking, like MAINTAIN_TRACKING() of CPython dicts.
+
+   MultiDict and CIMultiDict instances are created untracked (see
+   multidict_tp_alloc()); a dict of str, bytes and int items can't be a part
+   of a reference cycle and the collector doesn't need to traverse it.  The
+   first stored key or value that may be tracked makes the dict tracked for
+   the rest of its life.  Subclasses are always tracked, their instances have
+   __dict__.
+
+   Non-GC objects of other types track the dict as well: the deallocator
+   of an extension type may run arbitrary code, and the tables of untracked
+   dicts are shared on the assumption that releasing their items never runs
+   Python code (see md_clone_from_ht()).  Classes defined in Python are
+   always GC types.
+*/
+static inline bool
+_md_is_atomic(mod_state *state, PyObject *obj)
 {
-    PyObject *ret = PyUnicode_RichCompare(s1, s2, Py_EQ);
-    if (Py_IsTrue(ret)) {
-        Py_DECREF(ret);
-        return 1;
-    } else if (ret == NULL) {
-        return -1;
-    } else {
-        Py_DECREF(ret);
-        return 0;
+    PyTypeObject *tp = Py_TYPE(obj);
+    return tp == &PyUnicode_Type || tp == &PyLong_Type ||
+           tp == &PyBytes_Type || tp == &PyFloat_Type || obj == Py_None ||
+           tp == &PyBool_Type || tp == state->IStrType;
+}
+
+static inline bool
+_md_may_be_tracked(mod_state *state, PyObject *obj)
+{
+    if (_md_is_atomic(state, obj)) {
+        return false;
+    }
+    if (PyTuple_CheckExact(obj) && !PyObject_GC_IsTracked(obj)) {
+        // the collector untracks tuples of non-GC items, nested tuples
+        // are not inspected
+        for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(obj); i++) {
+            if (!_md_is_atomic(state, PyTuple_GET_ITEM(obj, i))) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+static inline void
+_md_maintain_tracking(MultiDictObject *md, PyObject *key, PyObject *value)
+{
+    if ((_md_may_be_tracked(md->state, value) ||
+         _md_may_be_tracked(md->state, key)) &&
+        !PyObject_GC_IsTracked((PyObject *)md)) {
+        PyObject_GC_Track(md);
     }
 }
 
+/* md receives the items of other, track it if other is tracked */
+static inline void
+_md_inherit_tracking(MultiDictObject *md, MultiDictObject *other)
+{
+    if (PyObject_GC_IsTracked((PyObject *)other) &&
+        !PyObject_GC_IsTracked((PyObject *)md)) {
+        PyObject_GC_Track(md);
+    }
+}
+
+/* Specialization by the mode of a multidict.
+
+   The hot operations (lookups, add, replace, update, iteration) are written
+   once as _md_*() functions taking the mode as the constant is_ci argument,
+   and MD_DISPATCH() in the public md_*() function inlines two copies of
+   the body, one per mode.  The mode is checked once per call: the key
+   conversions and the probe loops of a copy don't branch on md->is_ci, and
+   the case-sensitive copy doesn't contain the case-insensitive lookup code.
+
+   The slot functions of MultiDict and CIMultiDict can't be bound to the
+   mode instead: MultiDict methods are called for CIMultiDict instances
+   through inheritance.
+*/
+#if defined(_MSC_VER)
+#define MD_FORCE_INLINE static __forceinline
+#elif defined(__GNUC__) || defined(__clang__)
+#define MD_FORCE_INLINE static inline __attribute__((always_inline))
+#else
+#define MD_FORCE_INLINE static inline
+#endif
+
+#define MD_DISPATCH(md, impl, ...) \
+    ((md)->is_ci ? impl(__VA_ARGS__, true) : impl(__VA_ARGS__, false))
+
 static inline PyObject *
 _key_to_identity(mod_state *state, PyObject *key)
 {
@@ -136,25 +229,15 @@ _ci_key_to_identity(mod_state *state, PyObject *key)
     if (IStr_Check(state, key)) {
         return Py_NewRef(((istrobject *)key)->canonical);
     }
+    if (PyUnicode_CheckExact(key)) {
+        return intern_ci_identity(state, key);
+    }
     if (PyUnicode_Check(key)) {
-        PyObject *ret = PyObject_CallMethodNoArgs(key, state->str_lower);
-        if (ret == NULL) {
-            goto fail;
-        }
-        if (!PyUnicode_CheckExact(ret)) {
-            PyObject *tmp = PyUnicode_FromObject(ret);
-            Py_CLEAR(ret);
-            if (tmp == NULL) {
-                return NULL;
-            }
-            ret = tmp;
-        }
-        return ret;
+        return lower_str(state, key);
     }
     PyErr_SetString(PyExc_TypeError,
                     "CIMultiDict keys should be either str "
                     "or subclasses of str");
-fail:
     return NULL;
 }
 
@@ -185,6 +268,146 @@ _ci_arg_to_key(mod_state *state, PyObject *key, PyObject *identity)
     return NULL;
 }
 
+/* Copy-on-write tables.
+
+   copy() and construction from a multidict share the table of an untracked
+   multidict instead of cloning it (keys->refcnt > 1).  Sharing is safe
+   for untracked dicts only: their items are not tracked by the GC, thus the
+   collector doesn't count the references of the shared entries, and their
+   items are atomic (see _md_is_atomic()), releasing an entry never runs
+   Python code, so the table cannot be shared behind the back of a mutation
+   in progress.
+
+   Every mutation calls _md_unshare() before touching the table, a
+   multidict that shares its table clones it first.  Positions of entries
+   are kept, iterators are not affected.  Lookups and iteration never write
+   to a shared table (see _md_ensure_key_impl()).
+
+   The free-threaded build never shares tables: the reference counter of
+   a table is not atomic.
+*/
+#ifdef Py_GIL_DISABLED
+#define MD_SHARE_TABLES 0
+#else
+#define MD_SHARE_TABLES 1
+#endif
+
+static inline htkeys_t *
+_md_clone_keys(mod_state *state, htkeys_t *src)
+{
+    size_t size = htkeys_sizeof(src);
+    htkeys_t *keys = htkeys_alloc(state, src->log2_size);
+    if (keys == NULL) {
+        return NULL;
+    }
+    memcpy(keys, src, size);
+    keys->next = NULL;
+    keys->retired = NULL;
+    keys->refcnt = 1;
+    entry_t *entry = htkeys_entries(keys);
+    for (Py_ssize_t idx = 0; idx < keys->nentries; idx++, entry++) {
+        Py_XINCREF(entry->identity);
+        Py_XINCREF(entry->key);
+        Py_XINCREF(entry->value);
+    }
+    return keys;
+}
+
+/* Split tables.
+
+   A multidict built by the constructor from a list of items with the same
+   keys as a recently built one shares the key layout (identities, keys,
+   the index) with it and stores only its own values (md->values, see
+   md_init_split()).  Entries of the layout have NULL values, every entry
+   is alive and values[i] belongs to the entry i.
+
+   A split table is shared: the first mutation combines it into a private
+   table with the values moved back to the entries (see _md_unshare()).
+   Read paths take values by _md_entry_value().
+*/
+
+static inline PyObject *
+_md_entry_value(MultiDictObject *md, entry_t *entry)
+{
+    if (md->values != NULL) {
+        return md->values[entry - htkeys_entries(md->keys)];
+    }
+    return entry->value;
+}
+
+/* Drop a reference to a layout of split tables, free the last one */
+static inline void
+_md_layout_release(mod_state *state, htkeys_t *keys)
+{
+    if (keys->refcnt > 1) {
+        keys->refcnt -= 1;
+        return;
+    }
+    entry_t *entry = htkeys_entries(keys);
+    for (Py_ssize_t idx = 0; idx < keys->nentries; idx++, entry++) {
+        assert(entry->value == NULL);
+        Py_CLEAR(entry->identity);
+        Py_CLEAR(entry->key);
+    }
+    htkeys_free(state, keys);
+}
+
+static inline bool
+_md_is_shared(MultiDictObject *md)
+{
+    return md->keys->refcnt > 1 || md->values != NULL;
+}
+
+/* Make the table of md private before a mutation */
+static inline int
+_md_unshare(MultiDictObject *md)
+{
+    htkeys_t *keys = md->keys;
+    if (!_md_is_shared(md)) {
+        return 0;
+    }
+    htkeys_t *newkeys = keys;
+    if (keys->refcnt > 1) {
+        newkeys = _md_clone_keys(md->state, keys);
+        if (newkeys == NULL) {
+            return -1;
+        }
+        keys->refcnt -= 1;
+    }
+    PyObject **values = md->values;
+    if (values != NULL) {
+        // the references of values are moved to the entries
+        entry_t *entry = htkeys_entries(newkeys);
+        for (Py_ssize_t idx = 0; idx < newkeys->nentries; idx++, entry++) {
+            assert(entry->value == NULL);
+            entry->value = values[idx];
+        }
+        md->values = NULL;
+        PyMem_Free(values);
+    }
+    md->keys = newkeys;
+    return 0;
+}
+
+/* Unshare the table in the middle of a lookup.
+
+   Deletions unshare on the first match only, a miss leaves the table
+   shared.  The clone has the same layout, the iterator and the entries
+   pointer are moved to it. */
+static inline int
+_md_unshare_iter(MultiDictObject *md, htkeysiter_t *iter, entry_t **entries)
+{
+    if (!_md_is_shared(md)) {
+        return 0;
+    }
+    if (_md_unshare(md) < 0) {
+        return -1;
+    }
+    iter->keys = md->keys;
+    *entries = htkeys_entries(md->keys);
+    return 0;
+}
+
 static inline int
 _md_resize(MultiDictObject *md, uint8_t log2_newsize, bool update)
 {
@@ -197,17 +420,21 @@ _md_resize(MultiDictObject *md, uint8_t log2_newsize, bool update)
     assert(log2_newsize >= HT_LOG_MINSIZE);
 
     oldkeys = md->keys;
+    // the entries are moved, not copied
+    assert(oldkeys->refcnt == 1);
 
     /* Allocate a new table. */
-    newkeys = htkeys_new(log2_newsize);
+    newkeys = htkeys_new(md->state, log2_newsize);
     assert(newkeys);
     if (newkeys == NULL) {
         return -1;
     }
+    /* Bulk updates address entries by their positions (see md_dirty_t),
+       deleted entries are kept in place until md_post_update(). */
+    Py_ssize_t numentries = update ? oldkeys->nentries : md->used;
     // New table must be large enough.
-    assert(newkeys->usable >= md->used);
+    assert(newkeys->usable >= numentries);
 
-    Py_ssize_t numentries = md->used;
     entry_t *oldentries = htkeys_entries(oldkeys);
     entry_t *newentries = htkeys_entries(newkeys);
     if (oldkeys->nentries == numentries) {
@@ -223,14 +450,12 @@ _md_resize(MultiDictObject *md, uint8_t log2_newsize, bool update)
         }
     }
 
-    if (htkeys_build_indices(newkeys, newentries, numentries, update) < 0) {
-        return -1;
-    }
+    htkeys_build_indices(newkeys, newentries, numentries);
 
     md->keys = newkeys;
 
     if (oldkeys != &empty_htkeys) {
-        htkeys_free(oldkeys);
+        htkeys_free(md->state, oldkeys);
     }
 
     md->keys->usable = md->keys->usable - numentries;
@@ -239,9 +464,166 @@ _md_resize(MultiDictObject *md, uint8_t log2_newsize, bool update)
     return 0;
 }
 
-static inline int
-_md_shrink(MultiDictObject *md, bool update)
+/* Incremental resize.
+
+   _md_resize() copies all entries and rebuilds the index at once, thus an
+   insertion that overflows a table of 10^6 entries stalls for
+   milliseconds.  Tables of 2**MD_INCR_MIN_LOG2 slots and more grow
+   incrementally instead, like Redis dict rehashing: once an insertion
+   leaves less than a quarter of the usable entries, the next table is
+   allocated ahead (keys->next) without initializing it.  Every following
+   insertion either initializes a block of it by htkeys_clear_step() or,
+   when it is done, copies and indexes MD_INCR_STEP more entries into it,
+   no insertion touches O(n) memory.  The work runs faster than
+   insertions, the next table catches up before the current one runs out
+   of room and replaces it.  The memory of the replaced table is given
+   back by the following insertions, see htkeys_retire().
+
+   The current table stays authoritative, lookups and iteration never read
+   the next one.  Entries keep their positions (deleted entries are copied
+   as holes), the switch is invisible to iterators and to callers holding
+   positions.  Writes to the entries copied already are mirrored by
+   _md_next_sync() and _md_next_del().  Bulk updates soft-delete entries,
+   they finish the resize first by md_finish_resize().  Rebuilding the
+   table drops the next one.
+*/
+#ifdef NDEBUG
+#define MD_INCR_MIN_LOG2 14
+#else
+// debug builds run the test suite through incremental resizes
+#define MD_INCR_MIN_LOG2 5
+#endif
+#define MD_INCR_STEP 8
+
+/* Copy entries up to the stop position to the next table */
+static inline void
+_md_next_copy(htkeys_t *keys, Py_ssize_t stop)
+{
+    htkeys_t *next = keys->next;
+    Py_ssize_t start = next->nentries;
+    if (stop > keys->nentries) {
+        stop = keys->nentries;
+    }
+    memcpy(htkeys_entries(next) + start,
+           htkeys_entries(keys) + start,
+           sizeof(entry_t) * (size_t)(stop - start));
+    htkeys_build_range(next, start, stop);
+    next->usable -= stop - start;
+    next->nentries = stop;
+}
+
+static inline void
+_md_next_switch(MultiDictObject *md)
 {
+    htkeys_t *keys = md->keys;
+    htkeys_t *next = keys->next;
+    assert(next->nentries == keys->nentries);
+    // the references are moved to the next table
+    keys->next = NULL;
+    md->keys = next;
+    htkeys_retire(md->state, next, keys);
+}
+
+static inline void
+_md_drop_next(MultiDictObject *md)
+{
+    htkeys_t *keys = md->keys;
+    if (keys->next != NULL) {
+        htkeys_free(md->state, keys->next);
+        keys->next = NULL;
+    }
+}
+
+/* Complete the incremental resize if any */
+static inline void
+md_finish_resize(MultiDictObject *md)
+{
+    htkeys_t *keys = md->keys;
+    if (keys->next == NULL || keys->refcnt > 1) {
+        // a shared table is cloned without the next one before writes
+        return;
+    }
+    htkeys_clear_step(keys->next, SIZE_MAX);
+    _md_next_copy(keys, keys->nentries);
+    _md_next_switch(md);
+    ASSERT_CONSISTENT(md, false);
+}
+
+/* Advance the incremental resize after an insertion, start it if the table
+   is large and almost full.
+
+   The insertion has succeeded already, a failed allocation of the next
+   table is ignored: the table is resized at once on overflow then.
+*/
+static inline void
+_md_resize_step(MultiDictObject *md)
+{
+    htkeys_t *keys = md->keys;
+    if (keys->retired != NULL) {
+        htkeys_release_step(md->state, keys);
+        return;
+    }
+    if (keys->next == NULL) {
+        if (keys->log2_size < MD_INCR_MIN_LOG2 ||
+            keys->usable * 4 > htkeys_usable_size(keys->log2_size)) {
+            return;
+        }
+        uint8_t log2_newsize = calculate_log2_keysize(GROWTH_RATE(md));
+        if (log2_newsize <= keys->log2_size ||
+            log2_newsize >= SIZEOF_SIZE_T * 8) {
+            // many deleted entries, the overflow compacts the table instead
+            return;
+        }
+        keys->next = htkeys_new_uncleared(md->state, log2_newsize);
+        if (keys->next == NULL) {
+            PyErr_Clear();
+            return;
+        }
+    }
+    if (!htkeys_clear_step(keys->next, 1)) {
+        return;
+    }
+    _md_next_copy(keys, keys->next->nentries + MD_INCR_STEP);
+    if (keys->next->nentries == keys->nentries) {
+        _md_next_switch(md);
+    }
+}
+
+/* Mirror the entry content changed in place to the next table */
+static inline void
+_md_next_sync(htkeys_t *keys, const entry_t *entry)
+{
+    htkeys_t *next = keys->next;
+    if (next != NULL) {
+        Py_ssize_t ix = entry - htkeys_entries(keys);
+        if (ix < next->nentries) {
+            htkeys_entries(next)[ix] = *entry;
+        }
+    }
+}
+
+/* Mirror the deletion of the entry at ix to the next table,
+   the entry should be alive yet. */
+static inline void
+_md_next_del(htkeys_t *keys, Py_ssize_t ix)
+{
+    htkeys_t *next = keys->next;
+    if (next == NULL || ix >= next->nentries) {
+        return;
+    }
+    entry_t *entry = htkeys_entries(next) + ix;
+    size_t empty;
+    Py_ssize_t slot = _htkeys_find_head(
+        next, htkeys_entry_hash(entry), entry->identity, &empty);
+    assert(slot >= 0);
+    htkeys_del_entry(next, (size_t)slot, ix);
+    memset(entry, 0, sizeof(entry_t));
+}
+
+static inline void
+_md_shrink(MultiDictObject *md)
+{
+    _md_drop_next(md);
     htkeys_t *keys = md->keys;
     Py_ssize_t nentries = keys->nentries;
     entry_t *entries = htkeys_entries(keys);
@@ -260,33 +642,72 @@ _md_shrink(MultiDictObject *md, bool update)
     }
     keys->nentries = newnentries;
     keys->usable += nentries - newnentries;
-    memset(&keys->indices[0], 0xff, ((size_t)1 << keys->log2_index_bytes));
-    memset(new_ep, 0, sizeof(entry_t) * (size_t)(nentries - newnentries));
-    if (htkeys_build_indices(keys, entries, newnentries, update) < 0) {
-        return -1;
+    if (!htkeys_is_small(keys)) {
+        memset(
+            &keys->indices[0], 0xff, ((size_t)1 << keys->log2_index_bytes));
     }
-    ASSERT_CONSISTENT(md, update);
-    return 0;
+    memset(htkeys_ctrl(keys), HT_CTRL_EMPTY, _htkeys_ctrl_bytes(keys->log2_size));
+    memset(new_ep, 0, sizeof(entry_t) * (size_t)(nentries - newnentries));
+    htkeys_build_indices(keys, entries, newnentries);
+    ASSERT_CONSISTENT(md, false);
 }
 
 static inline int
 _md_resize_for_insert(MultiDictObject *md)
 {
+    if (md->keys->next != NULL) {
+        // the next table has room
+        md_finish_resize(md);
+        return 0;
+    }
     if (md->used < md->keys->nentries) {
-        return _md_shrink(md, false);
+        _md_shrink(md);
+        return 0;
     } else {
         return _md_resize(md, calculate_log2_keysize(GROWTH_RATE(md)), false);
     }
 }
 
+/* Give memory back after deletions.
+
+   The table is downsized once fewer than 1/MD_SHRINK_RATIO of its usable
+   entries are alive.  The new size is picked by GROWTH_RATE() as if the
+   remaining items had just filled a table, so it has room for at least
+   twice as many items.  A dict oscillating in size thus has to grow twice
+   or to lose most of its items again before the next resize, the gap keeps
+   the resizes amortized O(1) per deletion.
+
+   The deletion itself has succeeded already, a failed allocation keeps
+   the old table.
+*/
+#define MD_SHRINK_RATIO 8
+
+static inline void
+_md_shrink_if_sparse(MultiDictObject *md)
+{
+    htkeys_t *keys = md->keys;
+    if (htkeys_is_small(keys) ||
+        md->used >= htkeys_usable_size(keys->log2_size) / MD_SHRINK_RATIO) {
+        return;
+    }
+    uint8_t log2_newsize = calculate_log2_keysize(GROWTH_RATE(md));
+    if (log2_newsize < md->log2_min_size) {
+        log2_newsize = md->log2_min_size;
+    }
+    if (log2_newsize >= keys->log2_size) {
+        return;
+    }
+    if (_md_resize(md, log2_newsize, false) < 0) {
+        PyErr_Clear();
+    }
+}
+
 static inline int
 _md_resize_for_update(MultiDictObject *md)
 {
-    if (md->used < md->keys->nentries) {
-        return _md_shrink(md, true);
-    } else {
-        return _md_resize(md, calculate_log2_keysize(GROWTH_RATE(md)), true);
-    }
+    // deleted entries are not dropped, they are counted by nentries
+    return _md_resize(
+        md, calculate_log2_keysize(md->keys->nentries * 3), true);
 }
 
 static inline int
@@ -294,6 +715,9 @@ _md_reserve(MultiDictObject *md, Py_ssize_t extra_size, bool update)
 {
     uint8_t new_size = estimate_log2_keysize(extra_size + md->used);
     if (new_size > md->keys->log2_size) {
+        if (_md_unshare(md) < 0) {
+            return -1;
+        }
         return _md_resize(md, new_size, update);
     }
     return 0;
@@ -310,15 +734,18 @@ md_init(MultiDictObject *md, mod_state *state, bool is_ci, Py_ssize_t minused)
 {
     md->state = state;
     md->is_ci = is_ci;
+    md->log2_min_size = 0;
+    md->in_update = false;
     md->used = 0;
     md->version = NEXT_VERSION(md->state);
+    md->values = NULL;
 
     const uint8_t log2_max_presize = 17;
     const Py_ssize_t max_presize = ((Py_ssize_t)1) << log2_max_presize;
     uint8_t log2_newsize;
     htkeys_t *new_keys;
 
-    if (minused <= USABLE_FRACTION(HT_MINSIZE)) {
+    if (minused <= 0) {
         md->keys = &empty_htkeys;
         ASSERT_CONSISTENT(md, false);
         return 0;
@@ -333,7 +760,7 @@ md_init(MultiDictObject *md, mod_state *state, bool is_ci, Py_ssize_t minused)
         log2_newsize = estimate_log2_keysize(minused);
     }
 
-    new_keys = htkeys_new(log2_newsize);
+    new_keys = htkeys_new(state, log2_newsize);
     if (new_keys == NULL) return -1;
     md->keys = new_keys;
     ASSERT_CONSISTENT(md, false);
@@ -348,40 +775,182 @@ md_clone_from_ht(MultiDictObject *md, MultiDictObject *other)
     md->used = other->used;
     md->version = other->version;
     md->is_ci = other->is_ci;
-    if (other->keys != &empty_htkeys) {
-        size_t size = htkeys_sizeof(other->keys);
-        htkeys_t *keys = PyMem_Malloc(size);
-        if (keys == NULL) {
+    md->values = NULL;
+    if (other->keys == &empty_htkeys) {
+        md->keys = &empty_htkeys;
+    } else if (other->values != NULL) {
+        // the values are private, the layout is shared by tracked dicts too
+        PyObject **values = PyMem_New(PyObject *, other->used);
+        if (values == NULL) {
             PyErr_NoMemory();
             return -1;
         }
-        memcpy(keys, other->keys, size);
-        entry_t *entry = htkeys_entries(keys);
-        for (Py_ssize_t idx = 0; idx < keys->nentries; idx++, entry++) {
-            Py_XINCREF(entry->identity);
-            Py_XINCREF(entry->key);
-            Py_XINCREF(entry->value);
+        for (Py_ssize_t idx = 0; idx < other->used; idx++) {
+            values[idx] = Py_NewRef(other->values[idx]);
+        }
+        other->keys->refcnt += 1;
+        md->keys = other->keys;
+        md->values = values;
+        _md_inherit_tracking(md, other);
+    } else if (MD_SHARE_TABLES && !other->in_update &&
+               !PyObject_GC_IsTracked((PyObject *)other)) {
+        other->keys->refcnt += 1;
+        md->keys = other->keys;
+    } else {
+        htkeys_t *keys = _md_clone_keys(md->state, other->keys);
+        if (keys == NULL) {
+            return -1;
         }
         md->keys = keys;
-    } else {
-        md->keys = &empty_htkeys;
+        _md_inherit_tracking(md, other);
     }
     ASSERT_CONSISTENT(md, false);
     return 0;
 }
 
+MD_FORCE_INLINE PyObject *
+_md_calc_identity(mod_state *state, PyObject *key, const bool is_ci)
+{
+    if (is_ci) return _ci_key_to_identity(state, key);
+    return _key_to_identity(state, key);
+}
+
+MD_FORCE_INLINE PyObject *
+_md_calc_key(mod_state *state, PyObject *key, PyObject *identity,
+             const bool is_ci)
+{
+    if (is_ci) return _ci_arg_to_key(state, key, identity);
+    return _arg_to_key(state, key, identity);
+}
+
 static inline PyObject *
 md_calc_identity(MultiDictObject *md, PyObject *key)
 {
-    if (md->is_ci) return _ci_key_to_identity(md->state, key);
-    return _key_to_identity(md->state, key);
+    return _md_calc_identity(md->state, key, md->is_ci);
 }
 
 static inline PyObject *
 md_calc_key(MultiDictObject *md, PyObject *key, PyObject *identity)
 {
-    if (md->is_ci) return _ci_arg_to_key(md->state, key, identity);
-    return _arg_to_key(md->state, key, identity);
+    return _md_calc_key(md->state, key, identity, md->is_ci);
+}
+
+/* Lookups in CIMultiDict by ASCII str key don't create the lowered identity:
+   the key is lowered into a stack buffer for hashing only (str hash is the
+   hash of its canonical data), and entries are compared with the key
+   case-insensitively.  Longer keys, non-ASCII keys, str subclasses (they
+   could override lower()), istr and case-sensitive lookups use the identity.
+   The identity of an already lowered str key is the key itself.
+   A mixed-case key of a well-known header resolves to the shared identity,
+   other keys with the cached hash are looked up in the intern table; such
+   identities are compared by pointer.
+*/
+#define MD_LOOKUP_BUFSIZE 128
+
+MD_FORCE_INLINE int
+_md_init_lookup(MultiDictObject *md, PyObject *key, md_lookup_t *lookup,
+                const bool is_ci)
+{
+    lookup->ci_key = NULL;
+    if (is_ci && PyUnicode_CheckExact(key) && PyUnicode_IS_ASCII(key)) {
+        Py_ssize_t len = PyUnicode_GET_LENGTH(key);
+        if (len <= MD_LOOKUP_BUFSIZE) {
+            const Py_UCS1 *data = PyUnicode_1BYTE_DATA(key);
+            if (ascii_has_upper(data, len)) {
+                PyObject *identity = headers_identity(md->state, key);
+                if (identity != NULL) {
+                    // the hash of the well-known identity is cached
+                    lookup->identity = Py_NewRef(identity);
+                    lookup->hash = _unicode_hash(identity);
+                    return 0;
+                }
+                Py_hash_t hash = PyUnstable_Unicode_GET_CACHED_HASH(key);
+                if (hash != -1) {
+                    // the str hash is cached, try the interned identity
+                    lookup->identity = intern_lookup(md->state, key, hash);
+                    if (lookup->identity != NULL) {
+                        lookup->hash = _unicode_hash(lookup->identity);
+                        return 0;
+                    }
+                }
+                Py_UCS1 buf[MD_LOOKUP_BUFSIZE];
+                ascii_lower_copy(buf, data, len);
+                lookup->identity = NULL;
+                lookup->ci_key = key;
+                lookup->hash = Py_HashBuffer(buf, len);
+                return 0;
+            }
+            // the key is its own identity, the str hash is cached
+            lookup->identity = Py_NewRef(key);
+            lookup->hash = _unicode_hash(key);
+            return 0;
+        }
+    }
+    lookup->identity = _md_calc_identity(md->state, key, is_ci);
+    if (lookup->identity == NULL) {
+        return -1;
+    }
+    lookup->hash = _unicode_hash(lookup->identity);
+    if (lookup->hash == -1) {
+        Py_CLEAR(lookup->identity);
+        return -1;
+    }
+    return 0;
+}
+
+static inline int
+md_init_lookup(MultiDictObject *md, PyObject *key, md_lookup_t *lookup)
+{
+    return MD_DISPATCH(md, _md_init_lookup, md, key, lookup);
+}
+
+static inline void
+md_lookup_clear(md_lookup_t *lookup)
+{
+    Py_CLEAR(lookup->identity);
+}
+
+/* Compare the lookup key with the entry identity, never fails */
+static inline bool
+md_lookup_eq(const md_lookup_t *lookup, const entry_t *entry)
+{
+    PyObject *identity = entry->identity;
+    if (identity == lookup->identity) {
+        return true;
+    }
+    if (htkeys_entry_hash(entry) != lookup->hash) {
+        return false;
+    }
+    if (lookup->ci_key == NULL) {
+        return _htkeys_str_eq(lookup->identity, identity);
+    }
+    Py_ssize_t len = PyUnicode_GET_LENGTH(lookup->ci_key);
+    if (!PyUnicode_IS_ASCII(identity) ||
+        PyUnicode_GET_LENGTH(identity) != len) {
+        return false;
+    }
+    // the identity is lowered already
+    return ascii_lower_eq(PyUnicode_1BYTE_DATA(lookup->ci_key),
+                          PyUnicode_1BYTE_DATA(identity),
+                          len);
+}
+
+/* The identity to store for the lookup key */
+MD_FORCE_INLINE PyObject *
+_md_lookup_identity(MultiDictObject *md, const md_lookup_t *lookup,
+                    PyObject *key, const bool is_ci)
+{
+    if (lookup->identity != NULL) {
+        return Py_NewRef(lookup->identity);
+    }
+    return _md_calc_identity(md->state, key, is_ci);
+}
+
+static inline PyObject *
+md_lookup_identity(MultiDictObject *md, const md_lookup_t *lookup,
+                   PyObject *key)
+{
+    return MD_DISPATCH(md, _md_lookup_identity, md, lookup, key);
 }
 
 static inline Py_ssize_t
@@ -390,28 +959,44 @@ md_len(MultiDictObject *md)
     return md->used;
 }
 
-static inline PyObject *
-_md_ensure_key(MultiDictObject *md, entry_t *entry)
+MD_FORCE_INLINE PyObject *
+_md_ensure_key_impl(MultiDictObject *md, entry_t *entry, const bool is_ci)
 {
     assert(entry >= htkeys_entries(md->keys));
     assert(entry < htkeys_entries(md->keys) + md->keys->nentries);
-    PyObject *key = md_calc_key(md, entry->key, entry->identity);
+    PyObject *key =
+        _md_calc_key(md->state, entry->key, entry->identity, is_ci);
     if (key == NULL) {
         return NULL;
     }
-    if (key != entry->key) {
-        Py_SETREF(entry->key, key);
+    if (key != entry->key && !_md_is_shared(md)) {
+        PyObject *old_key = entry->key;
+        entry->key = key;
+        _md_next_sync(md->keys, entry);
+        Py_DECREF(old_key);
+    } else if (key != entry->key) {
+        // the converted key is not cached in a shared table
+        return key;
     } else {
         Py_CLEAR(key);
     }
     return Py_NewRef(entry->key);
 }
 
+static inline PyObject *
+_md_ensure_key(MultiDictObject *md, entry_t *entry)
+{
+    return MD_DISPATCH(md, _md_ensure_key_impl, md, entry);
+}
+
 static inline int
 _md_add_with_hash_steal_refs(MultiDictObject *md, Py_hash_t hash,
                              PyObject *identity, PyObject *key,
                              PyObject *value)
 {
+    if (_md_unshare(md) < 0) {
+        return -1;
+    }
     htkeys_t *keys = md->keys;
     if (keys->usable <= 0 || keys == &empty_htkeys) {
         /* Need to resize. */
@@ -421,20 +1006,20 @@ _md_add_with_hash_steal_refs(MultiDictObject *md, Py_hash_t hash,
         keys = md->keys;  // updated by resizing
     }
 
-    Py_ssize_t hashpos = htkeys_find_empty_slot(keys, hash);
-    htkeys_set_index(keys, hashpos, keys->nentries);
+    htkeys_add_index(keys, keys->nentries, hash, identity);
 
     entry_t *entry = htkeys_entries(keys) + keys->nentries;
 
     entry->identity = identity;
     entry->key = key;
     entry->value = value;
-    entry->hash = hash;
+    _md_maintain_tracking(md, key, value);
 
     md->version = NEXT_VERSION(md->state);
     md->used += 1;
     keys->usable -= 1;
     keys->nentries += 1;
+    _md_resize_step(md);
     return 0;
 }
 
@@ -448,10 +1033,115 @@ _md_add_with_hash(MultiDictObject *md, Py_hash_t hash, PyObject *identity,
     return _md_add_with_hash_steal_refs(md, hash, identity, key, value);
 }
 
+/* Entries touched by a bulk update.
+
+   An update replaces the first matching entry for every incoming item
+   and soft-deletes the rest of the equal keys (see _md_update()).  Next
+   items with the same key should skip the entries processed already.
+
+   Entries appended by the update are the tail of the entries array
+   starting at `start`.  Positions of the existing entries which are
+   replaced or soft-deleted are kept in a small open addressing set, its
+   size is proportional to the size of the update rather than to the size
+   of the dict.  md_post_update() visits these entries only.
+
+   Resizes during the update keep deleted entries in place (see
+   _md_resize()), so positions stay valid.
+*/
+#define MD_DIRTY_PREALLOC 8
+
+typedef struct {
+    Py_ssize_t start;
+    Py_ssize_t len;
+    Py_ssize_t mask;
+    Py_ssize_t *slots;  // positions, -1 for empty slots, NULL if unused
+    bool resized;
+    Py_ssize_t prealloc[MD_DIRTY_PREALLOC];
+} md_dirty_t;
+
+static inline void
+md_dirty_init(md_dirty_t *dirty, MultiDictObject *md)
+{
+    dirty->start = md->keys->nentries;
+    dirty->len = 0;
+    dirty->mask = -1;
+    dirty->slots = NULL;
+    dirty->resized = false;
+}
+
+static inline void
+md_dirty_clear(md_dirty_t *dirty)
+{
+    if (dirty->slots != dirty->prealloc) {
+        PyMem_Free(dirty->slots);
+    }
+    dirty->slots = NULL;
+    dirty->mask = -1;
+    dirty->len = 0;
+}
+
+static inline size_t
+_md_dirty_slot(const md_dirty_t *dirty, Py_ssize_t pos)
+{
+    // positions are dense, an odd multiplier spreads them over the set
+    size_t i = ((size_t)pos * 0x9E3779B1U) & (size_t)dirty->mask;
+    while (dirty->slots[i] != -1 && dirty->slots[i] != pos) {
+        i = (i + 1) & (size_t)dirty->mask;
+    }
+    return i;
+}
+
+static inline bool
+_md_dirty_contains(const md_dirty_t *dirty, Py_ssize_t pos)
+{
+    return dirty->len > 0 && dirty->slots[_md_dirty_slot(dirty, pos)] == pos;
+}
+
+static inline int
+_md_dirty_add(md_dirty_t *dirty, Py_ssize_t pos)
+{
+    if (dirty->slots == NULL) {
+        memset(dirty->prealloc, 0xff, sizeof(dirty->prealloc));
+        dirty->slots = dirty->prealloc;
+        dirty->mask = MD_DIRTY_PREALLOC - 1;
+    }
+    if ((dirty->len + 1) * 2 > dirty->mask + 1) {
+        Py_ssize_t size = (dirty->mask + 1) * 2;
+        Py_ssize_t *slots = PyMem_New(Py_ssize_t, size);
+        if (slots == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        memset(slots, 0xff, sizeof(Py_ssize_t) * (size_t)size);
+        Py_ssize_t *old_slots = dirty->slots;
+        Py_ssize_t old_size = dirty->mask + 1;
+        dirty->slots = slots;
+        dirty->mask = size - 1;
+        for (Py_ssize_t i = 0; i < old_size; i++) {
+            if (old_slots[i] != -1) {
+                slots[_md_dirty_slot(dirty, old_slots[i])] = old_slots[i];
+            }
+        }
+        if (old_slots != dirty->prealloc) {
+            PyMem_Free(old_slots);
+        }
+    }
+    size_t i = _md_dirty_slot(dirty, pos);
+    if (dirty->slots[i] == -1) {
+        dirty->slots[i] = pos;
+        dirty->len += 1;
+    }
+    return 0;
+}
+
 static inline int
 _md_add_for_upd_steal_refs(MultiDictObject *md, Py_hash_t hash,
-                           PyObject *identity, PyObject *key, PyObject *value)
+                           PyObject *identity, PyObject *key, PyObject *value,
+                           md_dirty_t *dirty)
 {
+    if (_md_unshare(md) < 0) {
+        return -1;
+    }
     htkeys_t *keys = md->keys;
     if (keys->usable <= 0 || keys == &empty_htkeys) {
         /* Need to resize. */
@@ -459,16 +1149,16 @@ _md_add_for_upd_steal_refs(MultiDictObject *md, Py_hash_t hash,
             return -1;
         }
         keys = md->keys;  // updated by resizing
+        dirty->resized = true;
     }
-    Py_ssize_t hashpos = htkeys_find_empty_slot(keys, hash);
-    htkeys_set_index(keys, hashpos, keys->nentries);
+    htkeys_add_index(keys, keys->nentries, hash, identity);
 
     entry_t *entry = htkeys_entries(keys) + keys->nentries;
 
     entry->identity = identity;
     entry->key = key;
     entry->value = value;
-    entry->hash = -1;
+    _md_maintain_tracking(md, key, value);
 
     md->version = NEXT_VERSION(md->state);
     md->used += 1;
@@ -479,18 +1169,19 @@ _md_add_for_upd_steal_refs(MultiDictObject *md, Py_hash_t hash,
 
 static inline int
 _md_add_for_upd(MultiDictObject *md, Py_hash_t hash, PyObject *identity,
-                PyObject *key, PyObject *value)
+                PyObject *key, PyObject *value, md_dirty_t *dirty)
 {
     Py_INCREF(identity);
     Py_INCREF(key);
     Py_INCREF(value);
-    return _md_add_for_upd_steal_refs(md, hash, identity, key, value);
+    return _md_add_for_upd_steal_refs(md, hash, identity, key, value, dirty);
 }
 
-static inline int
-md_add(MultiDictObject *md, PyObject *key, PyObject *value)
+MD_FORCE_INLINE int
+_md_add(MultiDictObject *md, PyObject *key, PyObject *value,
+        const bool is_ci)
 {
-    PyObject *identity = md_calc_identity(md, key);
+    PyObject *identity = _md_calc_identity(md->state, key, is_ci);
     if (identity == NULL) {
         goto fail;
     }
@@ -507,46 +1198,57 @@ fail:
     return -1;
 }
 
+static inline int
+md_add(MultiDictObject *md, PyObject *key, PyObject *value)
+{
+    return MD_DISPATCH(md, _md_add, md, key, value);
+}
+
 static inline int
 _md_del_at(MultiDictObject *md, size_t slot, entry_t *entry)
 {
     htkeys_t *keys = md->keys;
     assert(keys != &empty_htkeys);
+    Py_ssize_t ix = entry - htkeys_entries(keys);
+    _md_next_del(keys, ix);
+    htkeys_del_entry(keys, slot, ix);
     Py_CLEAR(entry->identity);
     Py_CLEAR(entry->key);
     Py_CLEAR(entry->value);
-    htkeys_set_index(keys, slot, DKIX_DUMMY);
     md->used -= 1;
     return 0;
 }
 
 static inline int
-_md_del_at_for_upd(MultiDictObject *md, size_t slot, entry_t *entry)
+_md_del_at_for_upd(MultiDictObject *md, size_t slot, entry_t *entry,
+                   md_dirty_t *dirty)
 {
     /* half deletion,
        the entry could be replaced later with key and value set
        or it will be finally cleaned up with identity=NULL,
-       used -= 1, and setting the hash to DKIX_DUMMY
-       in md_post_update()
+       used -= 1, and unlinking from the index in md_post_update()
     */
     assert(md->keys != &empty_htkeys);
+    if (entry->key == NULL) {
+        // already deleted by this update
+        return 0;
+    }
+    if (_md_dirty_add(dirty, entry - htkeys_entries(md->keys)) < 0) {
+        return -1;
+    }
     Py_CLEAR(entry->key);
     Py_CLEAR(entry->value);
     return 0;
 }
 
-static inline int
-md_del(MultiDictObject *md, PyObject *key)
-{
-    PyObject *identity = md_calc_identity(md, key);
-    if (identity == NULL) {
-        goto fail;
-    }
-
-    Py_hash_t hash = _unicode_hash(identity);
-    if (hash == -1) {
+static inline int
+md_del(MultiDictObject *md, PyObject *key)
+{
+    md_lookup_t lookup;
+    if (md_init_lookup(md, key, &lookup) < 0) {
         goto fail;
     }
+    Py_hash_t hash = lookup.hash;
 
     bool found = false;
 
@@ -560,19 +1262,15 @@ md_del(MultiDictObject *md, PyObject *key)
             continue;
         }
         entry_t *entry = entries + iter.index;
-        if (hash != entry->hash) {
-            continue;
-        }
-        int tmp = _str_cmp(entry->identity, identity);
-        if (tmp < 0) {
-            goto fail;
-        }
-        if (tmp == 0) {
+        if (!md_lookup_eq(&lookup, entry)) {
             continue;
         }
 
         found = true;
-        if (_md_del_at(md, iter.slot, entry) < 0) {
+        if (_md_unshare_iter(md, &iter, &entries) < 0) {
+            goto fail;
+        }
+        if (_md_del_at(md, iter.slot, entries + iter.index) < 0) {
             goto fail;
         }
     }
@@ -582,12 +1280,13 @@ md_del(MultiDictObject *md, PyObject *key)
         goto fail;
     } else {
         md->version = NEXT_VERSION(md->state);
+        _md_shrink_if_sparse(md);
     }
-    Py_DECREF(identity);
+    md_lookup_clear(&lookup);
     ASSERT_CONSISTENT(md, false);
     return 0;
 fail:
-    Py_XDECREF(identity);
+    md_lookup_clear(&lookup);
     return -1;
 }
 
@@ -604,29 +1303,22 @@ md_init_pos(MultiDictObject *md, md_pos_t *pos)
     pos->version = md->version;
 }
 
-static inline int
-md_next(MultiDictObject *md, md_pos_t *pos, PyObject **pidentity,
-        PyObject **pkey, PyObject **pvalue)
+MD_FORCE_INLINE int
+_md_next_at(MultiDictObject *md, Py_ssize_t *ppos, PyObject **pidentity,
+            PyObject **pkey, PyObject **pvalue, const bool is_ci)
 {
     int ret = 0;
 
-    if (pos->version != md->version) {
-        PyErr_SetString(PyExc_RuntimeError,
-                        "MultiDict is changed during iteration");
-        ret = -1;
-        goto cleanup;
-    }
-
-    if (pos->pos >= md->keys->nentries) {
+    if (*ppos >= md->keys->nentries) {
         goto cleanup;
     }
 
     entry_t *entries = htkeys_entries(md->keys);
-    entry_t *entry = entries + pos->pos;
+    entry_t *entry = entries + *ppos;
 
     while (entry->identity == NULL) {
-        pos->pos += 1;
-        if (pos->pos >= md->keys->nentries) {
+        *ppos += 1;
+        if (*ppos >= md->keys->nentries) {
             goto cleanup;
         }
         entry += 1;
@@ -638,7 +1330,7 @@ md_next(MultiDictObject *md, md_pos_t *pos, PyObject **pidentity,
 
     if (pkey) {
         assert(entry->key != NULL);
-        *pkey = _md_ensure_key(md, entry);
+        *pkey = _md_ensure_key_impl(md, entry, is_ci);
         if (*pkey == NULL) {
             assert(PyErr_Occurred());
             ret = -1;
@@ -646,10 +1338,10 @@ md_next(MultiDictObject *md, md_pos_t *pos, PyObject **pidentity,
         }
     }
     if (pvalue) {
-        *pvalue = Py_NewRef(entry->value);
+        *pvalue = Py_NewRef(_md_entry_value(md, entry));
     }
 
-    ++pos->pos;
+    ++*ppos;
     return 1;
 cleanup:
     if (pidentity) {
@@ -664,17 +1356,57 @@ cleanup:
     return ret;
 }
 
+/* Iterate from the entry index *ppos without the version check, *ppos
+   must be non-negative.  The caller is responsible for detecting changes
+   of the multidict; a stale index only skips or repeats items. */
 static inline int
-md_init_finder(MultiDictObject *md, PyObject *identity, md_finder_t *finder)
+md_next_at(MultiDictObject *md, Py_ssize_t *ppos, PyObject **pidentity,
+           PyObject **pkey, PyObject **pvalue)
+{
+    assert(*ppos >= 0);
+    return MD_DISPATCH(md, _md_next_at, md, ppos, pidentity, pkey, pvalue);
+}
+
+static inline int
+md_next(MultiDictObject *md, md_pos_t *pos, PyObject **pidentity,
+        PyObject **pkey, PyObject **pvalue)
+{
+    if (pos->version != md->version) {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "MultiDict is changed during iteration");
+        if (pidentity) {
+            *pidentity = NULL;
+        }
+        if (pkey) {
+            *pkey = NULL;
+        }
+        if (pvalue) {
+            *pvalue = NULL;
+        }
+        return -1;
+    }
+    return md_next_at(md, &pos->pos, pidentity, pkey, pvalue);
+}
+
+static inline void
+md_init_finder_lookup(MultiDictObject *md, const md_lookup_t *lookup,
+                      md_finder_t *finder)
 {
     finder->version = md->version;
     finder->md = md;
-    finder->identity = identity;
-    finder->hash = _unicode_hash(identity);
-    if (finder->hash == -1) {
+    finder->lookup = *lookup;
+    finder->found = false;
+    htkeysiter_init(&finder->iter, md->keys, lookup->hash);
+}
+
+static inline int
+md_init_finder(MultiDictObject *md, PyObject *identity, md_finder_t *finder)
+{
+    md_lookup_t lookup = {identity, NULL, _unicode_hash(identity)};
+    if (lookup.hash == -1) {
         return -1;
     }
-    htkeysiter_init(&finder->iter, finder->md->keys, finder->hash);
+    md_init_finder_lookup(md, &lookup, finder);
     return 0;
 }
 
@@ -708,26 +1440,19 @@ md_find_next(md_finder_t *finder, PyObject **pkey, PyObject **pvalue)
 
     entry_t *entries = htkeys_entries(finder->md->keys);
 
+    if (finder->found) {
+        /* The caller could delete the found entry,
+           advance the iterator only on the next call. */
+        finder->found = false;
+        htkeysiter_next(&finder->iter);
+    }
+
     for (; finder->iter.index != DKIX_EMPTY; htkeysiter_next(&finder->iter)) {
-        if (finder->iter.index < 0) {
-            continue;
-        }
         entry_t *entry = entries + finder->iter.index;
-        if (entry->hash != finder->hash) {
-            continue;
-        }
-        int tmp = _str_cmp(finder->identity, entry->identity);
-        if (tmp < 0) {
-            ret = -1;
-            goto cleanup;
-        }
-        if (tmp == 0) {
+        if (!md_lookup_eq(&finder->lookup, entry)) {
             continue;
         }
 
-        /* found, mark the entry as visited */
-        entry->hash = -1;
-
         if (pkey) {
             *pkey = _md_ensure_key(finder->md, entry);
             if (*pkey == NULL) {
@@ -736,8 +1461,9 @@ md_find_next(md_finder_t *finder, PyObject **pkey, PyObject **pvalue)
             }
         }
         if (pvalue) {
-            *pvalue = Py_NewRef(entry->value);
+            *pvalue = Py_NewRef(_md_entry_value(finder->md, entry));
         }
+        finder->found = true;
         return 1;
     }
     ret = 0;
@@ -757,38 +1483,23 @@ md_finder_cleanup(md_finder_t *finder)
     if (finder->md == NULL) {
         return;
     }
-
-    htkeysiter_init(&finder->iter, finder->md->keys, finder->hash);
-    entry_t *entries = htkeys_entries(finder->md->keys);
-    for (; finder->iter.index != DKIX_EMPTY; htkeysiter_next(&finder->iter)) {
-        if (finder->iter.index < 0) {
-            continue;
-        }
-        entry_t *entry = entries + finder->iter.index;
-        if (entry->hash == -1) {
-            entry->hash = finder->hash;
-        }
-    }
     ASSERT_CONSISTENT(finder->md, false);
     finder->md = NULL;
 }
 
-static inline int
-md_contains(MultiDictObject *md, PyObject *key, PyObject **pret)
+MD_FORCE_INLINE int
+_md_contains(MultiDictObject *md, PyObject *key, PyObject **pret,
+             const bool is_ci)
 {
     if (!PyUnicode_Check(key)) {
         return 0;
     }
 
-    PyObject *identity = md_calc_identity(md, key);
-    if (identity == NULL) {
-        goto fail;
-    }
-
-    Py_hash_t hash = _unicode_hash(identity);
-    if (hash == -1) {
+    md_lookup_t lookup;
+    if (_md_init_lookup(md, key, &lookup, is_ci) < 0) {
         goto fail;
     }
+    Py_hash_t hash = lookup.hash;
 
     htkeysiter_t iter;
     htkeysiter_init(&iter, md->keys, hash);
@@ -799,31 +1510,25 @@ md_contains(MultiDictObject *md, PyObject *key, PyObject **pret)
             continue;
         }
         entry_t *entry = entries + iter.index;
-        if (hash != entry->hash) {
-            continue;
-        }
-        int tmp = _str_cmp(identity, entry->identity);
-        if (tmp > 0) {
-            Py_DECREF(identity);
+        if (md_lookup_eq(&lookup, entry)) {
+            md_lookup_clear(&lookup);
             if (pret != NULL) {
-                *pret = _md_ensure_key(md, entry);
+                *pret = _md_ensure_key_impl(md, entry, is_ci);
                 if (*pret == NULL) {
                     goto fail;
                 }
             }
             return 1;
-        } else if (tmp < 0) {
-            goto fail;
         }
     }
 
-    Py_DECREF(identity);
+    md_lookup_clear(&lookup);
     if (pret != NULL) {
         *pret = NULL;
     }
     return 0;
 fail:
-    Py_XDECREF(identity);
+    md_lookup_clear(&lookup);
     if (pret != NULL) {
         *pret = NULL;
     }
@@ -831,17 +1536,20 @@ fail:
 }
 
 static inline int
-md_get_one(MultiDictObject *md, PyObject *key, PyObject **ret)
+md_contains(MultiDictObject *md, PyObject *key, PyObject **pret)
 {
-    PyObject *identity = md_calc_identity(md, key);
-    if (identity == NULL) {
-        goto fail;
-    }
+    return MD_DISPATCH(md, _md_contains, md, key, pret);
+}
 
-    Py_hash_t hash = _unicode_hash(identity);
-    if (hash == -1) {
+MD_FORCE_INLINE int
+_md_get_one(MultiDictObject *md, PyObject *key, PyObject **ret,
+            const bool is_ci)
+{
+    md_lookup_t lookup;
+    if (_md_init_lookup(md, key, &lookup, is_ci) < 0) {
         goto fail;
     }
+    Py_hash_t hash = lookup.hash;
 
     htkeysiter_t iter;
     htkeysiter_init(&iter, md->keys, hash);
@@ -852,28 +1560,29 @@ md_get_one(MultiDictObject *md, PyObject *key, PyObject **ret)
             continue;
         }
         entry_t *entry = entries + iter.index;
-        if (hash != entry->hash) {
-            continue;
-        }
-        int tmp = _str_cmp(identity, entry->identity);
-        if (tmp > 0) {
-            Py_DECREF(identity);
-            *ret = Py_NewRef(entry->value);
+        if (md_lookup_eq(&lookup, entry)) {
+            md_lookup_clear(&lookup);
+            *ret = Py_NewRef(_md_entry_value(md, entry));
             return 1;
-        } else if (tmp < 0) {
-            goto fail;
         }
     }
 
-    Py_DECREF(identity);
+    md_lookup_clear(&lookup);
     return 0;
 fail:
-    Py_XDECREF(identity);
+    md_lookup_clear(&lookup);
     return -1;
 }
 
 static inline int
-md_get_all(MultiDictObject *md, PyObject *key, PyObject **ret)
+md_get_one(MultiDictObject *md, PyObject *key, PyObject **ret)
+{
+    return MD_DISPATCH(md, _md_get_one, md, key, ret);
+}
+
+MD_FORCE_INLINE int
+_md_get_all(MultiDictObject *md, PyObject *key, PyObject **ret,
+            const bool is_ci)
 {
     int tmp;
     PyObject *value = NULL;
@@ -881,15 +1590,11 @@ md_get_all(MultiDictObject *md, PyObject *key, PyObject **ret)
 
     md_finder_t finder = {0};
 
-    PyObject *identity = md_calc_identity(md, key);
-    if (identity == NULL) {
-        goto fail;
-    }
-
-    if (md_init_finder(md, identity, &finder) < 0) {
-        assert(PyErr_Occurred());
+    md_lookup_t lookup;
+    if (_md_init_lookup(md, key, &lookup, is_ci) < 0) {
         goto fail;
     }
+    md_init_finder_lookup(md, &lookup, &finder);
 
     while ((tmp = md_find_next(&finder, NULL, &value)) > 0) {
         if (*ret == NULL) {
@@ -910,34 +1615,62 @@ md_get_all(MultiDictObject *md, PyObject *key, PyObject **ret)
         goto fail;
     }
 
-    if (*ret != NULL) {
-        // there is no need to restore hashes if none was marked
-        md_finder_cleanup(&finder);
-    }
-    Py_DECREF(identity);
+    md_finder_cleanup(&finder);
+    md_lookup_clear(&lookup);
     return *ret != NULL;
 fail:
     md_finder_cleanup(&finder);
-    Py_XDECREF(identity);
+    md_lookup_clear(&lookup);
     Py_XDECREF(value);
     Py_CLEAR(*ret);
     return -1;
 }
 
 static inline int
-md_set_default(MultiDictObject *md, PyObject *key, PyObject *value,
-               PyObject **result)
+md_get_all(MultiDictObject *md, PyObject *key, PyObject **ret)
 {
-    *result = NULL;
-    PyObject *identity = md_calc_identity(md, key);
-    if (identity == NULL) {
+    return MD_DISPATCH(md, _md_get_all, md, key, ret);
+}
+
+static inline Py_ssize_t
+md_count(MultiDictObject *md, PyObject *key)
+{
+    Py_ssize_t count = 0;
+    md_lookup_t lookup;
+    if (md_init_lookup(md, key, &lookup) < 0) {
         goto fail;
     }
+    Py_hash_t hash = lookup.hash;
 
-    Py_hash_t hash = _unicode_hash(identity);
-    if (hash == -1) {
+    htkeysiter_t iter;
+    htkeysiter_init(&iter, md->keys, hash);
+    entry_t *entries = htkeys_entries(md->keys);
+
+    for (; iter.index != DKIX_EMPTY; htkeysiter_next(&iter)) {
+        entry_t *entry = entries + iter.index;
+        if (md_lookup_eq(&lookup, entry)) {
+            count += 1;
+        }
+    }
+
+    md_lookup_clear(&lookup);
+    return count;
+fail:
+    md_lookup_clear(&lookup);
+    return -1;
+}
+
+static inline int
+md_set_default(MultiDictObject *md, PyObject *key, PyObject *value,
+               PyObject **result)
+{
+    *result = NULL;
+    PyObject *identity = NULL;
+    md_lookup_t lookup;
+    if (md_init_lookup(md, key, &lookup) < 0) {
         goto fail;
     }
+    Py_hash_t hash = lookup.hash;
 
     htkeysiter_t iter;
     htkeysiter_init(&iter, md->keys, hash);
@@ -949,29 +1682,29 @@ md_set_default(MultiDictObject *md, PyObject *key, PyObject *value,
         }
         entry_t *entry = entries + iter.index;
 
-        if (hash != entry->hash) {
-            continue;
-        }
-        int tmp = _str_cmp(identity, entry->identity);
-        if (tmp > 0) {
-            Py_DECREF(identity);
+        if (md_lookup_eq(&lookup, entry)) {
+            md_lookup_clear(&lookup);
             ASSERT_CONSISTENT(md, false);
-            *result = Py_NewRef(entry->value);
+            *result = Py_NewRef(_md_entry_value(md, entry));
             return 1;
-        } else if (tmp < 0) {
-            goto fail;
         }
     }
 
+    identity = md_lookup_identity(md, &lookup, key);
+    if (identity == NULL) {
+        goto fail;
+    }
     if (_md_add_with_hash(md, hash, identity, key, value) < 0) {
         goto fail;
     }
 
+    md_lookup_clear(&lookup);
     Py_DECREF(identity);
     ASSERT_CONSISTENT(md, false);
     *result = Py_NewRef(value);
     return 0;
 fail:
+    md_lookup_clear(&lookup);
     Py_XDECREF(identity);
     return -1;
 }
@@ -981,15 +1714,11 @@ md_pop_one(MultiDictObject *md, PyObject *key, PyObject **ret)
 {
     PyObject *value = NULL;
 
-    PyObject *identity = md_calc_identity(md, key);
-    if (identity == NULL) {
-        goto fail;
-    }
-
-    Py_hash_t hash = _unicode_hash(identity);
-    if (hash == -1) {
+    md_lookup_t lookup;
+    if (md_init_lookup(md, key, &lookup) < 0) {
         goto fail;
     }
+    Py_hash_t hash = lookup.hash;
 
     htkeysiter_t iter;
     htkeysiter_init(&iter, md->keys, hash);
@@ -1001,30 +1730,28 @@ md_pop_one(MultiDictObject *md, PyObject *key, PyObject **ret)
         }
         entry_t *entry = entries + iter.index;
 
-        if (hash != entry->hash) {
-            continue;
-        }
-        int tmp = _str_cmp(identity, entry->identity);
-        if (tmp > 0) {
-            value = Py_NewRef(entry->value);
-            if (_md_del_at(md, iter.slot, entry) < 0) {
+        if (md_lookup_eq(&lookup, entry)) {
+            value = Py_NewRef(_md_entry_value(md, entry));
+            if (_md_unshare_iter(md, &iter, &entries) < 0) {
+                goto fail;
+            }
+            if (_md_del_at(md, iter.slot, entries + iter.index) < 0) {
                 goto fail;
             }
-            Py_DECREF(identity);
+            md_lookup_clear(&lookup);
             *ret = value;
             md->version = NEXT_VERSION(md->state);
+            _md_shrink_if_sparse(md);
             ASSERT_CONSISTENT(md, false);
             return 1;
-        } else if (tmp < 0) {
-            goto fail;
         }
     }
-    Py_DECREF(identity);
+    md_lookup_clear(&lookup);
     ASSERT_CONSISTENT(md, false);
     return 0;
 fail:
     Py_XDECREF(value);
-    Py_XDECREF(identity);
+    md_lookup_clear(&lookup);
     return -1;
 }
 
@@ -1033,18 +1760,14 @@ md_pop_all(MultiDictObject *md, PyObject *key, PyObject **ret)
 {
     PyObject *lst = NULL;
 
-    PyObject *identity = md_calc_identity(md, key);
-    if (identity == NULL) {
-        goto fail;
-    }
-
-    Py_hash_t hash = _unicode_hash(identity);
-    if (hash == -1) {
+    md_lookup_t lookup;
+    if (md_init_lookup(md, key, &lookup) < 0) {
         goto fail;
     }
+    Py_hash_t hash = lookup.hash;
 
     if (md_len(md) == 0) {
-        Py_DECREF(identity);
+        md_lookup_clear(&lookup);
         return 0;
     }
 
@@ -1058,37 +1781,39 @@ md_pop_all(MultiDictObject *md, PyObject *key, PyObject **ret)
         }
         entry_t *entry = entries + iter.index;
 
-        if (hash != entry->hash) {
-            continue;
-        }
-        int tmp = _str_cmp(identity, entry->identity);
-        if (tmp > 0) {
+        if (md_lookup_eq(&lookup, entry)) {
+            PyObject *value = _md_entry_value(md, entry);
             if (lst == NULL) {
                 lst = PyList_New(1);
                 if (lst == NULL) {
                     goto fail;
                 }
-                if (PyList_SetItem(lst, 0, Py_NewRef(entry->value)) < 0) {
+                if (PyList_SetItem(lst, 0, Py_NewRef(value)) < 0) {
                     goto fail;
                 }
-            } else if (PyList_Append(lst, entry->value) < 0) {
+            } else if (PyList_Append(lst, value) < 0) {
+                goto fail;
+            }
+            // after PyList_New(): a finalizer run by the GC could copy md
+            if (_md_unshare_iter(md, &iter, &entries) < 0) {
                 goto fail;
             }
-            if (_md_del_at(md, iter.slot, entry) < 0) {
+            if (_md_del_at(md, iter.slot, entries + iter.index) < 0) {
                 goto fail;
             }
             md->version = NEXT_VERSION(md->state);
-        } else if (tmp < 0) {
-            goto fail;
         }
     }
 
+    if (lst != NULL) {
+        _md_shrink_if_sparse(md);
+    }
     *ret = lst;
-    Py_DECREF(identity);
+    md_lookup_clear(&lookup);
     ASSERT_CONSISTENT(md, false);
     return lst != NULL;
 fail:
-    Py_XDECREF(identity);
+    md_lookup_clear(&lookup);
     Py_XDECREF(lst);
     return -1;
 }
@@ -1115,14 +1840,19 @@ md_pop_item(MultiDictObject *md)
     if (key == NULL) {
         return NULL;
     }
-    PyObject *ret = PyTuple_Pack(2, key, entry->value);
+    PyObject *ret = PyTuple_Pack(2, key, _md_entry_value(md, entry));
     Py_CLEAR(key);
     if (ret == NULL) {
         return NULL;
     }
+    if (_md_unshare(md) < 0) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    entry = htkeys_entries(md->keys) + pos;
 
     htkeysiter_t iter;
-    htkeysiter_init(&iter, md->keys, entry->hash);
+    htkeysiter_init(&iter, md->keys, htkeys_entry_hash(entry));
 
     for (; iter.index != pos; htkeysiter_next(&iter)) {
     }
@@ -1130,20 +1860,21 @@ md_pop_item(MultiDictObject *md)
         return NULL;
     }
     md->version = NEXT_VERSION(md->state);
+    _md_shrink_if_sparse(md);
     ASSERT_CONSISTENT(md, false);
     return ret;
 }
 
-static inline int
+MD_FORCE_INLINE int
 _md_replace(MultiDictObject *md, PyObject *key, PyObject *value,
-            PyObject *identity, Py_hash_t hash)
+            const md_lookup_t *lookup, const bool is_ci)
 {
     int found = 0;
     md_finder_t finder = {0};
-    if (md_init_finder(md, identity, &finder) < 0) {
-        assert(PyErr_Occurred());
-        goto fail;
+    if (_md_unshare(md) < 0) {
+        return -1;
     }
+    md_init_finder_lookup(md, lookup, &finder);
     entry_t *entries = htkeys_entries(md->keys);
 
     int tmp;
@@ -1153,9 +1884,15 @@ _md_replace(MultiDictObject *md, PyObject *key, PyObject *value,
         entry_t *entry = entries + md_finder_index(&finder);
         if (!found) {
             found = 1;
-            Py_SETREF(entry->key, Py_NewRef(key));
-            Py_SETREF(entry->value, Py_NewRef(value));
-            entry->hash = -1;
+            PyObject *old_key = entry->key;
+            PyObject *old_value = entry->value;
+            entry->key = Py_NewRef(key);
+            entry->value = Py_NewRef(value);
+            _md_maintain_tracking(md, key, value);
+            // sync before destructors could touch the dict
+            _md_next_sync(md->keys, entry);
+            Py_DECREF(old_key);
+            Py_DECREF(old_value);
         } else {
             if (_md_del_at(md, md_finder_slot(&finder), entry) < 0) {
                 goto fail;
@@ -1168,10 +1905,13 @@ _md_replace(MultiDictObject *md, PyObject *key, PyObject *value,
 
     md_finder_cleanup(&finder);
     if (!found) {
-        if (_md_add_with_hash(md, hash, identity, key, value) < 0) {
-            goto fail;
+        PyObject *identity = _md_lookup_identity(md, lookup, key, is_ci);
+        if (identity == NULL) {
+            return -1;
         }
-        return 0;
+        int ret = _md_add_with_hash(md, lookup->hash, identity, key, value);
+        Py_DECREF(identity);
+        return ret;
     } else {
         md->version = NEXT_VERSION(md->state);
         return 0;
@@ -1181,32 +1921,33 @@ fail:
     return -1;
 }
 
-static inline int
-md_replace(MultiDictObject *md, PyObject *key, PyObject *value)
+MD_FORCE_INLINE int
+_md_replace_impl(MultiDictObject *md, PyObject *key, PyObject *value,
+                 const bool is_ci)
 {
-    PyObject *identity = md_calc_identity(md, key);
-    if (identity == NULL) {
-        goto fail;
-    }
-
-    Py_hash_t hash = _unicode_hash(identity);
-    if (hash == -1) {
-        goto fail;
+    md_lookup_t lookup;
+    if (_md_init_lookup(md, key, &lookup, is_ci) < 0) {
+        return -1;
     }
-
-    int ret = _md_replace(md, key, value, identity, hash);
-    Py_DECREF(identity);
+    int ret = _md_replace(md, key, value, &lookup, is_ci);
+    md_lookup_clear(&lookup);
     ASSERT_CONSISTENT(md, false);
     return ret;
-fail:
-    Py_XDECREF(identity);
-    return -1;
+}
+
+static inline int
+md_replace(MultiDictObject *md, PyObject *key, PyObject *value)
+{
+    return MD_DISPATCH(md, _md_replace_impl, md, key, value);
 }
 
 static inline int
 _md_update(MultiDictObject *md, Py_hash_t hash, PyObject *identity,
-           PyObject *key, PyObject *value)
+           PyObject *key, PyObject *value, md_dirty_t *dirty)
 {
+    if (_md_unshare(md) < 0) {
+        return -1;
+    }
     htkeysiter_t iter;
     htkeysiter_init(&iter, md->keys, hash);
     entry_t *entries = htkeys_entries(md->keys);
@@ -1217,37 +1958,40 @@ _md_update(MultiDictObject *md, Py_hash_t hash, PyObject *identity,
             continue;
         }
         entry_t *entry = entries + iter.index;
-        if (hash != entry->hash) {
+        if (!htkeys_entry_eq(entry, hash, identity)) {
             continue;
         }
-        int tmp = _str_cmp(identity, entry->identity);
-        if (tmp > 0) {
-            if (!found) {
-                found = true;
-                if (entry->key == NULL) {
-                    /* entry->key could be NULL if it was deleted
-                       by the previous _md_update call during the iteration
-                       in md_update_from* functions. */
-                    assert(entry->value == NULL);
-                    entry->key = Py_NewRef(key);
-                    entry->value = Py_NewRef(value);
-                } else {
-                    Py_SETREF(entry->key, Py_NewRef(key));
-                    Py_SETREF(entry->value, Py_NewRef(value));
-                }
-                entry->hash = -1;
+        if (entry->key != NULL && (iter.index >= dirty->start ||
+                                   _md_dirty_contains(dirty, iter.index))) {
+            // set or added by the previous item of this update
+            continue;
+        }
+        if (!found) {
+            found = true;
+            if (entry->key == NULL) {
+                /* entry->key could be NULL if it was deleted
+                   by the previous _md_update call during the iteration
+                   in md_update_from* functions. */
+                assert(entry->value == NULL);
+                entry->key = Py_NewRef(key);
+                entry->value = Py_NewRef(value);
             } else {
-                if (_md_del_at_for_upd(md, iter.slot, entry) < 0) {
+                if (_md_dirty_add(dirty, iter.index) < 0) {
                     goto fail;
                 }
+                Py_SETREF(entry->key, Py_NewRef(key));
+                Py_SETREF(entry->value, Py_NewRef(value));
+            }
+            _md_maintain_tracking(md, key, value);
+        } else {
+            if (_md_del_at_for_upd(md, iter.slot, entry, dirty) < 0) {
+                goto fail;
             }
-        } else if (tmp < 0) {
-            goto fail;
         }
     }
 
     if (!found) {
-        if (_md_add_for_upd(md, hash, identity, key, value) < 0) {
+        if (_md_add_for_upd(md, hash, identity, key, value, dirty) < 0) {
             goto fail;
         }
     }
@@ -1258,7 +2002,7 @@ fail:
 
 static inline int
 _md_merge(MultiDictObject *md, Py_hash_t hash, PyObject *identity,
-          PyObject *key, PyObject *value)
+          PyObject *key, PyObject *value, md_dirty_t *dirty)
 {
     htkeysiter_t iter;
     htkeysiter_init(&iter, md->keys, hash);
@@ -1269,18 +2013,13 @@ _md_merge(MultiDictObject *md, Py_hash_t hash, PyObject *identity,
             continue;
         }
         entry_t *entry = entries + iter.index;
-        if (hash != entry->hash) {
-            continue;
-        }
-        int tmp = _str_cmp(identity, entry->identity);
-        if (tmp > 0) {
+        if (iter.index < dirty->start &&
+            htkeys_entry_eq(entry, hash, identity)) {
             return 0;
-        } else if (tmp < 0) {
-            goto fail;
         }
     }
 
-    if (_md_add_for_upd(md, hash, identity, key, value) < 0) {
+    if (_md_add_for_upd(md, hash, identity, key, value, dirty) < 0) {
         goto fail;
     }
     return 0;
@@ -1289,33 +2028,157 @@ fail:
 }
 
 static inline void
-md_post_update(MultiDictObject *md)
+md_post_update(MultiDictObject *md, md_dirty_t *dirty)
 {
     htkeys_t *keys = md->keys;
-    size_t num_slots = htkeys_nslots(keys);
+    // written by _md_update() already, not shared since then
+    assert(keys->refcnt == 1 || dirty->len == 0);
     entry_t *entries = htkeys_entries(keys);
-    for (size_t slot = 0; slot < num_slots; slot++) {
-        Py_ssize_t index = htkeys_get_index(keys, slot);
-        if (index >= 0) {
-            entry_t *entry = entries + index;
-            if (entry->key == NULL) {
-                /* the entry is marked for deletion during .update() call
-                   and not replaced with a new value */
-                Py_CLEAR(entry->identity);
-                htkeys_set_index(keys, slot, DKIX_DUMMY);
-                md->used -= 1;
-            }
-            if (entry->hash == -1) {
-                entry->hash = _unicode_hash(entry->identity);
-            }
-            assert(entry->hash != -1);
+    for (Py_ssize_t i = 0; i <= dirty->mask; i++) {
+        Py_ssize_t pos = dirty->slots[i];
+        if (pos == -1) {
+            continue;
+        }
+        entry_t *entry = entries + pos;
+        if (entry->key != NULL) {
+            continue;
+        }
+        /* the entry is marked for deletion during .update() call
+           and not replaced with a new value */
+        assert(entry->identity != NULL && entry->value == NULL);
+        if (htkeys_is_small(keys)) {
+            htkeys_del_index(keys, (size_t)pos);
+        } else {
+            // unlink the entry while its identity is alive
+            size_t empty;
+            Py_ssize_t slot = _htkeys_find_head(
+                keys, htkeys_entry_hash(entry), entry->identity, &empty);
+            assert(slot >= 0);
+            htkeys_del_entry(keys, (size_t)slot, pos);
+        }
+        Py_CLEAR(entry->identity);
+        md->used -= 1;
+    }
+    md_dirty_clear(dirty);
+    if (dirty->resized && md->used < keys->nentries) {
+        /* The resize kept deleted entries in place and cost O(N) already,
+           drop them now. */
+        _md_shrink(md);
+    }
+    ASSERT_CONSISTENT(md, false);
+}
+
+/* Copy live entries of src to dst, return the number of copied entries.
+
+   values are the values of a split src or NULL. */
+static inline Py_ssize_t
+_md_copy_entries(entry_t *dst, htkeys_t *src, PyObject **values, bool incref)
+{
+    entry_t *src_ep = htkeys_entries(src);
+    entry_t *dst_ep = dst;
+    for (Py_ssize_t pos = 0; pos < src->nentries; pos++, src_ep++) {
+        if (src_ep->identity == NULL) {
+            continue;
+        }
+        *dst_ep = *src_ep;
+        if (values != NULL) {
+            dst_ep->value = values[pos];
+        }
+        if (incref) {
+            Py_INCREF(dst_ep->identity);
+            Py_INCREF(dst_ep->key);
+            Py_INCREF(dst_ep->value);
+        }
+        dst_ep++;
+    }
+    return dst_ep - dst;
+}
+
+/* Extend by a multidict of the same kind.
+
+   Identities and hashes of the entries are ready, the entries are copied
+   as is.  If the table is too small, the new table is allocated once and
+   indexed by a single htkeys_build_indices() pass over old and new
+   entries, without intermediate resizes and with no lookups.
+
+   other could be md itself.
+*/
+static inline int
+_md_extend_from_ht(MultiDictObject *md, MultiDictObject *other)
+{
+    assert(md->is_ci == other->is_ci);
+    htkeys_t *keys = md->keys;
+    htkeys_t *src = other->keys;
+    Py_ssize_t num = other->used;
+
+    if (num == 0) {
+        return 0;
+    }
+    if (md->used == 0 && keys->log2_size <= src->log2_size) {
+        // the index is copied as well, like by .copy()
+        if (md_clone_from_ht(md, other) < 0) {
+            md->used = 0;
+            md->keys = keys;
+            return -1;
         }
+        if (keys->refcnt > 1) {
+            keys->refcnt -= 1;
+        } else if (keys != &empty_htkeys) {
+            htkeys_free(md->state, keys);
+        }
+        md->version = NEXT_VERSION(md->state);
+        return 0;
+    }
+    if (_md_unshare(md) < 0) {
+        return -1;
     }
+    keys = md->keys;
+    src = other->keys;  // other could be md
+    if (keys == &empty_htkeys || keys->usable < num) {
+        uint8_t log2_newsize = estimate_log2_keysize(md->used + num);
+        if (log2_newsize >= SIZEOF_SIZE_T * 8) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        htkeys_t *newkeys = htkeys_new(md->state, log2_newsize);
+        if (newkeys == NULL) {
+            return -1;
+        }
+        entry_t *newentries = htkeys_entries(newkeys);
+        Py_ssize_t used = _md_copy_entries(newentries, keys, NULL, false);
+        assert(used == md->used);
+        used += _md_copy_entries(newentries + used, src, other->values, true);
+        assert(used == md->used + num);
+        htkeys_build_indices(newkeys, newentries, used);
+        newkeys->usable -= used;
+        newkeys->nentries = used;
+        md->keys = newkeys;
+        if (keys != &empty_htkeys) {
+            htkeys_free(md->state, keys);
+        }
+    } else {
+        Py_ssize_t start = keys->nentries;
+        entry_t *entries = htkeys_entries(keys);
+        Py_ssize_t copied =
+            _md_copy_entries(entries + start, src, other->values, true);
+        assert(copied == num);
+        for (Py_ssize_t ix = start; ix < start + copied; ix++) {
+            htkeys_add_index(
+                keys, ix, htkeys_entry_hash(entries + ix), entries[ix].identity);
+        }
+        keys->usable -= copied;
+        keys->nentries += copied;
+    }
+    md->used += num;
+    md->version = NEXT_VERSION(md->state);
+    _md_inherit_tracking(md, other);
     ASSERT_CONSISTENT(md, false);
+    return 0;
 }
 
 static inline int
-md_update_from_ht(MultiDictObject *md, MultiDictObject *other, UpdateOp op)
+md_update_from_ht(MultiDictObject *md, MultiDictObject *other, UpdateOp op,
+                  md_dirty_t *dirty)
 {
     Py_ssize_t pos;
     Py_hash_t hash;
@@ -1326,6 +2189,9 @@ md_update_from_ht(MultiDictObject *md, MultiDictObject *other, UpdateOp op)
     if (other->used == 0) {
         return 0;
     }
+    if (op == Extend && !recalc_identity) {
+        return _md_extend_from_ht(md, other);
+    }
 
     entry_t *entries = htkeys_entries(other->keys);
 
@@ -1334,6 +2200,7 @@ md_update_from_ht(MultiDictObject *md, MultiDictObject *other, UpdateOp op)
         if (entry->identity == NULL) {
             continue;
         }
+        PyObject *value = _md_entry_value(other, entry);
         if (recalc_identity) {
             identity = md_calc_identity(md, entry->key);
             if (identity == NULL) {
@@ -1350,23 +2217,22 @@ md_update_from_ht(MultiDictObject *md, MultiDictObject *other, UpdateOp op)
             }
         } else {
             identity = entry->identity;
-            hash = entry->hash;
+            hash = htkeys_entry_hash(entry);
             key = entry->key;
         }
         switch (op) {
             case Update:
-                if (_md_update(md, hash, identity, key, entry->value) < 0) {
+                if (_md_update(md, hash, identity, key, value, dirty) < 0) {
                     goto fail;
                 }
                 break;
             case Extend:
-                if (_md_add_with_hash(md, hash, identity, key, entry->value) <
-                    0) {
+                if (_md_add_with_hash(md, hash, identity, key, value) < 0) {
                     goto fail;
                 }
                 break;
             case Merge:
-                if (_md_merge(md, hash, identity, key, entry->value) < 0) {
+                if (_md_merge(md, hash, identity, key, value, dirty) < 0) {
                     goto fail;
                 }
                 break;
@@ -1385,8 +2251,9 @@ fail:
     return -1;
 }
 
-static inline int
-md_update_from_dict(MultiDictObject *md, PyObject *kwds, UpdateOp op)
+MD_FORCE_INLINE int
+_md_update_from_dict(MultiDictObject *md, PyObject *kwds, UpdateOp op,
+                     md_dirty_t *dirty, const bool is_ci)
 {
     Py_ssize_t pos = 0;
     PyObject *identity = NULL;
@@ -1398,7 +2265,7 @@ md_update_from_dict(MultiDictObject *md, PyObject *kwds, UpdateOp op)
     // PyDict_Next returns borrowed refs
     while (PyDict_Next(kwds, &pos, &key, &value)) {
         Py_INCREF(key);
-        identity = md_calc_identity(md, key);
+        identity = _md_calc_identity(md->state, key, is_ci);
         if (identity == NULL) {
             goto fail;
         }
@@ -1408,7 +2275,7 @@ md_update_from_dict(MultiDictObject *md, PyObject *kwds, UpdateOp op)
         }
         switch (op) {
             case Update: {
-                if (_md_update(md, hash, identity, key, value) < 0) {
+                if (_md_update(md, hash, identity, key, value, dirty) < 0) {
                     goto fail;
                 }
                 Py_CLEAR(identity);
@@ -1429,7 +2296,7 @@ md_update_from_dict(MultiDictObject *md, PyObject *kwds, UpdateOp op)
                 break;
             }
             case Merge: {
-                if (_md_merge(md, hash, identity, key, value) < 0) {
+                if (_md_merge(md, hash, identity, key, value, dirty) < 0) {
                     goto fail;
                 }
                 Py_CLEAR(identity);
@@ -1445,6 +2312,13 @@ fail:
     return -1;
 }
 
+static inline int
+md_update_from_dict(MultiDictObject *md, PyObject *kwds, UpdateOp op,
+                    md_dirty_t *dirty)
+{
+    return MD_DISPATCH(md, _md_update_from_dict, md, kwds, op, dirty);
+}
+
 static inline void
 _err_not_sequence(Py_ssize_t i)
 {
@@ -1524,8 +2398,9 @@ fail:
     return -1;
 }
 
-static inline int
-md_update_from_seq(MultiDictObject *md, PyObject *seq, UpdateOp op)
+MD_FORCE_INLINE int
+_md_update_from_seq(MultiDictObject *md, PyObject *seq, UpdateOp op,
+                    md_dirty_t *dirty, const bool is_ci)
 {
     PyObject *it = NULL;
     PyObject *item = NULL;  // seq[i]
@@ -1595,7 +2470,7 @@ md_update_from_seq(MultiDictObject *md, PyObject *seq, UpdateOp op)
             goto fail;
         }
 
-        identity = md_calc_identity(md, key);
+        identity = _md_calc_identity(md->state, key, is_ci);
         if (identity == NULL) {
             goto fail;
         }
@@ -1607,7 +2482,7 @@ md_update_from_seq(MultiDictObject *md, PyObject *seq, UpdateOp op)
 
         switch (op) {
             case Update:
-                if (_md_update(md, hash, identity, key, value) < 0) {
+                if (_md_update(md, hash, identity, key, value, dirty) < 0) {
                     goto fail;
                 }
                 Py_CLEAR(identity);
@@ -1624,7 +2499,7 @@ md_update_from_seq(MultiDictObject *md, PyObject *seq, UpdateOp op)
                 value = NULL;
                 break;
             case Merge:
-                if (_md_merge(md, hash, identity, key, value) < 0) {
+                if (_md_merge(md, hash, identity, key, value, dirty) < 0) {
                     goto fail;
                 }
                 Py_CLEAR(identity);
@@ -1648,6 +2523,13 @@ fail:
     return -1;
 }
 
+static inline int
+md_update_from_seq(MultiDictObject *md, PyObject *seq, UpdateOp op,
+                   md_dirty_t *dirty)
+{
+    return MD_DISPATCH(md, _md_update_from_seq, md, seq, op, dirty);
+}
+
 static inline int
 md_eq(MultiDictObject *md, MultiDictObject *other)
 {
@@ -1679,19 +2561,13 @@ md_eq(MultiDictObject *md, MultiDictObject *other)
             continue;
         }
 
-        if (entry1->hash != entry2->hash) {
-            return 0;
-        }
-
-        int cmp = _str_cmp(entry1->identity, entry2->identity);
-        if (cmp < 0) {
-            return -1;
-        };
-        if (cmp == 0) {
+        if (!htkeys_entry_eq(
+                entry1, htkeys_entry_hash(entry2), entry2->identity)) {
             return 0;
         }
 
-        cmp = PyObject_RichCompareBool(entry1->value, entry2->value, Py_EQ);
+        int cmp = PyObject_RichCompareBool(
+            _md_entry_value(md, entry1), _md_entry_value(other, entry2), Py_EQ);
         if (cmp < 0) {
             return -1;
         };
@@ -1704,6 +2580,55 @@ md_eq(MultiDictObject *md, MultiDictObject *other)
     return 1;
 }
 
+/* Hash of the items consistent with md_eq(): identities and values are
+   combined in the insertion order like the items of a tuple
+   (identity1, value1, identity2, value2, ...).
+*/
+#if SIZEOF_SIZE_T > 4
+#define MD_HASH_XXPRIME_1 ((Py_uhash_t)11400714785074694791ULL)
+#define MD_HASH_XXPRIME_2 ((Py_uhash_t)14029467366897019727ULL)
+#define MD_HASH_XXPRIME_5 ((Py_uhash_t)2870177450012600261ULL)
+#define MD_HASH_XXROTATE(x) ((x << 31) | (x >> 33))
+#else
+#define MD_HASH_XXPRIME_1 ((Py_uhash_t)2654435761UL)
+#define MD_HASH_XXPRIME_2 ((Py_uhash_t)2246822519UL)
+#define MD_HASH_XXPRIME_5 ((Py_uhash_t)374761393UL)
+#define MD_HASH_XXROTATE(x) ((x << 13) | (x >> 19))
+#endif
+
+static inline Py_uhash_t
+_md_hash_round(Py_uhash_t acc, Py_uhash_t lane)
+{
+    acc += lane * MD_HASH_XXPRIME_2;
+    acc = MD_HASH_XXROTATE(acc);
+    acc *= MD_HASH_XXPRIME_1;
+    return acc;
+}
+
+static inline Py_hash_t
+md_hash(MultiDictObject *md)
+{
+    Py_uhash_t acc = MD_HASH_XXPRIME_5;
+    entry_t *entries = htkeys_entries(md->keys);
+    for (Py_ssize_t pos = 0; pos < md->keys->nentries; pos++) {
+        entry_t *entry = entries + pos;
+        if (entry->identity == NULL) {
+            continue;
+        }
+        Py_hash_t hash = PyObject_Hash(_md_entry_value(md, entry));
+        if (hash == -1) {
+            return -1;
+        }
+        acc = _md_hash_round(acc, (Py_uhash_t)htkeys_entry_hash(entry));
+        acc = _md_hash_round(acc, (Py_uhash_t)hash);
+    }
+    acc += (Py_uhash_t)(md->used * 2) ^ (MD_HASH_XXPRIME_5 ^ 3527539UL);
+    if (acc == (Py_uhash_t)-1) {
+        return 1546275796;
+    }
+    return (Py_hash_t)acc;
+}
+
 static inline int
 md_eq_to_mapping(MultiDictObject *md, PyObject *other)
 {
@@ -1798,7 +2723,7 @@ md_repr(MultiDictObject *md, PyObject *name, bool show_keys, bool show_values)
             continue;
         }
         key = Py_NewRef(entry->key);
-        value = Py_NewRef(entry->value);
+        value = Py_NewRef(_md_entry_value(md, entry));
 
         if (comma) {
             if (PyUnicodeWriter_WriteChar(writer, ',') < 0) {
@@ -1862,6 +2787,14 @@ md_traverse(MultiDictObject *md, visitproc visit, void *arg)
         return 0;
     }
 
+    if (md->values != NULL) {
+        // the keys belong to the shared layout
+        for (Py_ssize_t pos = 0; pos < md->used; pos++) {
+            Py_VISIT(md->values[pos]);
+        }
+        return 0;
+    }
+
     entry_t *entries = htkeys_entries(md->keys);
     for (Py_ssize_t pos = 0; pos < md->keys->nentries; pos++) {
         entry_t *entry = entries + pos;
@@ -1874,6 +2807,25 @@ md_traverse(MultiDictObject *md, visitproc visit, void *arg)
     return 0;
 }
 
+/* Replace the split table of md with newkeys, release the values and
+   the layout.  md is detached before the values are released, their
+   destructors could touch it. */
+static inline void
+_md_detach_split(MultiDictObject *md, htkeys_t *newkeys)
+{
+    htkeys_t *keys = md->keys;
+    PyObject **values = md->values;
+    Py_ssize_t used = md->used;
+    md->keys = newkeys;
+    md->values = NULL;
+    md->used = 0;
+    for (Py_ssize_t pos = 0; pos < used; pos++) {
+        Py_DECREF(values[pos]);
+    }
+    PyMem_Free(values);
+    _md_layout_release(md->state, keys);
+}
+
 static inline int
 md_clear(MultiDictObject *md)
 {
@@ -1882,6 +2834,20 @@ md_clear(MultiDictObject *md)
     }
     md->version = NEXT_VERSION(md->state);
 
+    if (md->values != NULL) {
+        md->log2_min_size = 0;
+        _md_detach_split(md, &empty_htkeys);
+        return 0;
+    }
+    if (md->keys->refcnt > 1) {
+        // the entries belong to the other users of the table
+        md->keys->refcnt -= 1;
+        md->keys = &empty_htkeys;
+        md->used = 0;
+        md->log2_min_size = 0;
+        return 0;
+    }
+
     entry_t *entries = htkeys_entries(md->keys);
     for (Py_ssize_t pos = 0; pos < md->keys->nentries; pos++) {
         entry_t *entry = entries + pos;
@@ -1893,14 +2859,425 @@ md_clear(MultiDictObject *md)
     }
 
     md->used = 0;
+    md->log2_min_size = 0;
+    if (md->keys != &empty_htkeys) {
+        htkeys_free(md->state, md->keys);
+        md->keys = &empty_htkeys;
+    }
+    ASSERT_CONSISTENT(md, false);
+    return 0;
+}
+
+/* Remove all items but keep the allocated table for reusing.
+
+   The table is detached while the items are released, a destructor called
+   by Py_CLEAR() could touch the multidict.  If it has added new items,
+   the detached table is freed instead.
+*/
+static inline int
+md_clear_keep_capacity(MultiDictObject *md)
+{
+    htkeys_t *keys = md->keys;
+    if (keys == &empty_htkeys) {
+        return 0;
+    }
+    if (_md_is_shared(md)) {
+        htkeys_t *newkeys = htkeys_new(md->state, keys->log2_size);
+        if (newkeys == NULL) {
+            return -1;
+        }
+        md->version = NEXT_VERSION(md->state);
+        md->log2_min_size = newkeys->log2_size;
+        if (md->values != NULL) {
+            _md_detach_split(md, newkeys);
+            return 0;
+        }
+        keys->refcnt -= 1;
+        md->keys = newkeys;
+        md->used = 0;
+        ASSERT_CONSISTENT(md, false);
+        return 0;
+    }
+    _md_drop_next(md);
+    md->version = NEXT_VERSION(md->state);
+    md->keys = &empty_htkeys;
+    md->used = 0;
+
+    entry_t *entries = htkeys_entries(keys);
+    for (Py_ssize_t pos = 0; pos < keys->nentries; pos++) {
+        entry_t *entry = entries + pos;
+        if (entry->identity != NULL) {
+            Py_CLEAR(entry->identity);
+            Py_CLEAR(entry->key);
+            Py_CLEAR(entry->value);
+        }
+    }
+
     if (md->keys != &empty_htkeys) {
-        htkeys_free(md->keys);
+        htkeys_free(md->state, keys);
+        ASSERT_CONSISTENT(md, false);
+        return 0;
+    }
+    if (!htkeys_is_small(keys)) {
+        memset(
+            &keys->indices[0], 0xff, ((size_t)1 << keys->log2_index_bytes));
+    }
+    memset(htkeys_ctrl(keys), HT_CTRL_EMPTY, _htkeys_ctrl_bytes(keys->log2_size));
+    memset(entries, 0, sizeof(entry_t) * (size_t)keys->nentries);
+    keys->usable = htkeys_usable_size(keys->log2_size);
+    keys->nentries = 0;
+    md->keys = keys;
+    md->log2_min_size = keys->log2_size;
+    ASSERT_CONSISTENT(md, false);
+    return 0;
+}
+
+/* Make room for extra_size more items without further resizes.
+
+   Unlike md_reserve(), the size comes from the user and is checked
+   against overflows of the table size in bytes.  The reserved size is
+   kept until md_shrink_to_fit() or md_clear(): deletions don't downsize
+   the table below it. */
+static inline int
+md_reserve_capacity(MultiDictObject *md, Py_ssize_t extra_size)
+{
+    assert(extra_size >= 0);
+    if (extra_size >
+        (PY_SSIZE_T_MAX - md->used) / (Py_ssize_t)(4 * sizeof(entry_t))) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    uint8_t log2_newsize = estimate_log2_keysize(extra_size + md->used);
+    if (log2_newsize > md->log2_min_size) {
+        md->log2_min_size = log2_newsize;
+    }
+    if (log2_newsize <= md->keys->log2_size) {
+        return 0;
+    }
+    if (_md_unshare(md) < 0 || _md_resize(md, log2_newsize, false) < 0) {
+        return -1;
+    }
+    // deleted entries are dropped, iterators cannot continue
+    md->version = NEXT_VERSION(md->state);
+    return 0;
+}
+
+/* Drop deleted entries and downsize the table to the smallest one that
+   holds all items. */
+static inline int
+md_shrink_to_fit(MultiDictObject *md)
+{
+    htkeys_t *keys = md->keys;
+    md->log2_min_size = 0;
+    if (keys == &empty_htkeys || md->values != NULL) {
+        // a split table has no deleted entries and owns no layout
+        return 0;
+    }
+    if (_md_unshare(md) < 0) {
+        return -1;
+    }
+    keys = md->keys;
+    if (md->used == 0) {
+        md->version = NEXT_VERSION(md->state);
         md->keys = &empty_htkeys;
+        htkeys_free(md->state, keys);
+        ASSERT_CONSISTENT(md, false);
+        return 0;
+    }
+    uint8_t log2_newsize = estimate_log2_keysize(md->used);
+    if (log2_newsize < keys->log2_size) {
+        if (_md_resize(md, log2_newsize, false) < 0) {
+            return -1;
+        }
+    } else if (md->used < keys->nentries) {
+        _md_shrink(md);
+    } else {
+        return 0;
+    }
+    md->version = NEXT_VERSION(md->state);
+    return 0;
+}
+
+/* Frozen tables.
+
+   FrozenMultiDict is built once and never modified, md_freeze() finishes
+   the build.  The table is compacted to the smallest size that holds the
+   items.  If some keys are not resolved by their home group (see
+   htkeys_count_probe_collisions()), the twice larger table is tried and
+   kept only if it makes the index collision-free: every lookup of a present
+   key then loads a single group of control bytes and compares a single
+   entry.  Tags are fixed by the hashes, large key sets almost never become
+   collision-free, so the search is limited to tables below
+   2**MD_FROZEN_MAX_LOG2 slots.
+
+   Keys are converted in advance (see _md_ensure_key_impl()), lookups and
+   iteration of a frozen multidict never write to the table, thus it can be
+   read from many threads without locking.
+*/
+#define MD_FROZEN_MAX_LOG2 10
+
+static inline int
+md_freeze(MultiDictObject *md)
+{
+    if (md_shrink_to_fit(md) < 0) {
+        return -1;
+    }
+    if (md->keys == &empty_htkeys || md->values != NULL) {
+        // the layout of a split table is shared as is
+        return 0;
+    }
+    _md_drop_next(md);
+    uint8_t log2_size = md->keys->log2_size;
+    if (log2_size < MD_FROZEN_MAX_LOG2 &&
+        htkeys_count_probe_collisions(md->keys) > 0) {
+        if (_md_resize(md, log2_size + 1, false) < 0) {
+            return -1;
+        }
+        if (htkeys_count_probe_collisions(md->keys) > 0 &&
+            _md_resize(md, log2_size, false) < 0) {
+            return -1;
+        }
+    }
+
+    if (md->is_ci) {
+        entry_t *entries = htkeys_entries(md->keys);
+        for (Py_ssize_t pos = 0; pos < md->keys->nentries; pos++) {
+            PyObject *key = _md_ensure_key(md, entries + pos);
+            if (key == NULL) {
+                return -1;
+            }
+            Py_DECREF(key);
+        }
+    }
+    ASSERT_CONSISTENT(md, false);
+    return 0;
+}
+
+/* Layout cache of split tables.
+
+   Services build many multidicts with the same keys in the same order,
+   e.g. the headers of responses from one backend.  The constructor called
+   with a list or tuple of (key, value) pairs looks up a layout with these
+   keys in a small direct-mapped cache indexed by the hash of the first key
+   and the number of items.  On a hit the multidict shares the layout and
+   stores its values only (see md_init_split()): identities are not
+   calculated, keys are not hashed and indexed, no table is allocated.
+
+   On a miss the multidict is built as usual, and its table becomes the
+   layout of the slot (see md_publish_layout()).  An occupied slot is
+   replaced after LAYOUT_CACHE_MAX_MISSES misses in a row only, thus
+   occasional other shapes don't evict a layout in use.
+
+   Keys of the items should be exact str (or istr already stored in the
+   layout) equal to the layout keys case-sensitively: iteration returns the
+   layout keys.  The cache is a part of the module state; the free-threaded
+   build has no split tables, the table reference counter is not atomic.
+*/
+#define LAYOUT_CACHE_MAX_MISSES 8
+#define MD_SPLIT_MAX_SIZE 128
+
+/* Unpack an exact 2-tuple or 2-list to borrowed references */
+static inline bool
+_md_split_pair(PyObject *item, PyObject **pkey, PyObject **pvalue)
+{
+    if (PyTuple_CheckExact(item) && PyTuple_GET_SIZE(item) == 2) {
+        *pkey = PyTuple_GET_ITEM(item, 0);
+        *pvalue = PyTuple_GET_ITEM(item, 1);
+        return true;
+    }
+    if (PyList_CheckExact(item) && PyList_GET_SIZE(item) == 2) {
+        *pkey = PyList_GET_ITEM(item, 0);
+        *pvalue = PyList_GET_ITEM(item, 1);
+        return true;
+    }
+    return false;
+}
+
+/* Compare the exact str key with the layout key (str or istr) */
+static inline bool
+_md_split_key_eq(PyObject *key, PyObject *layout_key)
+{
+    if (key == layout_key) {
+        return true;
+    }
+    if (!PyUnicode_CheckExact(key)) {
+        return false;
+    }
+    Py_ssize_t len = PyUnicode_GET_LENGTH(key);
+    int kind = PyUnicode_KIND(key);
+    return len == PyUnicode_GET_LENGTH(layout_key) &&
+           kind == PyUnicode_KIND(layout_key) &&
+           memcmp(PyUnicode_DATA(key),
+                  PyUnicode_DATA(layout_key),
+                  (size_t)len * (size_t)kind) == 0;
+}
+
+/* Try to build md sharing a cached layout with the items of seq.
+
+   Return 1 if md is built, 0 if it should be built as usual, -1 on error.
+   *pslot is set to the cache slot for md_publish_layout() on a miss, -1 if
+   the slot should be kept.
+*/
+static inline int
+md_init_split(MultiDictObject *md, mod_state *state, bool is_ci,
+              PyObject *seq, Py_ssize_t *pslot)
+{
+    layout_cache_t *cache = &state->layout_cache;
+    *pslot = -1;
+    if (!MD_SHARE_TABLES || cache->size == 0 || seq == NULL ||
+        (!PyList_CheckExact(seq) && !PyTuple_CheckExact(seq))) {
+        return 0;
+    }
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+    PyObject *key, *value;
+    if (n == 0 || n > MD_SPLIT_MAX_SIZE ||
+        !_md_split_pair(items[0], &key, &value) || !PyUnicode_Check(key)) {
+        return 0;
+    }
+    // str subclasses have the hash of str, see istr
+    Py_hash_t hash = PyUnicode_Type.tp_hash(key);
+    if (hash == -1) {
+        PyErr_Clear();
+        return 0;
+    }
+    Py_ssize_t ix = (Py_ssize_t)(((size_t)hash ^ ((size_t)n << 1) ^ is_ci) &
+                                 (size_t)(cache->size - 1));
+    layout_slot_t *slot = &cache->slots[ix];
+    htkeys_t *keys = slot->keys;
+    if (keys == NULL || slot->is_ci != is_ci || keys->nentries != n) {
+        goto miss;
+    }
+    entry_t *entries = htkeys_entries(keys);
+    for (Py_ssize_t pos = 0; pos < n; pos++) {
+        if (!_md_split_pair(items[pos], &key, &value) ||
+            !_md_split_key_eq(key, entries[pos].key)) {
+            goto miss;
+        }
+    }
+
+    PyObject **values = PyMem_New(PyObject *, n);
+    if (values == NULL) {
+        PyErr_NoMemory();
+        return -1;
     }
+    md->state = state;
+    md->is_ci = is_ci;
+    md->log2_min_size = 0;
+    md->in_update = false;
+    md->used = n;
+    md->version = NEXT_VERSION(state);
+    keys->refcnt += 1;
+    md->keys = keys;
+    md->values = values;
+    for (Py_ssize_t pos = 0; pos < n; pos++) {
+        (void)_md_split_pair(items[pos], &key, &value);
+        values[pos] = Py_NewRef(value);
+        _md_maintain_tracking(md, entries[pos].key, value);
+    }
+    slot->misses = 0;
+    cache->hits += 1;
     ASSERT_CONSISTENT(md, false);
+    return 1;
+miss:
+    cache->misses += 1;
+    if (keys != NULL && slot->misses < LAYOUT_CACHE_MAX_MISSES) {
+        slot->misses += 1;
+    } else {
+        *pslot = ix;
+    }
     return 0;
 }
 
+/* Make the table of the just built md the layout of the cache slot,
+   md becomes split.  The cache is an optimization, errors are ignored. */
+static inline void
+md_publish_layout(MultiDictObject *md, Py_ssize_t ix)
+{
+    layout_cache_t *cache = &md->state->layout_cache;
+    htkeys_t *keys = md->keys;
+    if (ix < 0 || ix >= cache->size || keys == &empty_htkeys ||
+        _md_is_shared(md) || keys->next != NULL ||
+        md->used != keys->nentries || md->used > MD_SPLIT_MAX_SIZE) {
+        return;
+    }
+    entry_t *entries = htkeys_entries(keys);
+    for (Py_ssize_t pos = 0; pos < md->used; pos++) {
+        PyObject *key = entries[pos].key;
+        if (!PyUnicode_CheckExact(key) &&
+            !(md->is_ci && IStr_CheckExact(md->state, key))) {
+            return;
+        }
+    }
+    // the keys stay as given, iteration of a split table converts them
+    // to istr on the fly (see _md_ensure_key_impl())
+    PyObject **values = PyMem_New(PyObject *, md->used);
+    if (values == NULL) {
+        return;
+    }
+    for (Py_ssize_t pos = 0; pos < md->used; pos++) {
+        values[pos] = entries[pos].value;
+        entries[pos].value = NULL;
+    }
+    md->values = values;
+    keys->refcnt += 1;
+
+    layout_slot_t *slot = &cache->slots[ix];
+    htkeys_t *old = slot->keys;
+    slot->keys = keys;
+    slot->is_ci = md->is_ci;
+    slot->misses = 0;
+    if (old != NULL) {
+        _md_layout_release(md->state, old);
+    }
+    ASSERT_CONSISTENT(md, false);
+}
+
+/* Resize the cache dropping all layouts, 0 disables the cache. */
+static inline void
+layout_cache_set_size(mod_state *state, Py_ssize_t size)
+{
+    layout_cache_t *cache = &state->layout_cache;
+    assert(size >= 0 && size <= LAYOUT_CACHE_SIZE);
+    assert((size & (size - 1)) == 0);
+    cache->size = MD_SHARE_TABLES ? size : 0;
+    for (Py_ssize_t ix = 0; ix < LAYOUT_CACHE_SIZE; ix++) {
+        htkeys_t *keys = cache->slots[ix].keys;
+        cache->slots[ix].keys = NULL;
+        cache->slots[ix].misses = 0;
+        if (keys != NULL) {
+            _md_layout_release(state, keys);
+        }
+    }
+}
+
+static inline Py_ssize_t
+layout_cache_used(mod_state *state)
+{
+    layout_cache_t *cache = &state->layout_cache;
+    Py_ssize_t used = 0;
+    for (Py_ssize_t ix = 0; ix < LAYOUT_CACHE_SIZE; ix++) {
+        if (cache->slots[ix].keys != NULL) {
+            used += 1;
+        }
+    }
+    return used;
+}
+
+static inline void
+layout_cache_init(mod_state *state)
+{
+    layout_cache_t *cache = &state->layout_cache;
+    memset(cache, 0, sizeof(layout_cache_t));
+    cache->size = MD_SHARE_TABLES ? LAYOUT_CACHE_SIZE : 0;
+}
+
+static inline void
+layout_cache_clear(mod_state *state)
+{
+    layout_cache_set_size(state, 0);
+}
+
 #ifndef NDEBUG
 
 static inline int
@@ -1913,7 +3290,8 @@ _md_check_consistency(MultiDictObject *md, bool update)
 
     htkeys_t *keys = md->keys;
     CHECK(keys != NULL);
-    Py_ssize_t calc_usable = USABLE_FRACTION(htkeys_nslots(keys));
+    CHECK(keys->refcnt >= 1);
+    Py_ssize_t calc_usable = htkeys_usable_size(keys->log2_size);
 
     // In the free-threaded build, shared keys may be concurrently modified,
     // so use atomic loads.
@@ -1925,21 +3303,72 @@ _md_check_consistency(MultiDictObject *md, bool update)
     CHECK(0 <= nentries && nentries <= calc_usable);
     CHECK(usable + nentries <= calc_usable);
 
-    for (Py_ssize_t i = 0; i < htkeys_nslots(keys); i++) {
+    entry_t *entries = htkeys_entries(keys);
+    uint8_t *ctrl = htkeys_ctrl(keys);
+    Py_ssize_t nslots = htkeys_is_small(keys) ? 0 : htkeys_nslots(keys);
+    for (Py_ssize_t i = 0; i < nslots; i++) {
         Py_ssize_t ix = htkeys_get_index(keys, i);
         CHECK(DKIX_DUMMY <= ix && ix <= calc_usable);
+        if (ix == DKIX_EMPTY) {
+            CHECK(ctrl[i] == HT_CTRL_EMPTY);
+        } else if (ix == DKIX_DUMMY) {
+            CHECK(ctrl[i] == HT_CTRL_DELETED);
+        } else {
+            CHECK(ctrl[i] < 0x80);
+            CHECK(ctrl[i] == htkeys_tag(htkeys_entry_hash(&entries[ix])));
+        }
+    }
+    if (htkeys_is_small(keys)) {
+        for (Py_ssize_t i = 0; i < HT_GROUP_WIDTH; i++) {
+            if (i >= nentries) {
+                CHECK(ctrl[i] == HT_CTRL_EMPTY);
+            } else if (entries[i].identity == NULL) {
+                CHECK(ctrl[i] == HT_CTRL_DELETED);
+            } else {
+                CHECK(ctrl[i] == htkeys_tag(htkeys_entry_hash(&entries[i])));
+            }
+        }
+    } else {
+        for (Py_ssize_t i = nslots; i < nslots + HT_GROUP_WIDTH; i++) {
+            CHECK(ctrl[i] == ctrl[i & htkeys_mask(keys)]);
+        }
+        // every alive entry belongs to exactly one chain in insertion order
+        Py_ssize_t linked = 0;
+        for (Py_ssize_t i = 0; i < nslots; i++) {
+            Py_ssize_t head = htkeys_get_index(keys, i);
+            if (head < 0) {
+                continue;
+            }
+            CHECK(entries[head].identity != NULL);
+            Py_ssize_t ix = head;
+            do {
+                Py_ssize_t next = htkeys_next_link(keys, ix);
+                CHECK(0 <= next && next < nentries);
+                CHECK(htkeys_prev_link(keys, next) == ix);
+                CHECK(next == head || next > ix);
+                CHECK(_htkeys_str_eq(entries[next].identity,
+                                     entries[head].identity));
+                linked += 1;
+                ix = next;
+            } while (ix != head);
+        }
+        Py_ssize_t alive = 0;
+        for (Py_ssize_t i = 0; i < nentries; i++) {
+            if (entries[i].identity != NULL) {
+                alive += 1;
+            }
+        }
+        CHECK(linked == alive);
     }
 
-    entry_t *entries = htkeys_entries(keys);
     for (Py_ssize_t i = 0; i < calc_usable; i++) {
         entry_t *entry = &entries[i];
         PyObject *identity = entry->identity;
 
         if (identity != NULL) {
             if (!update) {
-                CHECK(entry->hash != -1);
                 CHECK(entry->key != NULL);
-                CHECK(entry->value != NULL);
+                CHECK(_md_entry_value(md, entry) != NULL);
             } else {
                 if (entry->key == NULL) {
                     CHECK(entry->value == NULL);
@@ -1949,12 +3378,35 @@ _md_check_consistency(MultiDictObject *md, bool update)
             }
 
             CHECK(PyUnicode_CheckExact(identity));
-            if (entry->hash != -1) {
-                Py_hash_t hash = _unicode_hash(identity);
-                CHECK(entry->hash == hash);
-            }
+            CHECK(PyUnstable_Unicode_GET_CACHED_HASH(identity) != -1);
+        }
+    }
+
+    if (md->values != NULL) {
+        // every entry of the layout is alive, see md_init_split()
+        CHECK(md->used == nentries && nentries > 0);
+        CHECK(keys->next == NULL);
+        for (Py_ssize_t i = 0; i < nentries; i++) {
+            CHECK(entries[i].identity != NULL);
+            CHECK(entries[i].value == NULL);
+            CHECK(md->values[i] != NULL);
         }
     }
+
+    // the retired table is released before the next resize starts
+    CHECK(keys->retired == NULL || keys->next == NULL);
+    htkeys_t *next = keys->next;
+    if (next != NULL) {
+        // the copied entries are the same, see _md_resize_step()
+        CHECK(next->next == NULL);
+        CHECK(next->log2_size > keys->log2_size);
+        CHECK(next->nentries <= nentries);
+        CHECK(next->usable + next->nentries ==
+              htkeys_usable_size(next->log2_size));
+        CHECK(memcmp(htkeys_entries(next),
+                     entries,
+                     sizeof(entry_t) * (size_t)next->nentries) == 0);
+    }
     return 1;
 
 #undef CHECK
@@ -1970,9 +3422,11 @@ _md_dump(MultiDictObject *md)
            htkeys_nslots(keys),
            keys->usable,
            keys->nentries);
-    for (Py_ssize_t i = 0; i < htkeys_nslots(keys); i++) {
-        Py_ssize_t ix = htkeys_get_index(keys, i);
-        printf("  %zd -> %zd\n", i, ix);
+    if (!htkeys_is_small(keys)) {
+        for (Py_ssize_t i = 0; i < htkeys_nslots(keys); i++) {
+            Py_ssize_t ix = htkeys_get_index(keys, i);
+            printf("  %zd -> %zd\n", i, ix);
+        }
     }
     printf("  --------\n");
     entry_t *entries = htkeys_entries(keys);
@@ -1983,12 +3437,12 @@ _md_dump(MultiDictObject *md)
         if (identity == NULL) {
             printf("  %zd [deleted]\n", i);
         } else {
-            printf("  %zd h=%20zd, i=\'", i, entry->hash);
+            printf("  %zd h=%20zd, i=\'", i, htkeys_entry_hash(entry));
             PyObject_Print(entry->identity, stdout, Py_PRINT_RAW);
             printf("\', k=\'");
             PyObject_Print(entry->key, stdout, Py_PRINT_RAW);
             printf("\', v=\'");
-            PyObject_Print(entry->value, stdout, Py_PRINT_RAW);
+            PyObject_Print(_md_entry_value(md, entry), stdout, Py_PRINT_RAW);
             printf("\'\n");
         }
     }
@@ -0,0 +1,334 @@
+#include "pythoncapi_compat.h"
+
+#ifndef _MULTIDICT_HEADERBLOCK_H
+#define _MULTIDICT_HEADERBLOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <Python.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dict.h"
+#include "hashtable.h"
+#include "headers.h"
+#include "htkeys.h"
+#include "intern.h"
+#include "lower.h"
+#include "state.h"
+
+/* Parser of HTTP/1.x header blocks, see CIMultiDict.from_http_header_block().
+
+   A block is a sequence of "name: value" lines terminated by LF with an
+   optional CR before it.  Parsing stops at the first empty line or at the
+   end of data.  Names are RFC 9110 tokens, values are trimmed of SP and
+   HTAB and must not contain NUL or CR.  A line starting with SP or HTAB
+   is an obsolete line folding: its trimmed content is appended to the
+   previous value with a single SP.
+
+   The block is scanned twice.  The first pass finds the end of the block
+   and counts headers to pre-size the table, the second one splits the
+   lines and inserts items.  hb_find() looks for line terminators and
+   colons 16 bytes per step with SSE2 or NEON (see lower.h).
+
+   Names of the well-known headers are resolved to the shared identities
+   by the perfect hash table straight from the buffer, a name written in
+   lower case is stored as the identity itself.
+*/
+
+// RFC 9110 tchar bitmap for 0-127
+static const uint64_t hb_tchar_bits[2] = {
+    UINT64_C(0x03FF6CFA00000000),
+    UINT64_C(0x57FFFFFFC7FFFFFE),
+};
+
+static inline bool
+_hb_is_token(const uint8_t *data, Py_ssize_t len)
+{
+    if (len == 0) {
+        return false;
+    }
+    for (Py_ssize_t i = 0; i < len; i++) {
+        uint8_t ch = data[i];
+        if (ch >= 128 || !((hb_tchar_bits[ch >> 6] >> (ch & 63)) & 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline bool
+_hb_is_ws(uint8_t ch)
+{
+    return ch == ' ' || ch == '\t';
+}
+
+/* Return the offset of the first byte equal to a, b or c in
+   data[start:len], or len if there is none. */
+static inline Py_ssize_t
+hb_find(const uint8_t *data, Py_ssize_t start, Py_ssize_t len, uint8_t a,
+        uint8_t b, uint8_t c)
+{
+    Py_ssize_t i = start;
+#if defined(LOWER_SSE2)
+    const __m128i va = _mm_set1_epi8((char)a);
+    const __m128i vb = _mm_set1_epi8((char)b);
+    const __m128i vc = _mm_set1_epi8((char)c);
+    for (; i + LOWER_STEP <= len; i += LOWER_STEP) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i match = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)),
+            _mm_cmpeq_epi8(v, vc));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(match);
+        if (mask != 0) {
+            return i + _ht_ctz(mask);
+        }
+    }
+#elif defined(LOWER_NEON)
+    const uint8x16_t va = vdupq_n_u8(a);
+    const uint8x16_t vb = vdupq_n_u8(b);
+    const uint8x16_t vc = vdupq_n_u8(c);
+    for (; i + LOWER_STEP <= len; i += LOWER_STEP) {
+        uint8x16_t v = vld1q_u8(data + i);
+        uint8x16_t match = vorrq_u8(vorrq_u8(vceqq_u8(v, va), vceqq_u8(v, vb)),
+                                    vceqq_u8(v, vc));
+        // vshrn() based movemask emulation produces 4 bits per byte
+        uint8x8_t res = vshrn_n_u16(vreinterpretq_u16_u8(match), 4);
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(res), 0);
+        if (mask != 0) {
+            return i + (_ht_ctz(mask) >> 2);
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        uint8_t ch = data[i];
+        if (ch == a || ch == b || ch == c) {
+            return i;
+        }
+    }
+    return len;
+}
+
+static inline int
+_hb_error(const char *msg, Py_ssize_t offset)
+{
+    PyErr_Format(PyExc_ValueError, "%s at offset %zd", msg, offset);
+    return -1;
+}
+
+/* Return true if the line at pos is empty: LF, CR LF or CR at the end */
+static inline bool
+_hb_is_empty_line(const uint8_t *data, Py_ssize_t pos, Py_ssize_t len)
+{
+    return data[pos] == '\n' ||
+           (data[pos] == '\r' && (pos + 1 == len || data[pos + 1] == '\n'));
+}
+
+/* Find the end of the line content started at pos.
+
+   Store the offset of the line terminator into *eol, return the offset
+   of the next line or -1 with ValueError for NUL or a bare CR. */
+static inline Py_ssize_t
+_hb_line_end(const uint8_t *data, Py_ssize_t pos, Py_ssize_t len,
+             Py_ssize_t *eol)
+{
+    Py_ssize_t i = hb_find(data, pos, len, '\n', '\r', '\0');
+    if (i == len) {
+        *eol = len;
+        return len;
+    }
+    if (data[i] == '\n') {
+        *eol = i;
+        return i + 1;
+    }
+    if (data[i] == '\r') {
+        if (i + 1 == len) {
+            *eol = i;
+            return len;
+        }
+        if (data[i + 1] == '\n') {
+            *eol = i;
+            return i + 2;
+        }
+        return _hb_error("Invalid CR in header value", i);
+    }
+    return _hb_error("Invalid NUL in header value", i);
+}
+
+/* Return the length of data up to the empty line ending the block and
+   store the number of headers into *count, -1 on error. */
+static inline Py_ssize_t
+hb_measure(const uint8_t *data, Py_ssize_t len, Py_ssize_t *count)
+{
+    Py_ssize_t pos = 0;
+    Py_ssize_t n = 0;
+    while (pos < len && !_hb_is_empty_line(data, pos, len)) {
+        if (!_hb_is_ws(data[pos])) {
+            n++;
+        }
+        pos = hb_find(data, pos, len, '\n', '\n', '\n');
+        if (pos < len) {
+            pos++;
+        }
+    }
+    *count = n;
+    return pos;
+}
+
+static inline void
+_hb_trim(const uint8_t *data, Py_ssize_t *start, Py_ssize_t *end)
+{
+    while (*start < *end && _hb_is_ws(data[*start])) {
+        (*start)++;
+    }
+    while (*end > *start && _hb_is_ws(data[*end - 1])) {
+        (*end)--;
+    }
+}
+
+static inline PyObject *
+_hb_decode(const uint8_t *data, Py_ssize_t len, bool latin1)
+{
+    if (latin1) {
+        return PyUnicode_DecodeLatin1((const char *)data, len, NULL);
+    }
+    return PyUnicode_DecodeUTF8((const char *)data, len, "surrogateescape");
+}
+
+/* Return a new reference to the key str and store a new reference to its
+   identity into *pidentity. */
+static inline PyObject *
+_hb_name(mod_state *state, const uint8_t *data, Py_ssize_t len,
+         PyObject **pidentity)
+{
+    int id = headers_find(data, len);
+    if (id >= 0) {
+        PyObject *identity = state->header_identities[id];
+        if (bytes_eq(data, PyUnicode_1BYTE_DATA(identity), (size_t)len)) {
+            *pidentity = Py_NewRef(identity);
+            return Py_NewRef(identity);
+        }
+    }
+    PyObject *key = PyUnicode_New(len, 127);
+    if (key == NULL) {
+        return NULL;
+    }
+    memcpy(PyUnicode_1BYTE_DATA(key), data, (size_t)len);
+    if (id >= 0) {
+        *pidentity = Py_NewRef(state->header_identities[id]);
+    } else {
+        *pidentity = intern_ci_identity(state, key);
+        if (*pidentity == NULL) {
+            Py_DECREF(key);
+            return NULL;
+        }
+    }
+    return key;
+}
+
+/* Return the value of the header at data[start:end] followed by
+   obsolete line foldings starting at *pos, advance *pos past them. */
+static inline PyObject *
+_hb_value(const uint8_t *data, Py_ssize_t len, Py_ssize_t start,
+          Py_ssize_t end, Py_ssize_t *pos, bool latin1)
+{
+    _hb_trim(data, &start, &end);
+    if (*pos >= len || !_hb_is_ws(data[*pos])) {
+        return _hb_decode(data + start, end - start, latin1);
+    }
+
+    // obs-fold, the joined value is never longer than the folded lines
+    uint8_t *buf = PyMem_Malloc((size_t)(len - start));
+    if (buf == NULL) {
+        return PyErr_NoMemory();
+    }
+    Py_ssize_t size = end - start;
+    memcpy(buf, data + start, (size_t)size);
+    while (*pos < len && _hb_is_ws(data[*pos])) {
+        Py_ssize_t eol;
+        Py_ssize_t next = _hb_line_end(data, *pos, len, &eol);
+        if (next < 0) {
+            PyMem_Free(buf);
+            return NULL;
+        }
+        Py_ssize_t piece = *pos;
+        _hb_trim(data, &piece, &eol);
+        if (eol > piece) {
+            if (size > 0) {
+                buf[size++] = ' ';
+            }
+            memcpy(buf + size, data + piece, (size_t)(eol - piece));
+            size += eol - piece;
+        }
+        *pos = next;
+    }
+    PyObject *ret = _hb_decode(buf, size, latin1);
+    PyMem_Free(buf);
+    return ret;
+}
+
+/* Add headers of the block data[0:len] to the case-insensitive md */
+static inline int
+md_extend_from_header_block(MultiDictObject *md, const uint8_t *data,
+                            Py_ssize_t len, bool latin1)
+{
+    assert(md->is_ci);
+    mod_state *state = md->state;
+    PyObject *identity = NULL;
+    PyObject *key = NULL;
+    PyObject *value = NULL;
+    Py_ssize_t pos = 0;
+
+    if (len > 0 && _hb_is_ws(data[0])) {
+        return _hb_error("Unexpected line folding", 0);
+    }
+    while (pos < len) {
+        Py_ssize_t colon = hb_find(data, pos, len, ':', '\n', '\n');
+        if (colon == len || data[colon] != ':') {
+            return _hb_error("Missing colon in header line", pos);
+        }
+        if (!_hb_is_token(data + pos, colon - pos)) {
+            return _hb_error("Invalid header name", pos);
+        }
+        Py_ssize_t eol;
+        Py_ssize_t next = _hb_line_end(data, colon + 1, len, &eol);
+        if (next < 0) {
+            goto fail;
+        }
+        key = _hb_name(state, data + pos, colon - pos, &identity);
+        if (key == NULL) {
+            goto fail;
+        }
+        pos = next;
+        value = _hb_value(data, len, colon + 1, eol, &pos, latin1);
+        if (value == NULL) {
+            goto fail;
+        }
+        Py_hash_t hash = _unicode_hash(identity);
+        if (hash == -1) {
+            goto fail;
+        }
+        if (_md_add_with_hash_steal_refs(md, hash, identity, key, value) <
+            0) {
+            goto fail;
+        }
+        identity = NULL;
+        key = NULL;
+        value = NULL;
+    }
+    ASSERT_CONSISTENT(md, false);
+    return 0;
+fail:
+    Py_XDECREF(identity);
+    Py_XDECREF(key);
+    Py_XDECREF(value);
+    return -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,687 @@
+/* Generated by tools/gen_headers.py, do not edit. */
+
+#ifndef _MULTIDICT_HEADERS_H
+#define _MULTIDICT_HEADERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <Python.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Well-known HTTP header names.
+
+   The first and the last 8 bytes of a lowered name are read as two
+   little-endian words, a perfect hash of the words and the length
+   selects the only candidate header ID.  headers_find() in intern.h
+   compares the words and the middle part of longer names with the
+   candidate.  The module state keeps the shared identity of every
+   header.
+*/
+
+typedef enum {
+    HDR_ACCEPT = 0,
+    HDR_ACCEPT_CHARSET = 1,
+    HDR_ACCEPT_ENCODING = 2,
+    HDR_ACCEPT_LANGUAGE = 3,
+    HDR_ACCEPT_PATCH = 4,
+    HDR_ACCEPT_RANGES = 5,
+    HDR_ACCESS_CONTROL_ALLOW_CREDENTIALS = 6,
+    HDR_ACCESS_CONTROL_ALLOW_HEADERS = 7,
+    HDR_ACCESS_CONTROL_ALLOW_METHODS = 8,
+    HDR_ACCESS_CONTROL_ALLOW_ORIGIN = 9,
+    HDR_ACCESS_CONTROL_EXPOSE_HEADERS = 10,
+    HDR_ACCESS_CONTROL_MAX_AGE = 11,
+    HDR_ACCESS_CONTROL_REQUEST_HEADERS = 12,
+    HDR_ACCESS_CONTROL_REQUEST_METHOD = 13,
+    HDR_AGE = 14,
+    HDR_ALLOW = 15,
+    HDR_ALT_SVC = 16,
+    HDR_AUTHORIZATION = 17,
+    HDR_CACHE_CONTROL = 18,
+    HDR_CLEAR_SITE_DATA = 19,
+    HDR_CONNECTION = 20,
+    HDR_CONTENT_DISPOSITION = 21,
+    HDR_CONTENT_ENCODING = 22,
+    HDR_CONTENT_LANGUAGE = 23,
+    HDR_CONTENT_LENGTH = 24,
+    HDR_CONTENT_LOCATION = 25,
+    HDR_CONTENT_MD5 = 26,
+    HDR_CONTENT_RANGE = 27,
+    HDR_CONTENT_SECURITY_POLICY = 28,
+    HDR_CONTENT_SECURITY_POLICY_REPORT_ONLY = 29,
+    HDR_CONTENT_TRANSFER_ENCODING = 30,
+    HDR_CONTENT_TYPE = 31,
+    HDR_COOKIE = 32,
+    HDR_CROSS_ORIGIN_EMBEDDER_POLICY = 33,
+    HDR_CROSS_ORIGIN_OPENER_POLICY = 34,
+    HDR_CROSS_ORIGIN_RESOURCE_POLICY = 35,
+    HDR_DATE = 36,
+    HDR_DESTINATION = 37,
+    HDR_DIGEST = 38,
+    HDR_DNT = 39,
+    HDR_EARLY_DATA = 40,
+    HDR_ETAG = 41,
+    HDR_EXPECT = 42,
+    HDR_EXPIRES = 43,
+    HDR_FORWARDED = 44,
+    HDR_FROM = 45,
+    HDR_HOST = 46,
+    HDR_IF_MATCH = 47,
+    HDR_IF_MODIFIED_SINCE = 48,
+    HDR_IF_NONE_MATCH = 49,
+    HDR_IF_RANGE = 50,
+    HDR_IF_UNMODIFIED_SINCE = 51,
+    HDR_KEEP_ALIVE = 52,
+    HDR_LAST_EVENT_ID = 53,
+    HDR_LAST_MODIFIED = 54,
+    HDR_LINK = 55,
+    HDR_LOCATION = 56,
+    HDR_MAX_FORWARDS = 57,
+    HDR_ORIGIN = 58,
+    HDR_PERMISSIONS_POLICY = 59,
+    HDR_PRAGMA = 60,
+    HDR_PRIORITY = 61,
+    HDR_PROXY_AUTHENTICATE = 62,
+    HDR_PROXY_AUTHORIZATION = 63,
+    HDR_PROXY_CONNECTION = 64,
+    HDR_RANGE = 65,
+    HDR_REFERER = 66,
+    HDR_REFERRER_POLICY = 67,
+    HDR_RETRY_AFTER = 68,
+    HDR_SEC_CH_UA = 69,
+    HDR_SEC_CH_UA_MOBILE = 70,
+    HDR_SEC_CH_UA_PLATFORM = 71,
+    HDR_SEC_FETCH_DEST = 72,
+    HDR_SEC_FETCH_MODE = 73,
+    HDR_SEC_FETCH_SITE = 74,
+    HDR_SEC_FETCH_USER = 75,
+    HDR_SEC_WEBSOCKET_ACCEPT = 76,
+    HDR_SEC_WEBSOCKET_EXTENSIONS = 77,
+    HDR_SEC_WEBSOCKET_KEY = 78,
+    HDR_SEC_WEBSOCKET_KEY1 = 79,
+    HDR_SEC_WEBSOCKET_PROTOCOL = 80,
+    HDR_SEC_WEBSOCKET_VERSION = 81,
+    HDR_SERVER = 82,
+    HDR_SERVER_TIMING = 83,
+    HDR_SET_COOKIE = 84,
+    HDR_STRICT_TRANSPORT_SECURITY = 85,
+    HDR_TE = 86,
+    HDR_TIMING_ALLOW_ORIGIN = 87,
+    HDR_TRAILER = 88,
+    HDR_TRANSFER_ENCODING = 89,
+    HDR_UPGRADE = 90,
+    HDR_UPGRADE_INSECURE_REQUESTS = 91,
+    HDR_URI = 92,
+    HDR_USER_AGENT = 93,
+    HDR_VARY = 94,
+    HDR_VIA = 95,
+    HDR_WANT_DIGEST = 96,
+    HDR_WARNING = 97,
+    HDR_WWW_AUTHENTICATE = 98,
+    HDR_X_CONTENT_TYPE_OPTIONS = 99,
+    HDR_X_FORWARDED_FOR = 100,
+    HDR_X_FORWARDED_HOST = 101,
+    HDR_X_FORWARDED_PROTO = 102,
+    HDR_X_FRAME_OPTIONS = 103,
+    HDR_X_REAL_IP = 104,
+    HDR_X_REQUEST_ID = 105,
+    HDR_X_REQUESTED_WITH = 106,
+    HDR_X_XSS_PROTECTION = 107,
+} header_id_t;
+
+#define HEADERS_COUNT 108
+#define HEADERS_MAX_LENGTH 35
+#define HEADERS_TABLE_BITS 10
+#define HEADERS_MULT0 0x1BD094486A2B3201ULL
+#define HEADERS_MULT1 0x8F928DC519724CE3ULL
+#define HEADERS_MULT2 0x7B2E1B82E89DC815ULL
+
+typedef struct {
+    const char *name;
+    uint64_t head;
+    uint64_t tail;
+    Py_ssize_t len;
+} header_name_t;
+
+// lowered names, the identities of the headers
+static const header_name_t headers_names[HEADERS_COUNT] = {
+    {"accept",
+     0x0000747065636361ULL,
+     0x0000747065636361ULL,
+     6},
+    {"accept-charset",
+     0x632D747065636361ULL,
+     0x746573726168632DULL,
+     14},
+    {"accept-encoding",
+     0x652D747065636361ULL,
+     0x676E69646F636E65ULL,
+     15},
+    {"accept-language",
+     0x6C2D747065636361ULL,
+     0x65676175676E616CULL,
+     15},
+    {"accept-patch",
+     0x702D747065636361ULL,
+     0x68637461702D7470ULL,
+     12},
+    {"accept-ranges",
+     0x722D747065636361ULL,
+     0x7365676E61722D74ULL,
+     13},
+    {"access-control-allow-credentials",
+     0x632D737365636361ULL,
+     0x736C6169746E6564ULL,
+     32},
+    {"access-control-allow-headers",
+     0x632D737365636361ULL,
+     0x737265646165682DULL,
+     28},
+    {"access-control-allow-methods",
+     0x632D737365636361ULL,
+     0x73646F6874656D2DULL,
+     28},
+    {"access-control-allow-origin",
+     0x632D737365636361ULL,
+     0x6E696769726F2D77ULL,
+     27},
+    {"access-control-expose-headers",
+     0x632D737365636361ULL,
+     0x737265646165682DULL,
+     29},
+    {"access-control-max-age",
+     0x632D737365636361ULL,
+     0x6567612D78616D2DULL,
+     22},
+    {"access-control-request-headers",
+     0x632D737365636361ULL,
+     0x737265646165682DULL,
+     30},
+    {"access-control-request-method",
+     0x632D737365636361ULL,
+     0x646F6874656D2D74ULL,
+     29},
+    {"age",
+     0x0000000000656761ULL,
+     0x0000000000656761ULL,
+     3},
+    {"allow",
+     0x000000776F6C6C61ULL,
+     0x000000776F6C6C61ULL,
+     5},
+    {"alt-svc",
+     0x006376732D746C61ULL,
+     0x006376732D746C61ULL,
+     7},
+    {"authorization",
+     0x7A69726F68747561ULL,
+     0x6E6F6974617A6972ULL,
+     13},
+    {"cache-control",
+     0x6F632D6568636163ULL,
+     0x6C6F72746E6F632DULL,
+     13},
+    {"clear-site-data",
+     0x69732D7261656C63ULL,
+     0x617461642D657469ULL,
+     15},
+    {"connection",
+     0x697463656E6E6F63ULL,
+     0x6E6F697463656E6EULL,
+     10},
+    {"content-disposition",
+     0x2D746E65746E6F63ULL,
+     0x6E6F697469736F70ULL,
+     19},
+    {"content-encoding",
+     0x2D746E65746E6F63ULL,
+     0x676E69646F636E65ULL,
+     16},
+    {"content-language",
+     0x2D746E65746E6F63ULL,
+     0x65676175676E616CULL,
+     16},
+    {"content-length",
+     0x2D746E65746E6F63ULL,
+     0x6874676E656C2D74ULL,
+     14},
+    {"content-location",
+     0x2D746E65746E6F63ULL,
+     0x6E6F697461636F6CULL,
+     16},
+    {"content-md5",
+     0x2D746E65746E6F63ULL,
+     0x35646D2D746E6574ULL,
+     11},
+    {"content-range",
+     0x2D746E65746E6F63ULL,
+     0x65676E61722D746EULL,
+     13},
+    {"content-security-policy",
+     0x2D746E65746E6F63ULL,
+     0x7963696C6F702D79ULL,
+     23},
+    {"content-security-policy-report-only",
+     0x2D746E65746E6F63ULL,
+     0x796C6E6F2D74726FULL,
+     35},
+    {"content-transfer-encoding",
+     0x2D746E65746E6F63ULL,
+     0x676E69646F636E65ULL,
+     25},
+    {"content-type",
+     0x2D746E65746E6F63ULL,
+     0x657079742D746E65ULL,
+     12},
+    {"cookie",
+     0x000065696B6F6F63ULL,
+     0x000065696B6F6F63ULL,
+     6},
+    {"cross-origin-embedder-policy",
+     0x726F2D73736F7263ULL,
+     0x7963696C6F702D72ULL,
+     28},
+    {"cross-origin-opener-policy",
+     0x726F2D73736F7263ULL,
+     0x7963696C6F702D72ULL,
+     26},
+    {"cross-origin-resource-policy",
+     0x726F2D73736F7263ULL,
+     0x7963696C6F702D65ULL,
+     28},
+    {"date",
+     0x0000000065746164ULL,
+     0x0000000065746164ULL,
+     4},
+    {"destination",
+     0x74616E6974736564ULL,
+     0x6E6F6974616E6974ULL,
+     11},
+    {"digest",
+     0x0000747365676964ULL,
+     0x0000747365676964ULL,
+     6},
+    {"dnt",
+     0x0000000000746E64ULL,
+     0x0000000000746E64ULL,
+     3},
+    {"early-data",
+     0x61642D796C726165ULL,
+     0x617461642D796C72ULL,
+     10},
+    {"etag",
+     0x0000000067617465ULL,
+     0x0000000067617465ULL,
+     4},
+    {"expect",
+     0x0000746365707865ULL,
+     0x0000746365707865ULL,
+     6},
+    {"expires",
+     0x0073657269707865ULL,
+     0x0073657269707865ULL,
+     7},
+    {"forwarded",
+     0x6564726177726F66ULL,
+     0x646564726177726FULL,
+     9},
+    {"from",
+     0x000000006D6F7266ULL,
+     0x000000006D6F7266ULL,
+     4},
+    {"host",
+     0x0000000074736F68ULL,
+     0x0000000074736F68ULL,
+     4},
+    {"if-match",
+     0x686374616D2D6669ULL,
+     0x686374616D2D6669ULL,
+     8},
+    {"if-modified-since",
+     0x6669646F6D2D6669ULL,
+     0x65636E69732D6465ULL,
+     17},
+    {"if-none-match",
+     0x2D656E6F6E2D6669ULL,
+     0x686374616D2D656EULL,
+     13},
+    {"if-range",
+     0x65676E61722D6669ULL,
+     0x65676E61722D6669ULL,
+     8},
+    {"if-unmodified-since",
+     0x646F6D6E752D6669ULL,
+     0x65636E69732D6465ULL,
+     19},
+    {"keep-alive",
+     0x696C612D7065656BULL,
+     0x6576696C612D7065ULL,
+     10},
+    {"last-event-id",
+     0x6576652D7473616CULL,
+     0x64692D746E657665ULL,
+     13},
+    {"last-modified",
+     0x646F6D2D7473616CULL,
+     0x6465696669646F6DULL,
+     13},
+    {"link",
+     0x000000006B6E696CULL,
+     0x000000006B6E696CULL,
+     4},
+    {"location",
+     0x6E6F697461636F6CULL,
+     0x6E6F697461636F6CULL,
+     8},
+    {"max-forwards",
+     0x77726F662D78616DULL,
+     0x7364726177726F66ULL,
+     12},
+    {"origin",
+     0x00006E696769726FULL,
+     0x00006E696769726FULL,
+     6},
+    {"permissions-policy",
+     0x697373696D726570ULL,
+     0x7963696C6F702D73ULL,
+     18},
+    {"pragma",
+     0x0000616D67617270ULL,
+     0x0000616D67617270ULL,
+     6},
+    {"priority",
+     0x797469726F697270ULL,
+     0x797469726F697270ULL,
+     8},
+    {"proxy-authenticate",
+     0x75612D79786F7270ULL,
+     0x6574616369746E65ULL,
+     18},
+    {"proxy-authorization",
+     0x75612D79786F7270ULL,
+     0x6E6F6974617A6972ULL,
+     19},
+    {"proxy-connection",
+     0x6F632D79786F7270ULL,
+     0x6E6F697463656E6EULL,
+     16},
+    {"range",
+     0x00000065676E6172ULL,
+     0x00000065676E6172ULL,
+     5},
+    {"referer",
+     0x0072657265666572ULL,
+     0x0072657265666572ULL,
+     7},
+    {"referrer-policy",
+     0x7265727265666572ULL,
+     0x7963696C6F702D72ULL,
+     15},
+    {"retry-after",
+     0x66612D7972746572ULL,
+     0x72657466612D7972ULL,
+     11},
+    {"sec-ch-ua",
+     0x752D68632D636573ULL,
+     0x61752D68632D6365ULL,
+     9},
+    {"sec-ch-ua-mobile",
+     0x752D68632D636573ULL,
+     0x656C69626F6D2D61ULL,
+     16},
+    {"sec-ch-ua-platform",
+     0x752D68632D636573ULL,
+     0x6D726F6674616C70ULL,
+     18},
+    {"sec-fetch-dest",
+     0x637465662D636573ULL,
+     0x747365642D686374ULL,
+     14},
+    {"sec-fetch-mode",
+     0x637465662D636573ULL,
+     0x65646F6D2D686374ULL,
+     14},
+    {"sec-fetch-site",
+     0x637465662D636573ULL,
+     0x657469732D686374ULL,
+     14},
+    {"sec-fetch-user",
+     0x637465662D636573ULL,
+     0x726573752D686374ULL,
+     14},
+    {"sec-websocket-accept",
+     0x736265772D636573ULL,
+     0x7470656363612D74ULL,
+     20},
+    {"sec-websocket-extensions",
+     0x736265772D636573ULL,
+     0x736E6F69736E6574ULL,
+     24},
+    {"sec-websocket-key",
+     0x736265772D636573ULL,
+     0x79656B2D74656B63ULL,
+     17},
+    {"sec-websocket-key1",
+     0x736265772D636573ULL,
+     0x3179656B2D74656BULL,
+     18},
+    {"sec-websocket-protocol",
+     0x736265772D636573ULL,
+     0x6C6F636F746F7270ULL,
+     22},
+    {"sec-websocket-version",
+     0x736265772D636573ULL,
+     0x6E6F69737265762DULL,
+     21},
+    {"server",
+     0x0000726576726573ULL,
+     0x0000726576726573ULL,
+     6},
+    {"server-timing",
+     0x742D726576726573ULL,
+     0x676E696D69742D72ULL,
+     13},
+    {"set-cookie",
+     0x6B6F6F632D746573ULL,
+     0x65696B6F6F632D74ULL,
+     10},
+    {"strict-transport-security",
+     0x742D746369727473ULL,
+     0x7974697275636573ULL,
+     25},
+    {"te",
+     0x0000000000006574ULL,
+     0x0000000000006574ULL,
+     2},
+    {"timing-allow-origin",
+     0x612D676E696D6974ULL,
+     0x6E696769726F2D77ULL,
+     19},
+    {"trailer",
+     0x0072656C69617274ULL,
+     0x0072656C69617274ULL,
+     7},
+    {"transfer-encoding",
+     0x726566736E617274ULL,
+     0x676E69646F636E65ULL,
+     17},
+    {"upgrade",
+     0x0065646172677075ULL,
+     0x0065646172677075ULL,
+     7},
+    {"upgrade-insecure-requests",
+     0x2D65646172677075ULL,
+     0x7374736575716572ULL,
+     25},
+    {"uri",
+     0x0000000000697275ULL,
+     0x0000000000697275ULL,
+     3},
+    {"user-agent",
+     0x6567612D72657375ULL,
+     0x746E6567612D7265ULL,
+     10},
+    {"vary",
+     0x0000000079726176ULL,
+     0x0000000079726176ULL,
+     4},
+    {"via",
+     0x0000000000616976ULL,
+     0x0000000000616976ULL,
+     3},
+    {"want-digest",
+     0x6769642D746E6177ULL,
+     0x7473656769642D74ULL,
+     11},
+    {"warning",
+     0x00676E696E726177ULL,
+     0x00676E696E726177ULL,
+     7},
+    {"www-authenticate",
+     0x687475612D777777ULL,
+     0x6574616369746E65ULL,
+     16},
+    {"x-content-type-options",
+     0x6E65746E6F632D78ULL,
+     0x736E6F6974706F2DULL,
+     22},
+    {"x-forwarded-for",
+     0x726177726F662D78ULL,
+     0x726F662D64656472ULL,
+     15},
+    {"x-forwarded-host",
+     0x726177726F662D78ULL,
+     0x74736F682D646564ULL,
+     16},
+    {"x-forwarded-proto",
+     0x726177726F662D78ULL,
+     0x6F746F72702D6465ULL,
+     17},
+    {"x-frame-options",
+     0x2D656D6172662D78ULL,
+     0x736E6F6974706F2DULL,
+     15},
+    {"x-real-ip",
+     0x692D6C6165722D78ULL,
+     0x70692D6C6165722DULL,
+     9},
+    {"x-request-id",
+     0x7365757165722D78ULL,
+     0x64692D7473657571ULL,
+     12},
+    {"x-requested-with",
+     0x7365757165722D78ULL,
+     0x687469772D646574ULL,
+     16},
+    {"x-xss-protection",
+     0x72702D7373782D78ULL,
+     0x6E6F69746365746FULL,
+     16},
+};
+
+// header ID + 1 by the perfect hash, 0 for unused slots
+static const uint8_t headers_table[1 << HEADERS_TABLE_BITS] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 78, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 22, 0, 0, 0, 0, 86, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 41, 27, 0, 0, 0, 0, 0, 0, 0, 107,
+    0, 0, 0, 0, 31, 0, 0, 36, 84, 0, 0, 0, 79, 0, 0, 0,
+    0, 0, 0, 0, 0, 58, 0, 0, 0, 0, 0, 0, 19, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 47, 0, 0, 0,
+    0, 0, 0, 0, 0, 93, 0, 0, 0, 0, 0, 0, 0, 0, 99, 67,
+    0, 0, 0, 46, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 49, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 75, 0, 0, 61, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 88, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 42,
+    0, 0, 0, 0, 0, 0, 11, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 39, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 100, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 28, 0, 0, 0, 0, 0, 0, 0, 34, 0,
+    0, 0, 0, 0, 0, 80, 0, 0, 0, 0, 0, 0, 0, 0, 7, 0,
+    0, 0, 0, 0, 0, 38, 0, 0, 0, 101, 56, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
+    0, 0, 0, 5, 0, 0, 0, 85, 0, 0, 0, 0, 26, 0, 0, 0,
+    0, 0, 0, 0, 72, 0, 0, 0, 0, 0, 69, 0, 0, 0, 0, 0,
+    97, 0, 0, 0, 0, 0, 59, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 102, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    44, 0, 0, 0, 0, 0, 0, 18, 105, 0, 0, 0, 0, 0, 0, 0,
+    0, 82, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 24,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 74, 0, 77, 0, 0, 0,
+    0, 106, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 92, 21, 0, 0,
+    81, 0, 0, 0, 0, 0, 0, 14, 0, 0, 0, 0, 0, 0, 0, 65,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 32,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 83, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 30, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 40, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 53,
+    98, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 20, 0, 0, 0, 0, 0, 10, 0, 0,
+    0, 23, 0, 0, 0, 0, 0, 0, 0, 104, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 0, 4, 48, 29,
+    35, 0, 0, 0, 0, 0, 54, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 62, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 94, 0, 51, 0, 0, 0, 0, 0, 0, 0, 6,
+    0, 0, 0, 0, 0, 0, 0, 0, 91, 0, 0, 0, 0, 0, 0, 0,
+    0, 33, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 15, 0,
+    17, 0, 0, 0, 0, 0, 50, 0, 0, 0, 0, 0, 0, 0, 0, 64,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 9, 0, 0, 0, 0, 0,
+    0, 0, 0, 89, 0, 0, 57, 0, 0, 0, 0, 0, 0, 0, 52, 0,
+    0, 0, 0, 0, 0, 0, 37, 0, 0, 0, 0, 45, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 76, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 68, 0, 0, 0, 0, 0, 0, 16, 0, 0, 25,
+    0, 73, 0, 90, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 70, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 60, 0, 0, 0, 0, 63, 0,
+    43, 95, 0, 0, 0, 0, 0, 108, 0, 0, 0, 0, 87, 0, 103, 12,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 66, 0, 0, 0, 0, 0, 0, 0, 0, 0, 55, 0,
+    2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 96, 0, 0, 0, 0, 0,
+};
+
+/* Return the little-endian word of n <= 8 bytes of ASCII data
+   with 'A'-'Z' replaced by 'a'-'z' */
+static inline uint64_t
+headers_lower_word(const Py_UCS1 *data, Py_ssize_t n)
+{
+    uint64_t word = 0;
+#if PY_LITTLE_ENDIAN
+    if (n == 8) {
+        memcpy(&word, data, 8);
+    } else
+#endif
+    {
+        for (Py_ssize_t i = 0; i < n; i++) {
+            word |= (uint64_t)data[i] << (8 * i);
+        }
+    }
+    // ASCII bytes are below 0x80, the sums don't carry into the next byte
+    const uint64_t high = 0x8080808080808080ULL;
+    uint64_t ge_a = word + 0x3F3F3F3F3F3F3F3FULL;  // 0x80 - 'A'
+    uint64_t gt_z = word + 0x2525252525252525ULL;  // 0x7F - 'Z'
+    return word | ((ge_a & ~gt_z & high) >> 2);
+}
+
+static inline int
+headers_candidate(uint64_t head, uint64_t tail, Py_ssize_t len)
+{
+    uint64_t h = (head * HEADERS_MULT0) ^ (tail * HEADERS_MULT1) ^
+                 ((uint64_t)len * HEADERS_MULT2);
+    return (int)headers_table[h >> (64 - HEADERS_TABLE_BITS)] - 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
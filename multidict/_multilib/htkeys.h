@@ -10,6 +10,25 @@ extern "C" {
 #include <Python.h>
 #include <stdbool.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HT_CTRL_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define HT_CTRL_NEON 1
+#endif
+
+#if defined(HAVE_MADVISE) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#ifdef MADV_DONTNEED
+#define HT_RELEASE_MADVISE 1
+#endif
+#endif
+
+#include "lower.h"
+#include "state.h"
+
 /* Implementation note.
 identity always has exact PyUnicode_Type type, not a subclass.
 It guarantees that identity hashing and comparison never calls
@@ -20,10 +39,14 @@ Taking into account the fact that all multidict operations except
 repr(md), repr(md_proxy), or repr(view) never access to the key
 itself but identity instead, borrowed references during iteration
 over pair_list for, e.g., md.get() or md.pop() is safe.
+
+Entries don't store the hash, like CPython dicts of str keys: the hash
+of the identity is cached by the str object and the control byte tag
+(see below) filters out the most of mismatching entries before
+the identity is touched.  An entry is 3 pointers.
 */
 
 typedef struct entry {
-    Py_hash_t hash;
     PyObject *identity;
     PyObject *key;
     PyObject *value;
@@ -34,7 +57,18 @@ typedef struct entry {
 
 #define HT_LOG_MINSIZE 3
 #define HT_MINSIZE 8
-#define HT_PERTURB_SHIFT 5
+
+/* Small tables.
+
+   The smallest table (log2_size == HT_LOG_MINSIZE) has no indices, it
+   holds up to HT_SMALL_SIZE entries and a single group of control bytes
+   where the slot number is the entry position.  Lookup is a linear scan
+   of the entry tags in the insertion order.  The table switches to the
+   indexed layout on resize, entries are copied in the same order.
+
+   empty_htkeys is small as well.
+*/
+#define HT_SMALL_SIZE 8
 
 typedef struct _htkeys {
     /* Size of the hash table (indices). It must be a power of 2. */
@@ -43,12 +77,34 @@ typedef struct _htkeys {
     /* Size of the hash table (indices) by bytes. */
     uint8_t log2_index_bytes;
 
+    /* Number of HT_CLEAR_BLOCK byte blocks of the index, the control
+       bytes and the entries initialized by htkeys_clear_step(),
+       UINT32_MAX for a table initialized at once.  For a retired table
+       the number of HT_RELEASE_BLOCK byte blocks released. */
+    uint32_t cleared;
+
     /* Number of usable entries in dk_entries. */
     Py_ssize_t usable;
 
     /* Number of used entries in dk_entries. */
     Py_ssize_t nentries;
 
+    /* The table being filled by an incremental resize (see hashtable.h),
+       NULL otherwise.  It holds borrowed copies of the first
+       next->nentries entries and is freed together with this table. */
+    struct _htkeys *next;
+
+    /* The table replaced by an incremental resize while its memory is
+       returned to the system by htkeys_release_step(), NULL otherwise.
+       It holds no references and is freed together with this table. */
+    struct _htkeys *retired;
+
+    /* Number of multidicts using the table, more than 1 for a table shared
+       by copy() (see hashtable.h).  The entries hold one reference per
+       table rather than per multidict.  The layout cache of split tables
+       holds a reference as well. */
+    Py_ssize_t refcnt;
+
     /* Actual hash table of dk_size entries. It holds indices in dk_entries,
        or DKIX_EMPTY(-1) or DKIX_DUMMY(-2).
 
@@ -61,11 +117,65 @@ typedef struct _htkeys {
        - 4 bytes if htkeys_nslots() <= 0xffffffff (int32_t*)
        - 8 bytes otherwise (int64_t*)
 
-       Dynamically sized, SIZEOF_VOID_P is minimum. */
+       Dynamically sized, SIZEOF_VOID_P is minimum.
+
+       The indices are followed by the control bytes array, see below,
+       entries, and duplicate chain links. */
     char indices[]; /* char is required to avoid strict aliasing. */
 
 } htkeys_t;
 
+/* Duplicate chains.
+
+   Only the first entry of every distinct key (the chain head) is
+   indexed.  Entries with equal keys form a circular doubly-linked list
+   in the insertion order, the head's prev link points to the chain tail.
+   Adding a duplicate is O(1) regardless of the number of equal keys and
+   getall() costs O(number of returned values).
+
+   Links are entry positions stored in two arrays (next and prev) after
+   entries, the width of a link is the same as the width of an index.
+   Small tables have no links, the tag scan returns entries in the
+   insertion order already.
+
+*/
+
+/* Control bytes.
+
+   Every slot has a control byte that is either HT_CTRL_EMPTY,
+   HT_CTRL_DELETED, or a 7-bit tag of the stored entry hash (the top
+   hash bits, the slot number is taken from the lowest ones).
+
+   Lookup checks control bytes of HT_GROUP_WIDTH consecutive slots at
+   once and reads the index and entry_t only if the tag matches.  A probe
+   ends at the group which has an empty slot.
+
+   The array has htkeys_nslots() + HT_GROUP_WIDTH bytes, the tail
+   mirrors the leading control bytes so a group started near the table
+   end could be loaded by a single unaligned read.
+
+   Groups start at (hash & mask) and advance by triangular numbers of
+   groups; for tables with HT_GROUP_WIDTH slots or more it visits every
+   slot exactly once.  Smaller tables fit into a single group.
+
+   Deleted slots are never reused (see DKIX_DUMMY), thus insertion always
+   takes the first empty slot of the probe sequence and entries with
+   equal hashes are visited in the insertion order.
+*/
+
+#define HT_GROUP_WIDTH 16
+#define HT_CTRL_EMPTY ((uint8_t)0x80)
+#define HT_CTRL_DELETED ((uint8_t)0xFE)
+
+#if defined(HT_CTRL_NEON)
+/* vshrn() based movemask emulation produces 4 bits per slot */
+typedef uint64_t ht_ctrlmask_t;
+#define HT_CTRLMASK_SHIFT 2
+#else
+typedef uint32_t ht_ctrlmask_t;
+#define HT_CTRLMASK_SHIFT 0
+#endif
+
 #if SIZEOF_VOID_P > 4
 static inline Py_ssize_t
 htkeys_nslots(const htkeys_t *keys)
@@ -86,12 +196,44 @@ htkeys_mask(const htkeys_t *keys)
     return htkeys_nslots(keys) - 1;
 }
 
-static inline entry_t *
-htkeys_entries(const htkeys_t *dk)
+static inline size_t
+_htkeys_ctrl_bytes(uint8_t log2_size)
+{
+    if (log2_size <= HT_LOG_MINSIZE) {
+        return HT_GROUP_WIDTH;  // small table
+    }
+    // keep entries aligned
+    return (((size_t)1 << log2_size) + HT_GROUP_WIDTH + 7) & ~(size_t)7;
+}
+
+static inline bool
+htkeys_is_small(const htkeys_t *dk)
+{
+    return dk->log2_size <= HT_LOG_MINSIZE;
+}
+
+static inline uint8_t *
+htkeys_ctrl(const htkeys_t *dk)
 {
     int8_t *indices = (int8_t *)(dk->indices);
+    if (htkeys_is_small(dk)) {
+        return (uint8_t *)indices;
+    }
     size_t index = (size_t)1 << dk->log2_index_bytes;
-    return (entry_t *)(&indices[index]);
+    return (uint8_t *)(&indices[index]);
+}
+
+static inline entry_t *
+htkeys_entries(const htkeys_t *dk)
+{
+    uint8_t *ctrl = htkeys_ctrl(dk);
+    return (entry_t *)(ctrl + _htkeys_ctrl_bytes(dk->log2_size));
+}
+
+static inline uint8_t
+htkeys_tag(Py_hash_t hash)
+{
+    return (uint8_t)((size_t)hash >> (sizeof(size_t) * 8 - 7));
 }
 
 #define LOAD_INDEX(keys, size, idx) \
@@ -149,6 +291,113 @@ htkeys_set_index(htkeys_t *keys, Py_ssize_t i, Py_ssize_t ix)
     }
 }
 
+static inline void
+htkeys_set_ctrl(htkeys_t *keys, size_t slot, uint8_t ctrl)
+{
+    uint8_t *ctrls = htkeys_ctrl(keys);
+    size_t nslots = (size_t)htkeys_nslots(keys);
+    ctrls[slot] = ctrl;
+    /* Update mirrored bytes, a table smaller than a group has several
+       copies of its control bytes. */
+    for (size_t i = nslots + slot; i < nslots + HT_GROUP_WIDTH; i += nslots) {
+        ctrls[i] = ctrl;
+    }
+}
+
+/* Store the index of a new entry with given hash into an empty slot. */
+static inline void
+htkeys_insert_index(htkeys_t *keys, size_t slot, Py_ssize_t ix,
+                    Py_hash_t hash)
+{
+    assert(htkeys_ctrl(keys)[slot] == HT_CTRL_EMPTY);
+    if (htkeys_is_small(keys)) {
+        assert((Py_ssize_t)slot == ix);
+        htkeys_ctrl(keys)[slot] = htkeys_tag(hash);
+        return;
+    }
+    htkeys_set_index(keys, slot, ix);
+    htkeys_set_ctrl(keys, slot, htkeys_tag(hash));
+}
+
+/* Mark the slot as deleted. */
+static inline void
+htkeys_del_index(htkeys_t *keys, size_t slot)
+{
+    if (htkeys_is_small(keys)) {
+        htkeys_ctrl(keys)[slot] = HT_CTRL_DELETED;
+        return;
+    }
+    htkeys_set_index(keys, slot, DKIX_DUMMY);
+    htkeys_set_ctrl(keys, slot, HT_CTRL_DELETED);
+}
+
+static inline int
+_ht_ctz(uint64_t x)
+{
+    assert(x != 0);
+#if (defined(__clang__) || defined(__GNUC__))
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long ret;
+    _BitScanForward64(&ret, x);
+    return (int)ret;
+#else
+    int ret = 0;
+    while ((x & 1) == 0) {
+        x >>= 1;
+        ret++;
+    }
+    return ret;
+#endif
+}
+
+#if defined(HT_CTRL_SSE2)
+
+static inline ht_ctrlmask_t
+_htkeys_group_match(const uint8_t *ctrl, uint8_t tag)
+{
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    __m128i match = _mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag));
+    return (ht_ctrlmask_t)_mm_movemask_epi8(match);
+}
+
+#elif defined(HT_CTRL_NEON)
+
+static inline ht_ctrlmask_t
+_htkeys_group_match(const uint8_t *ctrl, uint8_t tag)
+{
+    uint8x16_t match = vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(tag));
+    uint8x8_t res = vshrn_n_u16(vreinterpretq_u16_u8(match), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(res), 0) &
+           UINT64_C(0x8888888888888888);
+}
+
+#else
+
+static inline ht_ctrlmask_t
+_htkeys_group_match(const uint8_t *ctrl, uint8_t tag)
+{
+    ht_ctrlmask_t ret = 0;
+    for (int i = 0; i < HT_GROUP_WIDTH; i++) {
+        ret |= (ht_ctrlmask_t)(ctrl[i] == tag) << i;
+    }
+    return ret;
+}
+
+#endif
+
+/* Mask of group slots that belong to the table, small tables are shorter
+   than a group. */
+static inline ht_ctrlmask_t
+_htkeys_group_valid(const htkeys_t *keys)
+{
+    if (keys->log2_size >= 4) {
+        return ~(ht_ctrlmask_t)0;
+    }
+    return ((ht_ctrlmask_t)1 << (htkeys_nslots(keys) << HT_CTRLMASK_SHIFT)) -
+           1;
+}
+
 /* USABLE_FRACTION is the maximum dictionary load.
  * Increasing this ratio makes dictionaries more dense resulting in more
  * collisions.  Decreasing it improves sparseness at the expense of spreading
@@ -232,86 +481,394 @@ calculate_log2_keysize(Py_ssize_t minsize)
 static inline uint8_t
 estimate_log2_keysize(Py_ssize_t n)
 {
+    if (n <= HT_SMALL_SIZE) {
+        return HT_LOG_MINSIZE;
+    }
     return calculate_log2_keysize((n * 3 + 1) / 2);
 }
 
+/* The number of entries of the table of given size. */
+static inline Py_ssize_t
+htkeys_usable_size(uint8_t log2_size)
+{
+    if (log2_size == HT_LOG_MINSIZE) {
+        return HT_SMALL_SIZE;
+    }
+    return USABLE_FRACTION((size_t)1 << log2_size);
+}
+
 /* This immutable, empty PyDictKeysObject is used for PyDict_Clear()
  * (which cannot fail and thus can do no allocation).
  *
- * See https://github.com/python/cpython/pull/127568#discussion_r1868070614
- * for the rationale of using log2_index_bytes=3 instead of 0.
+ * The table is small, thus it has no indices but the control bytes group.
  */
+#define HT_CTRL_EMPTY_INIT ((char)HT_CTRL_EMPTY)
+
 static htkeys_t empty_htkeys = {
     0, /* log2_size */
-    3, /* log2_index_bytes */
+    0, /* log2_index_bytes */
+    UINT32_MAX, /* cleared */
     0, /* usable (immutable) */
-    0, /* nentries */
-    {DKIX_EMPTY,
-     DKIX_EMPTY,
-     DKIX_EMPTY,
-     DKIX_EMPTY,
-     DKIX_EMPTY,
-     DKIX_EMPTY,
-     DKIX_EMPTY,
-     DKIX_EMPTY}, /* indices */
+    0,    /* nentries */
+    NULL, /* next */
+    NULL, /* retired */
+    1,    /* refcnt */
+    {HT_CTRL_EMPTY_INIT, HT_CTRL_EMPTY_INIT, HT_CTRL_EMPTY_INIT,
+     HT_CTRL_EMPTY_INIT, HT_CTRL_EMPTY_INIT, HT_CTRL_EMPTY_INIT,
+     HT_CTRL_EMPTY_INIT, HT_CTRL_EMPTY_INIT, HT_CTRL_EMPTY_INIT,
+     HT_CTRL_EMPTY_INIT, HT_CTRL_EMPTY_INIT, HT_CTRL_EMPTY_INIT,
+     HT_CTRL_EMPTY_INIT, HT_CTRL_EMPTY_INIT, HT_CTRL_EMPTY_INIT,
+     HT_CTRL_EMPTY_INIT}, /* control bytes */
 };
 
+static inline size_t
+_htkeys_size(uint8_t log2_size, uint8_t log2_index_bytes)
+{
+    Py_ssize_t usable = htkeys_usable_size(log2_size);
+    if (log2_size <= HT_LOG_MINSIZE) {
+        return (sizeof(htkeys_t) + _htkeys_ctrl_bytes(log2_size) +
+                sizeof(entry_t) * usable);
+    }
+    size_t index_bytes = (size_t)1 << log2_index_bytes;
+    size_t link_bytes = 2 * usable * (index_bytes >> log2_size);
+    return (sizeof(htkeys_t) + index_bytes + _htkeys_ctrl_bytes(log2_size) +
+            sizeof(entry_t) * usable + link_bytes);
+}
+
 static inline Py_ssize_t
 htkeys_sizeof(htkeys_t *keys)
 {
-    Py_ssize_t usable = USABLE_FRACTION((size_t)1 << keys->log2_size);
-    return (sizeof(htkeys_t) + ((size_t)1 << keys->log2_index_bytes) +
-            sizeof(entry_t) * usable);
+    return (Py_ssize_t)_htkeys_size(keys->log2_size, keys->log2_index_bytes);
 }
 
-static inline htkeys_t *
-htkeys_new(uint8_t log2_size)
+static inline uint8_t
+_htkeys_log2_index_bytes(uint8_t log2_size)
 {
-    assert(log2_size >= HT_LOG_MINSIZE);
-
-    Py_ssize_t usable = USABLE_FRACTION(((size_t)1) << log2_size);
-    uint8_t log2_bytes;
-
-    if (log2_size < 8) {
-        log2_bytes = log2_size;
+    if (log2_size <= HT_LOG_MINSIZE) {
+        return 0;  // small table, no indices
+    } else if (log2_size < 8) {
+        return log2_size;
     } else if (log2_size < 16) {
-        log2_bytes = log2_size + 1;
+        return log2_size + 1;
     }
 #if SIZEOF_VOID_P > 4
     else if (log2_size >= 32) {
-        log2_bytes = log2_size + 3;
+        return log2_size + 3;
     }
 #endif
     else {
-        log2_bytes = log2_size + 2;
+        return log2_size + 2;
     }
+}
 
+static inline void
+htkeys_pool_lock(htkeys_pool_t *pool)
+{
+#ifdef Py_GIL_DISABLED
+    PyMutex_Lock(&pool->mutex);
+#endif
+}
+
+static inline void
+htkeys_pool_unlock(htkeys_pool_t *pool)
+{
+#ifdef Py_GIL_DISABLED
+    PyMutex_Unlock(&pool->mutex);
+#endif
+}
+
+/* Released tables are linked through their first bytes. */
+static inline htkeys_t **
+_htkeys_pool_next(htkeys_t *keys)
+{
+    return (htkeys_t **)keys;
+}
+
+/* Allocate memory for a table of given size without initializing it.
+
+   The memory is taken from the pool if possible.
+*/
+static inline htkeys_t *
+htkeys_alloc(mod_state *state, uint8_t log2_size)
+{
+    assert(log2_size >= HT_LOG_MINSIZE);
+
+    uint8_t log2_bytes = _htkeys_log2_index_bytes(log2_size);
+    size_t cls = log2_size - HT_LOG_MINSIZE;
     htkeys_t *keys = NULL;
-    /* TODO: CPython uses freelist of key objects with unicode type
-       and log2_size == PyDict_LOG_MINSIZE */
-    keys = PyMem_Malloc(sizeof(htkeys_t) + ((size_t)1 << log2_bytes) +
-                        sizeof(entry_t) * usable);
+
+    if (cls < HTKEYS_POOL_NCLASSES) {
+        htkeys_pool_t *pool = &state->htkeys_pool;
+        htkeys_pool_lock(pool);
+        keys = pool->tables[cls];
+        if (keys != NULL) {
+            pool->tables[cls] = *_htkeys_pool_next(keys);
+            pool->sizes[cls] -= 1;
+            pool->hits += 1;
+        } else {
+            pool->misses += 1;
+        }
+        htkeys_pool_unlock(pool);
+        if (keys != NULL) {
+            return keys;
+        }
+    }
+
+    keys = PyMem_Malloc(_htkeys_size(log2_size, log2_bytes));
     if (keys == NULL) {
         PyErr_NoMemory();
         return NULL;
     }
+    return keys;
+}
+
+static inline htkeys_t *
+htkeys_new(mod_state *state, uint8_t log2_size)
+{
+    Py_ssize_t usable = htkeys_usable_size(log2_size);
+    uint8_t log2_bytes = _htkeys_log2_index_bytes(log2_size);
+    // Large tables are not pooled.  calloc() gets them as fresh zero pages,
+    // so the entries are not touched until they are filled, that keeps
+    // the cost of a resize low for a huge multidict.
+    bool zeroed = (size_t)(log2_size - HT_LOG_MINSIZE) >= HTKEYS_POOL_NCLASSES;
+    htkeys_t *keys;
+    if (zeroed) {
+        keys = PyMem_Calloc(1, _htkeys_size(log2_size, log2_bytes));
+        if (keys == NULL) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+    } else {
+        keys = htkeys_alloc(state, log2_size);
+        if (keys == NULL) {
+            return NULL;
+        }
+    }
 
     keys->log2_size = log2_size;
     keys->log2_index_bytes = log2_bytes;
+    keys->cleared = UINT32_MAX;
     keys->nentries = 0;
     keys->usable = usable;
-    memset(&keys->indices[0], 0xff, ((size_t)1 << log2_bytes));
-    memset(
-        &keys->indices[(size_t)1 << log2_bytes], 0, sizeof(entry_t) * usable);
+    keys->next = NULL;
+    keys->retired = NULL;
+    keys->refcnt = 1;
+    if (!htkeys_is_small(keys)) {
+        memset(&keys->indices[0], 0xff, ((size_t)1 << log2_bytes));
+    }
+    memset(htkeys_ctrl(keys), HT_CTRL_EMPTY, _htkeys_ctrl_bytes(log2_size));
+    if (!zeroed) {
+        memset(htkeys_entries(keys), 0, sizeof(entry_t) * usable);
+    }
     return keys;
 }
 
+/* Allocate a table without initializing the index, the control bytes and
+   the entries, htkeys_clear_step() does it block by block.  The table
+   could be used once the step returns true.  The incremental resize (see
+   hashtable.h) spreads the work over insertions this way, a single
+   memset() of a huge table would stall one of them.
+*/
+#ifdef NDEBUG
+#define HT_CLEAR_BLOCK 4096
+#else
+// debug builds run the test suite through many clearing steps
+#define HT_CLEAR_BLOCK 256
+#endif
+
+static inline htkeys_t *
+htkeys_new_uncleared(mod_state *state, uint8_t log2_size)
+{
+    assert(log2_size > HT_LOG_MINSIZE);
+    htkeys_t *keys = htkeys_alloc(state, log2_size);
+    if (keys == NULL) {
+        return NULL;
+    }
+    keys->log2_size = log2_size;
+    keys->log2_index_bytes = _htkeys_log2_index_bytes(log2_size);
+    keys->cleared = 0;
+    keys->nentries = 0;
+    keys->usable = htkeys_usable_size(log2_size);
+    keys->next = NULL;
+    keys->retired = NULL;
+    keys->refcnt = 1;
+    return keys;
+}
+
+/* Fill the part of [lo, hi) within [start, stop) */
 static inline void
-htkeys_free(htkeys_t *dk)
+_htkeys_fill(char *base, size_t start, size_t stop, size_t lo, size_t hi,
+             int c)
 {
-    /* TODO: CPython uses freelist of key objects with unicode type
-       and log2_size == PyDict_LOG_MINSIZE */
-    PyMem_Free(dk);
+    if (start < lo) {
+        start = lo;
+    }
+    if (stop > hi) {
+        stop = hi;
+    }
+    if (start < stop) {
+        memset(base + start, c, stop - start);
+    }
+}
+
+/* Initialize up to nblocks more blocks of the table allocated by
+   htkeys_new_uncleared(), return true if the table is initialized. */
+static inline bool
+htkeys_clear_step(htkeys_t *keys, size_t nblocks)
+{
+    size_t ctrl_start = (size_t)1 << keys->log2_index_bytes;
+    size_t entries_start = ctrl_start + _htkeys_ctrl_bytes(keys->log2_size);
+    size_t end = entries_start + sizeof(entry_t) *
+                                     (size_t)htkeys_usable_size(keys->log2_size);
+    size_t total = (end + HT_CLEAR_BLOCK - 1) / HT_CLEAR_BLOCK;
+    size_t cleared = keys->cleared;
+    if (cleared >= total) {
+        return true;
+    }
+    if (nblocks > total - cleared) {
+        nblocks = total - cleared;
+    }
+    size_t start = cleared * HT_CLEAR_BLOCK;
+    size_t stop = (cleared + nblocks) * HT_CLEAR_BLOCK;
+    if (stop > end) {
+        stop = end;
+    }
+    _htkeys_fill(keys->indices, start, stop, 0, ctrl_start, 0xff);
+    _htkeys_fill(
+        keys->indices, start, stop, ctrl_start, entries_start, HT_CTRL_EMPTY);
+    _htkeys_fill(keys->indices, start, stop, entries_start, end, 0);
+    keys->cleared = (uint32_t)(cleared + nblocks);
+    return cleared + nblocks == total;
+}
+
+/* Release the table memory.
+
+   The caller is responsible for clearing entries before the call.
+   Small tables are kept in the pool for reusing by htkeys_alloc().
+*/
+static inline void
+htkeys_free(mod_state *state, htkeys_t *keys)
+{
+    assert(keys != &empty_htkeys);
+    if (keys->next != NULL) {
+        // the entries of the next table are borrowed
+        htkeys_free(state, keys->next);
+        keys->next = NULL;
+    }
+    if (keys->retired != NULL) {
+        htkeys_free(state, keys->retired);
+        keys->retired = NULL;
+    }
+    size_t cls = keys->log2_size - HT_LOG_MINSIZE;
+
+    if (cls < HTKEYS_POOL_NCLASSES) {
+        htkeys_pool_t *pool = &state->htkeys_pool;
+        htkeys_pool_lock(pool);
+        if (pool->sizes[cls] < pool->maxsize) {
+            *_htkeys_pool_next(keys) = pool->tables[cls];
+            pool->tables[cls] = keys;
+            pool->sizes[cls] += 1;
+            keys = NULL;
+        }
+        htkeys_pool_unlock(pool);
+        if (keys == NULL) {
+            return;
+        }
+    }
+    PyMem_Free(keys);
+}
+
+/* Retire the table replaced by new_keys.
+
+   free() of a huge table returns all its pages to the system at once,
+   that takes about a millisecond per 20 MB.  Where madvise() is
+   available, the memory is given back by htkeys_release_step() block by
+   block and the final free() has little left to do.  The entries of the
+   table should be moved to new_keys already.
+*/
+#define HT_RELEASE_BLOCK ((size_t)1 << 16)
+
+static inline void
+htkeys_retire(mod_state *state, htkeys_t *new_keys, htkeys_t *keys)
+{
+    // a resize starts once the previous retired table is freed
+    assert(keys->next == NULL && keys->retired == NULL);
+    assert(new_keys->retired == NULL);
+#ifdef HT_RELEASE_MADVISE
+    if (htkeys_sizeof(keys) >= 2 * (Py_ssize_t)HT_RELEASE_BLOCK) {
+        keys->cleared = 0;
+        new_keys->retired = keys;
+        return;
+    }
+#endif
+    htkeys_free(state, keys);
+}
+
+/* Give back the next block of the retired table memory if any,
+   free the table when no whole block is left. */
+static inline void
+htkeys_release_step(mod_state *state, htkeys_t *keys)
+{
+    htkeys_t *retired = keys->retired;
+    if (retired == NULL) {
+        return;
+    }
+#ifdef HT_RELEASE_MADVISE
+    // only the blocks within the allocation are released
+    uintptr_t start = ((uintptr_t)retired + sizeof(htkeys_t) +
+                       HT_RELEASE_BLOCK - 1) & ~(uintptr_t)(HT_RELEASE_BLOCK - 1);
+    start += (uintptr_t)retired->cleared * HT_RELEASE_BLOCK;
+    uintptr_t end = (uintptr_t)retired + (uintptr_t)htkeys_sizeof(retired);
+    if (start + HT_RELEASE_BLOCK <= end) {
+        // failures are ignored, free() releases the memory anyway
+        (void)madvise((void *)start, HT_RELEASE_BLOCK, MADV_DONTNEED);
+        retired->cleared += 1;
+        return;
+    }
+#endif
+    keys->retired = NULL;
+    htkeys_free(state, retired);
+}
+
+/* Drop pooled tables exceeding the new maxsize limit. */
+static inline void
+htkeys_pool_set_maxsize(mod_state *state, Py_ssize_t maxsize)
+{
+    htkeys_pool_t *pool = &state->htkeys_pool;
+    htkeys_t *released = NULL;
+
+    htkeys_pool_lock(pool);
+    pool->maxsize = maxsize;
+    for (size_t cls = 0; cls < HTKEYS_POOL_NCLASSES; cls++) {
+        while (pool->sizes[cls] > maxsize) {
+            htkeys_t *keys = pool->tables[cls];
+            pool->tables[cls] = *_htkeys_pool_next(keys);
+            pool->sizes[cls] -= 1;
+            *_htkeys_pool_next(keys) = released;
+            released = keys;
+        }
+    }
+    htkeys_pool_unlock(pool);
+
+    while (released != NULL) {
+        htkeys_t *next = *_htkeys_pool_next(released);
+        PyMem_Free(released);
+        released = next;
+    }
+}
+
+static inline void
+htkeys_pool_init(mod_state *state)
+{
+    htkeys_pool_t *pool = &state->htkeys_pool;
+    memset(pool, 0, sizeof(htkeys_pool_t));
+    pool->maxsize = HTKEYS_POOL_MAXSIZE;
+}
+
+static inline void
+htkeys_pool_clear(mod_state *state)
+{
+    htkeys_pool_set_maxsize(state, 0);
 }
 
 static inline Py_hash_t
@@ -325,87 +882,381 @@ _unicode_hash(PyObject *o)
     return PyUnicode_Type.tp_hash(o);
 }
 
-/*
-Internal routine used by ht_resize() to build a hashtable of entries.
+static inline bool
+_htkeys_str_eq(PyObject *a, PyObject *b)
+{
+    assert(PyUnicode_CheckExact(a));
+    assert(PyUnicode_CheckExact(b));
+    if (a == b) {
+        return true;
+    }
+    Py_ssize_t len = PyUnicode_GET_LENGTH(a);
+    int kind = PyUnicode_KIND(a);
+    if (len != PyUnicode_GET_LENGTH(b) || kind != PyUnicode_KIND(b)) {
+        return false;
+    }
+    return bytes_eq(PyUnicode_DATA(a), PyUnicode_DATA(b), (size_t)(len * kind));
+}
+
+/* The identity hash is computed before the entry is stored,
+   reading it is a load from the str object. */
+static inline Py_hash_t
+htkeys_entry_hash(const entry_t *entry)
+{
+    Py_hash_t hash = _unicode_hash(entry->identity);
+    assert(hash != -1);
+    return hash;
+}
+
+static inline bool
+htkeys_entry_eq(const entry_t *entry, Py_hash_t hash, PyObject *identity)
+{
+    return entry->identity == identity ||
+           (htkeys_entry_hash(entry) == hash &&
+            _htkeys_str_eq(entry->identity, identity));
+}
+
+/* Links storage, see "Duplicate chains" above */
+static inline char *
+_htkeys_links(const htkeys_t *keys, int prev)
+{
+    size_t width = (size_t)1 << (keys->log2_index_bytes - keys->log2_size);
+    size_t usable = (size_t)htkeys_usable_size(keys->log2_size);
+    char *links = (char *)(htkeys_entries(keys) + usable);
+    return links + prev * usable * width;
+}
+
+#define LOAD_LINK(links, size, idx) ((const int##size##_t *)(links))[idx]
+#define STORE_LINK(links, size, idx, value) \
+    ((int##size##_t *)(links))[idx] = (int##size##_t)value
+
+static inline Py_ssize_t
+_htkeys_get_link(const htkeys_t *keys, int prev, Py_ssize_t ix)
+{
+    uint8_t log2size = keys->log2_size;
+    char *links = _htkeys_links(keys, prev);
+    assert(!htkeys_is_small(keys));
+    if (log2size < 8) {
+        return LOAD_LINK(links, 8, ix);
+    } else if (log2size < 16) {
+        return LOAD_LINK(links, 16, ix);
+    }
+#if SIZEOF_VOID_P > 4
+    else if (log2size >= 32) {
+        return LOAD_LINK(links, 64, ix);
+    }
+#endif
+    else {
+        return LOAD_LINK(links, 32, ix);
+    }
+}
+
+static inline void
+_htkeys_set_link(htkeys_t *keys, int prev, Py_ssize_t ix, Py_ssize_t value)
+{
+    uint8_t log2size = keys->log2_size;
+    char *links = _htkeys_links(keys, prev);
+    assert(!htkeys_is_small(keys));
+    if (log2size < 8) {
+        STORE_LINK(links, 8, ix, value);
+    } else if (log2size < 16) {
+        STORE_LINK(links, 16, ix, value);
+    }
+#if SIZEOF_VOID_P > 4
+    else if (log2size >= 32) {
+        STORE_LINK(links, 64, ix, value);
+    }
+#endif
+    else {
+        STORE_LINK(links, 32, ix, value);
+    }
+}
+
+static inline Py_ssize_t
+htkeys_next_link(const htkeys_t *keys, Py_ssize_t ix)
+{
+    return _htkeys_get_link(keys, 0, ix);
+}
+
+static inline Py_ssize_t
+htkeys_prev_link(const htkeys_t *keys, Py_ssize_t ix)
+{
+    return _htkeys_get_link(keys, 1, ix);
+}
+
+/* Find the slot of the chain head for given hash and identity.
+
+   Return the head slot or -1 if the key is not present,
+   *pempty is set to the first empty slot of the probe sequence then.
 */
-static inline int
-htkeys_build_indices(htkeys_t *keys, entry_t *ep, Py_ssize_t n, bool update)
-{
-    size_t mask = htkeys_mask(keys);
-    for (Py_ssize_t ix = 0; ix != n; ix++, ep++) {
-        Py_hash_t hash = ep->hash;
-        if (update) {
-            if (hash == -1) {
-                hash = _unicode_hash(ep->identity);
-                if (hash == -1) {
-                    return -1;
-                }
+static inline Py_ssize_t
+_htkeys_find_head(htkeys_t *keys, Py_hash_t hash, PyObject *identity,
+                  size_t *pempty)
+{
+    const size_t mask = htkeys_mask(keys);
+    const ht_ctrlmask_t valid = _htkeys_group_valid(keys);
+    const uint8_t *ctrl = htkeys_ctrl(keys);
+    const uint8_t tag = htkeys_tag(hash);
+    entry_t *entries = htkeys_entries(keys);
+    size_t pos = hash & mask;
+    for (size_t stride = HT_GROUP_WIDTH;; stride += HT_GROUP_WIDTH) {
+        ht_ctrlmask_t match = _htkeys_group_match(ctrl + pos, tag) & valid;
+        while (match != 0) {
+            size_t slot =
+                (pos + (_ht_ctz(match) >> HT_CTRLMASK_SHIFT)) & mask;
+            match &= match - 1;
+            entry_t *entry = entries + htkeys_get_index(keys, slot);
+            if (htkeys_entry_eq(entry, hash, identity)) {
+                return (Py_ssize_t)slot;
             }
-        } else {
-            assert(hash != -1);
         }
-        size_t i = hash & mask;
-        for (size_t perturb = hash; htkeys_get_index(keys, i) != DKIX_EMPTY;) {
-            perturb >>= HT_PERTURB_SHIFT;
-            i = mask & (i * 5 + perturb + 1);
+        ht_ctrlmask_t empty =
+            _htkeys_group_match(ctrl + pos, HT_CTRL_EMPTY) & valid;
+        if (empty != 0) {
+            *pempty = (pos + (_ht_ctz(empty) >> HT_CTRLMASK_SHIFT)) & mask;
+            return -1;
         }
-        htkeys_set_index(keys, i, ix);
+        pos = (pos + stride) & mask;
     }
-    return 0;
 }
 
-/* Internal function to find slot for an item from its hash
-   when it is known that the key is not present in the dict.
- */
-static inline Py_ssize_t
-htkeys_find_empty_slot(htkeys_t *keys, Py_hash_t hash)
+/* Register a new entry at ix position in the index.
+
+   The entry is appended to the chain of equal keys if any,
+   or becomes a new chain head.
+*/
+static inline void
+htkeys_add_index(htkeys_t *keys, Py_ssize_t ix, Py_hash_t hash,
+                 PyObject *identity)
 {
-    const size_t mask = htkeys_mask(keys);
-    size_t i = hash & mask;
-    Py_ssize_t ix = htkeys_get_index(keys, i);
-    for (size_t perturb = hash; ix >= 0 || ix == DKIX_DUMMY;) {
-        perturb >>= HT_PERTURB_SHIFT;
-        i = (i * 5 + perturb + 1) & mask;
-        ix = htkeys_get_index(keys, i);
+    if (htkeys_is_small(keys)) {
+        htkeys_insert_index(keys, (size_t)ix, ix, hash);
+        return;
+    }
+    size_t empty = 0;
+    Py_ssize_t slot = _htkeys_find_head(keys, hash, identity, &empty);
+    if (slot < 0) {
+        htkeys_insert_index(keys, empty, ix, hash);
+        _htkeys_set_link(keys, 0, ix, ix);
+        _htkeys_set_link(keys, 1, ix, ix);
+    } else {
+        Py_ssize_t head = htkeys_get_index(keys, (size_t)slot);
+        Py_ssize_t tail = htkeys_prev_link(keys, head);
+        assert(tail < ix);
+        _htkeys_set_link(keys, 0, tail, ix);
+        _htkeys_set_link(keys, 1, ix, tail);
+        _htkeys_set_link(keys, 0, ix, head);
+        _htkeys_set_link(keys, 1, head, ix);
+    }
+}
+
+/* Remove the entry at ix position from the index,
+   slot is the slot of the entry's chain head.
+*/
+static inline void
+htkeys_del_entry(htkeys_t *keys, size_t slot, Py_ssize_t ix)
+{
+    if (htkeys_is_small(keys)) {
+        assert((Py_ssize_t)slot == ix);
+        htkeys_del_index(keys, slot);
+        return;
+    }
+    Py_ssize_t next = htkeys_next_link(keys, ix);
+    if (next == ix) {
+        // the only entry of the chain
+        assert(htkeys_get_index(keys, slot) == ix);
+        htkeys_del_index(keys, slot);
+        return;
+    }
+    Py_ssize_t prev = htkeys_prev_link(keys, ix);
+    _htkeys_set_link(keys, 0, prev, next);
+    _htkeys_set_link(keys, 1, next, prev);
+    if (htkeys_get_index(keys, slot) == ix) {
+        // the next entry becomes the head, the key and the tag are the same
+        htkeys_set_index(keys, slot, next);
+    }
+}
+
+/* Entries are indexed by blocks, the hashes of a block are read first */
+#define HT_BUILD_BLOCK 32
+
+/*
+Internal routine used by ht_resize() to build a hashtable of entries
+at positions from start to stop.
+Deleted entries are kept at their positions, the slots stay unused.
+
+The hashes are read from the identities which are scattered in memory.
+Independent loads of a block of hashes overlap their cache misses, the
+index updates follow.
+*/
+static inline void
+htkeys_build_range(htkeys_t *keys, Py_ssize_t start, Py_ssize_t stop)
+{
+    Py_hash_t hashes[HT_BUILD_BLOCK];
+    entry_t *ep = htkeys_entries(keys);
+    for (Py_ssize_t base = start; base < stop; base += HT_BUILD_BLOCK) {
+        Py_ssize_t count = stop - base;
+        if (count > HT_BUILD_BLOCK) {
+            count = HT_BUILD_BLOCK;
+        }
+        entry_t *block = ep + base;
+        for (Py_ssize_t i = 0; i < count; i++) {
+            if (block[i].identity != NULL) {
+                hashes[i] = htkeys_entry_hash(block + i);
+            }
+        }
+        for (Py_ssize_t i = 0; i < count; i++) {
+            Py_ssize_t ix = base + i;
+            if (block[i].identity == NULL) {
+                if (htkeys_is_small(keys)) {
+                    htkeys_ctrl(keys)[ix] = HT_CTRL_DELETED;
+                }
+                continue;
+            }
+            htkeys_add_index(keys, ix, hashes[i], block[i].identity);
+        }
     }
-    return i;
+}
+
+static inline void
+htkeys_build_indices(htkeys_t *keys, entry_t *ep, Py_ssize_t n)
+{
+    assert(ep == htkeys_entries(keys));
+    htkeys_build_range(keys, 0, n);
 }
 
 /* Iterator over slots/indexes for given hash.
-   N.B. The iterator MIGHT return the same slot
-   multiple times, eiter consequently (1, 2, 2, 3)
-   or with different slots in the middle (1, 2, 3, 1).
 
-   The caller is responsible to mark visited slots
-   and cleanup the mark after the iteration finish.
+   Only slots with the matching control byte tag are returned,
+   iter->index is DKIX_EMPTY when the probe sequence ends.
+   Every slot is returned at most once, in the probe order.
+   The tag could match for entries with different hashes,
+   the caller is responsible for comparing the entry hash.
+
+   The chain of a head with the equal hash is returned
+   right after the head, iter->slot is the head slot for all chain
+   entries.  The links are read lazily, a lookup that stops at the head
+   doesn't touch them.  The caller could delete the current entry by
+   htkeys_del_entry(), the links of the removed entry are kept intact
+   and chain positions grow up to the wrap to the head.
 
-   See ht_finder_t for an object designed for such operations.
+   For small tables the slot is the position of the entry.
 */
 
 typedef struct _htkeysiter {
     htkeys_t *keys;
     size_t mask;  // htkeys_mask(keys)
-    size_t slot;  // masked hash, Py_hash_t h & mask;
-    size_t perturb;
+    size_t slot;  // current slot
+    size_t pos;   // the first slot of the current group
+    size_t stride;
+    ht_ctrlmask_t valid;  // _htkeys_group_valid(keys)
+    ht_ctrlmask_t match;  // not visited matching slots of the current group
+    uint8_t tag;
+    bool small;
+    Py_hash_t hash;
+    bool chain;  // iter->index is in the chain that should be walked
     Py_ssize_t index;
 } htkeysiter_t;
 
 static inline void
-htkeysiter_init(htkeysiter_t *iter, htkeys_t *keys, Py_hash_t hash)
+htkeysiter_next(htkeysiter_t *iter)
 {
-    iter->keys = keys;
-    iter->mask = htkeys_mask(keys);
-    iter->perturb = (size_t)hash;
-    iter->slot = hash & iter->mask;
+    if (iter->chain) {
+        Py_ssize_t next = htkeys_next_link(iter->keys, iter->index);
+        if (next > iter->index) {
+            iter->index = next;
+            return;
+        }
+        iter->chain = false;
+    }
+    while (iter->match == 0) {
+        /* The group is exhausted, the probe ends if it has an empty slot.
+           The check is postponed until this point to keep the lookup of
+           the first matching entry as cheap as possible. */
+        const uint8_t *ctrl = htkeys_ctrl(iter->keys);
+        if ((_htkeys_group_match(ctrl + iter->pos, HT_CTRL_EMPTY) &
+             iter->valid) != 0) {
+            iter->index = DKIX_EMPTY;
+            return;
+        }
+        iter->stride += HT_GROUP_WIDTH;
+        iter->pos = (iter->pos + iter->stride) & iter->mask;
+        iter->match =
+            _htkeys_group_match(ctrl + iter->pos, iter->tag) & iter->valid;
+    }
+    size_t offset = (size_t)(_ht_ctz(iter->match) >> HT_CTRLMASK_SHIFT);
+    iter->match &= iter->match - 1;
+    iter->slot = (iter->pos + offset) & iter->mask;
+    if (iter->small) {
+        iter->index = (Py_ssize_t)iter->slot;
+        return;
+    }
     iter->index = htkeys_get_index(iter->keys, iter->slot);
+    assert(iter->index >= 0);
+    iter->chain = htkeys_entry_hash(htkeys_entries(iter->keys) +
+                                    iter->index) == iter->hash;
 }
 
 static inline void
-htkeysiter_next(htkeysiter_t *iter)
+htkeysiter_init(htkeysiter_t *iter, htkeys_t *keys, Py_hash_t hash)
 {
-    iter->perturb >>= HT_PERTURB_SHIFT;
-    iter->slot = (iter->slot * 5 + iter->perturb + 1) & iter->mask;
-    iter->index = htkeys_get_index(iter->keys, iter->slot);
+    iter->keys = keys;
+    iter->tag = htkeys_tag(hash);
+    iter->hash = hash;
+    iter->stride = 0;
+    iter->chain = false;
+    if (htkeys_is_small(keys)) {
+        /* The only group, unused control bytes are empty */
+        iter->small = true;
+        iter->mask = HT_GROUP_WIDTH - 1;
+        iter->valid = ~(ht_ctrlmask_t)0;
+        iter->pos = 0;
+    } else {
+        iter->small = false;
+        iter->mask = htkeys_mask(keys);
+        iter->valid = _htkeys_group_valid(keys);
+        iter->pos = hash & iter->mask;
+    }
+    iter->match =
+        _htkeys_group_match(htkeys_ctrl(keys) + iter->pos, iter->tag) &
+        iter->valid;
+    htkeysiter_next(iter);
+}
+
+/* Count chain heads which a lookup doesn't resolve by a single group load.
+
+   A lookup of the key is resolved by the home group (the group at
+   hash & mask) if the head is in the group, no other slot of the group has
+   the same tag, and the group has an empty slot that ends the probe.
+   Tags are the top bits of the hash, a larger table spreads the heads over
+   more groups but never changes their tags.
+*/
+static inline Py_ssize_t
+htkeys_count_probe_collisions(const htkeys_t *keys)
+{
+    if (htkeys_is_small(keys)) {
+        return 0;  // the only group
+    }
+    const size_t mask = htkeys_mask(keys);
+    const uint8_t *ctrl = htkeys_ctrl(keys);
+    const entry_t *entries = htkeys_entries(keys);
+    const Py_ssize_t nslots = htkeys_nslots(keys);
+    Py_ssize_t count = 0;
+    for (Py_ssize_t slot = 0; slot < nslots; slot++) {
+        Py_ssize_t ix = htkeys_get_index(keys, slot);
+        if (ix < 0) {
+            continue;
+        }
+        Py_hash_t hash = htkeys_entry_hash(entries + ix);
+        size_t pos = hash & mask;
+        ht_ctrlmask_t match = _htkeys_group_match(ctrl + pos, ctrl[slot]);
+        if ((((size_t)slot - pos) & mask) >= HT_GROUP_WIDTH ||
+            (match & (match - 1)) != 0 ||
+            _htkeys_group_match(ctrl + pos, HT_CTRL_EMPTY) == 0) {
+            count += 1;
+        }
+    }
+    return count;
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,312 @@
+#include "pythoncapi_compat.h"
+
+#ifndef _MULTIDICT_INTERN_H
+#define _MULTIDICT_INTERN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <Python.h>
+#include <stdbool.h>
+
+#include "htkeys.h"
+#include "lower.h"
+#include "state.h"
+
+/* Intern table of case-insensitive identities.
+
+   Every CIMultiDict entry holds the lowered identity of its key.  Without
+   interning, each of many live header dicts keeps its own 'content-type'
+   string, and equal identities are compared by content.
+
+   The table is a direct-mapped cache indexed by the str hash.  A slot maps
+   either an original key ('Content-Type') or an identity ('content-type')
+   to the canonical identity object, so repeated lowering of the same key is
+   a table hit and identities of equal keys are the same object (compared
+   by pointer).  A colliding key replaces the slot: the table never grows
+   whatever keys come in.  Keys longer than INTERN_MAX_LENGTH are not
+   interned.
+
+   Only storing a key into a multidict fills the table, lookups just read it.
+   The table is a part of the module state and thus per-interpreter.
+   Free-threaded build guards it by a mutex.
+*/
+
+#define INTERN_MAX_LENGTH 64
+
+/* Identities of the well-known HTTP headers (see headers.h) are created at
+   module init and live as long as the module.  Keys and istr with these
+   names are resolved to the shared identity by the perfect hash table,
+   without lowering, allocating and hashing.
+*/
+
+static inline int
+headers_init(mod_state *state)
+{
+    for (Py_ssize_t id = 0; id < HEADERS_COUNT; id++) {
+        PyObject *identity =
+            PyUnicode_InternFromString(headers_names[id].name);
+        if (identity == NULL) {
+            return -1;
+        }
+        state->header_identities[id] = identity;
+        // cache the hash
+        if (PyObject_Hash(identity) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static inline void
+headers_clear(mod_state *state)
+{
+    for (Py_ssize_t id = 0; id < HEADERS_COUNT; id++) {
+        Py_CLEAR(state->header_identities[id]);
+    }
+}
+
+/* Return the ID of the header with the ASCII name in any case, or -1 */
+static inline int
+headers_find(const Py_UCS1 *data, Py_ssize_t len)
+{
+    if (len == 0 || len > HEADERS_MAX_LENGTH) {
+        return -1;
+    }
+    Py_ssize_t n = len < 8 ? len : 8;
+    uint64_t head = headers_lower_word(data, n);
+    uint64_t tail = headers_lower_word(data + len - n, n);
+    int id = headers_candidate(head, tail, len);
+    if (id < 0) {
+        return -1;
+    }
+    const header_name_t *hdr = &headers_names[id];
+    if (hdr->len != len || hdr->head != head || hdr->tail != tail) {
+        return -1;
+    }
+    // the words cover names up to 16 chars
+    if (len > 16 && !ascii_lower_eq(data + 8,
+                                    (const Py_UCS1 *)hdr->name + 8,
+                                    len - 16)) {
+        return -1;
+    }
+    return id;
+}
+
+/* Return a borrowed identity of the well-known header with the ASCII str
+   name or NULL without an exception set. */
+static inline PyObject *
+headers_identity(mod_state *state, PyObject *name)
+{
+    assert(PyUnicode_IS_ASCII(name));
+    int id =
+        headers_find(PyUnicode_1BYTE_DATA(name), PyUnicode_GET_LENGTH(name));
+    if (id < 0) {
+        return NULL;
+    }
+    return state->header_identities[id];
+}
+
+static inline void
+intern_lock(intern_table_t *table)
+{
+#ifdef Py_GIL_DISABLED
+    PyMutex_Lock(&table->mutex);
+#endif
+}
+
+static inline void
+intern_unlock(intern_table_t *table)
+{
+#ifdef Py_GIL_DISABLED
+    PyMutex_Unlock(&table->mutex);
+#endif
+}
+
+static inline intern_slot_t *
+_intern_slot(intern_table_t *table, Py_hash_t hash)
+{
+    assert(table->slots != NULL);
+    return table->slots + ((size_t)hash & (size_t)(table->size - 1));
+}
+
+static inline bool
+_intern_slot_match(intern_slot_t *slot, PyObject *key, Py_hash_t hash)
+{
+    return slot->key != NULL && _unicode_hash(slot->key) == hash &&
+           _htkeys_str_eq(slot->key, key);
+}
+
+static inline void
+_intern_slot_set(intern_slot_t *slot, PyObject *key, PyObject *identity)
+{
+    PyObject *old_key = slot->key;
+    PyObject *old_identity = slot->identity;
+    slot->key = Py_NewRef(key);
+    slot->identity = Py_NewRef(identity);
+    Py_XDECREF(old_key);
+    Py_XDECREF(old_identity);
+}
+
+/* Return a new reference to the interned identity of the exact str key,
+   or NULL without an exception set if the key is not in the table. */
+static inline PyObject *
+intern_lookup(mod_state *state, PyObject *key, Py_hash_t hash)
+{
+    intern_table_t *table = &state->intern_table;
+    PyObject *ret = NULL;
+    intern_lock(table);
+    if (table->slots != NULL) {
+        intern_slot_t *slot = _intern_slot(table, hash);
+        if (_intern_slot_match(slot, key, hash)) {
+            ret = Py_NewRef(slot->identity);
+        }
+    }
+    intern_unlock(table);
+    return ret;
+}
+
+/* Return the canonical object equal to the identity,
+   steal the identity reference.
+
+   If key is not NULL, the key is remembered as lowered to the identity.
+*/
+static inline PyObject *
+_intern_add(mod_state *state, PyObject *key, Py_hash_t hash,
+            PyObject *identity)
+{
+    intern_table_t *table = &state->intern_table;
+    assert(PyUnicode_CheckExact(identity));
+    Py_hash_t ihash = _unicode_hash(identity);
+
+    intern_lock(table);
+    if (table->size == 0) {
+        goto done;
+    }
+    if (table->slots == NULL) {
+        table->slots = PyMem_Calloc((size_t)table->size, sizeof(intern_slot_t));
+        if (table->slots == NULL) {
+            // the table is an optimization, keep the identity as is
+            goto done;
+        }
+    }
+    if (key != NULL) {
+        // canonicalizing an identity (key == NULL) is not a cache miss
+        table->misses += 1;
+    }
+    intern_slot_t *islot = _intern_slot(table, ihash);
+    if (_intern_slot_match(islot, identity, ihash)) {
+        Py_SETREF(identity, Py_NewRef(islot->identity));
+    } else {
+        _intern_slot_set(islot, identity, identity);
+    }
+    if (key != NULL && key != identity) {
+        _intern_slot_set(_intern_slot(table, hash), key, identity);
+    }
+done:
+    intern_unlock(table);
+    return identity;
+}
+
+/* Return the canonical identity of the exact str key for CIMultiDict */
+static inline PyObject *
+intern_ci_identity(mod_state *state, PyObject *key)
+{
+    assert(PyUnicode_CheckExact(key));
+    if (PyUnicode_IS_ASCII(key)) {
+        PyObject *identity = headers_identity(state, key);
+        if (identity != NULL) {
+            return Py_NewRef(identity);
+        }
+    }
+    intern_table_t *table = &state->intern_table;
+    if (PyUnicode_GET_LENGTH(key) > INTERN_MAX_LENGTH) {
+        return lower_str(state, key);
+    }
+    // the disabled table (size == 0) has no slots, the lookup misses and
+    // _intern_add() checks the size under the lock
+    Py_hash_t hash = _unicode_hash(key);
+    PyObject *identity = intern_lookup(state, key, hash);
+    if (identity != NULL) {
+        intern_lock(table);
+        table->hits += 1;
+        intern_unlock(table);
+        return identity;
+    }
+    identity = lower_str(state, key);
+    if (identity == NULL) {
+        return NULL;
+    }
+    return _intern_add(state, key, hash, identity);
+}
+
+/* Return the canonical object equal to the identity,
+   steal the identity reference. */
+static inline PyObject *
+intern_identity(mod_state *state, PyObject *identity)
+{
+    if (PyUnicode_GET_LENGTH(identity) > INTERN_MAX_LENGTH) {
+        return identity;
+    }
+    return _intern_add(state, NULL, 0, identity);
+}
+
+/* Resize the table dropping all interned strings, 0 disables the table. */
+static inline void
+intern_set_size(mod_state *state, Py_ssize_t size)
+{
+    intern_table_t *table = &state->intern_table;
+    assert(size >= 0 && (size & (size - 1)) == 0);
+
+    intern_lock(table);
+    intern_slot_t *slots = table->slots;
+    Py_ssize_t old_size = table->size;
+    table->slots = NULL;
+    table->size = size;
+    intern_unlock(table);
+
+    if (slots != NULL) {
+        for (Py_ssize_t i = 0; i < old_size; i++) {
+            Py_XDECREF(slots[i].key);
+            Py_XDECREF(slots[i].identity);
+        }
+        PyMem_Free(slots);
+    }
+}
+
+static inline Py_ssize_t
+intern_used(mod_state *state)
+{
+    intern_table_t *table = &state->intern_table;
+    Py_ssize_t used = 0;
+    intern_lock(table);
+    if (table->slots != NULL) {
+        for (Py_ssize_t i = 0; i < table->size; i++) {
+            if (table->slots[i].key != NULL) {
+                used += 1;
+            }
+        }
+    }
+    intern_unlock(table);
+    return used;
+}
+
+static inline void
+intern_init(mod_state *state)
+{
+    intern_table_t *table = &state->intern_table;
+    memset(table, 0, sizeof(intern_table_t));
+    table->size = INTERN_TABLE_SIZE;
+}
+
+static inline void
+intern_clear(mod_state *state)
+{
+    intern_set_size(state, 0);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -5,6 +5,8 @@
 extern "C" {
 #endif
 
+#include "intern.h"
+#include "lower.h"
 #include "state.h"
 
 typedef struct {
@@ -56,9 +58,16 @@ istr_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
     if (!ret) {
         goto fail;
     }
-    canonical = PyObject_CallMethodNoArgs(ret, state->str_lower);
-    if (!canonical) {
-        goto fail;
+    // subclasses could override lower()
+    if (Py_IS_TYPE(ret, state->IStrType) && PyUnicode_IS_ASCII(ret) &&
+        (canonical = headers_identity(state, ret)) != NULL) {
+        Py_INCREF(canonical);
+    } else {
+        canonical = lower_str(state, ret);
+        if (!canonical) {
+            goto fail;
+        }
+        canonical = intern_identity(state, canonical);
     }
     ((istrobject *)ret)->canonical = canonical;
     ((istrobject *)ret)->state = state;
@@ -25,12 +25,15 @@ _init_iter(MultidictIter *it, MultiDictObject *md)
 }
 
 static inline PyObject *
-multidict_items_iter_new(MultiDictObject *md)
+_multidict_iter_new(MultiDictObject *md, PyTypeObject *tp)
 {
     MultidictIter *it =
-        PyObject_GC_New(MultidictIter, md->state->ItemsIterType);
+        (MultidictIter *)freelist_pop(&md->state->iter_freelist, tp);
     if (it == NULL) {
-        return NULL;
+        it = PyObject_GC_New(MultidictIter, tp);
+        if (it == NULL) {
+            return NULL;
+        }
     }
 
     _init_iter(it, md);
@@ -40,33 +43,21 @@ multidict_items_iter_new(MultiDictObject *md)
 }
 
 static inline PyObject *
-multidict_keys_iter_new(MultiDictObject *md)
+multidict_items_iter_new(MultiDictObject *md)
 {
-    MultidictIter *it =
-        PyObject_GC_New(MultidictIter, md->state->KeysIterType);
-    if (it == NULL) {
-        return NULL;
-    }
-
-    _init_iter(it, md);
+    return _multidict_iter_new(md, md->state->ItemsIterType);
+}
 
-    PyObject_GC_Track(it);
-    return (PyObject *)it;
+static inline PyObject *
+multidict_keys_iter_new(MultiDictObject *md)
+{
+    return _multidict_iter_new(md, md->state->KeysIterType);
 }
 
 static inline PyObject *
 multidict_values_iter_new(MultiDictObject *md)
 {
-    MultidictIter *it =
-        PyObject_GC_New(MultidictIter, md->state->ValuesIterType);
-    if (it == NULL) {
-        return NULL;
-    }
-
-    _init_iter(it, md);
-
-    PyObject_GC_Track(it);
-    return (PyObject *)it;
+    return _multidict_iter_new(md, md->state->ValuesIterType);
 }
 
 static inline PyObject *
@@ -135,9 +126,12 @@ static inline void
 multidict_iter_dealloc(MultidictIter *self)
 {
     PyTypeObject *tp = Py_TYPE(self);
+    mod_state *state = get_mod_state_by_cls(tp);
     PyObject_GC_UnTrack(self);
     Py_XDECREF(self->md);
-    tp->tp_free(self);
+    if (!freelist_push(&state->iter_freelist, (PyObject *)self)) {
+        tp->tp_free(self);
+    }
     Py_DECREF(tp);
 }
 
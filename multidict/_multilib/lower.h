@@ -0,0 +1,254 @@
+#include "pythoncapi_compat.h"
+
+#ifndef _MULTIDICT_LOWER_H
+#define _MULTIDICT_LOWER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <Python.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LOWER_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define LOWER_NEON 1
+#endif
+
+#include "state.h"
+
+/* ASCII case folding.
+
+   HTTP header names are ASCII nearly always, str.lower() for them is
+   replacing 'A'-'Z' with 'a'-'z'.  The kernels below process 16 bytes per
+   step with SSE2 or NEON, the scalar loop handles the tail and platforms
+   without SIMD.
+
+   Non-ASCII strings are lowered by str.lower(), the Unicode case mapping
+   could change the length of the string.
+
+   bytes_eq() shares the SIMD setup for comparing identities.
+*/
+
+#define LOWER_STEP 16
+
+static inline Py_UCS1
+_ascii_lower_char(Py_UCS1 ch)
+{
+    return (ch >= 'A' && ch <= 'Z') ? (Py_UCS1)(ch + ('a' - 'A')) : ch;
+}
+
+#if defined(LOWER_SSE2)
+
+// 0xFF for upper case letters, 0x00 otherwise; ASCII bytes are positive
+static inline __m128i
+_ascii_upper_mask(__m128i v)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+}
+
+#elif defined(LOWER_NEON)
+
+static inline uint8x16_t
+_ascii_upper_mask(uint8x16_t v)
+{
+    return vandq_u8(vcgeq_u8(v, vdupq_n_u8('A')), vcleq_u8(v, vdupq_n_u8('Z')));
+}
+
+#endif
+
+/* Return true if ASCII data has upper case letters */
+static inline bool
+ascii_has_upper(const Py_UCS1 *src, Py_ssize_t len)
+{
+    Py_ssize_t i = 0;
+#if defined(LOWER_SSE2)
+    for (; i + LOWER_STEP <= len; i += LOWER_STEP) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        if (_mm_movemask_epi8(_ascii_upper_mask(v)) != 0) {
+            return true;
+        }
+    }
+#elif defined(LOWER_NEON)
+    for (; i + LOWER_STEP <= len; i += LOWER_STEP) {
+        uint8x16_t v = vld1q_u8(src + i);
+        if (vmaxvq_u8(_ascii_upper_mask(v)) != 0) {
+            return true;
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        if (src[i] >= 'A' && src[i] <= 'Z') {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Copy lowered ASCII data */
+static inline void
+ascii_lower_copy(Py_UCS1 *dst, const Py_UCS1 *src, Py_ssize_t len)
+{
+    Py_ssize_t i = 0;
+#if defined(LOWER_SSE2)
+    const __m128i delta = _mm_set1_epi8('a' - 'A');
+    for (; i + LOWER_STEP <= len; i += LOWER_STEP) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        v = _mm_add_epi8(v, _mm_and_si128(_ascii_upper_mask(v), delta));
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+#elif defined(LOWER_NEON)
+    const uint8x16_t delta = vdupq_n_u8('a' - 'A');
+    for (; i + LOWER_STEP <= len; i += LOWER_STEP) {
+        uint8x16_t v = vld1q_u8(src + i);
+        v = vaddq_u8(v, vandq_u8(_ascii_upper_mask(v), delta));
+        vst1q_u8(dst + i, v);
+    }
+#endif
+    for (; i < len; i++) {
+        dst[i] = _ascii_lower_char(src[i]);
+    }
+}
+
+/* Return true if lowered ASCII data a is equal to b */
+static inline bool
+ascii_lower_eq(const Py_UCS1 *a, const Py_UCS1 *b, Py_ssize_t len)
+{
+    Py_ssize_t i = 0;
+#if defined(LOWER_SSE2)
+    const __m128i delta = _mm_set1_epi8('a' - 'A');
+    for (; i + LOWER_STEP <= len; i += LOWER_STEP) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(a + i));
+        v = _mm_add_epi8(v, _mm_and_si128(_ascii_upper_mask(v), delta));
+        __m128i w = _mm_loadu_si128((const __m128i *)(b + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, w)) != 0xFFFF) {
+            return false;
+        }
+    }
+#elif defined(LOWER_NEON)
+    const uint8x16_t delta = vdupq_n_u8('a' - 'A');
+    for (; i + LOWER_STEP <= len; i += LOWER_STEP) {
+        uint8x16_t v = vld1q_u8(a + i);
+        v = vaddq_u8(v, vandq_u8(_ascii_upper_mask(v), delta));
+        if (vminvq_u8(vceqq_u8(v, vld1q_u8(b + i))) == 0) {
+            return false;
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        if (_ascii_lower_char(a[i]) != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Return true if n bytes of a and b are equal.
+
+   Identities are short, the kernel compares them by overlapping loads
+   instead of calling memcmp().
+*/
+static inline bool
+bytes_eq(const void *a, const void *b, size_t n)
+{
+    const unsigned char *p = (const unsigned char *)a;
+    const unsigned char *q = (const unsigned char *)b;
+    if (n >= 16) {
+#if defined(LOWER_SSE2)
+        size_t i = 0;
+        for (; i + LOWER_STEP < n; i += LOWER_STEP) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+            __m128i w = _mm_loadu_si128((const __m128i *)(q + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, w)) != 0xFFFF) {
+                return false;
+            }
+        }
+        // the last block overlaps the previous one
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + n - LOWER_STEP));
+        __m128i w = _mm_loadu_si128((const __m128i *)(q + n - LOWER_STEP));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(v, w)) == 0xFFFF;
+#elif defined(LOWER_NEON)
+        size_t i = 0;
+        for (; i + LOWER_STEP < n; i += LOWER_STEP) {
+            if (vminvq_u8(vceqq_u8(vld1q_u8(p + i), vld1q_u8(q + i))) == 0) {
+                return false;
+            }
+        }
+        return vminvq_u8(vceqq_u8(vld1q_u8(p + n - LOWER_STEP),
+                                  vld1q_u8(q + n - LOWER_STEP))) != 0;
+#else
+        return memcmp(p, q, n) == 0;
+#endif
+    }
+    if (n >= 8) {
+        uint64_t p0, q0, p1, q1;
+        memcpy(&p0, p, 8);
+        memcpy(&q0, q, 8);
+        memcpy(&p1, p + n - 8, 8);
+        memcpy(&q1, q + n - 8, 8);
+        return ((p0 ^ q0) | (p1 ^ q1)) == 0;
+    }
+    if (n >= 4) {
+        uint32_t p0, q0, p1, q1;
+        memcpy(&p0, p, 4);
+        memcpy(&q0, q, 4);
+        memcpy(&p1, p + n - 4, 4);
+        memcpy(&q1, q + n - 4, 4);
+        return ((p0 ^ q0) | (p1 ^ q1)) == 0;
+    }
+    if (n > 0) {
+        // 1 to 3 bytes
+        return p[0] == q[0] && p[n / 2] == q[n / 2] && p[n - 1] == q[n - 1];
+    }
+    return true;
+}
+
+/* Return str.lower() of the str or str subclass as an exact str.
+
+   An exact str without upper case ASCII letters is returned as is.
+   The lower() method of user-defined subclasses is respected.
+*/
+static inline PyObject *
+lower_str(mod_state *state, PyObject *str)
+{
+    assert(PyUnicode_Check(str));
+    if ((PyUnicode_CheckExact(str) || Py_IS_TYPE(str, state->IStrType)) &&
+        PyUnicode_IS_ASCII(str)) {
+        Py_ssize_t len = PyUnicode_GET_LENGTH(str);
+        const Py_UCS1 *data = PyUnicode_1BYTE_DATA(str);
+        if (!ascii_has_upper(data, len)) {
+            if (PyUnicode_CheckExact(str)) {
+                return Py_NewRef(str);
+            }
+            return PyUnicode_FromObject(str);
+        }
+        PyObject *ret = PyUnicode_New(len, 127);
+        if (ret == NULL) {
+            return NULL;
+        }
+        ascii_lower_copy(PyUnicode_1BYTE_DATA(ret), data, len);
+        return ret;
+    }
+    PyObject *ret = PyObject_CallMethodNoArgs(str, state->str_lower);
+    if (ret == NULL) {
+        return NULL;
+    }
+    if (!PyUnicode_CheckExact(ret)) {
+        PyObject *tmp = PyUnicode_FromObject(ret);
+        Py_CLEAR(ret);
+        return tmp;
+    }
+    return ret;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,923 @@
+#include "pythoncapi_compat.h"
+
+#ifndef _MULTIDICT_PERSISTENT_H
+#define _MULTIDICT_PERSISTENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <Python.h>
+#include <stdbool.h>
+
+#include "dict.h"
+#include "hashtable.h"
+#include "htkeys.h"
+#include "state.h"
+
+/* Persistent multidict.
+
+   A version is never modified once built: pmd_add(), pmd_replace() and
+   pmd_del() are applied to a fresh shallow copy of the version and replace
+   the touched paths of its tries, all other nodes are shared with the
+   original.  Nodes are tuples or PMDNodeObject for the index: they are
+   immutable, reference counted and tracked by the GC, sharing needs no
+   bookkeeping.
+
+   Items are tuples (identity, key, value, pos), every item is referenced
+   by both tries:
+
+   - The order trie keeps the items by their position in the insertion
+     order.  A node has up to PMD_WIDTH children, the leaves are items or
+     None for removed ones.  An item is appended at the `nentries` position,
+     the trie grows by a level when the root is full.  Positions of removed
+     items are not reused, the tries are rebuilt when removed items
+     outnumber the live ones.
+
+   - The index is a hash array mapped trie from the identity to the vector
+     of its items.  A node holds a bitmap and the slots
+     key0, value0, key1, value1, ...: the pairs are sorted by the PMD_BITS
+     hash chunk of the node level, the bitmap has a bit set for every chunk
+     present.  A pair with None key holds a subnode for the chunk.  The
+     hash is folded to 32 bits, keys with equal folded hashes live in a
+     collision node with zero bitmap below the last level.
+
+   - The items of a key are a vector in the insertion order: a tuple of up
+     to PMD_WIDTH items, or (None, count, root) for more of them where root
+     is an order trie node without holes of the _pmd_vec_shift(count)
+     level.  The vector is replaced as a whole by pmd_replace() and
+     pmd_del(), only pmd_add() appends to it.
+
+   An update copies O(log n) nodes of up to PMD_WIDTH items in both tries
+   and O(log k) nodes in the vector of a key with k items.
+*/
+
+#define PMD_BITS 5
+#define PMD_WIDTH (1 << PMD_BITS)
+#define PMD_MASK (PMD_WIDTH - 1)
+// the shift of the last index level of a 32-bit hash
+#define PMD_MAX_SHIFT 30
+// don't rebuild small tries, removed items cost a pointer each
+#define PMD_REBUILD_MIN PMD_WIDTH
+
+#define PMD_ITEM_IDENTITY 0
+#define PMD_ITEM_KEY 1
+#define PMD_ITEM_VALUE 2
+#define PMD_ITEM_POS 3
+
+static inline int
+_pmd_popcount(uint32_t x)
+{
+#if (defined(__clang__) || defined(__GNUC__))
+    return __builtin_popcount(x);
+#else
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    return (int)((((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+#endif
+}
+
+static inline uint32_t
+_pmd_hash32(Py_hash_t hash)
+{
+    uint64_t h = (uint64_t)hash;
+    return (uint32_t)h ^ (uint32_t)(h >> 32);
+}
+
+static inline Py_ssize_t
+_pmd_item_pos(PyObject *item)
+{
+    return PyLong_AsSsize_t(PyTuple_GET_ITEM(item, PMD_ITEM_POS));
+}
+
+/* Return a new tuple src[:i] + items[:n] + src[i + ndel:], src may be NULL
+ */
+static inline PyObject *
+_pmd_splice(PyObject *src, Py_ssize_t i, Py_ssize_t ndel,
+            PyObject *const *items, Py_ssize_t n)
+{
+    Py_ssize_t size = src == NULL ? 0 : PyTuple_GET_SIZE(src);
+    assert(i >= 0 && i + ndel <= size);
+    assert(size - ndel + n > 0);
+    PyObject *ret = PyTuple_New(size - ndel + n);
+    if (ret == NULL) {
+        return NULL;
+    }
+    Py_ssize_t j = 0;
+    for (Py_ssize_t k = 0; k < i; k++) {
+        PyTuple_SET_ITEM(ret, j++, Py_NewRef(PyTuple_GET_ITEM(src, k)));
+    }
+    for (Py_ssize_t k = 0; k < n; k++) {
+        PyTuple_SET_ITEM(ret, j++, Py_NewRef(items[k]));
+    }
+    for (Py_ssize_t k = i + ndel; k < size; k++) {
+        PyTuple_SET_ITEM(ret, j++, Py_NewRef(PyTuple_GET_ITEM(src, k)));
+    }
+    return ret;
+}
+
+/******************** Order trie ********************/
+
+static PyObject *
+_pmd_order_set(PyObject *node, int shift, Py_ssize_t pos, PyObject *item)
+{
+    Py_ssize_t size = node == NULL ? 0 : PyTuple_GET_SIZE(node);
+    Py_ssize_t i = (pos >> shift) & PMD_MASK;
+    Py_ssize_t ndel = i < size ? 1 : 0;
+    assert(i <= size);
+    if (shift == 0) {
+        return _pmd_splice(node, i, ndel, &item, 1);
+    }
+    PyObject *child = _pmd_order_set(ndel ? PyTuple_GET_ITEM(node, i) : NULL,
+                                     shift - PMD_BITS,
+                                     pos,
+                                     item);
+    if (child == NULL) {
+        return NULL;
+    }
+    PyObject *ret = _pmd_splice(node, i, ndel, &child, 1);
+    Py_DECREF(child);
+    return ret;
+}
+
+/* Store the item (None for a removed one) at the position, the position of
+   a new item is pmd->nentries */
+static inline int
+_pmd_set_at(PersistentMultiDictObject *pmd, Py_ssize_t pos, PyObject *item)
+{
+    assert(pos <= pmd->nentries);
+    if (pmd->order != NULL && pos == (Py_ssize_t)1 << (pmd->shift + PMD_BITS)) {
+        // the root is full
+        PyObject *root = _pmd_splice(NULL, 0, 0, &pmd->order, 1);
+        if (root == NULL) {
+            return -1;
+        }
+        Py_SETREF(pmd->order, root);
+        pmd->shift += PMD_BITS;
+    }
+    PyObject *root = _pmd_order_set(pmd->order, pmd->shift, pos, item);
+    if (root == NULL) {
+        return -1;
+    }
+    Py_XSETREF(pmd->order, root);
+    return 0;
+}
+
+typedef int (*pmd_visit_fn)(PyObject *item, void *arg);
+
+static int
+_pmd_order_visit(PyObject *node, int shift, pmd_visit_fn fn, void *arg)
+{
+    Py_ssize_t size = PyTuple_GET_SIZE(node);
+    for (Py_ssize_t i = 0; i < size; i++) {
+        PyObject *child = PyTuple_GET_ITEM(node, i);
+        int ret;
+        if (shift > 0) {
+            ret = _pmd_order_visit(child, shift - PMD_BITS, fn, arg);
+        } else if (child == Py_None) {
+            continue;
+        } else {
+            ret = fn(child, arg);
+        }
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+/* Call fn for every item in the insertion order */
+static inline int
+pmd_visit(PersistentMultiDictObject *pmd, pmd_visit_fn fn, void *arg)
+{
+    if (pmd->order == NULL) {
+        return 0;
+    }
+    return _pmd_order_visit(pmd->order, pmd->shift, fn, arg);
+}
+
+/******************** Items of a key ********************/
+
+/* The level of the root of a vector of more than PMD_WIDTH items */
+static inline int
+_pmd_vec_shift(Py_ssize_t count)
+{
+    int shift = 0;
+    while ((count - 1) >> (shift + PMD_BITS)) {
+        shift += PMD_BITS;
+    }
+    return shift;
+}
+
+static inline bool
+_pmd_vec_is_flat(PyObject *items)
+{
+    return PyTuple_GET_ITEM(items, 0) != Py_None;
+}
+
+static inline Py_ssize_t
+pmd_items_count(PyObject *items)
+{
+    if (_pmd_vec_is_flat(items)) {
+        return PyTuple_GET_SIZE(items);
+    }
+    return PyLong_AsSsize_t(PyTuple_GET_ITEM(items, 1));
+}
+
+/* Return a borrowed reference to the first item, never fails */
+static inline PyObject *
+pmd_items_first(PyObject *items)
+{
+    if (!_pmd_vec_is_flat(items)) {
+        int shift = _pmd_vec_shift(pmd_items_count(items));
+        items = PyTuple_GET_ITEM(items, 2);
+        for (; shift > 0; shift -= PMD_BITS) {
+            items = PyTuple_GET_ITEM(items, 0);
+        }
+    }
+    return PyTuple_GET_ITEM(items, 0);
+}
+
+/* Call fn for every item of the vector in the insertion order */
+static inline int
+pmd_items_visit(PyObject *items, pmd_visit_fn fn, void *arg)
+{
+    if (_pmd_vec_is_flat(items)) {
+        return _pmd_order_visit(items, 0, fn, arg);
+    }
+    return _pmd_order_visit(PyTuple_GET_ITEM(items, 2),
+                            _pmd_vec_shift(pmd_items_count(items)),
+                            fn,
+                            arg);
+}
+
+/* Return a new vector with the item appended, items may be NULL */
+static PyObject *
+_pmd_items_append(PyObject *items, PyObject *item)
+{
+    Py_ssize_t count = items == NULL ? 0 : pmd_items_count(items);
+    if (count < PMD_WIDTH) {
+        return _pmd_splice(items, count, 0, &item, 1);
+    }
+    PyObject *root =
+        _pmd_vec_is_flat(items) ? items : PyTuple_GET_ITEM(items, 2);
+    int shift = _pmd_vec_shift(count + 1);
+    if (shift > _pmd_vec_shift(count)) {
+        // the root is full
+        root = _pmd_splice(NULL, 0, 0, &root, 1);
+        if (root == NULL) {
+            return NULL;
+        }
+    } else {
+        Py_INCREF(root);
+    }
+    PyObject *new_root = _pmd_order_set(root, shift, count, item);
+    Py_DECREF(root);
+    if (new_root == NULL) {
+        return NULL;
+    }
+    PyObject *size = PyLong_FromSsize_t(count + 1);
+    if (size == NULL) {
+        Py_DECREF(new_root);
+        return NULL;
+    }
+    PyObject *ret = PyTuple_Pack(3, Py_None, size, new_root);
+    Py_DECREF(size);
+    Py_DECREF(new_root);
+    return ret;
+}
+
+/******************** Index ********************/
+
+typedef struct {
+    PyObject_VAR_HEAD
+    uint32_t bitmap;  // zero for a collision node
+    PyObject *slots[1];  // key0, value0, key1, value1, ...
+} PMDNodeObject;
+
+/* Return a new node with the bitmap and the slots
+   src[:i] + items[:n] + src[i + ndel:], src may be NULL */
+static PMDNodeObject *
+_pmd_node_splice(mod_state *state, uint32_t bitmap, PMDNodeObject *src,
+                 Py_ssize_t i, Py_ssize_t ndel, PyObject *const *items,
+                 Py_ssize_t n)
+{
+    Py_ssize_t size = src == NULL ? 0 : Py_SIZE(src);
+    assert(i >= 0 && i + ndel <= size);
+    assert(size - ndel + n > 0);
+    PMDNodeObject *ret = PyObject_GC_NewVar(
+        PMDNodeObject, state->PMDNodeType, size - ndel + n);
+    if (ret == NULL) {
+        return NULL;
+    }
+    ret->bitmap = bitmap;
+    Py_ssize_t j = 0;
+    for (Py_ssize_t k = 0; k < i; k++) {
+        ret->slots[j++] = Py_NewRef(src->slots[k]);
+    }
+    for (Py_ssize_t k = 0; k < n; k++) {
+        ret->slots[j++] = Py_NewRef(items[k]);
+    }
+    for (Py_ssize_t k = i + ndel; k < size; k++) {
+        ret->slots[j++] = Py_NewRef(src->slots[k]);
+    }
+    PyObject_GC_Track(ret);
+    return ret;
+}
+
+static inline bool
+_pmd_identity_eq(PyObject *a, PyObject *identity, Py_hash_t hash)
+{
+    return a == identity ||
+           (_unicode_hash(a) == hash && _htkeys_str_eq(a, identity));
+}
+
+/* Return a borrowed reference to the items of the identity or NULL,
+   never fails */
+static inline PyObject *
+_pmd_index_find(PMDNodeObject *node, Py_hash_t hash, PyObject *identity)
+{
+    uint32_t h = _pmd_hash32(hash);
+    int shift = 0;
+    while (node != NULL) {
+        uint32_t bitmap = node->bitmap;
+        if (bitmap == 0) {
+            Py_ssize_t size = Py_SIZE(node);
+            for (Py_ssize_t i = 0; i < size; i += 2) {
+                if (_pmd_identity_eq(node->slots[i], identity, hash)) {
+                    return node->slots[i + 1];
+                }
+            }
+            return NULL;
+        }
+        uint32_t bit = (uint32_t)1 << ((h >> shift) & PMD_MASK);
+        if (!(bitmap & bit)) {
+            return NULL;
+        }
+        Py_ssize_t i = 2 * _pmd_popcount(bitmap & (bit - 1));
+        PyObject *key = node->slots[i];
+        PyObject *value = node->slots[i + 1];
+        if (key != Py_None) {
+            return _pmd_identity_eq(key, identity, hash) ? value : NULL;
+        }
+        node = (PMDNodeObject *)value;
+        shift += PMD_BITS;
+    }
+    return NULL;
+}
+
+/* A node for two keys which hashes are equal below the shift */
+static PMDNodeObject *
+_pmd_index_pair(mod_state *state, int shift, PyObject *key1,
+                PyObject *value1, uint32_t h1, PyObject *key2,
+                PyObject *value2, uint32_t h2)
+{
+    if (shift > PMD_MAX_SHIFT) {
+        assert(h1 == h2);
+        PyObject *items[] = {key1, value1, key2, value2};
+        return _pmd_node_splice(state, 0, NULL, 0, 0, items, 4);
+    }
+    uint32_t i1 = (h1 >> shift) & PMD_MASK;
+    uint32_t i2 = (h2 >> shift) & PMD_MASK;
+    if (i1 == i2) {
+        PMDNodeObject *sub = _pmd_index_pair(
+            state, shift + PMD_BITS, key1, value1, h1, key2, value2, h2);
+        if (sub == NULL) {
+            return NULL;
+        }
+        PyObject *items[] = {Py_None, (PyObject *)sub};
+        PMDNodeObject *ret =
+            _pmd_node_splice(state, 1u << i1, NULL, 0, 0, items, 2);
+        Py_DECREF(sub);
+        return ret;
+    }
+    uint32_t bitmap = (1u << i1) | (1u << i2);
+    if (i1 < i2) {
+        PyObject *items[] = {key1, value1, key2, value2};
+        return _pmd_node_splice(state, bitmap, NULL, 0, 0, items, 4);
+    } else {
+        PyObject *items[] = {key2, value2, key1, value1};
+        return _pmd_node_splice(state, bitmap, NULL, 0, 0, items, 4);
+    }
+}
+
+/* Return a new node which maps the identity to the value */
+static PMDNodeObject *
+_pmd_index_assoc(mod_state *state, PMDNodeObject *node, int shift,
+                 Py_hash_t hash, PyObject *identity, PyObject *value)
+{
+    uint32_t h = _pmd_hash32(hash);
+    if (node == NULL) {
+        PyObject *items[] = {identity, value};
+        return _pmd_node_splice(
+            state, 1u << ((h >> shift) & PMD_MASK), NULL, 0, 0, items, 2);
+    }
+    uint32_t bitmap = node->bitmap;
+    if (bitmap == 0) {
+        Py_ssize_t size = Py_SIZE(node);
+        for (Py_ssize_t i = 0; i < size; i += 2) {
+            if (_pmd_identity_eq(node->slots[i], identity, hash)) {
+                return _pmd_node_splice(state, 0, node, i + 1, 1, &value, 1);
+            }
+        }
+        PyObject *items[] = {identity, value};
+        return _pmd_node_splice(state, 0, node, size, 0, items, 2);
+    }
+    uint32_t bit = (uint32_t)1 << ((h >> shift) & PMD_MASK);
+    Py_ssize_t i = 2 * _pmd_popcount(bitmap & (bit - 1));
+    if (!(bitmap & bit)) {
+        PyObject *items[] = {identity, value};
+        return _pmd_node_splice(state, bitmap | bit, node, i, 0, items, 2);
+    }
+    PyObject *key = node->slots[i];
+    PyObject *old = node->slots[i + 1];
+    PMDNodeObject *child;
+    if (key == Py_None) {
+        child = _pmd_index_assoc(state,
+                                 (PMDNodeObject *)old,
+                                 shift + PMD_BITS,
+                                 hash,
+                                 identity,
+                                 value);
+        if (child == NULL) {
+            return NULL;
+        }
+        PyObject *items[] = {(PyObject *)child};
+        PMDNodeObject *ret =
+            _pmd_node_splice(state, bitmap, node, i + 1, 1, items, 1);
+        Py_DECREF(child);
+        return ret;
+    }
+    if (_pmd_identity_eq(key, identity, hash)) {
+        return _pmd_node_splice(state, bitmap, node, i + 1, 1, &value, 1);
+    }
+    child = _pmd_index_pair(state,
+                            shift + PMD_BITS,
+                            key,
+                            old,
+                            _pmd_hash32(_unicode_hash(key)),
+                            identity,
+                            value,
+                            h);
+    if (child == NULL) {
+        return NULL;
+    }
+    PyObject *items[] = {Py_None, (PyObject *)child};
+    PMDNodeObject *ret = _pmd_node_splice(state, bitmap, node, i, 2, items, 2);
+    Py_DECREF(child);
+    return ret;
+}
+
+/* Store a new node without the identity to *pret, NULL if the node becomes
+   empty.  The identity must be present. */
+static int
+_pmd_index_without(mod_state *state, PMDNodeObject *node, int shift,
+                   Py_hash_t hash, PyObject *identity, PMDNodeObject **pret)
+{
+    Py_ssize_t size = Py_SIZE(node);
+    uint32_t bitmap = node->bitmap;
+    Py_ssize_t i;
+    *pret = NULL;
+    if (bitmap == 0) {
+        for (i = 0; i < size; i += 2) {
+            if (_pmd_identity_eq(node->slots[i], identity, hash)) {
+                break;
+            }
+        }
+        assert(i < size);
+        if (size == 2) {
+            return 0;
+        }
+        *pret = _pmd_node_splice(state, 0, node, i, 2, NULL, 0);
+        return *pret == NULL ? -1 : 0;
+    }
+    uint32_t bit = (uint32_t)1 << ((_pmd_hash32(hash) >> shift) & PMD_MASK);
+    assert(bitmap & bit);
+    i = 2 * _pmd_popcount(bitmap & (bit - 1));
+    if (node->slots[i] == Py_None) {
+        PMDNodeObject *child;
+        if (_pmd_index_without(state,
+                               (PMDNodeObject *)node->slots[i + 1],
+                               shift + PMD_BITS,
+                               hash,
+                               identity,
+                               &child) < 0) {
+            return -1;
+        }
+        if (child != NULL) {
+            PyObject *items[] = {Py_None, (PyObject *)child};
+            if (Py_SIZE(child) == 2 && child->slots[0] != Py_None) {
+                // a single key left in the subnode, pull it up
+                items[0] = child->slots[0];
+                items[1] = child->slots[1];
+            }
+            *pret = _pmd_node_splice(state, bitmap, node, i, 2, items, 2);
+            Py_DECREF(child);
+            return *pret == NULL ? -1 : 0;
+        }
+    } else {
+        assert(_pmd_identity_eq(node->slots[i], identity, hash));
+    }
+    if (bitmap == bit) {
+        return 0;
+    }
+    *pret = _pmd_node_splice(state, bitmap & ~bit, node, i, 2, NULL, 0);
+    return *pret == NULL ? -1 : 0;
+}
+
+static void
+pmd_node_dealloc(PMDNodeObject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+    PyObject_GC_UnTrack(self);
+    for (Py_ssize_t i = 0; i < Py_SIZE(self); i++) {
+        Py_XDECREF(self->slots[i]);
+    }
+    tp->tp_free(self);
+    Py_DECREF(tp);
+}
+
+static int
+pmd_node_traverse(PMDNodeObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(Py_TYPE(self));
+    for (Py_ssize_t i = 0; i < Py_SIZE(self); i++) {
+        Py_VISIT(self->slots[i]);
+    }
+    return 0;
+}
+
+static PyType_Slot pmd_node_slots[] = {
+    {Py_tp_dealloc, pmd_node_dealloc},
+    {Py_tp_traverse, pmd_node_traverse},
+    {0, NULL},
+};
+
+static PyType_Spec pmd_node_spec = {
+    .name = "multidict._multidict._persistentnode",
+    .basicsize = offsetof(PMDNodeObject, slots),
+    .itemsize = sizeof(PyObject *),
+    .flags = (Py_TPFLAGS_DEFAULT
+#if PY_VERSION_HEX >= 0x030a00f0
+              | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+              | Py_TPFLAGS_HAVE_GC),
+    .slots = pmd_node_slots,
+};
+
+static inline int
+pmd_node_init(PyObject *module, mod_state *state)
+{
+    PyObject *tmp = PyType_FromModuleAndSpec(module, &pmd_node_spec, NULL);
+    if (tmp == NULL) {
+        return -1;
+    }
+    state->PMDNodeType = (PyTypeObject *)tmp;
+    return 0;
+}
+
+/******************** Operations ********************/
+
+/* Init a new version sharing the tries of src, the object is allocated
+   already */
+static inline void
+pmd_init_from(PersistentMultiDictObject *pmd, PersistentMultiDictObject *src)
+{
+    pmd->state = src->state;
+    pmd->is_ci = src->is_ci;
+    pmd->used = src->used;
+    pmd->nentries = src->nentries;
+    pmd->shift = src->shift;
+    pmd->order = Py_XNewRef(src->order);
+    pmd->index = Py_XNewRef(src->index);
+    pmd->frozen = NULL;
+}
+
+static inline int
+_pmd_add_with_hash(PersistentMultiDictObject *pmd, Py_hash_t hash,
+                   PyObject *identity, PyObject *key, PyObject *value)
+{
+    PyObject *item = NULL;
+    PyObject *items = NULL;
+    PyObject *pos = PyLong_FromSsize_t(pmd->nentries);
+    if (pos == NULL) {
+        goto fail;
+    }
+    item = PyTuple_Pack(4, identity, key, value, pos);
+    if (item == NULL) {
+        goto fail;
+    }
+    if (_pmd_set_at(pmd, pmd->nentries, item) < 0) {
+        goto fail;
+    }
+    pmd->nentries += 1;
+    items = _pmd_items_append(
+        _pmd_index_find((PMDNodeObject *)pmd->index, hash, identity), item);
+    if (items == NULL) {
+        goto fail;
+    }
+    PMDNodeObject *index = _pmd_index_assoc(
+        pmd->state, (PMDNodeObject *)pmd->index, 0, hash, identity, items);
+    if (index == NULL) {
+        goto fail;
+    }
+    Py_XSETREF(pmd->index, (PyObject *)index);
+    pmd->used += 1;
+    Py_DECREF(items);
+    Py_DECREF(item);
+    Py_DECREF(pos);
+    return 0;
+fail:
+    Py_XDECREF(items);
+    Py_XDECREF(item);
+    Py_XDECREF(pos);
+    return -1;
+}
+
+static int
+_pmd_rebuild_item(PyObject *item, void *arg)
+{
+    PyObject *identity = PyTuple_GET_ITEM(item, PMD_ITEM_IDENTITY);
+    return _pmd_add_with_hash((PersistentMultiDictObject *)arg,
+                              _unicode_hash(identity),
+                              identity,
+                              PyTuple_GET_ITEM(item, PMD_ITEM_KEY),
+                              PyTuple_GET_ITEM(item, PMD_ITEM_VALUE));
+}
+
+/* Drop the removed items by rebuilding the tries from scratch, O(n) after
+   at least n / 2 removals */
+static inline int
+_pmd_rebuild_if_sparse(PersistentMultiDictObject *pmd)
+{
+    if (pmd->nentries < PMD_REBUILD_MIN ||
+        pmd->nentries - pmd->used <= pmd->used) {
+        return 0;
+    }
+    PyObject *order = pmd->order;
+    PyObject *index = pmd->index;
+    int shift = pmd->shift;
+    pmd->order = NULL;
+    pmd->index = NULL;
+    pmd->shift = 0;
+    pmd->nentries = 0;
+    pmd->used = 0;
+    int ret = 0;
+    if (order != NULL) {
+        ret = _pmd_order_visit(order, shift, _pmd_rebuild_item, pmd);
+    }
+    Py_XDECREF(order);
+    Py_XDECREF(index);
+    return ret;
+}
+
+static inline int
+_pmd_lookup(PersistentMultiDictObject *pmd, PyObject *key,
+            PyObject **pidentity, Py_hash_t *phash)
+{
+    PyObject *identity = _md_calc_identity(pmd->state, key, pmd->is_ci);
+    if (identity == NULL) {
+        return -1;
+    }
+    Py_hash_t hash = _unicode_hash(identity);
+    if (hash == -1) {
+        Py_DECREF(identity);
+        return -1;
+    }
+    *pidentity = identity;
+    *phash = hash;
+    return 0;
+}
+
+/* Store a borrowed reference to the vector of items of the key to *pitems,
+   return 1 if found, 0 if not found and -1 on error */
+static inline int
+pmd_find(PersistentMultiDictObject *pmd, PyObject *key, PyObject **pitems)
+{
+    PyObject *identity;
+    Py_hash_t hash;
+    *pitems = NULL;
+    if (_pmd_lookup(pmd, key, &identity, &hash) < 0) {
+        return -1;
+    }
+    *pitems = _pmd_index_find((PMDNodeObject *)pmd->index, hash, identity);
+    Py_DECREF(identity);
+    return *pitems != NULL;
+}
+
+typedef struct {
+    PyObject *list;
+    Py_ssize_t pos;
+} _pmd_values_t;
+
+static int
+_pmd_value_to_list(PyObject *item, void *arg)
+{
+    _pmd_values_t *values = (_pmd_values_t *)arg;
+    PyList_SET_ITEM(values->list,
+                    values->pos++,
+                    Py_NewRef(PyTuple_GET_ITEM(item, PMD_ITEM_VALUE)));
+    return 0;
+}
+
+/* Return a new list of the values of the vector of items */
+static inline PyObject *
+pmd_items_values(PyObject *items)
+{
+    _pmd_values_t values = {PyList_New(pmd_items_count(items)), 0};
+    if (values.list == NULL) {
+        return NULL;
+    }
+    pmd_items_visit(items, _pmd_value_to_list, &values);
+    assert(values.pos == PyList_GET_SIZE(values.list));
+    return values.list;
+}
+
+static inline int
+pmd_add(PersistentMultiDictObject *pmd, PyObject *key, PyObject *value)
+{
+    PyObject *identity;
+    Py_hash_t hash;
+    if (_pmd_lookup(pmd, key, &identity, &hash) < 0) {
+        return -1;
+    }
+    int ret = _pmd_add_with_hash(pmd, hash, identity, key, value);
+    Py_DECREF(identity);
+    return ret;
+}
+
+static int
+_pmd_remove_item(PyObject *item, void *arg)
+{
+    return _pmd_set_at(
+        (PersistentMultiDictObject *)arg, _pmd_item_pos(item), Py_None);
+}
+
+/* Replace the value of the first item of the key and remove the rest of
+   them like md[key] = value does */
+static inline int
+pmd_replace(PersistentMultiDictObject *pmd, PyObject *key, PyObject *value)
+{
+    PyObject *identity;
+    Py_hash_t hash;
+    PyObject *item = NULL;
+    PyObject *new_items = NULL;
+    if (_pmd_lookup(pmd, key, &identity, &hash) < 0) {
+        return -1;
+    }
+    PyObject *items = Py_XNewRef(
+        _pmd_index_find((PMDNodeObject *)pmd->index, hash, identity));
+    if (items == NULL) {
+        int ret = _pmd_add_with_hash(pmd, hash, identity, key, value);
+        Py_DECREF(identity);
+        return ret;
+    }
+    PyObject *first = pmd_items_first(items);
+    item = PyTuple_Pack(4,
+                        PyTuple_GET_ITEM(first, PMD_ITEM_IDENTITY),
+                        key,
+                        value,
+                        PyTuple_GET_ITEM(first, PMD_ITEM_POS));
+    if (item == NULL) {
+        goto fail;
+    }
+    if (pmd_items_visit(items, _pmd_remove_item, pmd) < 0) {
+        goto fail;
+    }
+    if (_pmd_set_at(pmd, _pmd_item_pos(first), item) < 0) {
+        goto fail;
+    }
+    new_items = _pmd_splice(NULL, 0, 0, &item, 1);
+    if (new_items == NULL) {
+        goto fail;
+    }
+    PMDNodeObject *index = _pmd_index_assoc(
+        pmd->state, (PMDNodeObject *)pmd->index, 0, hash, identity, new_items);
+    if (index == NULL) {
+        goto fail;
+    }
+    Py_SETREF(pmd->index, (PyObject *)index);
+    pmd->used -= pmd_items_count(items) - 1;
+    Py_DECREF(new_items);
+    Py_DECREF(item);
+    Py_DECREF(items);
+    Py_DECREF(identity);
+    return _pmd_rebuild_if_sparse(pmd);
+fail:
+    Py_XDECREF(new_items);
+    Py_XDECREF(item);
+    Py_DECREF(items);
+    Py_DECREF(identity);
+    return -1;
+}
+
+/* Remove all items of the key, raise KeyError if there is no such key */
+static inline int
+pmd_del(PersistentMultiDictObject *pmd, PyObject *key)
+{
+    PyObject *identity;
+    Py_hash_t hash;
+    if (_pmd_lookup(pmd, key, &identity, &hash) < 0) {
+        return -1;
+    }
+    PyObject *items = Py_XNewRef(
+        _pmd_index_find((PMDNodeObject *)pmd->index, hash, identity));
+    if (items == NULL) {
+        Py_DECREF(identity);
+        PyErr_SetObject(PyExc_KeyError, key);
+        return -1;
+    }
+    if (pmd_items_visit(items, _pmd_remove_item, pmd) < 0) {
+        goto fail;
+    }
+    PMDNodeObject *index;
+    if (_pmd_index_without(pmd->state,
+                           (PMDNodeObject *)pmd->index,
+                           0,
+                           hash,
+                           identity,
+                           &index) < 0) {
+        goto fail;
+    }
+    Py_XSETREF(pmd->index, (PyObject *)index);
+    pmd->used -= pmd_items_count(items);
+    if (pmd->used == 0) {
+        // start from scratch
+        Py_CLEAR(pmd->order);
+        pmd->shift = 0;
+        pmd->nentries = 0;
+    }
+    Py_DECREF(items);
+    Py_DECREF(identity);
+    return _pmd_rebuild_if_sparse(pmd);
+fail:
+    Py_DECREF(items);
+    Py_DECREF(identity);
+    return -1;
+}
+
+/* Append all items of a multidict */
+static inline int
+pmd_extend_from_md(PersistentMultiDictObject *pmd, MultiDictObject *md)
+{
+    entry_t *entries = htkeys_entries(md->keys);
+    for (Py_ssize_t pos = 0; pos < md->keys->nentries; pos++) {
+        entry_t *entry = entries + pos;
+        if (entry->identity == NULL) {
+            continue;
+        }
+        if (_pmd_add_with_hash(pmd,
+                               htkeys_entry_hash(entry),
+                               entry->identity,
+                               entry->key,
+                               _md_entry_value(md, entry)) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int
+_pmd_to_md_item(PyObject *item, void *arg)
+{
+    PyObject *identity = PyTuple_GET_ITEM(item, PMD_ITEM_IDENTITY);
+    return _md_add_with_hash((MultiDictObject *)arg,
+                             _unicode_hash(identity),
+                             identity,
+                             PyTuple_GET_ITEM(item, PMD_ITEM_KEY),
+                             PyTuple_GET_ITEM(item, PMD_ITEM_VALUE));
+}
+
+/* Append all items to a multidict of the same case sensitivity */
+static inline int
+pmd_to_md(PersistentMultiDictObject *pmd, MultiDictObject *md)
+{
+    assert(pmd->is_ci == md->is_ci);
+    return pmd_visit(pmd, _pmd_to_md_item, md);
+}
+
+static inline int
+pmd_traverse(PersistentMultiDictObject *pmd, visitproc visit, void *arg)
+{
+    Py_VISIT(pmd->order);
+    Py_VISIT(pmd->index);
+    Py_VISIT(pmd->frozen);
+    return 0;
+}
+
+static inline int
+pmd_clear(PersistentMultiDictObject *pmd)
+{
+    pmd->used = 0;
+    pmd->nentries = 0;
+    pmd->shift = 0;
+    Py_CLEAR(pmd->order);
+    Py_CLEAR(pmd->index);
+    Py_CLEAR(pmd->frozen);
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -5,6 +5,75 @@
 extern "C" {
 #endif
 
+#include "freelist.h"
+#include "headers.h"
+#include "../multidict_api.h"
+
+/* Pool of released htkeys_t tables, see htkeys_new() and htkeys_free().
+
+   Tables are recycled by log2_size size class, the smallest
+   HTKEYS_POOL_NCLASSES classes starting from HT_LOG_MINSIZE are pooled.
+   Every class keeps at most maxsize tables.
+
+   The pool is a part of the module state and thus per-interpreter.
+   Free-threaded build guards it by a mutex.
+*/
+
+#define HTKEYS_POOL_NCLASSES 6
+#define HTKEYS_POOL_MAXSIZE 80
+
+struct _htkeys;
+
+typedef struct {
+    struct _htkeys *tables[HTKEYS_POOL_NCLASSES];
+    Py_ssize_t sizes[HTKEYS_POOL_NCLASSES];
+    Py_ssize_t maxsize;
+
+    uint64_t hits;
+    uint64_t misses;
+#ifdef Py_GIL_DISABLED
+    PyMutex mutex;
+#endif
+} htkeys_pool_t;
+
+/* Intern table of case-insensitive identities, see intern.h */
+
+#define INTERN_TABLE_SIZE 1024
+
+typedef struct {
+    PyObject *key;       // exact str, the original key or the identity
+    PyObject *identity;  // canonical identity of the key
+} intern_slot_t;
+
+typedef struct {
+    intern_slot_t *slots;
+    Py_ssize_t size;  // power of 2, 0 disables the table
+
+    uint64_t hits;
+    uint64_t misses;
+#ifdef Py_GIL_DISABLED
+    PyMutex mutex;
+#endif
+} intern_table_t;
+
+/* Cache of shared key layouts for split tables, see hashtable.h */
+
+#define LAYOUT_CACHE_SIZE 64
+
+typedef struct {
+    struct _htkeys *keys;  // the layout or NULL
+    bool is_ci;
+    uint8_t misses;  // constructions of other shapes since the last hit
+} layout_slot_t;
+
+typedef struct {
+    layout_slot_t slots[LAYOUT_CACHE_SIZE];
+    Py_ssize_t size;  // power of 2 up to LAYOUT_CACHE_SIZE, 0 disables
+
+    uint64_t hits;
+    uint64_t misses;
+} layout_cache_t;
+
 /* State of the _multidict module */
 typedef struct {
     PyTypeObject *IStrType;
@@ -13,6 +82,11 @@ typedef struct {
     PyTypeObject *CIMultiDictType;
     PyTypeObject *MultiDictProxyType;
     PyTypeObject *CIMultiDictProxyType;
+    PyTypeObject *FrozenMultiDictType;
+    PyTypeObject *FrozenCIMultiDictType;
+    PyTypeObject *PersistentMultiDictType;
+    PyTypeObject *PersistentCIMultiDictType;
+    PyTypeObject *PMDNodeType;
 
     PyTypeObject *KeysViewType;
     PyTypeObject *ItemsViewType;
@@ -25,8 +99,21 @@ typedef struct {
     PyObject *str_canonical;
     PyObject *str_lower;
     PyObject *str_name;
+    PyObject *str_keep_capacity;
 
     uint64_t global_version;
+
+    htkeys_pool_t htkeys_pool;
+    intern_table_t intern_table;
+    layout_cache_t layout_cache;
+    PyObject *header_identities[HEADERS_COUNT];
+
+    freelist_t multidict_freelist;
+    freelist_t proxy_freelist;
+    freelist_t view_freelist;
+    freelist_t iter_freelist;
+
+    MultiDict_CAPI capi;  // exported as a capsule, see multidict_api.h
 } mod_state;
 
 static inline mod_state *
@@ -27,13 +27,34 @@ _init_view(_Multidict_ViewObject *self, MultiDictObject *md)
     self->md = md;
 }
 
+static inline PyObject *
+_multidict_view_new(MultiDictObject *md, PyTypeObject *tp)
+{
+    _Multidict_ViewObject *mv = (_Multidict_ViewObject *)freelist_pop(
+        &md->state->view_freelist, tp);
+    if (mv == NULL) {
+        mv = PyObject_GC_New(_Multidict_ViewObject, tp);
+        if (mv == NULL) {
+            return NULL;
+        }
+    }
+
+    _init_view(mv, md);
+
+    PyObject_GC_Track(mv);
+    return (PyObject *)mv;
+}
+
 static inline void
 multidict_view_dealloc(_Multidict_ViewObject *self)
 {
     PyTypeObject *tp = Py_TYPE(self);
+    mod_state *state = get_mod_state_by_cls(tp);
     PyObject_GC_UnTrack(self);
     Py_XDECREF(self->md);
-    tp->tp_free(self);
+    if (!freelist_push(&state->view_freelist, (PyObject *)self)) {
+        tp->tp_free(self);
+    }
     Py_DECREF(tp);
 }
 
@@ -154,16 +175,7 @@ fail:
 static inline PyObject *
 multidict_itemsview_new(MultiDictObject *md)
 {
-    _Multidict_ViewObject *mv =
-        PyObject_GC_New(_Multidict_ViewObject, md->state->ItemsViewType);
-    if (mv == NULL) {
-        return NULL;
-    }
-
-    _init_view(mv, md);
-
-    PyObject_GC_Track(mv);
-    return (PyObject *)mv;
+    return _multidict_view_new(md, md->state->ItemsViewType);
 }
 
 static inline PyObject *
@@ -1075,16 +1087,7 @@ static PyType_Spec multidict_itemsview_spec = {
 static inline PyObject *
 multidict_keysview_new(MultiDictObject *md)
 {
-    _Multidict_ViewObject *mv =
-        PyObject_GC_New(_Multidict_ViewObject, md->state->KeysViewType);
-    if (mv == NULL) {
-        return NULL;
-    }
-
-    _init_view(mv, md);
-
-    PyObject_GC_Track(mv);
-    return (PyObject *)mv;
+    return _multidict_view_new(md, md->state->KeysViewType);
 }
 
 static inline PyObject *
@@ -1631,16 +1634,7 @@ static PyType_Spec multidict_keysview_spec = {
 static inline PyObject *
 multidict_valuesview_new(MultiDictObject *md)
 {
-    _Multidict_ViewObject *mv =
-        PyObject_GC_New(_Multidict_ViewObject, md->state->ValuesViewType);
-    if (mv == NULL) {
-        return NULL;
-    }
-
-    _init_view(mv, md);
-
-    PyObject_GC_Track(mv);
-    return (PyObject *)mv;
+    return _multidict_view_new(md, md->state->ValuesViewType);
 }
 
 static inline PyObject *
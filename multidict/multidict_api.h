@@ -0,0 +1,189 @@
+/* C API of the multidict._multidict extension.
+
+   Other extension modules build and query multidicts through a table of
+   function pointers exported as the "multidict._multidict.CAPI" capsule:
+
+       #include "multidict_api.h"
+
+       MultiDict_CAPI *api = MultiDict_ImportCAPI();
+       if (api == NULL) {
+           return NULL;
+       }
+       PyObject *md = MultiDict_New(api, 1, 16);  // CIMultiDict
+       ...
+
+   The directory containing this header is the multidict package itself,
+   os.path.dirname(multidict.__file__).
+
+   The table is versioned: functions are only appended, the version is
+   bumped for every addition.  MultiDict_ImportCAPI() fails if the
+   imported extension is older than MULTIDICT_CAPI_VERSION of the header
+   the caller is compiled with.
+
+   All functions follow the usual CPython conventions: the caller holds
+   the GIL (or is attached to the interpreter on the free-threaded build),
+   a failure is reported by -1 or NULL with an exception set, the returned
+   objects are new references.
+
+   The functions accepting a multidict for reading work with MultiDict,
+   CIMultiDict, their proxies, frozen and persistent variants and
+   subclasses.  The functions adding items accept MultiDict and
+   CIMultiDict (and subclasses) only.
+*/
+
+#ifndef _MULTIDICT_API_H
+#define _MULTIDICT_API_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <Python.h>
+#include <stdint.h>
+
+#define MULTIDICT_CAPI_NAME "multidict._multidict.CAPI"
+#define MULTIDICT_CAPI_VERSION 1
+
+typedef struct {
+    int version;  // MULTIDICT_CAPI_VERSION of the exporting extension
+    void *state;  // opaque, passed back to every function
+
+    PyTypeObject *MultiDictType;
+    PyTypeObject *CIMultiDictType;
+
+    /* Return a new empty MultiDict (is_ci == 0) or CIMultiDict
+       (is_ci != 0) with room for size_hint items. */
+    PyObject *(*md_new)(void *state, int is_ci, Py_ssize_t size_hint);
+
+    /* Append the key/value pair, return 0 on success. */
+    int (*md_add)(void *state, PyObject *md, PyObject *key, PyObject *value);
+
+    /* Return the lookup identity of the str key: the key itself for
+       MultiDict and its case-folded form for CIMultiDict.  Precompute
+       identities of well-known keys once and pass them to
+       md_add_with_identity() to skip the case folding on every insert. */
+    PyObject *(*md_identity)(void *state, int is_ci, PyObject *key);
+
+    /* Append the key/value pair using identity returned by md_identity()
+       for the same case sensitivity.  The identity must match the key,
+       otherwise lookups of the key don't find the item. */
+    int (*md_add_with_identity)(void *state, PyObject *md, PyObject *identity,
+                                PyObject *key, PyObject *value);
+
+    /* Find the first value for the key.
+       Return 1 and store a new reference into *result if found,
+       return 0 and store NULL if not found, return -1 on error. */
+    int (*md_get_one)(void *state, PyObject *md, PyObject *key,
+                      PyObject **result);
+
+    /* Find all values for the key as a new list.
+       Return 1, 0 or -1 like md_get_one(). */
+    int (*md_get_all)(void *state, PyObject *md, PyObject *key,
+                      PyObject **result);
+
+    /* Return 1 if the key is in the multidict, 0 if not, -1 on error. */
+    int (*md_contains)(void *state, PyObject *md, PyObject *key);
+
+    /* Return the number of items, -1 on error. */
+    Py_ssize_t (*md_len)(void *state, PyObject *md);
+
+    /* Iterate over items like PyDict_Next(), *pos should be 0 initially.
+       Return 1 and store new references into *pkey and *pvalue (either
+       may be NULL), return 0 when exhausted, return -1 on error (a
+       ValueError for a negative *pos).  Like PyDict_Next() the changes
+       of the multidict are not detected: it must not be modified during
+       the iteration, save md_version() before it and compare to check. */
+    int (*md_next)(void *state, PyObject *md, Py_ssize_t *pos,
+                   PyObject **pkey, PyObject **pvalue);
+
+    /* Return the version of the multidict (see multidict.getversion()),
+       (uint64_t)-1 on error. */
+    uint64_t (*md_version)(void *state, PyObject *md);
+} MultiDict_CAPI;
+
+static inline MultiDict_CAPI *
+MultiDict_ImportCAPI(void)
+{
+    MultiDict_CAPI *api =
+        (MultiDict_CAPI *)PyCapsule_Import(MULTIDICT_CAPI_NAME, 0);
+    if (api == NULL) {
+        return NULL;
+    }
+    if (api->version < MULTIDICT_CAPI_VERSION) {
+        PyErr_Format(PyExc_ImportError,
+                     "multidict C API version %d is required, got %d",
+                     MULTIDICT_CAPI_VERSION, api->version);
+        return NULL;
+    }
+    return api;
+}
+
+static inline PyObject *
+MultiDict_New(MultiDict_CAPI *api, int is_ci, Py_ssize_t size_hint)
+{
+    return api->md_new(api->state, is_ci, size_hint);
+}
+
+static inline int
+MultiDict_Add(MultiDict_CAPI *api, PyObject *md, PyObject *key,
+              PyObject *value)
+{
+    return api->md_add(api->state, md, key, value);
+}
+
+static inline PyObject *
+MultiDict_Identity(MultiDict_CAPI *api, int is_ci, PyObject *key)
+{
+    return api->md_identity(api->state, is_ci, key);
+}
+
+static inline int
+MultiDict_AddWithIdentity(MultiDict_CAPI *api, PyObject *md,
+                          PyObject *identity, PyObject *key, PyObject *value)
+{
+    return api->md_add_with_identity(api->state, md, identity, key, value);
+}
+
+static inline int
+MultiDict_GetOne(MultiDict_CAPI *api, PyObject *md, PyObject *key,
+                 PyObject **result)
+{
+    return api->md_get_one(api->state, md, key, result);
+}
+
+static inline int
+MultiDict_GetAll(MultiDict_CAPI *api, PyObject *md, PyObject *key,
+                 PyObject **result)
+{
+    return api->md_get_all(api->state, md, key, result);
+}
+
+static inline int
+MultiDict_Contains(MultiDict_CAPI *api, PyObject *md, PyObject *key)
+{
+    return api->md_contains(api->state, md, key);
+}
+
+static inline Py_ssize_t
+MultiDict_Len(MultiDict_CAPI *api, PyObject *md)
+{
+    return api->md_len(api->state, md);
+}
+
+static inline int
+MultiDict_Next(MultiDict_CAPI *api, PyObject *md, Py_ssize_t *pos,
+               PyObject **pkey, PyObject **pvalue)
+{
+    return api->md_next(api->state, md, pos, pkey, pvalue);
+}
+
+static inline uint64_t
+MultiDict_Version(MultiDict_CAPI *api, PyObject *md)
+{
+    return api->md_version(api->state, md);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
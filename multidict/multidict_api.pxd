@@ -0,0 +1,43 @@
+# Cython declarations of the C API, see multidict_api.h.
+#
+# from multidict.multidict_api cimport MultiDict_CAPI, MultiDict_ImportCAPI
+#
+# Compile with os.path.dirname(multidict.__file__) in the include path.
+
+from cpython.object cimport PyObject, PyTypeObject
+from libc.stdint cimport uint64_t
+
+
+cdef extern from "multidict_api.h":
+    const char *MULTIDICT_CAPI_NAME
+    int MULTIDICT_CAPI_VERSION
+
+    ctypedef struct MultiDict_CAPI:
+        int version
+        void *state
+        PyTypeObject *MultiDictType
+        PyTypeObject *CIMultiDictType
+
+    MultiDict_CAPI *MultiDict_ImportCAPI() except NULL
+
+    object MultiDict_New(MultiDict_CAPI *api, int is_ci, Py_ssize_t size_hint)
+    int MultiDict_Add(
+        MultiDict_CAPI *api, object md, object key, object value
+    ) except -1
+    object MultiDict_Identity(MultiDict_CAPI *api, int is_ci, object key)
+    int MultiDict_AddWithIdentity(
+        MultiDict_CAPI *api, object md, object identity, object key, object value
+    ) except -1
+    int MultiDict_GetOne(
+        MultiDict_CAPI *api, object md, object key, PyObject **result
+    ) except -1
+    int MultiDict_GetAll(
+        MultiDict_CAPI *api, object md, object key, PyObject **result
+    ) except -1
+    int MultiDict_Contains(MultiDict_CAPI *api, object md, object key) except -1
+    Py_ssize_t MultiDict_Len(MultiDict_CAPI *api, object md) except -1
+    int MultiDict_Next(
+        MultiDict_CAPI *api, object md, Py_ssize_t *pos,
+        PyObject **pkey, PyObject **pvalue
+    ) except -1
+    uint64_t MultiDict_Version(MultiDict_CAPI *api, object md) except? 0xFFFFFFFFFFFFFFFF
@@ -0,0 +1,237 @@
+/* Test extension for the C API, built by tests/test_capi.py */
+
+#include <Python.h>
+
+#include "multidict_api.h"
+
+static MultiDict_CAPI *api;
+
+static PyObject *
+found(int ret, PyObject *value)
+{
+    if (ret < 0) {
+        return NULL;
+    }
+    if (ret == 0) {
+        return Py_BuildValue("(iO)", 0, Py_None);
+    }
+    return Py_BuildValue("(iN)", 1, value);
+}
+
+static PyObject *
+build(PyObject *self, PyObject *args)
+{
+    int is_ci, with_identity;
+    PyObject *items;
+    if (!PyArg_ParseTuple(args, "ppO!", &is_ci, &with_identity, &PyList_Type,
+                          &items)) {
+        return NULL;
+    }
+    PyObject *md = MultiDict_New(api, is_ci, PyList_GET_SIZE(items));
+    if (md == NULL) {
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(items); i++) {
+        PyObject *key, *value;
+        if (!PyArg_ParseTuple(PyList_GET_ITEM(items, i), "OO", &key, &value)) {
+            goto fail;
+        }
+        if (with_identity) {
+            PyObject *identity = MultiDict_Identity(api, is_ci, key);
+            if (identity == NULL) {
+                goto fail;
+            }
+            int ret = MultiDict_AddWithIdentity(api, md, identity, key, value);
+            Py_DECREF(identity);
+            if (ret < 0) {
+                goto fail;
+            }
+        } else if (MultiDict_Add(api, md, key, value) < 0) {
+            goto fail;
+        }
+    }
+    return md;
+fail:
+    Py_DECREF(md);
+    return NULL;
+}
+
+static PyObject *
+add(PyObject *self, PyObject *args)
+{
+    PyObject *md, *key, *value;
+    if (!PyArg_ParseTuple(args, "OOO", &md, &key, &value)) {
+        return NULL;
+    }
+    if (MultiDict_Add(api, md, key, value) < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+add_with_identity(PyObject *self, PyObject *args)
+{
+    PyObject *md, *identity, *key, *value;
+    if (!PyArg_ParseTuple(args, "OOOO", &md, &identity, &key, &value)) {
+        return NULL;
+    }
+    if (MultiDict_AddWithIdentity(api, md, identity, key, value) < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+identity(PyObject *self, PyObject *args)
+{
+    int is_ci;
+    PyObject *key;
+    if (!PyArg_ParseTuple(args, "pO", &is_ci, &key)) {
+        return NULL;
+    }
+    return MultiDict_Identity(api, is_ci, key);
+}
+
+static PyObject *
+get_one(PyObject *self, PyObject *args)
+{
+    PyObject *md, *key, *value;
+    if (!PyArg_ParseTuple(args, "OO", &md, &key)) {
+        return NULL;
+    }
+    int ret = MultiDict_GetOne(api, md, key, &value);
+    return found(ret, value);
+}
+
+static PyObject *
+get_all(PyObject *self, PyObject *args)
+{
+    PyObject *md, *key, *values;
+    if (!PyArg_ParseTuple(args, "OO", &md, &key)) {
+        return NULL;
+    }
+    int ret = MultiDict_GetAll(api, md, key, &values);
+    return found(ret, values);
+}
+
+static PyObject *
+contains(PyObject *self, PyObject *args)
+{
+    PyObject *md, *key;
+    if (!PyArg_ParseTuple(args, "OO", &md, &key)) {
+        return NULL;
+    }
+    int ret = MultiDict_Contains(api, md, key);
+    if (ret < 0) {
+        return NULL;
+    }
+    return PyBool_FromLong(ret);
+}
+
+static PyObject *
+length(PyObject *self, PyObject *md)
+{
+    Py_ssize_t ret = MultiDict_Len(api, md);
+    if (ret < 0) {
+        return NULL;
+    }
+    return PyLong_FromSsize_t(ret);
+}
+
+static PyObject *
+items(PyObject *self, PyObject *md)
+{
+    PyObject *ret = PyList_New(0);
+    if (ret == NULL) {
+        return NULL;
+    }
+    Py_ssize_t pos = 0;
+    PyObject *key, *value;
+    int res;
+    while ((res = MultiDict_Next(api, md, &pos, &key, &value)) > 0) {
+        PyObject *item = PyTuple_Pack(2, key, value);
+        Py_DECREF(key);
+        Py_DECREF(value);
+        if (item == NULL || PyList_Append(ret, item) < 0) {
+            Py_XDECREF(item);
+            goto fail;
+        }
+        Py_DECREF(item);
+    }
+    if (res < 0) {
+        goto fail;
+    }
+    return ret;
+fail:
+    Py_DECREF(ret);
+    return NULL;
+}
+
+static PyObject *
+next_item(PyObject *self, PyObject *args)
+{
+    PyObject *md, *key, *value;
+    Py_ssize_t pos;
+    if (!PyArg_ParseTuple(args, "On", &md, &pos)) {
+        return NULL;
+    }
+    int ret = MultiDict_Next(api, md, &pos, &key, &value);
+    if (ret < 0) {
+        return NULL;
+    }
+    if (ret == 0) {
+        return Py_BuildValue("(nOO)", pos, Py_None, Py_None);
+    }
+    return Py_BuildValue("(nNN)", pos, key, value);
+}
+
+static PyObject *
+version(PyObject *self, PyObject *md)
+{
+    uint64_t ret = MultiDict_Version(api, md);
+    if (ret == (uint64_t)-1 && PyErr_Occurred()) {
+        return NULL;
+    }
+    return PyLong_FromUnsignedLongLong(ret);
+}
+
+static PyObject *
+types(PyObject *self, PyObject *Py_UNUSED(unused))
+{
+    return Py_BuildValue("(iOO)", api->version, api->MultiDictType,
+                         api->CIMultiDictType);
+}
+
+static PyMethodDef methods[] = {
+    {"build", build, METH_VARARGS},
+    {"add", add, METH_VARARGS},
+    {"add_with_identity", add_with_identity, METH_VARARGS},
+    {"identity", identity, METH_VARARGS},
+    {"get_one", get_one, METH_VARARGS},
+    {"get_all", get_all, METH_VARARGS},
+    {"contains", contains, METH_VARARGS},
+    {"length", length, METH_O},
+    {"items", items, METH_O},
+    {"next_item", next_item, METH_VARARGS},
+    {"version", version, METH_O},
+    {"types", types, METH_NOARGS},
+    {NULL, NULL},
+};
+
+static struct PyModuleDef module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "multidict_capi_test",
+    .m_size = -1,
+    .m_methods = methods,
+};
+
+PyMODINIT_FUNC
+PyInit_multidict_capi_test(void)
+{
+    api = MultiDict_ImportCAPI();
+    if (api == NULL) {
+        return NULL;
+    }
+    return PyModule_Create(&module);
+}
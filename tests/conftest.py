@@ -2,7 +2,7 @@ from __future__ import annotations
 
 import argparse
 import pickle
-from collections.abc import Callable
+from collections.abc import Callable, Iterator
 from dataclasses import dataclass
 from functools import cached_property
 from importlib import import_module
@@ -76,6 +76,52 @@ def multidict_module(
     return multidict_implementation.imported_module
 
 
+@pytest.fixture
+def c_module(
+    multidict_implementation: MultidictImplementation,
+    multidict_module: ModuleType,
+) -> ModuleType:
+    """Return the C-extension module, skip the test for pure-python."""
+    if multidict_implementation.is_pure_python:
+        pytest.skip("The C extension only")
+    return multidict_module
+
+
+# the name of a C extension cache -> its stats function, size field, setter
+C_CACHES = {
+    "identity_intern": (
+        "_identity_intern_stats",
+        "size",
+        "_set_identity_intern_size",
+    ),
+    "htkeys_pool": ("_htkeys_pool_stats", "maxsize", "_set_htkeys_pool_maxsize"),
+    "split_layouts": ("_split_layouts_stats", "size", "_set_split_layouts_size"),
+}
+
+
+@pytest.fixture
+def c_caches(request: pytest.FixtureRequest, c_module: ModuleType) -> Iterator[None]:
+    """Restore the sizes of the C extension caches after the test.
+
+    Parametrize indirectly with a dict of cache names to the sizes to use
+    during the test, ``None`` empties the cache keeping its size and skips
+    the test when the build has the cache disabled.
+    """
+    sizes = {
+        name: getattr(c_module, stats)()[field]
+        for name, (stats, field, _) in C_CACHES.items()
+    }
+    for name, size in getattr(request, "param", {}).items():
+        if size is None:
+            size = sizes[name]
+            if size == 0:
+                pytest.skip(f"The build has no {name.replace('_', ' ')}")
+        getattr(c_module, C_CACHES[name][2])(size)
+    yield
+    for name, size in sizes.items():
+        getattr(c_module, C_CACHES[name][2])(size)
+
+
 @pytest.fixture(
     scope="session",
     params=("MultiDict", "CIMultiDict"),
@@ -148,6 +194,24 @@ def case_insensitive_multidict_proxy_class(
     return multidict_module.CIMultiDictProxy  # type: ignore[no-any-return]
 
 
+@pytest.fixture(scope="session")
+def any_frozen_multidict_class(
+    any_multidict_class_name: str,
+    multidict_module: ModuleType,
+) -> type[MultiMapping[str]]:
+    """Return a frozen multidict class of the same case sensitivity."""
+    return getattr(multidict_module, f"Frozen{any_multidict_class_name}")  # type: ignore[no-any-return]
+
+
+@pytest.fixture(scope="session")
+def any_persistent_multidict_class(
+    any_multidict_class_name: str,
+    multidict_module: ModuleType,
+) -> type[MultiMapping[str]]:
+    """Return a persistent multidict class of the same case sensitivity."""
+    return getattr(multidict_module, f"Persistent{any_multidict_class_name}")  # type: ignore[no-any-return]
+
+
 @pytest.fixture(scope="session")
 def multidict_getversion_callable(
     multidict_module: ModuleType,
@@ -0,0 +1,212 @@
+import sys
+from typing import TYPE_CHECKING
+
+import pytest
+
+from multidict import CIMultiDict, MultiDict
+
+if TYPE_CHECKING:
+    from conftest import MultidictImplementation
+
+_MD_Classes = type[MultiDict[int]] | type[CIMultiDict[int]]
+
+skip_on_pypy = pytest.mark.skipif(
+    sys.implementation.name == "pypy",
+    reason="getsizeof() is not implemented on PyPy",
+)
+
+
+@pytest.fixture
+def sized_multidict_class(
+    any_multidict_class: _MD_Classes,
+    multidict_implementation: "MultidictImplementation",
+) -> _MD_Classes:
+    if multidict_implementation.is_pure_python:
+        pytest.skip("The pure Python implementation grows its entries list")
+    return any_multidict_class
+
+
+@skip_on_pypy
+def test_reserve(sized_multidict_class: _MD_Classes) -> None:
+    md = sized_multidict_class()
+    md.reserve(1000)
+    size = sys.getsizeof(md)
+    assert size > sys.getsizeof(sized_multidict_class())
+    for i in range(1000):
+        md[str(i)] = i
+    assert sys.getsizeof(md) == size
+    assert len(md) == 1000
+
+
+@skip_on_pypy
+def test_reserve_counts_existing_items(sized_multidict_class: _MD_Classes) -> None:
+    md = sized_multidict_class((str(i), i) for i in range(100))
+    md.reserve(100)
+    size = sys.getsizeof(md)
+    for i in range(100, 200):
+        md.add(str(i), i)
+    assert sys.getsizeof(md) == size
+    assert list(md.values()) == list(range(200))
+
+
+@skip_on_pypy
+def test_reserve_smaller_is_noop(any_multidict_class: _MD_Classes) -> None:
+    md = any_multidict_class((str(i), i) for i in range(100))
+    size = sys.getsizeof(md)
+    md.reserve(0)
+    md.reserve(1)
+    assert sys.getsizeof(md) == size
+
+
+@skip_on_pypy
+def test_reserve_survives_deletions(sized_multidict_class: _MD_Classes) -> None:
+    md = sized_multidict_class()
+    md.reserve(1000)
+    size = sys.getsizeof(md)
+    for i in range(1000):
+        md[str(i)] = i
+    for i in range(999):
+        del md[str(i)]
+    assert sys.getsizeof(md) == size
+    assert list(md.items()) == [("999", 999)]
+
+
+def test_reserve_negative(any_multidict_class: _MD_Classes) -> None:
+    md = any_multidict_class()
+    with pytest.raises(ValueError):
+        md.reserve(-1)
+
+
+def test_reserve_not_int(any_multidict_class: _MD_Classes) -> None:
+    md = any_multidict_class()
+    with pytest.raises(TypeError):
+        md.reserve(1.5)  # type: ignore[arg-type]
+
+
+def test_reserve_too_large(any_multidict_class: _MD_Classes) -> None:
+    md = any_multidict_class()
+    with pytest.raises(MemoryError):
+        md.reserve(sys.maxsize)
+    assert len(md) == 0
+
+
+def test_reserve_during_iteration(any_multidict_class: _MD_Classes) -> None:
+    md = any_multidict_class([("a", 1), ("b", 2)])
+    it = iter(md.items())
+    assert next(it) == ("a", 1)
+    md.reserve(1000)
+    with pytest.raises(RuntimeError):
+        next(it)
+
+
+@skip_on_pypy
+def test_shrink_to_fit(any_multidict_class: _MD_Classes) -> None:
+    md = any_multidict_class((str(i), i) for i in range(1000))
+    peak = sys.getsizeof(md)
+    for i in range(0, 1000, 2):
+        del md[str(i)]
+    assert sys.getsizeof(md) == peak
+    md.shrink_to_fit()
+    assert sys.getsizeof(md) < peak
+    assert list(md.values()) == list(range(1, 1000, 2))
+    assert md["999"] == 999
+    assert "998" not in md
+
+
+@skip_on_pypy
+def test_shrink_to_fit_drops_reservation(any_multidict_class: _MD_Classes) -> None:
+    # built by add(), the constructor could share a split table
+    md = any_multidict_class()
+    md.add("a", 1)
+    small = sys.getsizeof(md)
+    md.reserve(1000)
+    assert sys.getsizeof(md) > small
+    md.shrink_to_fit()
+    assert sys.getsizeof(md) <= small
+    assert list(md.items()) == [("a", 1)]
+
+
+def test_shrink_to_fit_keeps_duplicates(any_multidict_class: _MD_Classes) -> None:
+    md = any_multidict_class()
+    for i in range(100):
+        md.add("a" if i % 10 == 0 else str(i), i)
+    for i in range(100):
+        if i % 10:
+            del md[str(i)]
+    md.shrink_to_fit()
+    assert md.getall("a") == list(range(0, 100, 10))
+    md.add("b", 1)
+    assert list(md.keys()) == ["a"] * 10 + ["b"]
+
+
+def test_shrink_to_fit_empty(any_multidict_class: _MD_Classes) -> None:
+    md = any_multidict_class([("a", 1)])
+    del md["a"]
+    md.shrink_to_fit()
+    assert len(md) == 0
+    md["b"] = 2
+    assert list(md.items()) == [("b", 2)]
+
+
+@skip_on_pypy
+def test_clear_keep_capacity(sized_multidict_class: _MD_Classes) -> None:
+    md = sized_multidict_class((str(i), i) for i in range(1000))
+    size = sys.getsizeof(md)
+    md.clear(keep_capacity=True)
+    assert len(md) == 0
+    assert "1" not in md
+    assert sys.getsizeof(md) == size
+    for i in range(500):
+        md.add(str(i), -i)
+    for i in range(400):
+        del md[str(i)]
+    assert sys.getsizeof(md) == size
+    assert list(md.items()) == [(str(i), -i) for i in range(400, 500)]
+
+
+@skip_on_pypy
+def test_clear_drops_capacity(any_multidict_class: _MD_Classes) -> None:
+    md = any_multidict_class((str(i), i) for i in range(1000))
+    size = sys.getsizeof(md)
+    md.clear(keep_capacity=False)
+    assert len(md) == 0
+    assert sys.getsizeof(md) < size
+
+
+def test_clear_keep_capacity_positional(any_multidict_class: _MD_Classes) -> None:
+    md = any_multidict_class([("a", 1)])
+    with pytest.raises(TypeError):
+        md.clear(True)  # type: ignore[misc]
+    with pytest.raises(TypeError):
+        md.clear(keep=True)  # type: ignore[call-arg]
+    assert len(md) == 1
+
+
+def test_clear_keep_capacity_during_iteration(
+    any_multidict_class: _MD_Classes,
+) -> None:
+    md = any_multidict_class([("a", 1), ("b", 2)])
+    it = iter(md)
+    next(it)
+    md.clear(keep_capacity=True)
+    with pytest.raises(RuntimeError):
+        next(it)
+
+
+def test_clear_keep_capacity_reentrant(any_multidict_class: _MD_Classes) -> None:
+    md = any_multidict_class()
+
+    class Value:
+        def __del__(self) -> None:
+            md["added"] = 1
+
+    md["a"] = Value()  # type: ignore[assignment]
+    md.clear(keep_capacity=True)
+    assert list(md.items()) == [("added", 1)]
+
+
+def test_clear_keep_capacity_then_extend(any_multidict_class: _MD_Classes) -> None:
+    md = any_multidict_class((str(i), i) for i in range(100))
+    md.clear(keep_capacity=True)
+    md.extend(any_multidict_class([("a", 1), ("b", 2)]))
+    assert list(md.items()) == [("a", 1), ("b", 2)]
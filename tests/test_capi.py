@@ -0,0 +1,222 @@
+"""Tests for the C API exported as a capsule, see multidict/multidict_api.h."""
+
+import importlib.util
+from pathlib import Path
+from types import ModuleType
+from typing import TYPE_CHECKING, Any
+
+import pytest
+
+setuptools = pytest.importorskip("setuptools")
+setuptools_errors = pytest.importorskip("setuptools.errors")
+
+if TYPE_CHECKING:
+    from conftest import MultidictImplementation
+
+
+@pytest.fixture(scope="session")
+def capi_test_ext(
+    tmp_path_factory: pytest.TempPathFactory,
+    multidict_implementation: "MultidictImplementation",
+    multidict_module: ModuleType,
+) -> ModuleType:
+    if multidict_implementation.is_pure_python:
+        pytest.skip("The C API exists in the C extension only")
+    name = "multidict_capi_test"
+    build_dir = tmp_path_factory.mktemp("capi")
+    ext = setuptools.Extension(
+        name,
+        [str(Path(__file__).parent / "capi" / f"{name}.c")],
+        include_dirs=[str(Path(multidict_module.__file__).parent)],
+    )
+    dist = setuptools.Distribution({"name": name, "ext_modules": [ext]})
+    cmd: Any = dist.get_command_obj("build_ext")
+    cmd.build_lib = str(build_dir)
+    cmd.build_temp = str(build_dir / "temp")
+    cmd.ensure_finalized()
+    try:
+        cmd.run()
+    except setuptools_errors.PlatformError:  # pragma: no cover
+        pytest.skip("No C compiler available")
+    spec = importlib.util.spec_from_file_location(name, cmd.get_ext_fullpath(name))
+    assert spec is not None and spec.loader is not None
+    mod = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(mod)
+    return mod
+
+
+@pytest.fixture(params=[False, True], ids=["add", "add_with_identity"])
+def with_identity(request: pytest.FixtureRequest) -> bool:
+    return request.param  # type: ignore[no-any-return]
+
+
+def test_types(capi_test_ext: ModuleType, multidict_module: ModuleType) -> None:
+    version, md_type, ci_type = capi_test_ext.types()
+    assert version >= 1
+    assert md_type is multidict_module.MultiDict
+    assert ci_type is multidict_module.CIMultiDict
+
+
+def test_build(
+    capi_test_ext: ModuleType, multidict_module: ModuleType, with_identity: bool
+) -> None:
+    items = [("a", 1), ("b", 2), ("a", 3)]
+    md = capi_test_ext.build(False, with_identity, items)
+    assert type(md) is multidict_module.MultiDict
+    assert md == multidict_module.MultiDict(items)
+    assert md.getall("a") == [1, 3]
+    md.add("c", 4)
+    assert md["c"] == 4
+
+
+def test_build_ci(
+    capi_test_ext: ModuleType, multidict_module: ModuleType, with_identity: bool
+) -> None:
+    items = [("Content-Type", "text/plain"), ("X-Tag", 1), ("x-tag", 2)]
+    md = capi_test_ext.build(True, with_identity, items)
+    assert type(md) is multidict_module.CIMultiDict
+    assert md["content-type"] == "text/plain"
+    assert md.getall("X-TAG") == [1, 2]
+    assert list(md) == ["Content-Type", "X-Tag", "x-tag"]
+    assert md == multidict_module.CIMultiDict(items)
+
+
+def test_build_bad_key(capi_test_ext: ModuleType, with_identity: bool) -> None:
+    with pytest.raises(TypeError):
+        capi_test_ext.build(True, with_identity, [(1, 2)])
+
+
+def test_identity(capi_test_ext: ModuleType, multidict_module: ModuleType) -> None:
+    assert capi_test_ext.identity(True, "Content-Type") == "content-type"
+    assert capi_test_ext.identity(False, "Content-Type") == "Content-Type"
+    assert capi_test_ext.identity(True, multidict_module.istr("Key")) == "key"
+
+
+def test_add(capi_test_ext: ModuleType, any_multidict_class: type[Any]) -> None:
+    md = any_multidict_class(a=1)
+    version = capi_test_ext.version(md)
+    capi_test_ext.add(md, "b", 2)
+    assert list(md.items()) == [("a", 1), ("b", 2)]
+    assert capi_test_ext.version(md) != version
+
+
+def test_add_with_identity(
+    capi_test_ext: ModuleType, multidict_module: ModuleType
+) -> None:
+    md = multidict_module.CIMultiDict()
+    identity = capi_test_ext.identity(True, "Server")
+    capi_test_ext.add_with_identity(md, identity, "Server", "nginx")
+    capi_test_ext.add_with_identity(md, identity, "SERVER", "apache")
+    assert md.getall("server") == ["nginx", "apache"]
+    with pytest.raises(TypeError):
+        capi_test_ext.add_with_identity(md, 1, "Server", "x")
+    with pytest.raises(TypeError):
+        capi_test_ext.add_with_identity(md, identity, 1, "x")
+
+
+@pytest.mark.parametrize(
+    "make",
+    [
+        lambda m, items: m.MultiDict(items),
+        lambda m, items: m.MultiDictProxy(m.MultiDict(items)),
+        lambda m, items: m.FrozenMultiDict(items),
+        lambda m, items: m.PersistentMultiDict(items),
+    ],
+    ids=["multidict", "proxy", "frozen", "persistent"],
+)
+def test_read(
+    capi_test_ext: ModuleType, multidict_module: ModuleType, make: Any
+) -> None:
+    items = [("a", 1), ("b", 2), ("a", 3)]
+    md = make(multidict_module, items)
+    assert capi_test_ext.get_one(md, "a") == (1, 1)
+    assert capi_test_ext.get_one(md, "x") == (0, None)
+    assert capi_test_ext.get_all(md, "a") == (1, [1, 3])
+    assert capi_test_ext.get_all(md, "x") == (0, None)
+    assert capi_test_ext.contains(md, "b")
+    assert not capi_test_ext.contains(md, "x")
+    assert not capi_test_ext.contains(md, 1)
+    assert capi_test_ext.length(md) == 3
+    assert capi_test_ext.items(md) == items
+    assert isinstance(capi_test_ext.version(md), int)
+
+
+def test_version(capi_test_ext: ModuleType, multidict_module: ModuleType) -> None:
+    md = multidict_module.MultiDict(a=1)
+    proxy = multidict_module.MultiDictProxy(md)
+    assert capi_test_ext.version(md) == multidict_module.getversion(md)
+    assert capi_test_ext.version(proxy) == capi_test_ext.version(md)
+    md["a"] = 2
+    assert capi_test_ext.version(proxy) == multidict_module.getversion(md)
+
+
+def test_ci_items_are_istr(
+    capi_test_ext: ModuleType, multidict_module: ModuleType
+) -> None:
+    md = multidict_module.CIMultiDict([("Key", 1)])
+    [(key, value)] = capi_test_ext.items(md)
+    assert type(key) is multidict_module.istr
+    assert key == "Key"
+    assert capi_test_ext.get_one(md, "KEY") == (1, 1)
+
+
+def test_next_item(capi_test_ext: ModuleType, multidict_module: ModuleType) -> None:
+    md = multidict_module.MultiDict([("a", 1), ("b", 2), ("c", 3)])
+    del md["b"]
+    pos, key, value = capi_test_ext.next_item(md, 0)
+    assert (key, value) == ("a", 1)
+    pos, key, value = capi_test_ext.next_item(md, pos)
+    assert (key, value) == ("c", 3)
+    assert capi_test_ext.next_item(md, pos) == (pos, None, None)
+    assert capi_test_ext.next_item(md, 1000) == (1000, None, None)
+
+
+def test_next_item_negative_pos(
+    capi_test_ext: ModuleType, multidict_module: ModuleType
+) -> None:
+    md = multidict_module.MultiDict(a=1)
+    with pytest.raises(ValueError, match="non-negative"):
+        capi_test_ext.next_item(md, -1)
+
+
+def test_next_item_after_change(
+    capi_test_ext: ModuleType, multidict_module: ModuleType
+) -> None:
+    # changes aren't detected like PyDict_Next(), the caller compares versions
+    md = multidict_module.MultiDict([("a", 1), ("b", 2)])
+    version = capi_test_ext.version(md)
+    pos, key, value = capi_test_ext.next_item(md, 0)
+    md.clear()
+    assert capi_test_ext.version(md) != version
+    assert capi_test_ext.next_item(md, pos) == (pos, None, None)
+
+
+def test_write_requires_mutable(
+    capi_test_ext: ModuleType, multidict_module: ModuleType
+) -> None:
+    md = multidict_module.MultiDict(a=1)
+    for obj in (
+        multidict_module.MultiDictProxy(md),
+        multidict_module.FrozenMultiDict(md),
+        {"a": 1},
+    ):
+        with pytest.raises(TypeError, match="MultiDict or CIMultiDict"):
+            capi_test_ext.add(obj, "b", 2)
+    assert md == {"a": 1}
+
+
+@pytest.mark.parametrize(
+    "call",
+    [
+        lambda ext, obj: ext.get_one(obj, "a"),
+        lambda ext, obj: ext.get_all(obj, "a"),
+        lambda ext, obj: ext.contains(obj, "a"),
+        lambda ext, obj: ext.length(obj),
+        lambda ext, obj: ext.items(obj),
+        lambda ext, obj: ext.version(obj),
+    ],
+    ids=["get_one", "get_all", "contains", "length", "items", "version"],
+)
+def test_read_bad_type(capi_test_ext: ModuleType, call: Any) -> None:
+    with pytest.raises(TypeError, match="multidict is expected"):
+        call(capi_test_ext, {"a": 1})
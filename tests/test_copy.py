@@ -1,7 +1,16 @@
 import copy
+import gc
+import sys
+from collections.abc import Callable
+from typing import TYPE_CHECKING
+
+import pytest
 
 from multidict import CIMultiDict, CIMultiDictProxy, MultiDict, MultiDictProxy
 
+if TYPE_CHECKING:
+    from conftest import MultidictImplementation
+
 _MD_Classes = type[MultiDict[int]] | type[CIMultiDict[int]]
 _MDP_Classes = type[MultiDictProxy[int]] | type[CIMultiDictProxy[int]]
 
@@ -43,3 +52,165 @@ def test_ci_multidict_clone(any_multidict_class: _MD_Classes) -> None:
     d2["foo"] = 7
     assert d["foo"] == 6
     assert d2["foo"] == 7
+
+
+MUTATIONS: list[Callable[[MultiDict[int]], object]] = [
+    lambda md: md.add("new", 0),
+    lambda md: md.__setitem__("a", 0),
+    lambda md: md.__delitem__("a"),
+    lambda md: md.setdefault("new", 0),
+    lambda md: md.popone("a"),
+    lambda md: md.popall("a"),
+    lambda md: md.popitem(),
+    lambda md: md.update(a=0),
+    lambda md: md.update(new=0),
+    lambda md: md.merge(new=0),
+    lambda md: md.extend([("new", 0)]),
+    lambda md: md.clear(),
+    lambda md: md.clear(keep_capacity=True),
+    lambda md: md.reserve(100),
+    lambda md: md.shrink_to_fit(),
+]
+MUTATION_IDS = [
+    "add",
+    "setitem",
+    "delitem",
+    "setdefault",
+    "popone",
+    "popall",
+    "popitem",
+    "update-replace",
+    "update-new",
+    "merge",
+    "extend",
+    "clear",
+    "clear-keep-capacity",
+    "reserve",
+    "shrink-to-fit",
+]
+
+
+@pytest.mark.parametrize("mutate", MUTATIONS, ids=MUTATION_IDS)
+@pytest.mark.parametrize("side", ["copy", "original"])
+def test_copy_is_independent(
+    any_multidict_class: _MD_Classes,
+    mutate: Callable[[MultiDict[int]], object],
+    side: str,
+) -> None:
+    items = [("a", 1), ("b", 2), ("a", 3), ("c", 4)]
+    d = any_multidict_class(items)
+    for i in range(20):
+        d.add(f"k{i}", i)
+    del d["k0"]
+    expected = list(d.items())
+    d2 = d.copy()
+    changed, kept = (d2, d) if side == "copy" else (d, d2)
+    mutate(changed)
+    assert list(kept.items()) == expected
+    assert kept.getall("a") == [1, 3]
+    reference = any_multidict_class(expected)
+    mutate(reference)
+    assert list(changed.items()) == list(reference.items())
+
+
+def test_copy_of_copy(any_multidict_class: _MD_Classes) -> None:
+    d = any_multidict_class(a=1, b=2)
+    d2 = d.copy()
+    d3 = d2.copy()
+    d4 = any_multidict_class(d3)
+    d3["a"] = 3
+    del d
+    d2.add("c", 4)
+    assert list(d2.items()) == [("a", 1), ("b", 2), ("c", 4)]
+    assert list(d3.items()) == [("a", 3), ("b", 2)]
+    assert list(d4.items()) == [("a", 1), ("b", 2)]
+
+
+def test_iterate_copy_source_after_mutation(any_multidict_class: _MD_Classes) -> None:
+    d = any_multidict_class(a=1, b=2, c=3)
+    it = iter(d.items())
+    assert next(it) == ("a", 1)
+    d2 = d.copy()
+    d2["b"] = 5
+    del d2["c"]
+    assert list(it) == [("b", 2), ("c", 3)]
+    it2 = iter(d2.items())
+    d2["d"] = 4
+    with pytest.raises(RuntimeError):
+        next(it2)
+
+
+def test_copy_with_container_values(any_multidict_class: _MD_Classes) -> None:
+    lst: list[int] = []
+    d = any_multidict_class(a=lst)  # type: ignore[arg-type]
+    d2 = d.copy()
+    d2["b"] = d2  # type: ignore[assignment]
+    assert d["a"] is lst
+    assert "b" not in d
+    del d2
+    gc.collect()
+    assert list(d.items()) == [("a", lst)]
+
+
+def test_copy_reference_cycle(any_multidict_class: _MD_Classes) -> None:
+    d = any_multidict_class(a=1)
+    d2 = d.copy()
+    d2["self"] = d2  # type: ignore[assignment]
+    d["self"] = d  # type: ignore[assignment]
+    del d, d2
+    gc.collect()
+
+
+@pytest.mark.parametrize(
+    "mutate",
+    [
+        lambda md: md.__delitem__("a"),
+        lambda md: md.popall("a"),
+        lambda md: md.clear(),
+    ],
+    ids=["delitem", "popall", "clear"],
+)
+def test_copy_finalizer_mutates_source(
+    any_multidict_class: _MD_Classes, mutate: Callable[[MultiDict[int]], object]
+) -> None:
+    snapshots: list[tuple[MultiDict[int], list[tuple[str, int]]]] = []
+
+    class Value(int):
+        __slots__ = ()
+
+        def __del__(self) -> None:
+            snapshots.append((d.copy(), list(d.items())))
+            d["c"] = 5
+
+    d = any_multidict_class([("a", Value(1)), ("b", 2), ("a", Value(3)), ("c", 4)])
+    d2 = d.copy()
+    d2.add("d", 6)
+    mutate(d)
+    assert not snapshots
+    del d2
+    assert len(snapshots) == 2
+    for snapshot, items in snapshots:
+        assert list(snapshot.items()) == items
+    assert d["c"] == 5
+    assert "a" not in d
+
+
+@pytest.mark.skipif(
+    sys.implementation.name == "pypy",
+    reason="getsizeof() is not implemented on PyPy",
+)
+def test_copy_shares_table(
+    any_multidict_class: _MD_Classes,
+    multidict_implementation: "MultidictImplementation",
+) -> None:
+    if multidict_implementation.is_pure_python:
+        pytest.skip("The pure Python copy() is not copy-on-write")
+    d = any_multidict_class((str(i), i) for i in range(100))
+    size = sys.getsizeof(d)
+    d2 = d.copy()
+    # the shared table is not counted
+    assert sys.getsizeof(d2) < size
+    assert sys.getsizeof(d) < size
+    d2["x"] = 1
+    assert sys.getsizeof(d) == size
+    assert sys.getsizeof(d2) >= size
@@ -0,0 +1,105 @@
+"""Tests for the freelists of deallocated objects in the C extension."""
+
+import sys
+from types import ModuleType
+from typing import Any
+
+import pytest
+
+
+@pytest.mark.parametrize("cls_name", ["MultiDict", "CIMultiDict"])
+def test_multidict_reuse(c_module: ModuleType, cls_name: str) -> None:
+    cls = getattr(c_module, cls_name)
+    md = cls(a=1)
+    addr = id(md)
+    del md
+
+    md = cls(b=2)
+    assert id(md) == addr
+    assert type(md) is cls
+    assert list(md.items()) == [("b", 2)]
+
+
+@pytest.mark.parametrize(
+    "make",
+    [
+        lambda md: md.copy(),
+        lambda md: type(md).from_http_header_block(b"B: 2\r\n"),
+    ],
+    ids=["copy", "from_http_header_block"],
+)
+def test_reuse_from_c_constructors(c_module: ModuleType, make: Any) -> None:
+    md = c_module.CIMultiDict(b="2")
+    tmp = c_module.CIMultiDict()
+    addr = id(tmp)
+    del tmp
+
+    new = make(md)
+    assert id(new) == addr
+    assert type(new) is c_module.CIMultiDict
+    assert new == md
+
+
+def test_reuse_across_types(c_module: ModuleType) -> None:
+    md = c_module.MultiDict(a=1)
+    del md
+
+    md = c_module.CIMultiDict(A=1)
+    assert type(md) is c_module.CIMultiDict
+    assert md["a"] == 1
+
+
+def test_proxy_reuse(c_module: ModuleType) -> None:
+    md = c_module.CIMultiDict(a=1)
+    proxy = c_module.CIMultiDictProxy(md)
+    addr = id(proxy)
+    del proxy
+
+    proxy = c_module.CIMultiDictProxy(md)
+    assert id(proxy) == addr
+    assert proxy["A"] == 1
+
+
+def test_views_and_iterators_reuse(c_module: ModuleType) -> None:
+    md = c_module.MultiDict(a=1, b=2)
+    assert list(md.keys()) == ["a", "b"]
+    assert list(md.values()) == [1, 2]
+    assert list(md.items()) == [("a", 1), ("b", 2)]
+    assert list(iter(md)) == ["a", "b"]
+
+
+def test_subclass_is_not_pooled(c_module: ModuleType) -> None:
+    class MyMultiDict(c_module.MultiDict):  # type: ignore[name-defined, misc]
+        pass
+
+    md = MyMultiDict(a=1)
+    md.attr = 1
+    del md
+
+    md2 = c_module.MultiDict(a=1)
+    assert type(md2) is c_module.MultiDict
+    assert not hasattr(md2, "attr")
+
+
+@pytest.mark.parametrize(
+    "cls_name",
+    ["MultiDict", "CIMultiDict", "MultiDictProxy", "CIMultiDictProxy"],
+)
+def test_type_refcount(c_module: ModuleType, cls_name: str) -> None:
+    cls = getattr(c_module, cls_name)
+    md = c_module.CIMultiDict(a=1)
+    arg = md if "Proxy" in cls_name else ()
+    before = sys.getrefcount(cls)
+    for _ in range(1000):
+        cls(arg)
+    assert sys.getrefcount(cls) == before
+
+
+def test_view_type_refcount(c_module: ModuleType) -> None:
+    md = c_module.MultiDict(a=1)
+    view_cls = type(md.keys())
+    iter_cls = type(iter(md))
+    before = sys.getrefcount(view_cls), sys.getrefcount(iter_cls)
+    for _ in range(1000):
+        iter(md.keys())
+    assert (sys.getrefcount(view_cls), sys.getrefcount(iter_cls)) == before
@@ -0,0 +1,247 @@
+import gc
+import pickle
+import sys
+import threading
+import weakref
+from types import ModuleType
+from typing import TYPE_CHECKING
+
+import pytest
+
+from multidict import FrozenMultiDict, MultiDict, MultiMapping, MutableMultiMapping
+
+if TYPE_CHECKING:
+    from conftest import MultidictImplementation
+
+_FMD_Class = type[FrozenMultiDict[object]]
+_MD_Class = type[MultiDict[object]]
+
+
+def test_read_api(any_frozen_multidict_class: _FMD_Class) -> None:
+    d = any_frozen_multidict_class([("a", 1), ("b", 2), ("a", 3)], c=4)
+    assert len(d) == 4
+    assert d["a"] == 1
+    assert d.getone("b") == 2
+    assert d.getall("a") == [1, 3]
+    assert d.getall("x", []) == []
+    assert d.get("x") is None
+    assert d.count("a") == 2
+    assert "c" in d
+    assert "x" not in d
+    assert list(d) == ["a", "b", "a", "c"]
+    assert list(d.items()) == [("a", 1), ("b", 2), ("a", 3), ("c", 4)]
+    assert list(d.values()) == [1, 2, 3, 4]
+    with pytest.raises(KeyError):
+        d["x"]
+
+
+def test_abc(any_frozen_multidict_class: _FMD_Class) -> None:
+    d = any_frozen_multidict_class(a=1)
+    assert isinstance(d, MultiMapping)
+    assert not isinstance(d, MutableMultiMapping)
+
+
+@pytest.mark.parametrize(
+    "mutation",
+    [
+        lambda d: d.__setitem__("a", 2),
+        lambda d: d.__delitem__("a"),
+        lambda d: d.add("a", 2),
+        lambda d: d.extend(a=2),
+        lambda d: d.update(a=2),
+        lambda d: d.clear(),
+        lambda d: d.popone("a"),
+    ],
+    ids=["setitem", "delitem", "add", "extend", "update", "clear", "popone"],
+)
+def test_immutable(any_frozen_multidict_class: _FMD_Class, mutation: object) -> None:
+    d = any_frozen_multidict_class(a=1)
+    with pytest.raises((TypeError, AttributeError)):
+        mutation(d)  # type: ignore[operator]
+    assert d == {"a": 1}
+
+
+def test_init_is_noop(any_frozen_multidict_class: _FMD_Class) -> None:
+    d = any_frozen_multidict_class(a=1)
+    d.__init__([("b", 2)])  # type: ignore[misc]
+    assert list(d.items()) == [("a", 1)]
+
+
+def test_from_multidict(
+    any_multidict_class: _MD_Class, any_frozen_multidict_class: _FMD_Class
+) -> None:
+    md = any_multidict_class([("a", 1), ("b", 2), ("a", 3)])
+    d = any_frozen_multidict_class(md)
+    md.add("c", 4)
+    del md["a"]
+    assert list(d.items()) == [("a", 1), ("b", 2), ("a", 3)]
+    assert d == any_multidict_class([("a", 1), ("b", 2), ("a", 3)])
+
+
+def test_to_multidict(
+    any_multidict_class: _MD_Class, any_frozen_multidict_class: _FMD_Class
+) -> None:
+    d = any_frozen_multidict_class([("a", 1), ("b", 2)])
+    md = any_multidict_class(d)
+    md.add("a", 3)
+    md.extend(d)
+    assert list(md.items()) == [("a", 1), ("b", 2), ("a", 3), ("a", 1), ("b", 2)]
+    assert list(d.items()) == [("a", 1), ("b", 2)]
+
+
+def test_copy_is_mutable(
+    any_multidict_class: _MD_Class, any_frozen_multidict_class: _FMD_Class
+) -> None:
+    d = any_frozen_multidict_class(a=1)
+    md = d.copy()
+    assert type(md) is any_multidict_class
+    md["a"] = 2
+    assert d["a"] == 1
+
+
+def test_same_object_reused(any_frozen_multidict_class: _FMD_Class) -> None:
+    d = any_frozen_multidict_class(a=1)
+    assert any_frozen_multidict_class(d) is d
+    assert any_frozen_multidict_class(d, b=2) is not d
+
+
+def test_hash(any_frozen_multidict_class: _FMD_Class) -> None:
+    d1 = any_frozen_multidict_class([("a", 1), ("b", 2), ("a", 3)])
+    d2 = any_frozen_multidict_class([("a", 1), ("b", 2), ("a", 3)])
+    assert d1 is not d2
+    assert d1 == d2
+    assert hash(d1) == hash(d2)
+    assert hash(d1) == hash(d1)
+    assert {d1: "x"}[d2] == "x"
+
+
+def test_hash_empty(any_frozen_multidict_class: _FMD_Class) -> None:
+    assert hash(any_frozen_multidict_class()) == hash(any_frozen_multidict_class([]))
+
+
+def test_hash_order_sensitive(any_frozen_multidict_class: _FMD_Class) -> None:
+    d1 = any_frozen_multidict_class([("a", 1), ("b", 2)])
+    d2 = any_frozen_multidict_class([("b", 2), ("a", 1)])
+    assert d1 != d2
+
+
+def test_hash_unhashable_value(any_frozen_multidict_class: _FMD_Class) -> None:
+    d = any_frozen_multidict_class(a=[])
+    with pytest.raises(TypeError):
+        hash(d)
+    with pytest.raises(TypeError):
+        hash(d)
+
+
+def test_ci_hash(multidict_module: ModuleType) -> None:
+    d1 = multidict_module.FrozenCIMultiDict(Key="v")
+    d2 = multidict_module.FrozenCIMultiDict(KEY="v")
+    assert d1 == d2
+    assert hash(d1) == hash(d2)
+    assert d1["key"] == "v"
+    assert [type(k) for k in d1] == [multidict_module.istr]
+
+
+def test_pickle(any_frozen_multidict_class: _FMD_Class) -> None:
+    d = any_frozen_multidict_class([("a", 1), ("b", 2), ("a", 3)])
+    for proto in range(pickle.HIGHEST_PROTOCOL + 1):
+        loaded = pickle.loads(pickle.dumps(d, proto))
+        assert type(loaded) is any_frozen_multidict_class
+        assert loaded == d
+
+
+def test_repr(any_frozen_multidict_class: _FMD_Class) -> None:
+    d = any_frozen_multidict_class([("a", 1), ("b", 2)])
+    name = any_frozen_multidict_class.__name__
+    assert repr(d) == f"<{name}('a': 1, 'b': 2)>"
+
+
+def test_getversion(
+    any_frozen_multidict_class: _FMD_Class, multidict_module: ModuleType
+) -> None:
+    d = any_frozen_multidict_class(a=1)
+    version = multidict_module.getversion(d)
+    d.getall("a")
+    list(d.items())
+    assert multidict_module.getversion(d) == version
+
+
+@pytest.mark.parametrize("size", [5, 16, 100, 1000, 5000])
+def test_lookups(any_frozen_multidict_class: _FMD_Class, size: int) -> None:
+    items = [(f"key{i % (size // 2 + 1)}", i) for i in range(size)]
+    expected = MultiDict(items)
+    d = any_frozen_multidict_class(items)
+    for key in set(expected):
+        assert d.getall(key) == expected.getall(key)
+        assert d[key] == expected[key]
+    assert "missing" not in d
+    assert list(d.items()) == items
+
+
+def test_subclass(any_frozen_multidict_class: _FMD_Class) -> None:
+    class Sub(any_frozen_multidict_class):  # type: ignore[valid-type,misc]
+        pass
+
+    d = Sub(a=1)
+    assert type(Sub(d)) is Sub
+    assert d == any_frozen_multidict_class(a=1)
+    assert hash(d) == hash(any_frozen_multidict_class(a=1))
+
+
+def test_concurrent_reads(any_frozen_multidict_class: _FMD_Class) -> None:
+    items = [(f"Key{i}", i) for i in range(200)]
+    d = any_frozen_multidict_class(items)
+    errors: list[BaseException] = []
+
+    def read() -> None:
+        try:
+            for _ in range(20):
+                for key, value in items:
+                    assert d[key] == value
+                assert list(d.items()) == items
+                hash(d)
+        except BaseException as exc:  # pragma: no cover
+            errors.append(exc)
+
+    threads = [threading.Thread(target=read) for _ in range(4)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    assert not errors
+
+
+@pytest.fixture
+def c_frozen_class(
+    multidict_implementation: "MultidictImplementation",
+    any_frozen_multidict_class: _FMD_Class,
+) -> _FMD_Class:
+    if multidict_implementation.is_pure_python:
+        pytest.skip("The C implementation only")
+    return any_frozen_multidict_class
+
+
+def test_atomic_items_untracked(c_frozen_class: _FMD_Class) -> None:
+    assert not gc.is_tracked(c_frozen_class(a="b", c=1))
+    assert gc.is_tracked(c_frozen_class(a=[]))
+
+
+def test_cycle_collected(c_frozen_class: _FMD_Class) -> None:
+    lst: list[object] = []
+    d = c_frozen_class(a=lst)
+    lst.append(d)
+    wr = weakref.ref(d)
+    del d, lst
+    gc.collect()
+    assert wr() is None
+
+
+@pytest.mark.skipif(
+    sys.implementation.name == "pypy", reason="PyPy has no sys.getsizeof()"
+)
+def test_compact_table(c_frozen_class: _FMD_Class) -> None:
+    md: MultiDict[int] = MultiDict()
+    md.reserve(1000)
+    md.extend((f"key{i}", i) for i in range(100))
+    d = c_frozen_class(md)
+    assert sys.getsizeof(d) < sys.getsizeof(md)
@@ -0,0 +1,116 @@
+"""Tests for the lazy GC tracking of multidicts in the C extension."""
+
+import gc
+import weakref
+from types import ModuleType
+
+import pytest
+
+
+@pytest.fixture(params=["MultiDict", "CIMultiDict"])
+def cls(c_module: ModuleType, request: pytest.FixtureRequest) -> type:
+    return getattr(c_module, request.param)  # type: ignore[no-any-return]
+
+
+def test_atomic_items_untracked(cls: type) -> None:
+    md = cls([("a", "str"), ("b", b"bytes"), ("c", 1), ("d", None)])
+    md.add("e", 1.5)
+    md["f"] = ("a", 1)
+    md.setdefault("g", "h")
+    md.update(h="i")
+    md.merge(j="k")
+    assert not gc.is_tracked(md)
+    assert not gc.is_tracked(md.copy())
+
+
+def test_empty_untracked(cls: type) -> None:
+    assert not gc.is_tracked(cls())
+
+
+@pytest.mark.parametrize(
+    "store",
+    [
+        lambda md, v: md.add("x", v),
+        lambda md, v: md.__setitem__("a", v),
+        lambda md, v: md.__setitem__("x", v),
+        lambda md, v: md.setdefault("x", v),
+        lambda md, v: md.extend([("x", v)]),
+        lambda md, v: md.update(a=v),
+        lambda md, v: md.update(x=v),
+        lambda md, v: md.merge(x=v),
+    ],
+    ids=[
+        "add",
+        "setitem-replace",
+        "setitem-new",
+        "setdefault",
+        "extend",
+        "update-replace",
+        "update-new",
+        "merge",
+    ],
+)
+def test_container_value_tracks(cls: type, store: object) -> None:
+    md = cls(a="b")
+    assert not gc.is_tracked(md)
+    store(md, [])  # type: ignore[operator]
+    assert gc.is_tracked(md)
+
+
+def test_tracked_forever(cls: type) -> None:
+    md = cls(a="b")
+    md["c"] = []
+    del md["c"]
+    assert gc.is_tracked(md)
+
+
+def test_copy_inherits_tracking(cls: type) -> None:
+    md = cls(a=[])
+    assert gc.is_tracked(md.copy())
+    other = cls()
+    other.extend(md)
+    assert gc.is_tracked(other)
+
+
+def test_subclass_tracked(cls: type) -> None:
+    sub = type("Sub", (cls,), {})
+    assert gc.is_tracked(sub(a="b"))
+
+
+def test_untracked_tuple_value(cls: type) -> None:
+    value = tuple([1, 2])
+    gc.collect()  # the collector untracks tuples of atomic items
+    assert not gc.is_tracked(value)
+    md = cls(a=value)
+    assert not gc.is_tracked(md)
+
+
+@pytest.mark.parametrize(
+    "value",
+    [1j, range(3), (1, 1j)],
+    ids=["complex", "range", "tuple"],
+)
+def test_non_atomic_value_tracks(cls: type, value: object) -> None:
+    # non-GC objects of types not known to be safe to release
+    gc.collect()  # untrack the tuple
+    md = cls(a=value)
+    assert gc.is_tracked(md)
+    assert gc.is_tracked(md.copy())
+
+
+def test_cycle_collected(cls: type) -> None:
+    md = cls(a="b")
+    md["self"] = md
+    wr = weakref.ref(md)
+    del md
+    gc.collect()
+    assert wr() is None
+
+
+def test_cycle_through_proxy_collected(cls: type, c_module: ModuleType) -> None:
+    md = cls(a="b")
+    md["proxy"] = c_module.MultiDictProxy(md)
+    wr = weakref.ref(md)
+    del md
+    gc.collect()
+    assert wr() is None
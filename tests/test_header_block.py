@@ -0,0 +1,165 @@
+"""Tests for CIMultiDict.from_http_header_block()."""
+
+from typing import Any
+
+import pytest
+
+from multidict import CIMultiDict
+
+_CIMD_Class = type[CIMultiDict[str]]
+
+
+def test_basic(case_insensitive_multidict_class: _CIMD_Class) -> None:
+    block = (
+        b"Host: example.com\r\n"
+        b"Content-Type: text/html\r\n"
+        b"set-cookie: a=1\r\n"
+        b"Set-Cookie: b=2\r\n"
+        b"X-Custom-Header:value\r\n"
+        b"\r\n"
+    )
+    d = case_insensitive_multidict_class.from_http_header_block(block)
+    assert type(d) is case_insensitive_multidict_class
+    assert list(d.items()) == [
+        ("Host", "example.com"),
+        ("Content-Type", "text/html"),
+        ("set-cookie", "a=1"),
+        ("Set-Cookie", "b=2"),
+        ("X-Custom-Header", "value"),
+    ]
+    assert d["content-type"] == "text/html"
+    assert d.getall("SET-COOKIE") == ["a=1", "b=2"]
+
+
+@pytest.mark.parametrize(
+    "block",
+    [b"A: 1\r\nB: 2", b"A: 1\nB: 2\n", b"A: 1\r\nB: 2\r\n\r\nC: 3", b"A: 1\nB: 2\n\n"],
+    ids=["no-end", "lf", "body", "lf-end"],
+)
+def test_line_endings(
+    case_insensitive_multidict_class: _CIMD_Class, block: bytes
+) -> None:
+    d = case_insensitive_multidict_class.from_http_header_block(block)
+    assert list(d.items()) == [("A", "1"), ("B", "2")]
+
+
+@pytest.mark.parametrize("block", [b"", b"\r\n", b"\n", b"\r\nA: 1"])
+def test_empty(case_insensitive_multidict_class: _CIMD_Class, block: bytes) -> None:
+    assert len(case_insensitive_multidict_class.from_http_header_block(block)) == 0
+
+
+def test_whitespace_is_trimmed(case_insensitive_multidict_class: _CIMD_Class) -> None:
+    block = b"A: \t one two \t\r\nB:\r\nC:   \r\n"
+    d = case_insensitive_multidict_class.from_http_header_block(block)
+    assert list(d.items()) == [("A", "one two"), ("B", ""), ("C", "")]
+
+
+def test_obs_fold(case_insensitive_multidict_class: _CIMD_Class) -> None:
+    block = b"A: one\r\n  two  \r\n\tthree\r\n \r\nB:\r\n four\r\nC: 5\r\n"
+    d = case_insensitive_multidict_class.from_http_header_block(block)
+    assert list(d.items()) == [("A", "one two three"), ("B", "four"), ("C", "5")]
+
+
+@pytest.mark.parametrize(
+    ("encoding", "expected"),
+    [
+        ("utf-8", "caf\xe9 \udcff"),
+        ("latin-1", "caf\xc3\xa9 \xff"),
+    ],
+)
+def test_encoding(
+    case_insensitive_multidict_class: _CIMD_Class, encoding: str, expected: str
+) -> None:
+    block = b"X-Name: caf\xc3\xa9 \xff\r\n"
+    d = case_insensitive_multidict_class.from_http_header_block(
+        block, encoding=encoding
+    )
+    assert d["x-name"] == expected
+
+
+def test_bad_encoding(case_insensitive_multidict_class: _CIMD_Class) -> None:
+    with pytest.raises(ValueError, match="utf-8"):
+        case_insensitive_multidict_class.from_http_header_block(b"", "ascii")
+    with pytest.raises(TypeError):
+        case_insensitive_multidict_class.from_http_header_block(
+            b"", 1  # type: ignore[arg-type]
+        )
+
+
+@pytest.mark.parametrize(
+    "block", [bytearray(b"A: 1\r\n"), memoryview(b"xxA: 1\r\n")[2:]]
+)
+def test_buffer_protocol(
+    case_insensitive_multidict_class: _CIMD_Class, block: Any
+) -> None:
+    d = case_insensitive_multidict_class.from_http_header_block(block)
+    assert list(d.items()) == [("A", "1")]
+
+
+def test_not_buffer(case_insensitive_multidict_class: _CIMD_Class) -> None:
+    with pytest.raises(TypeError):
+        case_insensitive_multidict_class.from_http_header_block(
+            "A: 1"  # type: ignore[arg-type]
+        )
+
+
+@pytest.mark.parametrize(
+    ("block", "message"),
+    [
+        (b" A: 1\r\n", "Unexpected line folding at offset 0"),
+        (b"A: 1\r\nB\r\n", "Missing colon in header line at offset 6"),
+        (b"A: 1\r\nB", "Missing colon in header line at offset 6"),
+        (b": 1\r\n", "Invalid header name at offset 0"),
+        (b"A : 1\r\n", "Invalid header name at offset 0"),
+        (b"A\xe9: 1\r\n", "Invalid header name at offset 0"),
+        (b"A: 1\r2\r\n", "Invalid CR in header value at offset 4"),
+        (b"A: 1\x002\r\n", "Invalid NUL in header value at offset 4"),
+        (b"A: 1\r\n 2\x00\r\n", "Invalid NUL in header value at offset 8"),
+    ],
+)
+def test_invalid(
+    case_insensitive_multidict_class: _CIMD_Class, block: bytes, message: str
+) -> None:
+    with pytest.raises(ValueError, match=message):
+        case_insensitive_multidict_class.from_http_header_block(block)
+
+
+def test_long_lines(case_insensitive_multidict_class: _CIMD_Class) -> None:
+    # longer than the SIMD step in every part
+    name = "X-" + "Very-Long-Header-Name" * 3
+    value = "v" * 100
+    block = "".join(f"{name}{i}: {value}{i}\r\n" for i in range(50)).encode()
+    d = case_insensitive_multidict_class.from_http_header_block(block)
+    assert list(d.items()) == [(f"{name}{i}", f"{value}{i}") for i in range(50)]
+
+
+def test_keys_are_istr(
+    case_insensitive_multidict_class: _CIMD_Class,
+    case_insensitive_str_class: type[str],
+) -> None:
+    d = case_insensitive_multidict_class.from_http_header_block(
+        b"content-length: 1\r\nX-Other: 2\r\n"
+    )
+    assert [type(k) for k in d] == [case_insensitive_str_class] * 2
+    assert list(d) == ["content-length", "X-Other"]
+
+
+def test_subclass(case_insensitive_multidict_class: _CIMD_Class) -> None:
+    class Headers(case_insensitive_multidict_class):  # type: ignore[valid-type,misc]
+        pass
+
+    d = Headers.from_http_header_block(b"A: 1\r\n")
+    assert type(d) is Headers
+    assert d["a"] == "1"
+    d.add("b", "2")
+    assert len(d) == 2
+
+
+def test_mutable(case_insensitive_multidict_class: _CIMD_Class) -> None:
+    block = b"".join(b"H%d: %d\r\n" % (i, i) for i in range(20))
+    d = case_insensitive_multidict_class.from_http_header_block(block)
+    for i in range(20):
+        d[f"h{i}"] = str(-i)
+    d.add("New", "x")
+    assert len(d) == 21
+    assert d["H7"] == "-7"
@@ -0,0 +1,73 @@
+"""Tests for the pool of released hashtables in the C extension."""
+
+from types import ModuleType
+
+import pytest
+
+# the tables of split multidicts are kept by the layout cache
+pytestmark = [
+    pytest.mark.usefixtures("c_caches"),
+    pytest.mark.parametrize(
+        "c_caches", [{"split_layouts": 0}], indirect=True, ids=["unsplit"]
+    ),
+]
+
+
+def test_stats(c_module: ModuleType) -> None:
+    stats = c_module._htkeys_pool_stats()
+    assert set(stats) == {"hits", "misses", "cached", "maxsize"}
+    assert stats["maxsize"] > 0
+
+
+def test_reuse(c_module: ModuleType) -> None:
+    md = c_module.CIMultiDict([(str(i), i) for i in range(10)])
+    del md
+    before = c_module._htkeys_pool_stats()
+    assert before["cached"] > 0
+
+    md = c_module.CIMultiDict([(str(i), i) for i in range(10)])
+    after = c_module._htkeys_pool_stats()
+    assert after["hits"] == before["hits"] + 1
+    assert after["cached"] == before["cached"] - 1
+    assert md.getall("5") == [5]
+
+
+def test_copy_uses_pool(c_module: ModuleType) -> None:
+    md = c_module.MultiDict([(str(i), i) for i in range(10)])
+    before = c_module._htkeys_pool_stats()
+    md2 = md.copy()
+    # the table is shared until the first modification
+    after = c_module._htkeys_pool_stats()
+    assert after["hits"] + after["misses"] == before["hits"] + before["misses"]
+    md2["0"] = 1
+    after = c_module._htkeys_pool_stats()
+    assert after["hits"] + after["misses"] == before["hits"] + before["misses"] + 1
+    assert md != md2
+
+
+def test_large_tables_are_not_pooled(c_module: ModuleType) -> None:
+    before = c_module._htkeys_pool_stats()
+    md = c_module.MultiDict((str(i), i) for i in range(10000))
+    del md
+    after = c_module._htkeys_pool_stats()
+    assert after["cached"] <= before["cached"] + 6
+
+
+def test_set_maxsize(c_module: ModuleType) -> None:
+    mds = [c_module.MultiDict(a=1, b=2, c=3, d=4, e=5, f=6) for _ in range(10)]
+    del mds
+    assert c_module._htkeys_pool_stats()["cached"] >= 10
+
+    c_module._set_htkeys_pool_maxsize(0)
+    stats = c_module._htkeys_pool_stats()
+    assert stats["cached"] == 0
+    assert stats["maxsize"] == 0
+
+    mds = [c_module.MultiDict(a=1, b=2, c=3, d=4, e=5, f=6) for _ in range(10)]
+    del mds
+    assert c_module._htkeys_pool_stats()["cached"] == 0
+
+
+def test_set_maxsize_negative(c_module: ModuleType) -> None:
+    with pytest.raises(ValueError, match="non-negative"):
+        c_module._set_htkeys_pool_maxsize(-1)
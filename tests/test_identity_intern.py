@@ -0,0 +1,151 @@
+"""Tests for the intern table of case-insensitive identities."""
+
+from types import ModuleType
+
+import pytest
+
+# dicts sharing a split table don't look up identities
+pytestmark = [
+    pytest.mark.usefixtures("c_caches"),
+    pytest.mark.parametrize(
+        "c_caches", [{"split_layouts": 0}], indirect=True, ids=["unsplit"]
+    ),
+]
+
+
+def _decoded(s: str) -> str:
+    # a fresh str object, like a header name decoded from the wire
+    return s.encode().decode()
+
+
+def test_stats(c_module: ModuleType) -> None:
+    stats = c_module._identity_intern_stats()
+    assert set(stats) == {"hits", "misses", "used", "size"}
+    assert stats["size"] > 0
+
+
+def test_identities_are_shared(c_module: ModuleType) -> None:
+    md1 = c_module.CIMultiDict([(_decoded("X-Custom-Key"), 1)])
+    md2 = c_module.CIMultiDict([(_decoded("X-CUSTOM-KEY"), 2)])
+    before = c_module._identity_intern_stats()
+    md3 = c_module.CIMultiDict([(_decoded("X-Custom-Key"), 3)])
+    after = c_module._identity_intern_stats()
+    assert after["hits"] == before["hits"] + 1
+
+    assert md1["x-custom-key"] == 1
+    assert md2["x-custom-key"] == 2
+    assert md3["X-CUSTOM-KEY"] == 3
+    assert list(md3) == ["X-Custom-Key"]
+
+
+def test_istr_canonical_is_shared(c_module: ModuleType) -> None:
+    md = c_module.CIMultiDict([(_decoded("X-Interned-Key"), 1)])
+    key = c_module.istr(_decoded("X-INTERNED-KEY"))
+    assert md[key] == 1
+    assert md.getall(_decoded("x-interned-key")) == [1]
+
+
+def test_istr_is_not_a_miss(c_module: ModuleType) -> None:
+    before = c_module._identity_intern_stats()
+    c_module.istr(_decoded("X-Istr-Only-Key"))
+    after = c_module._identity_intern_stats()
+    assert after["misses"] == before["misses"]
+    assert after["used"] == before["used"] + 1
+
+
+def test_disabled_table(c_module: ModuleType) -> None:
+    c_module._set_identity_intern_size(0)
+    md = c_module.CIMultiDict([(_decoded("X-Disabled-Key"), 1)])
+    key = c_module.istr(_decoded("X-DISABLED-KEY"))
+    stats = c_module._identity_intern_stats()
+    assert stats["used"] == 0
+    assert md[key] == 1
+
+
+def test_lookup_by_interned_key(c_module: ModuleType) -> None:
+    key = "X-Lookup-Key"
+    hash(key)
+    md = c_module.CIMultiDict([(key, 1), ("x-lookup-key", 2)])
+    assert md.getall("X-LOOKUP-KEY") == [1, 2]
+    assert md.getall(key) == [1, 2]
+    assert "x-Lookup-key" in md
+    assert "X-Lookup-Keys" not in md
+
+
+def test_long_keys_are_not_interned(c_module: ModuleType) -> None:
+    c_module._set_identity_intern_size(8)
+    key = "X-" + "A" * 100
+    md = c_module.CIMultiDict([(key, 1)])
+    assert c_module._identity_intern_stats()["used"] == 0
+    assert md[key.lower()] == 1
+
+
+def test_bounded(c_module: ModuleType) -> None:
+    c_module._set_identity_intern_size(8)
+    md = c_module.CIMultiDict((f"Key-{i}", i) for i in range(1000))
+    stats = c_module._identity_intern_stats()
+    assert stats["size"] == 8
+    assert stats["used"] <= 8
+    assert md.getall("KEY-999") == [999]
+    assert md.getall("key-0") == [0]
+
+
+def test_disable(c_module: ModuleType) -> None:
+    c_module.CIMultiDict([("Some-Key", 1)])
+    c_module._set_identity_intern_size(0)
+    stats = c_module._identity_intern_stats()
+    assert stats["used"] == 0
+    assert stats["size"] == 0
+
+    md = c_module.CIMultiDict([("Some-Key", 1)])
+    assert c_module._identity_intern_stats()["used"] == 0
+    assert md["some-key"] == 1
+
+
+@pytest.mark.parametrize("size", [-1, 3, 1000])
+def test_set_size_invalid(c_module: ModuleType, size: int) -> None:
+    with pytest.raises(ValueError, match="power of two"):
+        c_module._set_identity_intern_size(size)
+
+
+@pytest.mark.parametrize(
+    "name", ["Content-Type", "content-type", "CONTENT-TYPE", "x-request-id", "TE"]
+)
+def test_header_id(c_module: ModuleType, name: str) -> None:
+    header_id = c_module._header_id(name)
+    assert isinstance(header_id, int)
+    assert header_id == c_module._header_id(name.swapcase())
+
+
+@pytest.mark.parametrize(
+    "name", ["", "Content-Typ", "Content-Types", "X-Custom", "Contént-Type"]
+)
+def test_header_id_unknown(c_module: ModuleType, name: str) -> None:
+    assert c_module._header_id(name) is None
+
+
+def test_known_headers_are_not_interned(c_module: ModuleType) -> None:
+    before = c_module._identity_intern_stats()
+    md = c_module.CIMultiDict(
+        [(_decoded("Content-Type"), 1), (_decoded("USER-AGENT"), 2)]
+    )
+    key = c_module.istr(_decoded("Accept-Encoding"))
+    after = c_module._identity_intern_stats()
+    assert after["hits"] == before["hits"]
+    assert after["misses"] == before["misses"]
+
+    md[key] = 3
+    assert md["content-type"] == 1
+    assert md.getall("User-Agent") == [2]
+    assert md["ACCEPT-ENCODING"] == 3
+    assert list(md) == ["Content-Type", "USER-AGENT", "Accept-Encoding"]
+
+
+def test_istr_subclass_lower_is_respected(c_module: ModuleType) -> None:
+    class Alias(c_module.istr):  # type: ignore[name-defined, misc]
+        def lower(self) -> str:
+            return "x-alias"
+
+    md = c_module.CIMultiDict([(Alias("Content-Type"), 1)])
+    assert md["X-Alias"] == 1
+    assert "content-type" not in md
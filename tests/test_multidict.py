@@ -272,6 +272,22 @@ class BaseMultiDictTest:
         assert (42, 3) not in d.items()  # type: ignore[comparison-overlap]
         assert 42 not in d.items()  # type: ignore[comparison-overlap]
 
+    def test_items__contains_reentrant_lookup(
+        self,
+        cls: type[MultiDict[object]] | type[CIMultiDict[object]],
+    ) -> None:
+        d = cls([("key", 1), ("other", 2), ("key", 3)])
+        seen = []
+
+        class Value:
+            def __eq__(self, other: object) -> bool:
+                seen.append(d.getall("key"))
+                return False
+
+        assert ("key", Value()) not in d.items()
+        assert seen == [[1, 3], [1, 3]]
+        assert d.getall("key") == [1, 3]
+
     def test_cannot_create_from_unaccepted(
         self,
         cls: type[MutableMultiMapping[str]],
@@ -772,6 +788,13 @@ class TestMultiDict(BaseMultiDictTest):
         default = object()
         assert d.getall("some_key", default) is default
 
+    def test_count(self, cls: type[MultiDict[str]]) -> None:
+        d = cls([("key", "value1"), ("other", "value")], key="value2")
+
+        assert d.count("key") == 2
+        assert d.count("other") == 1
+        assert d.count("some_key") == 0
+
     def test_preserve_stable_ordering(
         self,
         cls: type[MultiDict[str | int]],
@@ -785,6 +808,18 @@ class TestMultiDict(BaseMultiDictTest):
         d = cls([("a", 1), ("a", 2)])
         assert d["a"] == 1
 
+    @pytest.mark.parametrize("char", ["a", "\xe9", "€", "\U0001f600"])
+    def test_lookup_by_equal_keys(self, cls: type[MultiDict[int]], char: str) -> None:
+        keys = [char * n + str(n) for n in range(40)]
+        d = cls((key, i) for i, key in enumerate(keys))
+        for i, key in enumerate(keys):
+            # an equal str, not the same object
+            other = "".join(list(key))
+            assert d[other] == i
+            assert d.getall(other) == [i]
+            assert other + "x" not in d
+        assert d == cls((key.encode().decode(), i) for i, key in enumerate(keys))
+
     def test_items__repr__(self, cls: type[MultiDict[str]]) -> None:
         d = cls([("key", "value1")], key="value2")
         expected = "<_ItemsView('key': 'value1', 'key': 'value2')>"
@@ -860,10 +895,48 @@ class TestCIMultiDict(BaseMultiDictTest):
         with pytest.raises(KeyError, match="some_key"):
             d.getall("some_key")
 
+    def test_count(self, cls: type[CIMultiDict[str]]) -> None:
+        d = cls([("KEY", "value1")], key="value2")
+
+        assert d.count("Key") == 2
+        assert d.count("some_key") == 0
+
     def test_get(self, cls: type[CIMultiDict[int]]) -> None:
         d = cls([("A", 1), ("a", 2)])
         assert 1 == d["a"]
 
+    def test_lookup_mixed_case(self, cls: type[CIMultiDict[int]]) -> None:
+        class S(str):
+            pass
+
+        long_key = "X-" + "Long" * 50
+        d = cls([("Content-Type", 1), (long_key, 2), ("Stra\xdfe", 3), ("\u212a", 4)])
+
+        assert d["content-type"] == 1
+        assert d["CONTENT-TYPE"] == 1
+        assert d[S("cOnTeNt-TyPe")] == 1
+        assert d.getall("Content-type") == [1]
+        assert "CONTENT-type" in d
+        assert "Content-Typ" not in d
+        assert "Content-Typf" not in d
+        assert d[long_key.upper()] == 2
+        assert d["STRA\xdfE"] == 3
+        assert d["K"] == 4
+        assert d.count("k") == 1
+
+    def test_lookup_by_subclass_with_lower(
+        self, cls: type[CIMultiDict[int]]
+    ) -> None:
+        class Alias(str):
+            def lower(self) -> str:
+                return "content-type"
+
+        d = cls([("Content-Type", 1), ("X-Other", 2)])
+
+        assert d[Alias("X-Other")] == 1
+        assert Alias("missing") in d
+        assert d.getall(Alias("X-OTHER")) == [1]
+
     def test__repr__(self, cls: type[CIMultiDict[str]]) -> None:
         d = cls([("KEY", "value1")], key="value2")
         _cls = type(d)
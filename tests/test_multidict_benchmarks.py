@@ -5,8 +5,10 @@ from pytest_codspeed import BenchmarkFixture
 from multidict import (
     CIMultiDict,
     CIMultiDictProxy,
+    FrozenMultiDict,
     MultiDict,
     MultiDictProxy,
+    PersistentMultiDict,
     istr,
 )
 
@@ -115,6 +117,20 @@ def test_multidict_popitem_str(
             md.popitem()
 
 
+def test_multidict_grow_shrink_str(
+    benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
+) -> None:
+    md = any_multidict_class((str(i), str(i)) for i in range(10))
+    keys = [str(i) for i in range(10, 1000)]
+
+    @benchmark
+    def _run() -> None:
+        for key in keys:
+            md[key] = key
+        for key in keys:
+            del md[key]
+
+
 def test_multidict_clear_str(
     benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
 ) -> None:
@@ -125,6 +141,32 @@ def test_multidict_clear_str(
         md.clear()
 
 
+def test_multidict_refill_str(
+    benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
+) -> None:
+    md = any_multidict_class()
+    items = [(str(i), str(i)) for i in range(20)]
+
+    @benchmark
+    def _run() -> None:
+        for key, value in items:
+            md.add(key, value)
+        md.clear()
+
+
+def test_multidict_refill_keep_capacity_str(
+    benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
+) -> None:
+    md = any_multidict_class()
+    items = [(str(i), str(i)) for i in range(20)]
+
+    @benchmark
+    def _run() -> None:
+        for key, value in items:
+            md.add(key, value)
+        md.clear(keep_capacity=True)
+
+
 def test_multidict_update_str(
     benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
 ) -> None:
@@ -187,6 +229,30 @@ def test_cimultidict_update_istr_with_kwargs(
         md.update(items, **kwargs)
 
 
+def test_multidict_update_small_into_large_str(
+    benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
+) -> None:
+    md = any_multidict_class((str(i), str(i)) for i in range(50000))
+    items = [{str(i): str(i), "x": str(i)} for i in range(0, 50000, 500)]
+
+    @benchmark
+    def _run() -> None:
+        for upd in items:
+            md.update(upd)
+
+
+def test_multidict_merge_small_into_large_str(
+    benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
+) -> None:
+    md = any_multidict_class((str(i), str(i)) for i in range(50000))
+    items = [{str(i): str(i), "x": str(i)} for i in range(0, 50000, 500)]
+
+    @benchmark
+    def _run() -> None:
+        for upd in items:
+            md.merge(upd)
+
+
 def test_multidict_extend_str(
     benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
 ) -> None:
@@ -220,6 +286,19 @@ def test_cimultidict_extend_istr(
             md.extend(items)
 
 
+def test_multidict_extend_multidict_str(
+    benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
+) -> None:
+    base_md = any_multidict_class((str(i), str(i)) for i in range(100))
+    other = any_multidict_class((str(i), str(i)) for i in range(200))
+
+    @benchmark
+    def _run() -> None:
+        for _ in range(100):
+            md = base_md.copy()
+            md.extend(other)
+
+
 def test_multidict_extend_str_with_kwargs(
     benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
 ) -> None:
@@ -407,6 +486,52 @@ def test_multidict_get_miss(
             md.get(i)
 
 
+def test_multidict_get_hit_large(
+    benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
+) -> None:
+    md = any_multidict_class((str(i), str(i)) for i in range(10000))
+    items = [str(i) for i in range(0, 10000, 100)]
+
+    @benchmark
+    def _run() -> None:
+        for i in items:
+            md.get(i)
+
+
+def test_multidict_contains_miss_large(
+    benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
+) -> None:
+    md = any_multidict_class((str(i), str(i)) for i in range(10000))
+    items = [str(i) for i in range(10000, 10100)]
+
+    @benchmark
+    def _run() -> None:
+        for i in items:
+            i in md
+
+
+def test_multidict_add_duplicates(
+    benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
+) -> None:
+    @benchmark
+    def _run() -> None:
+        md = any_multidict_class()
+        for i in range(10000):
+            md.add("key", "value")
+
+
+def test_multidict_getall_duplicates(
+    benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
+) -> None:
+    md = any_multidict_class(("key", str(i)) for i in range(10000))
+    md.add("other", "value")
+
+    @benchmark
+    def _run() -> None:
+        md.getall("other")
+        md.getall("key")
+
+
 def test_cimultidict_get_istr_hit(
     benchmark: BenchmarkFixture,
     case_insensitive_multidict_class: type[CIMultiDict[istr]],
@@ -441,6 +566,32 @@ def test_cimultidict_get_istr_miss(
             md.get(i)
 
 
+def test_cimultidict_get_str_mixed_case_hit(
+    benchmark: BenchmarkFixture,
+    case_insensitive_multidict_class: type[CIMultiDict[str]],
+) -> None:
+    md = case_insensitive_multidict_class((f"X-Header-{i}", str(i)) for i in range(100))
+    items = [f"x-HEADER-{i}" for i in range(100)]
+
+    @benchmark
+    def _run() -> None:
+        for i in items:
+            md.get(i)
+
+
+def test_cimultidict_get_str_mixed_case_miss(
+    benchmark: BenchmarkFixture,
+    case_insensitive_multidict_class: type[CIMultiDict[str]],
+) -> None:
+    md = case_insensitive_multidict_class((f"X-Header-{i}", str(i)) for i in range(100))
+    items = [f"x-HEADER-{i}" for i in range(100, 200)]
+
+    @benchmark
+    def _run() -> None:
+        for i in items:
+            md.get(i)
+
+
 def test_multidict_get_hit_with_default(
     benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
 ) -> None:
@@ -652,6 +803,105 @@ def test_copy_from_existing_cimultidict(
         existing.copy()
 
 
+def test_create_cimultidict_same_headers(
+    benchmark: BenchmarkFixture,
+    case_insensitive_multidict_class: type[CIMultiDict[str]],
+) -> None:
+    names = ["Content-Type", "Content-Length", "Date", "Server", "X-Request-Id"]
+    # fresh key objects for every response, like names decoded from the wire
+    responses = [
+        [(name.encode().decode(), str(i)) for name in names] for i in range(100)
+    ]
+
+    @benchmark
+    def _run() -> None:
+        for items in responses:
+            case_insensitive_multidict_class(items)
+
+
+def test_cimultidict_from_http_header_block(
+    benchmark: BenchmarkFixture,
+    case_insensitive_multidict_class: type[CIMultiDict[str]],
+) -> None:
+    block = (
+        b"Host: example.com\r\n"
+        b"User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:130.0) Firefox/130.0\r\n"
+        b"Accept: text/html,application/xhtml+xml\r\n"
+        b"Accept-Language: en-US,en;q=0.5\r\n"
+        b"Accept-Encoding: gzip, deflate, br\r\n"
+        b"Connection: keep-alive\r\n"
+        b"Cookie: session=0123456789abcdef\r\n"
+        b"X-Request-Id: 0f1e2d3c4b5a\r\n"
+        b"\r\n"
+    )
+
+    @benchmark
+    def _run() -> None:
+        for _ in range(100):
+            case_insensitive_multidict_class.from_http_header_block(block)
+
+
+def test_copy_large_multidict(
+    benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
+) -> None:
+    existing = any_multidict_class((str(i), str(i)) for i in range(1000))
+
+    @benchmark
+    def _run() -> None:
+        for _ in range(100):
+            existing.copy()
+
+
+def test_copy_and_modify_multidict(
+    benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
+) -> None:
+    existing = any_multidict_class((str(i), str(i)) for i in range(20))
+
+    @benchmark
+    def _run() -> None:
+        for _ in range(100):
+            md = existing.copy()
+            md["0"] = "changed"
+
+
+def test_frozen_multidict_fetch(
+    benchmark: BenchmarkFixture,
+    any_frozen_multidict_class: type[FrozenMultiDict[str]],
+) -> None:
+    md = any_frozen_multidict_class((str(i), str(i)) for i in range(100))
+    items = [str(i) for i in range(100)]
+
+    @benchmark
+    def _run() -> None:
+        for i in items:
+            md[i]
+
+
+def test_frozen_multidict_hash(
+    benchmark: BenchmarkFixture,
+    any_frozen_multidict_class: type[FrozenMultiDict[str]],
+) -> None:
+    md = any_frozen_multidict_class((str(i), str(i)) for i in range(20))
+    cache = {md: None}
+
+    @benchmark
+    def _run() -> None:
+        for _ in range(100):
+            md in cache
+
+
+def test_persistent_multidict_with_replaced(
+    benchmark: BenchmarkFixture,
+    any_persistent_multidict_class: type[PersistentMultiDict[str]],
+) -> None:
+    md = any_persistent_multidict_class((str(i), str(i)) for i in range(1000))
+
+    @benchmark
+    def _run() -> None:
+        for i in range(100):
+            md.with_replaced(str(i), "changed")
+
+
 def test_iterate_multidict(
     benchmark: BenchmarkFixture, any_multidict_class: type[MultiDict[str]]
 ) -> None:
@@ -1,5 +1,6 @@
 import string
 import sys
+from collections.abc import Callable
 
 import pytest
 
@@ -346,6 +347,46 @@ class TestMutableMultiDict:
 
         assert {"key" + str(SIZE - 1): SIZE - 1} == d
 
+    def test_order_on_growth_from_small_table(
+        self,
+        case_sensitive_multidict_class: type[MultiDict[int]],
+    ) -> None:
+        d = case_sensitive_multidict_class()
+        expected = []
+        for i in range(8):
+            d.add("key" + str(i % 3), i)
+            expected.append(("key" + str(i % 3), i))
+        del d["key1"]
+        expected = [item for item in expected if item[0] != "key1"]
+        for i in range(8, 20):
+            d.add("key" + str(i % 3), i)
+            expected.append(("key" + str(i % 3), i))
+
+        assert list(d.items()) == expected
+        assert d.getall("key1") == [i for i in range(8, 20) if i % 3 == 1]
+
+    def test_many_duplicates(
+        self,
+        case_sensitive_multidict_class: type[MultiDict[int]],
+    ) -> None:
+        d = case_sensitive_multidict_class()
+        for i in range(1000):
+            d.add("dup", i)
+            d.add("key" + str(i % 10), i)
+
+        assert d.count("dup") == 1000
+        assert d.getall("dup") == list(range(1000))
+        assert d.popone("dup") == 0
+        d.popitem()
+        assert d.popitem() == ("dup", 999)
+        d["key5"] = -1
+        assert d.count("key5") == 1
+        assert d.getall("dup") == list(range(1, 999))
+        d.update(dup=-1)
+        assert d.popall("dup") == [-1]
+        assert d.count("dup") == 0
+        assert len(d) == 900
+
     def test_update(
         self,
         case_sensitive_multidict_class: type[MultiDict[str | int]],
@@ -780,6 +821,72 @@ class TestCIMutableMultiDict:
         md = case_insensitive_multidict_class()
         assert sys.getsizeof(md) < 1024
 
+    @pytest.mark.skipif(
+        sys.implementation.name == "pypy",
+        reason="getsizeof() is not implemented on PyPy",
+    )
+    @pytest.mark.parametrize(
+        "remove",
+        [
+            lambda md, key: md.__delitem__(key),
+            lambda md, key: md.popone(key),
+            lambda md, key: md.popall(key),
+            lambda md, key: md.popitem(),
+        ],
+        ids=["delitem", "popone", "popall", "popitem"],
+    )
+    def test_sizeof_shrinks_after_deletions(
+        self,
+        case_insensitive_multidict_class: type[CIMultiDict[str]],
+        remove: Callable[[CIMultiDict[str], str], object],
+    ) -> None:
+        small = case_insensitive_multidict_class()
+        for i in range(4):
+            small[f"k{i}"] = str(i)
+        md = case_insensitive_multidict_class()
+        for i in range(1000):
+            md[f"k{i}"] = str(i)
+        peak = sys.getsizeof(md)
+        for i in reversed(range(4, 1000)):
+            remove(md, f"k{i}")
+        assert sys.getsizeof(md) < peak // 10
+        assert sys.getsizeof(md) <= 4 * sys.getsizeof(small)
+        assert list(md.items()) == [(f"k{i}", str(i)) for i in range(4)]
+
+    @pytest.mark.skipif(
+        sys.implementation.name == "pypy",
+        reason="getsizeof() is not implemented on PyPy",
+    )
+    def test_sizeof_no_resize_on_oscillation(
+        self,
+        case_insensitive_multidict_class: type[CIMultiDict[str]],
+    ) -> None:
+        md = case_insensitive_multidict_class()
+        for i in range(1000):
+            md[f"k{i}"] = str(i)
+        for i in range(20, 1000):
+            del md[f"k{i}"]
+        size = sys.getsizeof(md)
+        for _ in range(10):
+            md["extra"] = "1"
+            del md["extra"]
+            assert sys.getsizeof(md) == size
+
+    def test_shrink_keeps_duplicates_order(
+        self,
+        case_insensitive_multidict_class: type[CIMultiDict[str]],
+    ) -> None:
+        md = case_insensitive_multidict_class()
+        for i in range(1000):
+            md.add("a" if i % 100 == 0 else f"k{i}", str(i))
+        for i in range(1000):
+            if i % 100:
+                del md[f"k{i}"]
+        assert md.getall("a") == [str(i) for i in range(0, 1000, 100)]
+        md["b"] = "b"
+        assert md.popall("A") == [str(i) for i in range(0, 1000, 100)]
+        assert list(md.items()) == [("b", "b")]
+
     def test_issue_620_items(
         self,
         case_insensitive_multidict_class: type[CIMultiDict[str]],
@@ -915,3 +1022,45 @@ def test_multidict_shrink_regression() -> None:
     # Verify new entries
     for i in range(50):
         assert md[f"new{i}"] == f"val{i}"
+
+
+def test_large_multidict_grows_incrementally(
+    any_multidict_class: type[MultiDict[int]],
+) -> None:
+    # large enough for the C table to grow incrementally once and to give
+    # the memory of the replaced table back
+    md = any_multidict_class()
+    expected = []
+    for i in range(12000):
+        key = f"k{i % 8000}"
+        md.add(key, i)
+        expected.append((key, i))
+        if i % 2999 == 0:
+            assert md.copy() == md  # 8997 is in the middle of a resize
+    assert len(md) == 12000
+    assert list(md.items()) == expected
+    for i in range(0, 12000, 7):
+        assert md.getall(f"k{i % 8000}")[0] == i % 8000
+
+
+def test_mutations_during_incremental_resize(
+    any_multidict_class: type[MultiDict[int]],
+) -> None:
+    md = any_multidict_class()
+    model: dict[str, int] = {}
+    for i in range(10000):
+        md[f"k{i}"] = i
+        model[f"k{i}"] = i
+        if i % 3 == 0:
+            # replace an entry that may already be copied to the new table
+            md[f"k{i // 2}"] = -i
+            model[f"k{i // 2}"] = -i
+        if i % 5 == 0:
+            del md[f"k{i // 3}"]
+            del model[f"k{i // 3}"]
+            assert md.setdefault(f"k{i // 3}", i) == i
+            model[f"k{i // 3}"] = i
+    assert len(md) == len(model)
+    assert sorted(md.items()) == sorted(model.items())
+    for key, value in model.items():
+        assert md[key] == value
@@ -0,0 +1,323 @@
+import gc
+import pickle
+import random
+import weakref
+from types import ModuleType
+from typing import TYPE_CHECKING
+
+import pytest
+
+from multidict import (
+    FrozenMultiDict,
+    MultiDict,
+    MultiMapping,
+    MutableMultiMapping,
+    PersistentMultiDict,
+)
+
+if TYPE_CHECKING:
+    from conftest import MultidictImplementation
+
+_PMD_Class = type[PersistentMultiDict[object]]
+_FMD_Class = type[FrozenMultiDict[object]]
+_MD_Class = type[MultiDict[object]]
+
+
+def test_read_api(any_persistent_multidict_class: _PMD_Class) -> None:
+    d = any_persistent_multidict_class([("a", 1), ("b", 2), ("a", 3)], c=4)
+    assert len(d) == 4
+    assert d["a"] == 1
+    assert d.getone("b") == 2
+    assert d.getall("a") == [1, 3]
+    assert d.getall("x", []) == []
+    assert d.get("x") is None
+    assert d.get("c") == 4
+    assert d.count("a") == 2
+    assert d.count("x") == 0
+    assert "c" in d
+    assert "x" not in d
+    assert 1 not in d
+    assert list(d) == ["a", "b", "a", "c"]
+    assert list(d.keys()) == ["a", "b", "a", "c"]
+    assert list(d.items()) == [("a", 1), ("b", 2), ("a", 3), ("c", 4)]
+    assert list(d.values()) == [1, 2, 3, 4]
+    with pytest.raises(KeyError):
+        d["x"]
+    with pytest.raises(KeyError):
+        d.getall("x")
+
+
+def test_abc(any_persistent_multidict_class: _PMD_Class) -> None:
+    d = any_persistent_multidict_class(a=1)
+    assert isinstance(d, MultiMapping)
+    assert not isinstance(d, MutableMultiMapping)
+
+
+@pytest.mark.parametrize(
+    "mutation",
+    [
+        lambda d: d.__setitem__("a", 2),
+        lambda d: d.__delitem__("a"),
+        lambda d: d.add("a", 2),
+        lambda d: d.extend(a=2),
+        lambda d: d.clear(),
+    ],
+    ids=["setitem", "delitem", "add", "extend", "clear"],
+)
+def test_immutable(
+    any_persistent_multidict_class: _PMD_Class, mutation: object
+) -> None:
+    d = any_persistent_multidict_class(a=1)
+    with pytest.raises((TypeError, AttributeError)):
+        mutation(d)  # type: ignore[operator]
+    assert d == {"a": 1}
+
+
+def test_with_added(any_persistent_multidict_class: _PMD_Class) -> None:
+    d1 = any_persistent_multidict_class(a=1)
+    d2 = d1.with_added("b", 2)
+    d3 = d2.with_added("a", 3)
+    assert type(d3) is any_persistent_multidict_class
+    assert list(d1.items()) == [("a", 1)]
+    assert list(d2.items()) == [("a", 1), ("b", 2)]
+    assert list(d3.items()) == [("a", 1), ("b", 2), ("a", 3)]
+    assert d3.getall("a") == [1, 3]
+
+
+def test_with_replaced(any_persistent_multidict_class: _PMD_Class) -> None:
+    d1 = any_persistent_multidict_class([("a", 1), ("b", 2), ("a", 3)])
+    d2 = d1.with_replaced("a", 4)
+    d3 = d2.with_replaced("c", 5)
+    assert list(d1.items()) == [("a", 1), ("b", 2), ("a", 3)]
+    assert list(d2.items()) == [("a", 4), ("b", 2)]
+    assert list(d3.items()) == [("a", 4), ("b", 2), ("c", 5)]
+    assert len(d2) == 2
+
+
+def test_without(any_persistent_multidict_class: _PMD_Class) -> None:
+    d1 = any_persistent_multidict_class([("a", 1), ("b", 2), ("a", 3)])
+    d2 = d1.without("a")
+    assert list(d1.items()) == [("a", 1), ("b", 2), ("a", 3)]
+    assert list(d2.items()) == [("b", 2)]
+    d3 = d2.without("b")
+    assert len(d3) == 0
+    assert list(d3.items()) == []
+    assert list(d3.with_added("c", 4).items()) == [("c", 4)]
+    with pytest.raises(KeyError):
+        d3.without("b")
+
+
+def test_bad_key(any_persistent_multidict_class: _PMD_Class) -> None:
+    d = any_persistent_multidict_class(a=1)
+    with pytest.raises(TypeError):
+        d.with_added(1, 2)  # type: ignore[arg-type]
+    with pytest.raises(TypeError):
+        d.without(1)  # type: ignore[arg-type]
+
+
+@pytest.mark.parametrize("size", [5, 40, 1000, 5000])
+def test_updates(any_persistent_multidict_class: _PMD_Class, size: int) -> None:
+    rnd = random.Random(size)
+    keys = [f"key{i}" for i in range(size // 4 + 1)]
+    expected = MultiDict[int]()
+    d = any_persistent_multidict_class()
+    versions = []
+    for i in range(size):
+        key = rnd.choice(keys)
+        op = rnd.random()
+        if op < 0.5:
+            d = d.with_added(key, i)
+            expected.add(key, i)
+        elif op < 0.75:
+            d = d.with_replaced(key, i)
+            expected[key] = i
+        elif key in expected:
+            d = d.without(key)
+            del expected[key]
+        if i % 100 == 0:
+            versions.append((d, list(expected.items())))
+    assert len(d) == len(expected)
+    assert list(d.items()) == list(expected.items())
+    for key in keys:
+        assert d.getall(key, []) == expected.getall(key, [])
+    for version, items in versions:
+        assert list(version.items()) == items
+
+
+def test_many_removals(any_persistent_multidict_class: _PMD_Class) -> None:
+    d = any_persistent_multidict_class((f"key{i}", i) for i in range(100))
+    for i in range(95):
+        d = d.without(f"key{i}")
+    assert list(d.items()) == [(f"key{i}", i) for i in range(95, 100)]
+    d = d.with_added("key0", 0)
+    assert d["key0"] == 0
+    assert d["key99"] == 99
+
+
+@pytest.mark.parametrize("count", [32, 33, 1024, 1025, 2000])
+def test_many_values(any_persistent_multidict_class: _PMD_Class, count: int) -> None:
+    d = any_persistent_multidict_class(b=0)
+    for i in range(count):
+        d = d.with_added("a", i).with_added("b", i)
+    assert d.count("a") == count
+    assert d.getall("a") == list(range(count))
+    assert d["a"] == 0
+    assert d.getall("b") == [0, *range(count)]
+    replaced = d.with_replaced("a", -1)
+    assert replaced.getall("a") == [-1]
+    assert list(replaced.items())[:2] == [("b", 0), ("a", -1)]
+    assert len(replaced) == count + 2
+    removed = d.without("a")
+    assert "a" not in removed
+    assert removed.getall("b") == [0, *range(count)]
+    assert d.getall("a") == list(range(count))
+
+
+def test_from_multidict(
+    any_multidict_class: _MD_Class, any_persistent_multidict_class: _PMD_Class
+) -> None:
+    md = any_multidict_class([("a", 1), ("b", 2), ("a", 3)])
+    d = any_persistent_multidict_class(md)
+    md.add("c", 4)
+    del md["a"]
+    assert list(d.items()) == [("a", 1), ("b", 2), ("a", 3)]
+    assert d == any_multidict_class([("a", 1), ("b", 2), ("a", 3)])
+
+
+def test_to_multidict(
+    any_multidict_class: _MD_Class, any_persistent_multidict_class: _PMD_Class
+) -> None:
+    d = any_persistent_multidict_class([("a", 1), ("b", 2)])
+    md = any_multidict_class(d)
+    md.add("a", 3)
+    md.extend(d)
+    assert list(md.items()) == [("a", 1), ("b", 2), ("a", 3), ("a", 1), ("b", 2)]
+    assert list(d.items()) == [("a", 1), ("b", 2)]
+
+
+def test_frozen_equality(
+    any_frozen_multidict_class: _FMD_Class,
+    any_persistent_multidict_class: _PMD_Class,
+) -> None:
+    d = any_persistent_multidict_class([("a", 1), ("b", 2)])
+    f = any_frozen_multidict_class([("a", 1), ("b", 2)])
+    assert d == f
+    assert f == d
+    assert hash(d) == hash(f)
+    assert any_frozen_multidict_class(d) == d
+
+
+def test_copy_is_mutable(
+    any_multidict_class: _MD_Class, any_persistent_multidict_class: _PMD_Class
+) -> None:
+    d = any_persistent_multidict_class(a=1)
+    md = d.copy()
+    assert type(md) is any_multidict_class
+    md["a"] = 2
+    assert d["a"] == 1
+
+
+def test_same_object_reused(any_persistent_multidict_class: _PMD_Class) -> None:
+    d = any_persistent_multidict_class(a=1)
+    assert any_persistent_multidict_class(d) is d
+    assert any_persistent_multidict_class(d, b=2) is not d
+
+
+def test_hash(any_persistent_multidict_class: _PMD_Class) -> None:
+    d1 = any_persistent_multidict_class([("a", 1), ("b", 2)]).with_added("a", 3)
+    d2 = any_persistent_multidict_class([("a", 1), ("b", 2), ("a", 3)])
+    assert d1 == d2
+    assert hash(d1) == hash(d2)
+    assert {d1: "x"}[d2] == "x"
+    with pytest.raises(TypeError):
+        hash(any_persistent_multidict_class(a=[]))
+
+
+def test_ci(multidict_module: ModuleType) -> None:
+    d = multidict_module.PersistentCIMultiDict(Key="v")
+    assert d["key"] == "v"
+    d = d.with_added("KEY", "w")
+    assert d.getall("kEy") == ["v", "w"]
+    assert [type(k) for k in d] == [multidict_module.istr] * 2
+    d = d.with_replaced("key", "x")
+    assert list(d.items()) == [("key", "x")]
+    assert len(d.without("KEY")) == 0
+
+
+def test_ci_conversion(multidict_module: ModuleType) -> None:
+    d = multidict_module.PersistentMultiDict([("a", 1), ("A", 2)])
+    ci = multidict_module.PersistentCIMultiDict(d)
+    assert ci.getall("a") == [1, 2]
+    assert multidict_module.PersistentMultiDict(ci) == multidict_module.MultiDict(ci)
+
+
+def test_pickle(any_persistent_multidict_class: _PMD_Class) -> None:
+    d = any_persistent_multidict_class([("a", 1), ("b", 2), ("a", 3)])
+    for proto in range(pickle.HIGHEST_PROTOCOL + 1):
+        loaded = pickle.loads(pickle.dumps(d, proto))
+        assert type(loaded) is any_persistent_multidict_class
+        assert loaded == d
+
+
+def test_repr(any_persistent_multidict_class: _PMD_Class) -> None:
+    d = any_persistent_multidict_class([("a", 1), ("b", 2)])
+    name = any_persistent_multidict_class.__name__
+    assert repr(d) == f"<{name}('a': 1, 'b': 2)>"
+
+
+def test_subclass(any_persistent_multidict_class: _PMD_Class) -> None:
+    class Sub(any_persistent_multidict_class):  # type: ignore[valid-type,misc]
+        pass
+
+    d = Sub(a=1)
+    assert type(Sub(d)) is Sub
+    assert type(d.with_added("b", 2)) is Sub
+    assert type(any_persistent_multidict_class(d)) is any_persistent_multidict_class
+    assert d == any_persistent_multidict_class(a=1)
+
+
+def test_hash_collisions(any_persistent_multidict_class: _PMD_Class) -> None:
+    # the index folds hashes to 32 bits, find keys colliding after the fold
+    seen: dict[int, str] = {}
+    keys: list[str] = []
+    for i in range(300000):
+        key = f"k{i}"
+        h = hash(key.lower()) & 0xFFFFFFFFFFFFFFFF
+        h = (h & 0xFFFFFFFF) ^ (h >> 32)
+        if h in seen:
+            keys += [seen[h], key]
+            if len(keys) >= 4:
+                break
+        seen[h] = key
+    else:  # pragma: no cover
+        pytest.skip("No colliding keys found")
+    d = any_persistent_multidict_class()
+    for i, key in enumerate(keys):
+        d = d.with_added(key, i)
+    assert [d[key] for key in keys] == list(range(len(keys)))
+    d = d.with_replaced(keys[0], -1)
+    assert d[keys[0]] == -1
+    for key in keys:
+        d = d.without(key)
+        assert key not in d
+    assert len(d) == 0
+
+
+@pytest.fixture
+def c_persistent_class(
+    multidict_implementation: "MultidictImplementation",
+    any_persistent_multidict_class: _PMD_Class,
+) -> _PMD_Class:
+    if multidict_implementation.is_pure_python:
+        pytest.skip("The C implementation only")
+    return any_persistent_multidict_class
+
+
+def test_cycle_collected(c_persistent_class: _PMD_Class) -> None:
+    lst: list[object] = []
+    d = c_persistent_class(a=lst)
+    lst.append(d)
+    wr = weakref.ref(d)
+    del d, lst
+    gc.collect()
+    assert wr() is None
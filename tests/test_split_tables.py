@@ -0,0 +1,212 @@
+"""Tests for split tables sharing the key layout of equal-shaped multidicts."""
+
+import gc
+import sys
+import weakref
+from collections.abc import Callable
+from types import ModuleType
+from typing import Any
+
+import pytest
+
+# start with the empty layout cache
+pytestmark = [
+    pytest.mark.usefixtures("c_caches"),
+    pytest.mark.parametrize(
+        "c_caches", [{"split_layouts": None}], indirect=True, ids=["empty"]
+    ),
+]
+
+
+def _headers(**values: object) -> list[tuple[str, object]]:
+    # fresh key objects, like header names decoded from the wire
+    names = ["Content-Type", "Content-Length", "X-Request-Id", "Server"]
+    return [(name.encode().decode(), values.get(name, name)) for name in names]
+
+
+def _hits(c_module: ModuleType) -> int:
+    hits: int = c_module._split_layouts_stats()["hits"]
+    return hits
+
+
+def test_stats(c_module: ModuleType) -> None:
+    stats = c_module._split_layouts_stats()
+    assert set(stats) == {"hits", "misses", "used", "size"}
+    assert stats["used"] == 0
+
+
+def test_layout_is_shared(c_module: ModuleType) -> None:
+    md1 = c_module.CIMultiDict(_headers())
+    hits = _hits(c_module)
+    md2 = c_module.CIMultiDict(_headers(Server="nginx"))
+    assert _hits(c_module) == hits + 1
+    assert c_module._split_layouts_stats()["used"] == 1
+
+    assert md2["server"] == "nginx"
+    assert md2.getall("CONTENT-TYPE") == ["Content-Type"]
+    assert "x-request-id" in md2
+    assert "missing" not in md2
+    assert list(md2) == [name for name, _ in _headers()]
+    assert [type(k) for k in md2] == [c_module.istr] * 4
+    assert list(md2.values()) == [value for _, value in _headers(Server="nginx")]
+    assert md1["Server"] == "Server"
+
+
+@pytest.mark.skipif(
+    sys.implementation.name == "pypy", reason="PyPy has no sys.getsizeof()"
+)
+def test_split_table_is_compact(c_module: ModuleType) -> None:
+    c_module.MultiDict(_headers())
+    md = c_module.MultiDict(_headers())
+    private = c_module.MultiDict()
+    private.extend(_headers())
+    assert md == private
+    assert sys.getsizeof(md) < sys.getsizeof(private)
+
+
+def test_keys_are_case_sensitive(c_module: ModuleType) -> None:
+    c_module.CIMultiDict([("Key", 1), ("Other", 2)])
+    md = c_module.CIMultiDict([("Key", 3), ("OTHER", 4)])
+    assert list(md.items()) == [("Key", 3), ("OTHER", 4)]
+    md = c_module.MultiDict([("Key", 3), ("Other", 4), ("Key", 5)])
+    assert md.getall("Key") == [3, 5]
+
+
+def test_duplicate_keys(c_module: ModuleType) -> None:
+    c_module.MultiDict([("a", 1), ("b", 2), ("a", 3)])
+    hits = _hits(c_module)
+    md = c_module.MultiDict([("a", 4), ("b", 5), ("a", 6)])
+    assert _hits(c_module) == hits + 1
+    assert md.getall("a") == [4, 6]
+    assert md.popall("a") == [4, 6]
+    assert list(md.items()) == [("b", 5)]
+
+
+def test_str_subclass_keys(c_module: ModuleType) -> None:
+    class S(str):
+        pass
+
+    c_module.MultiDict([("a", 1)])
+    hits = _hits(c_module)
+    md = c_module.MultiDict([(S("a"), 2)])
+    assert _hits(c_module) == hits
+    assert type(next(iter(md))) is S
+
+
+@pytest.mark.parametrize(
+    "mutation",
+    [
+        lambda d: d.__setitem__("server", "x"),
+        lambda d: d.__setitem__("new", "x"),
+        lambda d: d.add("server", "x"),
+        lambda d: d.__delitem__("server"),
+        lambda d: d.popone("server"),
+        lambda d: d.popall("server"),
+        lambda d: d.popitem(),
+        lambda d: d.setdefault("new", "x"),
+        lambda d: d.extend(new="x"),
+        lambda d: d.update(server="x"),
+        lambda d: d.merge(new="x"),
+        lambda d: d.clear(),
+        lambda d: d.clear(keep_capacity=True),
+        lambda d: d.reserve(100),
+        lambda d: d.shrink_to_fit(),
+    ],
+)
+def test_mutation(c_module: ModuleType, mutation: Callable[[Any], object]) -> None:
+    md1 = c_module.CIMultiDict(_headers())
+    md2 = c_module.CIMultiDict(_headers())
+    expected = c_module.CIMultiDict()
+    expected.extend(_headers())
+    mutation(md2)
+    mutation(expected)
+    assert list(md2.items()) == list(expected.items())
+    assert list(md1.items()) == _headers()
+    md2.add("Last", 1)
+    assert md2.getall("last") == [1]
+    assert list(md1.items()) == _headers()
+
+
+@pytest.mark.parametrize("method", [None, "extend", "update", "merge"])
+def test_ci_keys_stay_str(c_module: ModuleType, method: str | None) -> None:
+    # the keys of published layouts are not converted to istr, a case
+    # sensitive multidict built from them keeps the original keys
+    items = [("Content-Type", 9), ("key54", 3)]
+    published = c_module.CIMultiDict(items)
+    hits = _hits(c_module)
+    shared = c_module.CIMultiDict(items)
+    assert _hits(c_module) == hits + 1
+    for ci in (published, shared):
+        if method is None:
+            md = c_module.MultiDict(ci)
+        else:
+            md = c_module.MultiDict()
+            getattr(md, method)(ci)
+        assert md["Content-Type"] == 9
+        assert md.get("content-type") is None
+        assert md.popone("Content-Type") == 9
+
+
+def test_copy(c_module: ModuleType) -> None:
+    c_module.MultiDict(_headers())
+    md = c_module.MultiDict(_headers())
+    copy = md.copy()
+    frozen = c_module.FrozenMultiDict(md)
+    copy["Server"] = "x"
+    assert md["Server"] == "Server"
+    assert frozen["Server"] == "Server"
+    assert copy == c_module.MultiDict(_headers(Server="x"))
+    md.clear()
+    assert frozen == c_module.MultiDict(_headers())
+
+
+def test_frozen(c_module: ModuleType) -> None:
+    d1 = c_module.FrozenCIMultiDict(_headers())
+    hits = _hits(c_module)
+    d2 = c_module.FrozenCIMultiDict(_headers())
+    assert _hits(c_module) == hits + 1
+    assert d1 == d2
+    assert hash(d1) == hash(d2)
+    assert d2["content-type"] == "Content-Type"
+
+
+def test_views(c_module: ModuleType) -> None:
+    c_module.MultiDict(_headers())
+    md = c_module.MultiDict(_headers())
+    assert ("Server", "Server") in md.items()
+    assert "Server" in md.values()
+    assert list(md.items()) == _headers()
+    assert repr(md).startswith("<MultiDict('Content-Type': 'Content-Type'")
+
+
+def test_gc_tracking(c_module: ModuleType) -> None:
+    c_module.MultiDict([("a", 1), ("b", 2)])
+    assert not gc.is_tracked(c_module.MultiDict([("a", 1), ("b", 2)]))
+    lst: list[object] = []
+    md = c_module.MultiDict([("a", 1), ("b", lst)])
+    assert gc.is_tracked(md)
+    lst.append(md)
+    wr = weakref.ref(md)
+    del md, lst
+    gc.collect()
+    assert wr() is None
+
+
+def test_disable(c_module: ModuleType) -> None:
+    c_module.MultiDict(_headers())
+    c_module._set_split_layouts_size(0)
+    stats = c_module._split_layouts_stats()
+    assert stats["used"] == 0
+    assert stats["size"] == 0
+
+    hits = _hits(c_module)
+    md = c_module.MultiDict(_headers())
+    md = c_module.MultiDict(_headers())
+    assert _hits(c_module) == hits
+    assert list(md.items()) == _headers()
+
+
+@pytest.mark.parametrize("size", [-1, 3, 1024])
+def test_set_size_invalid(c_module: ModuleType, size: int) -> None:
+    with pytest.raises(ValueError, match="power of two"):
+        c_module._set_split_layouts_size(size)
@@ -1,8 +1,16 @@
 from collections import deque
+from typing import TYPE_CHECKING
+
+import pytest
+
+import pytest
 
 from multidict import CIMultiDict, MultiDict
 from multidict._multidict_py import MultiDict as PyMultiDict
 
+if TYPE_CHECKING:
+    from conftest import MultidictImplementation
+
 _MD_Classes = type[MultiDict[int]] | type[CIMultiDict[int]]
 
 
@@ -150,6 +158,60 @@ def test_update_with_empty_slots(any_multidict_class: _MD_Classes) -> None:
     assert obj == {"1": 100}
 
 
+def test_update_large_without_resize(any_multidict_class: _MD_Classes) -> None:
+    # the update touches a few entries of a large table, no resize happens
+    obj = any_multidict_class((str(i), i) for i in range(1000))
+    obj.add("5", 5)
+    obj.add("7", 7)
+    obj.add("7", 8)
+    obj.update([("5", 50), ("7", 70), ("new", 1)], **{"20": 200})
+    expected = [(str(i), i) for i in range(1000)]
+    expected[5] = ("5", 50)
+    expected[7] = ("7", 70)
+    expected[20] = ("20", 200)
+    expected.append(("new", 1))
+    assert list(obj.items()) == expected
+    assert obj.getall("7") == [70]
+    obj.update({"5": 51})
+    assert obj.getall("5") == [51]
+
+
+def test_update_large_many_touched(any_multidict_class: _MD_Classes) -> None:
+    obj = any_multidict_class((str(i), i) for i in range(1000))
+    obj.extend((str(i), -i) for i in range(100))
+    obj.update((str(i), i * 10) for i in range(0, 200, 2))
+    for i in range(0, 200, 2):
+        assert obj.getall(str(i)) == [i * 10]
+    for i in range(1, 100, 2):
+        assert obj.getall(str(i)) == [i, -i]
+    assert len(obj) == 1050
+
+
+def test_merge_large_without_resize(any_multidict_class: _MD_Classes) -> None:
+    obj = any_multidict_class((str(i), i) for i in range(1000))
+    obj.merge({"5": 50, "new": 1})
+    assert obj["5"] == 5
+    assert obj["new"] == 1
+    assert len(obj) == 1001
+
+
+@pytest.mark.parametrize("replaced", [1, 10, 40])
+def test_update_removes_duplicates(
+    any_multidict_class: _MD_Classes, replaced: int
+) -> None:
+    items = [(f"k{i % 40}", i) for i in range(120)]
+    obj = any_multidict_class(items)
+    obj.update({f"k{i}": -i for i in range(replaced)})
+    expected = [(k, v) for k, v in items if int(k[1:]) >= replaced]
+    assert sorted(obj.items()) == sorted(
+        expected + [(f"k{i}", -i) for i in range(replaced)]
+    )
+    for i in range(40):
+        assert obj.getall(f"k{i}") == ([-i] if i < replaced else [i, i + 40, i + 80])
+    obj.add("k0", 1000)
+    assert obj.getall("k0")[-1] == 1000
+
+
 def test_pure_python_parse_args_size_hint_with_seq_and_kwargs() -> None:
     """Regression test for pure-Python ``_parse_args`` size hint.
 
@@ -194,3 +256,57 @@ def test_pure_python_parse_args_size_hint_with_md_and_kwargs() -> None:
     entries = list(it)
 
     assert size_hint == len(entries) == len(arg) + len(kwargs)
+
+
+def test_extend_md_with_deleted_entries(any_multidict_class: _MD_Classes) -> None:
+    obj1 = any_multidict_class((str(i), i) for i in range(20))
+    obj2 = any_multidict_class((str(i), -i) for i in range(10, 40))
+    for i in range(0, 20, 3):
+        del obj1[str(i)]
+    for i in range(10, 40, 4):
+        del obj2[str(i)]
+    expected = list(obj1.items()) + list(obj2.items())
+    obj1.extend(obj2)
+    assert list(obj1.items()) == expected
+    assert obj1.getall("11") == [11, -11]
+    assert obj1.getall("14") == [14]
+    assert obj1.getall("15") == [-15]
+
+
+def test_extend_md_no_resize(any_multidict_class: _MD_Classes) -> None:
+    obj1 = any_multidict_class((str(i), i) for i in range(100))
+    obj1.popall("0")
+    obj2 = any_multidict_class([("1", -1), ("new", 0)])
+    obj1.extend(obj2)
+    assert obj1.getall("1") == [1, -1]
+    assert obj1["new"] == 0
+    assert len(obj1) == 101
+
+
+
+def test_extend_md_by_itself(
+    any_multidict_class: _MD_Classes,
+    multidict_implementation: "MultidictImplementation",
+) -> None:
+    if multidict_implementation.is_pure_python:
+        pytest.skip("The pure Python implementation iterates over the added entries")
+    for size in (3, 100):
+        obj = any_multidict_class((str(i), i) for i in range(size))
+        expected = list(obj.items()) * 2
+        obj.extend(obj)
+        assert list(obj.items()) == expected
+        assert obj.getall("1") == [1, 1]
+
+
+def test_update_resize_with_deleted_entries(any_multidict_class: _MD_Classes) -> None:
+    obj = any_multidict_class((str(i), i) for i in range(10))
+    obj.add("1", -1)
+    del obj["5"]
+    new = [(f"n{i}", i) for i in range(100)]
+    obj.update([("1", 10), *new, ("1", 11), ("1", 12)])
+    expected = [(str(i), i) for i in range(10) if i != 5]
+    expected[1] = ("1", 10)
+    expected += [("1", 11), *new, ("1", 12)]
+    assert list(obj.items()) == expected
+    assert obj.getall("1") == [10, 11, 12]
+    assert "5" not in obj
@@ -0,0 +1,263 @@
+#!/usr/bin/env python3
+"""Generate multidict/_multilib/headers.h.
+
+The header contains a perfect hash table of well-known HTTP header names
+used by the C extension to resolve case-insensitive keys to shared
+identities without lowering and hashing them.
+
+Run the script after editing HEADERS:
+
+    python tools/gen_headers.py
+"""
+
+import pathlib
+import random
+import re
+
+HEADERS = (
+    "Accept",
+    "Accept-Charset",
+    "Accept-Encoding",
+    "Accept-Language",
+    "Accept-Patch",
+    "Accept-Ranges",
+    "Access-Control-Allow-Credentials",
+    "Access-Control-Allow-Headers",
+    "Access-Control-Allow-Methods",
+    "Access-Control-Allow-Origin",
+    "Access-Control-Expose-Headers",
+    "Access-Control-Max-Age",
+    "Access-Control-Request-Headers",
+    "Access-Control-Request-Method",
+    "Age",
+    "Allow",
+    "Alt-Svc",
+    "Authorization",
+    "Cache-Control",
+    "Clear-Site-Data",
+    "Connection",
+    "Content-Disposition",
+    "Content-Encoding",
+    "Content-Language",
+    "Content-Length",
+    "Content-Location",
+    "Content-MD5",
+    "Content-Range",
+    "Content-Security-Policy",
+    "Content-Security-Policy-Report-Only",
+    "Content-Transfer-Encoding",
+    "Content-Type",
+    "Cookie",
+    "Cross-Origin-Embedder-Policy",
+    "Cross-Origin-Opener-Policy",
+    "Cross-Origin-Resource-Policy",
+    "Date",
+    "Destination",
+    "Digest",
+    "DNT",
+    "Early-Data",
+    "ETag",
+    "Expect",
+    "Expires",
+    "Forwarded",
+    "From",
+    "Host",
+    "If-Match",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "If-Unmodified-Since",
+    "Keep-Alive",
+    "Last-Event-ID",
+    "Last-Modified",
+    "Link",
+    "Location",
+    "Max-Forwards",
+    "Origin",
+    "Permissions-Policy",
+    "Pragma",
+    "Priority",
+    "Proxy-Authenticate",
+    "Proxy-Authorization",
+    "Proxy-Connection",
+    "Range",
+    "Referer",
+    "Referrer-Policy",
+    "Retry-After",
+    "Sec-CH-UA",
+    "Sec-CH-UA-Mobile",
+    "Sec-CH-UA-Platform",
+    "Sec-Fetch-Dest",
+    "Sec-Fetch-Mode",
+    "Sec-Fetch-Site",
+    "Sec-Fetch-User",
+    "Sec-WebSocket-Accept",
+    "Sec-WebSocket-Extensions",
+    "Sec-WebSocket-Key",
+    "Sec-WebSocket-Key1",
+    "Sec-WebSocket-Protocol",
+    "Sec-WebSocket-Version",
+    "Server",
+    "Server-Timing",
+    "Set-Cookie",
+    "Strict-Transport-Security",
+    "TE",
+    "Timing-Allow-Origin",
+    "Trailer",
+    "Transfer-Encoding",
+    "Upgrade",
+    "Upgrade-Insecure-Requests",
+    "URI",
+    "User-Agent",
+    "Vary",
+    "Via",
+    "Want-Digest",
+    "Warning",
+    "WWW-Authenticate",
+    "X-Content-Type-Options",
+    "X-Forwarded-For",
+    "X-Forwarded-Host",
+    "X-Forwarded-Proto",
+    "X-Frame-Options",
+    "X-Real-IP",
+    "X-Request-ID",
+    "X-Requested-With",
+    "X-XSS-Protection",
+)
+
+TABLE_BITS = 10
+MASK64 = (1 << 64) - 1
+
+OUTPUT = pathlib.Path(__file__).parent.parent / "multidict/_multilib/headers.h"
+
+
+def calc_words(name: bytes) -> tuple[int, int]:
+    # must match headers_hash() in the generated code
+    n = min(len(name), 8)
+    head = int.from_bytes(name[:n], "little")
+    tail = int.from_bytes(name[-n:], "little")
+    return head, tail
+
+
+def calc_hash(name: bytes, mult: tuple[int, int, int]) -> int:
+    head, tail = calc_words(name)
+    h = (head * mult[0]) ^ (tail * mult[1]) ^ (len(name) * mult[2])
+    return (h & MASK64) >> (64 - TABLE_BITS)
+
+
+def find_multipliers(names: list[bytes]) -> tuple[int, int, int]:
+    # the hash reads the first and the last 8 bytes and the length only
+    assert all(name == name.lower() and name.isascii() for name in names)
+    assert len({(calc_words(name), len(name)) for name in names}) == len(names)
+    rnd = random.Random(0)
+    for _ in range(100000):
+        mult = (
+            rnd.getrandbits(64) | 1,
+            rnd.getrandbits(64) | 1,
+            rnd.getrandbits(64) | 1,
+        )
+        if len({calc_hash(name, mult) for name in names}) == len(names):
+            return mult
+    raise RuntimeError("no perfect hash multipliers")
+
+
+def c_ident(name: str) -> str:
+    return "HDR_" + re.sub(r"[^A-Z0-9]", "_", name.upper())
+
+
+def main() -> None:
+    assert len(set(HEADERS)) == len(HEADERS)
+    assert len(HEADERS) < 255
+    names = [name.lower().encode("ascii") for name in HEADERS]
+    mult = find_multipliers(names)
+    table = [0] * (1 << TABLE_BITS)
+    for i, name in enumerate(names):
+        table[calc_hash(name, mult)] = i + 1
+
+    out = []
+    out.append("/* Generated by tools/gen_headers.py, do not edit. */\n")
+    out.append("#ifndef _MULTIDICT_HEADERS_H\n#define _MULTIDICT_HEADERS_H\n")
+    out.append('#ifdef __cplusplus\nextern "C" {\n#endif\n')
+    out.append("#include <Python.h>\n#include <stdint.h>\n#include <string.h>\n")
+    out.append(
+        "/* Well-known HTTP header names.\n"
+        "\n"
+        "   The first and the last 8 bytes of a lowered name are read as two\n"
+        "   little-endian words, a perfect hash of the words and the length\n"
+        "   selects the only candidate header ID.  headers_find() in intern.h\n"
+        "   compares the words and the middle part of longer names with the\n"
+        "   candidate.  The module state keeps the shared identity of every\n"
+        "   header.\n"
+        "*/\n"
+    )
+    out.append("typedef enum {")
+    for i, name in enumerate(HEADERS):
+        out.append(f"    {c_ident(name)} = {i},")
+    out.append("} header_id_t;\n")
+    out.append(f"#define HEADERS_COUNT {len(HEADERS)}")
+    out.append(f"#define HEADERS_MAX_LENGTH {max(map(len, names))}")
+    out.append(f"#define HEADERS_TABLE_BITS {TABLE_BITS}")
+    for i, m in enumerate(mult):
+        out.append(f"#define HEADERS_MULT{i} 0x{m:016X}ULL")
+    out.append("")
+    out.append(
+        "typedef struct {\n"
+        "    const char *name;\n"
+        "    uint64_t head;\n"
+        "    uint64_t tail;\n"
+        "    Py_ssize_t len;\n"
+        "} header_name_t;\n"
+    )
+    out.append("// lowered names, the identities of the headers")
+    out.append("static const header_name_t headers_names[HEADERS_COUNT] = {")
+    for name in names:
+        head, tail = calc_words(name)
+        out.append(f'    {{"{name.decode()}",')
+        out.append(f"     0x{head:016X}ULL,")
+        out.append(f"     0x{tail:016X}ULL,")
+        out.append(f"     {len(name)}}},")
+    out.append("};\n")
+    out.append("// header ID + 1 by the perfect hash, 0 for unused slots")
+    out.append("static const uint8_t headers_table[1 << HEADERS_TABLE_BITS] = {")
+    for i in range(0, len(table), 16):
+        out.append("    " + ", ".join(str(v) for v in table[i : i + 16]) + ",")
+    out.append("};\n")
+    out.append(
+        """/* Return the little-endian word of n <= 8 bytes of ASCII data
+   with 'A'-'Z' replaced by 'a'-'z' */
+static inline uint64_t
+headers_lower_word(const Py_UCS1 *data, Py_ssize_t n)
+{
+    uint64_t word = 0;
+#if PY_LITTLE_ENDIAN
+    if (n == 8) {
+        memcpy(&word, data, 8);
+    } else
+#endif
+    {
+        for (Py_ssize_t i = 0; i < n; i++) {
+            word |= (uint64_t)data[i] << (8 * i);
+        }
+    }
+    // ASCII bytes are below 0x80, the sums don't carry into the next byte
+    const uint64_t high = 0x8080808080808080ULL;
+    uint64_t ge_a = word + 0x3F3F3F3F3F3F3F3FULL;  // 0x80 - 'A'
+    uint64_t gt_z = word + 0x2525252525252525ULL;  // 0x7F - 'Z'
+    return word | ((ge_a & ~gt_z & high) >> 2);
+}
+
+static inline int
+headers_candidate(uint64_t head, uint64_t tail, Py_ssize_t len)
+{
+    uint64_t h = (head * HEADERS_MULT0) ^ (tail * HEADERS_MULT1) ^
+                 ((uint64_t)len * HEADERS_MULT2);
+    return (int)headers_table[h >> (64 - HEADERS_TABLE_BITS)] - 1;
+}
+"""
+    )
+    out.append("#ifdef __cplusplus\n}\n#endif\n#endif")
+    OUTPUT.write_text("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main()